@@ -84,6 +84,8 @@ struct thread_data {
 	int			disconnect;
 	int			do_stat;
 	pthread_t		thread_id;
+	uint64_t		cycles_per_msg;
+	uint64_t		insns_per_msg;
 };
 
 /* private session data */
@@ -186,6 +188,24 @@ static void *statistics_thread_cb(void *data)
 	return NULL;
 }
 
+/*---------------------------------------------------------------------------*/
+/* perf_counters_cb							     */
+/*---------------------------------------------------------------------------*/
+static int perf_counters_cb(const struct xio_stat *stat, void *user_context)
+{
+	struct thread_data	*tdata = (struct thread_data *)user_context;
+
+	if (stat->scope != XIO_STAT_SCOPE_CONTEXT)
+		return 0;
+
+	if (!strcmp(stat->name, "PERF_CYCLES_PER_MSG"))
+		tdata->cycles_per_msg = stat->value;
+	else if (!strcmp(stat->name, "PERF_INSNS_PER_MSG"))
+		tdata->insns_per_msg = stat->value;
+
+	return 0;
+}
+
 /*---------------------------------------------------------------------------*/
 /* worker_thread							     */
 /*---------------------------------------------------------------------------*/
@@ -275,6 +295,9 @@ static void *worker_thread(void *data)
 		xio_mem_free(&tdata->reg_mem);
 
 
+	if (tdata->user_param->perf_counters)
+		xio_query_stats(tdata->ctx, perf_counters_cb, tdata);
+
 	/* free the context */
 	xio_context_destroy(tdata->ctx);
 
@@ -428,6 +451,11 @@ int run_client_test(struct perf_parameters *user_param)
 
 	xio_init();
 
+	if (user_param->perf_counters)
+		xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+			    XIO_OPTNAME_ENABLE_PERF_COUNTERS,
+			    &user_param->perf_counters, sizeof(int));
+
 	if (user_param->output_file) {
                 fd = fopen(user_param->output_file, "w");
                 if (fd == NULL) {
@@ -560,6 +588,16 @@ int run_client_test(struct perf_parameters *user_param)
 		       sess_data.avg_lat_us,
 		       sess_data.min_lat_us,
 		       sess_data.max_lat_us);
+		if (user_param->perf_counters) {
+			uint64_t cycles = 0, insns = 0;
+
+			for (i = 0; i < threads_iter; i++) {
+				cycles += sess_data.tdata[i].cycles_per_msg;
+				insns += sess_data.tdata[i].insns_per_msg;
+			}
+			printf(PERF_COUNTERS_FMT,
+			       cycles / threads_iter, insns / threads_iter);
+		}
 		if (fd)
 			fprintf(fd, "%lu, %d, %lu, %.2lf, %.2lf\n",
 				data_len,
@@ -187,6 +187,9 @@ void usage(const char *argv0, int status)
 	       XIO_DEF_START_THREAD);
 
 
+	printf("\t-e, --perf_counters ");
+	printf("\t\t\tReport cycles and instructions per message\n");
+
 	printf("\t-v, --version ");
 	printf("\t\t\t\t\tPrint the version and exit\n");
 
@@ -257,6 +260,7 @@ static void init_perf_params(struct perf_parameters *user_param)
 	user_param->transport		= NULL;
 	user_param->portals_arr		= NULL;
 	user_param->portals_arr_len     = 0;
+	user_param->perf_counters	= 0;
 	user_param->server_addr		= NULL;
 	user_param->intf_name		= NULL;
 }
@@ -323,12 +327,13 @@ int parse_cmdline(struct perf_parameters *user_param,
 			{ .name = "queue_depth", .has_arg = 1, .val = 'q'},
 			{ .name = "output_file", .has_arg = 1, .val = 'o'},
 			{ .name = "start_thread",.has_arg = 1, .val = 's'},
+			{ .name = "perf_counters",.has_arg = 0, .val = 'e'},
 			{ .name = "version",	 .has_arg = 0, .val = 'v'},
 			{ .name = "help",	 .has_arg = 0, .val = 'h'},
 			{0, 0, 0, 0},
 		};
 
-		static char *short_options = "c:i:p:n:r:w:t:q:o:s:vh";
+		static char *short_options = "c:i:p:n:r:w:t:q:o:s:evh";
 
 		c = getopt_long(argc, argv, short_options,
 				long_options, NULL);
@@ -446,6 +451,9 @@ int parse_cmdline(struct perf_parameters *user_param,
 			}
 			user_param->start_thread = l;
 			break;
+		case 'e':
+			user_param->perf_counters = 1;
+			break;
 		case 'v':
 			printf("version: %s\n", XIO_PERF_VERSION);
 			exit(0);
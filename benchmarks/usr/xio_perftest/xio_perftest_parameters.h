@@ -91,6 +91,8 @@ typedef enum { READ, WRITE} Verb;
 #define RESULT_FMT		" #bytes     #threads   #TPS       BW average[MBps]   Latency average[usecs]   Latency low[usecs]   Latency peak[usecs]\n"
 /* Result print format */
 #define REPORT_FMT		" %-7lu     %-2d         %-9.2lu	  %-9.2lf     %-9.2lf                  %-9.2lf              %-9.2lf\n"
+/* Hardware counters print format */
+#define PERF_COUNTERS_FMT	"             cycles/msg %-9lu instructions/msg %-9lu\n"
 
 
 struct perf_parameters {
@@ -101,7 +103,7 @@ struct perf_parameters {
 	uint32_t		poll_timeout;
 	uint32_t		threads_num;
 	uint32_t		portals_arr_len;
-	uint32_t		pad;
+	uint32_t		perf_counters;
 	TestType		test_type;
 	MachineType		machine_type;
 	Verb			verb;
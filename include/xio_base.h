@@ -49,7 +49,7 @@ extern "C" {
  * @def XIO_VERSION
  * @brief accelio current api version number
  */
-#define XIO_VERSION			0x0101
+#define XIO_VERSION			0x0102
 
 /**
  * @def XIO_IOVLEN
@@ -222,9 +222,29 @@ enum xio_msg_flags {
 	 */
 	XIO_MSG_FLAG_LAST_IN_BATCH	  = (1 << 4),
 
+	/** priority class of the message - two bits, see XIO_MSG_FLAG_PRIO.
+	 * class 0 is the default and is transmitted first, classes 1 to 3
+	 * are for progressively less urgent (e.g. bulk) traffic. messages of
+	 * the same class are transmitted in order
+	 */
+	XIO_MSG_FLAG_PRIO_MASK		  = (3 << 5),
+
 	/* [1<<10 and above - reserved for library usage] */
 };
 
+/** number of message priority classes */
+#define XIO_MSG_PRIO_NR			4
+#define XIO_MSG_FLAG_PRIO_SHIFT		5
+
+/** flags value that sets priority class prio on a message */
+#define XIO_MSG_FLAG_PRIO(prio) \
+	(((uint64_t)(prio) << XIO_MSG_FLAG_PRIO_SHIFT) & XIO_MSG_FLAG_PRIO_MASK)
+
+/** priority class of a message */
+#define xio_msg_prio(msg) \
+	((int)(((msg)->flags & XIO_MSG_FLAG_PRIO_MASK) >> \
+	       XIO_MSG_FLAG_PRIO_SHIFT))
+
 /**
  * @enum xio_msg_hints
  * @brief message level specific hints
@@ -330,7 +350,37 @@ struct xio_options_keepalive {
  * @brief supported context attributes to query/modify
  */
 enum xio_context_attr_mask {
-	XIO_CONTEXT_ATTR_USER_CTX		= 1 << 0
+	XIO_CONTEXT_ATTR_USER_CTX		= 1 << 0,
+	XIO_CONTEXT_ATTR_MEM_STATS		= 1 << 1
+};
+
+/**
+ * @enum xio_mem_class
+ * @brief internal memory consumers accounted per context
+ */
+enum xio_mem_class {
+	XIO_MEM_CLASS_TASKS_POOL,	/**< tasks, slabs and their private   */
+					/**< transport data		      */
+	XIO_MEM_CLASS_INLINE_BUFS,	/**< transport inline data buffers    */
+	XIO_MEM_CLASS_MEMPOOL,		/**< internal mempool regions	      */
+	XIO_MEM_CLASS_OBJPOOL,		/**< objects pools (e.g. msg pool)    */
+	XIO_MEM_CLASS_TRANSPORT,	/**< transport handles		      */
+	XIO_MEM_CLASS_SCRATCH,		/**< transport scratch space (iovecs, */
+					/**< temporary rx buffers)	      */
+	XIO_MEM_CLASS_NEXUS,		/**< nexus objects		      */
+	XIO_MEM_CLASS_CONNECTION,	/**< connection objects		      */
+	XIO_MEM_CLASS_LAST
+};
+
+/**
+ * @struct xio_mem_stats
+ * @brief live memory accounting of one memory class
+ */
+struct xio_mem_stats {
+	uint64_t		bytes;		/**< bytes currently allocated */
+	uint64_t		objs;		/**< objects currently backed  */
+						/**< by that memory	       */
+	uint64_t		peak_bytes;	/**< high watermark of bytes   */
 };
 
 /**
@@ -341,8 +391,20 @@ struct xio_context_attr {
 	void			*user_context;  /**< private user context to */
 						/**< pass to connection      */
 						/**< oriented callbacks      */
+	struct xio_mem_stats	mem_stats[XIO_MEM_CLASS_LAST];
+						/**< memory accounting - see */
+						/**< enum xio_mem_class	     */
 };
 
+/**
+ * get the name of a memory class
+ *
+ * @param[in] mem_class	memory class
+ *
+ * @return the name of the memory class
+ */
+const char *xio_mem_class_str(enum xio_mem_class mem_class);
+
 /**
  * closes the xio context and free its resources
  *
@@ -382,6 +444,111 @@ int xio_query_context(struct xio_context *ctx,
 		      struct xio_context_attr *attr,
 		      int attr_mask);
 
+/**
+ * @enum xio_stat_scope
+ * @brief object a statistic belongs to
+ */
+enum xio_stat_scope {
+	XIO_STAT_SCOPE_CONTEXT,
+	XIO_STAT_SCOPE_SESSION,
+	XIO_STAT_SCOPE_CONNECTION,
+	XIO_STAT_SCOPE_NEXUS
+};
+
+/**
+ * @enum xio_stat_type
+ * @brief kind of a statistic
+ */
+enum xio_stat_type {
+	XIO_STAT_TYPE_COUNTER,		/**< monotonic count		      */
+	XIO_STAT_TYPE_GAUGE,		/**< current level		      */
+	XIO_STAT_TYPE_HISTOGRAM,	/**< log2 distribution of samples     */
+	XIO_STAT_TYPE_LATENCY		/**< log-linear distribution of	      */
+					/**< delays, see xio_latency_stats    */
+};
+
+/** bucket 0 counts zero samples, bucket i samples in [2^(i-1), 2^i)	      */
+#define XIO_STAT_HIST_BUCKETS	64
+
+/**
+ * @struct xio_latency_stats
+ * @brief summary of a latency distribution, quantiles are reported as the
+ *	  upper bound of their bucket - within 1/8 of the true value
+ */
+struct xio_latency_stats {
+	uint64_t		samples;
+	uint64_t		mean_ns;
+	uint64_t		p50_ns;
+	uint64_t		p99_ns;
+	uint64_t		p999_ns;
+	uint64_t		max_ns;
+};
+
+/**
+ * @struct xio_stat
+ * @brief one statistic as reported by xio_query_stats
+ */
+struct xio_stat {
+	const char		*name;
+	void			*owner;	  /**< context, session,	      */
+					  /**< connection or nexus	      */
+	enum xio_stat_scope	scope;
+	enum xio_stat_type	type;
+	uint64_t		value;	  /**< samples for histograms	      */
+	uint64_t		sum;	  /**< sum of histogram samples	      */
+	const uint64_t		*buckets; /**< XIO_STAT_HIST_BUCKETS	      */
+					  /**< entries for histograms	      */
+	struct xio_latency_stats latency; /**< for latencies, value holds    */
+					  /**< the samples, sum is in ns     */
+};
+
+/**
+ * callback called per statistic by xio_query_stats
+ *
+ * @param[in] stat		the statistic - valid during the call only
+ * @param[in] user_context	as passed to xio_query_stats
+ *
+ * @return 0 to continue, nonzero to stop the enumeration
+ */
+typedef int (*xio_stat_fn_t)(const struct xio_stat *stat, void *user_context);
+
+/**
+ * enumerate the statistics of the context and of the sessions,
+ * connections and nexuses it runs; must be called from the context's thread
+ *
+ * @param[in] ctx		The xio context handle
+ * @param[in] fn		callback called per statistic
+ * @param[in] user_context	passed to the callback
+ *
+ * @return 0 on success, the callback's nonzero value if it stopped the
+ *	    enumeration or -1 on error.  If an error occurs, call
+ *	    xio_errno function to get the failure reason.
+ */
+int xio_query_stats(struct xio_context *ctx, xio_stat_fn_t fn,
+		    void *user_context);
+
+/**
+ * write the context's flight recorder - its most recent connection and
+ * transport events - to a file descriptor.  the output is decoded by the
+ * xio_flight tool
+ *
+ * @param[in] ctx	The xio context handle
+ * @param[in] fd	file descriptor open for writing
+ *
+ * @return 0 on success, or -1 on error.  If an error occurs, call
+ *	    xio_errno function to get the failure reason.
+ */
+int xio_context_dump_flight(struct xio_context *ctx, int fd);
+
+/**
+ * get the name of a statistic scope
+ *
+ * @param[in] scope	statistic scope
+ *
+ * @return the name of the scope
+ */
+const char *xio_stat_scope_str(enum xio_stat_scope scope);
+
 /**
  * poll for events using direct access to the event signaling resources
  * (e.g. hw event queues) associated with the context;
@@ -405,6 +572,56 @@ int xio_query_context(struct xio_context *ctx,
  */
 int xio_context_poll_completions(struct xio_context *ctx, int timeout_us);
 
+/**
+ * @enum xio_cq_event_type
+ * @brief message events delivered through the context completion queue
+ */
+enum xio_cq_event_type {
+	XIO_CQ_EVENT_MSG,		  /**< on_msg - request, response or  */
+					  /**< one way message arrived	      */
+	XIO_CQ_EVENT_MSG_SEND_COMPLETE,	  /**< on_msg_send_complete	      */
+	XIO_CQ_EVENT_OW_MSG_SEND_COMPLETE, /**< on_ow_msg_send_complete	      */
+	XIO_CQ_EVENT_MSG_DELIVERED,	  /**< on_msg_delivered		      */
+	XIO_CQ_EVENT_MSG_ERROR		  /**< on_msg_error		      */
+};
+
+/**
+ * @struct xio_cq_event
+ * @brief completion queue entry, the arguments of the matching callback
+ */
+struct xio_cq_event {
+	enum xio_cq_event_type	type;		/**< event type		      */
+	enum xio_status		status;		/**< error of MSG_ERROR	      */
+	enum xio_msg_direction	direction;	/**< direction of MSG_ERROR   */
+	int			last_in_rxq;	/**< last in receive queue    */
+	struct xio_session	*session;	/**< the message session      */
+	struct xio_connection	*conn;		/**< the message connection   */
+	struct xio_msg		*msg;		/**< the message	      */
+	void			*conn_user_context; /**< connection user      */
+						/**< context		      */
+};
+
+/**
+ * harvests message events of a context created with a completion queue
+ *
+ * in that mode messages, completions and message errors are not passed to
+ * the session callbacks but queued on the context in order of arrival. the
+ * application owns each harvested message exactly as it would inside the
+ * callback and releases it with the same calls. events are queued while
+ * the context loop runs, poll between loop iterations (e.g. after
+ * xio_context_poll_wait). events still queued when their connection is
+ * destroyed are dropped, harvest them before destroying the connection
+ *
+ * @param[in] ctx	Pointer to the xio context handle
+ * @param[out] events	array to fill with harvested events
+ * @param[in] nevents	maximum number of events to harvest
+ *
+ * @return number of events harvested, or -1 on error.  If an error
+ *	    occurs, call xio_errno function to get the failure reason.
+ */
+int xio_poll_cq(struct xio_context *ctx, struct xio_cq_event *events,
+		int nevents);
+
 /*---------------------------------------------------------------------------*/
 /* XIO session API                                                           */
 /*---------------------------------------------------------------------------*/
@@ -456,7 +673,9 @@ enum xio_session_event {
 enum xio_session_attr_mask {
 	XIO_SESSION_ATTR_USER_CTX		= 1 << 0,
 	XIO_SESSION_ATTR_SES_OPS		= 1 << 1,
-	XIO_SESSION_ATTR_URI			= 1 << 2
+	XIO_SESSION_ATTR_URI			= 1 << 2,
+	XIO_SESSION_ATTR_TX_WEIGHT		= 1 << 3,
+	XIO_SESSION_ATTR_SND_QUEUE_DEPTH	= 1 << 4
 };
 
 /**
@@ -485,6 +704,17 @@ struct xio_session_attr {
 	struct xio_session_ops	*ses_ops;	/**< session's ops callbacks  */
 	void			*user_context;  /**< session user context     */
 	char			*uri;		/**< the uri		      */
+	uint32_t		tx_weight;	/**< share of a transport     */
+						/**< shared with other	      */
+						/**< sessions, 1 by default   */
+	uint32_t		snd_queue_depth_msgs;
+						/**< most messages queued for */
+						/**< sending, see	      */
+						/**< XIO_OPTNAME_SND_QUEUE_   */
+						/**< DEPTH_MSGS		      */
+	uint64_t		snd_queue_depth_bytes;
+						/**< most bytes queued for    */
+						/**< sending		      */
 };
 
 /**
@@ -689,6 +919,48 @@ struct xio_session_ops {
 	int (*on_rdma_direct_complete)(struct xio_session *session,
 				       struct xio_msg *msg,
 				       void *conn_user_context);
+
+	/**
+	 * batched message arrived notification - replaces on_msg when set
+	 *
+	 *  @param[in] session			the session
+	 *  @param[in] msgs			the incoming messages, in arrival
+	 *					order. the array is valid only
+	 *					during the callback, each message
+	 *					is owned as if passed to on_msg
+	 *  @param[in] nmsgs			number of messages
+	 *  @param[in] conn_user_context	user private data provided in
+	 *					connection open on which
+	 *					the messages arrived
+	 *  @return 0
+	 *  @note  messages a connection receives in one transport poll are
+	 *	   passed in one call
+	 */
+	int (*on_msg_batch)(struct xio_session *session,
+			    struct xio_msg **msgs,
+			    int nmsgs,
+			    void *conn_user_context);
+
+	/**
+	 * batched send completion notification - replaces
+	 * on_msg_send_complete and on_ow_msg_send_complete when set
+	 *
+	 *  @param[in] session			the session
+	 *  @param[in] msgs			the sent responses and one way
+	 *					messages, in completion order. the
+	 *					array is valid only during the
+	 *					callback
+	 *  @param[in] nmsgs			number of messages
+	 *  @param[in] conn_user_context	user private data provided on
+	 *					connection creation
+	 *  @return 0
+	 *  @note  completions are coalesced per connection - see
+	 *	   XIO_CONNECTION_ATTR_COMP_COALESCING
+	 */
+	int (*on_msg_send_complete_batch)(struct xio_session *session,
+					  struct xio_msg **msgs,
+					  int nmsgs,
+					  void *conn_user_context);
 };
 
 /**
@@ -761,6 +1033,11 @@ enum xio_connection_attr_mask {
 	XIO_CONNECTION_ATTR_PEER_ADDR		= 1 << 3,
 	XIO_CONNECTION_ATTR_LOCAL_ADDR		= 1 << 4,
 	XIO_CONNECTION_ATTR_DISCONNECT_TIMEOUT	= 1 << 5,
+	XIO_CONNECTION_ATTR_AGGREGATION		= 1 << 6,
+	XIO_CONNECTION_ATTR_PRIO_WEIGHTS	= 1 << 7,
+	XIO_CONNECTION_ATTR_PRIO_STATS		= 1 << 8,
+	XIO_CONNECTION_ATTR_COMP_COALESCING	= 1 << 9,
+	XIO_CONNECTION_ATTR_LATENCY		= 1 << 10,
 };
 
 /**
@@ -778,6 +1055,44 @@ struct xio_connection_attr {
 	enum xio_proto		proto;	        /**< protocol type           */
 	struct sockaddr_storage	peer_addr;	/**< address of peer	     */
 	struct sockaddr_storage	local_addr;	/**< address of local	     */
+	uint32_t		agg_max_bytes;	/**< pack small one way      */
+						/**< messages into one wire  */
+						/**< message up to this size */
+						/**< 0 - aggregation is off  */
+	uint32_t		agg_max_delay_us; /**< longest time a message */
+						/**< waits for others to     */
+						/**< share its wire message, */
+						/**< up to 1 s. ms granular  */
+						/**< from 1 ms, polled below */
+	uint16_t		prio_weights[XIO_MSG_PRIO_NR];
+						/**< messages sent per class */
+						/**< in each round, all 0 -  */
+						/**< strict priority	     */
+	uint32_t		prio_queued_msgs[XIO_MSG_PRIO_NR];
+						/**< messages waiting per    */
+						/**< class (query only)      */
+	uint32_t		prio_max_queued_msgs[XIO_MSG_PRIO_NR];
+						/**< most messages waited    */
+						/**< per class (query only)  */
+	uint32_t		comp_max_msgs;	/**< send completions passed */
+						/**< to on_msg_send_complete_*/
+						/**< batch at once, 0 - those*/
+						/**< of one loop pass	     */
+	uint32_t		comp_max_delay_us; /**< longest time a	      */
+						/**< completion waits for    */
+						/**< others to share a call, */
+						/**< up to 1 s. ms granular  */
+						/**< from 1 ms, polled below */
+	struct xio_latency_stats rtt;		/**< request to response,    */
+						/**< modifying the LATENCY   */
+						/**< attribute clears all    */
+						/**< three distributions     */
+	struct xio_latency_stats app_hold;	/**< request delivered to    */
+						/**< response sent (query    */
+						/**< only)		     */
+	struct xio_latency_stats queueing;	/**< message sent to handed  */
+						/**< to the transport (query */
+						/**< only)		     */
 };
 
 /**
@@ -871,6 +1186,53 @@ int xio_query_connection(struct xio_connection *conn,
 			 struct xio_connection_attr *attr,
 			 int attr_mask);
 
+/**
+ * @enum xio_msg_stage
+ * @brief stages of a sampled request's life, see XIO_OPTNAME_MSG_SAMPLE_RATE
+ */
+enum xio_msg_stage {
+	XIO_MSG_STAGE_QUEUED,		/**< waited in the connection's queues */
+					/**< for a task or flow control credits*/
+	XIO_MSG_STAGE_XMIT,		/**< waited for the transport to hand  */
+					/**< it all to the socket or the qp    */
+	XIO_MSG_STAGE_WIRE,		/**< on the network both ways - round  */
+					/**< trip less the server's time       */
+	XIO_MSG_STAGE_SERVER_QUEUE,	/**< arrived at the server until	*/
+					/**< delivered to its application      */
+	XIO_MSG_STAGE_SERVER_APP,	/**< in the server's application until */
+					/**< the response left its queues      */
+	XIO_MSG_STAGE_DELIVER,		/**< response arrived until delivered  */
+					/**< to the application		       */
+	XIO_MSG_STAGE_NR
+};
+
+/**
+ * @struct xio_msg_breakdown
+ * @brief where the time of a sampled request went
+ */
+struct xio_msg_breakdown {
+	void			*user_context;	/**< of the request	      */
+	uint64_t		sn;		/**< of the request	      */
+	uint64_t		total_ns;	/**< submitted to delivered   */
+	uint64_t		stage_ns[XIO_MSG_STAGE_NR];
+};
+
+/**
+ * fetch the breakdowns of the latest sampled requests answered on the
+ * connection, oldest first. the connection keeps the last 32 and a fetched
+ * breakdown is not returned again. must be called from the connection's
+ * context thread
+ *
+ * @param[in] conn	The xio connection handle
+ * @param[out] bd	array of breakdowns to fill
+ * @param[in] nr	number of entries in bd
+ *
+ * @return number of breakdowns filled, or -1 on error.  If an error occurs,
+ *	    call xio_errno function to get the failure reason.
+ */
+int xio_connection_get_breakdowns(struct xio_connection *conn,
+				  struct xio_msg_breakdown *bd, int nr);
+
 /**
  * @enum xio_connection_optname
  * @brief connection option name
@@ -948,6 +1310,22 @@ int xio_send_response_error(struct xio_msg *msg, enum xio_status result);
  */
 int xio_release_response(struct xio_msg *rsp);
 
+/**
+ * cancel a request previously passed to xio_send_request
+ *
+ * a request still waiting in the send queue is dropped at once, a request
+ * already transmitted is completed when its response arrives, the response
+ * is released by the library. in both cases on_msg_error is called with
+ * XIO_E_MSG_CANCELED and XIO_MSG_DIRECTION_OUT
+ *
+ * @param[in] conn	The xio connection handle
+ * @param[in] req	The request to cancel
+ *
+ * @return 0 on success, or -1 on error.  If an error occurs, call
+ *	    xio_errno function to get the failure reason.
+ */
+int xio_cancel_request(struct xio_connection *conn, struct xio_msg *req);
+
 /**
  * safely retain request message on responder side after sending the response
  *
@@ -1227,6 +1605,40 @@ enum xio_optname {
 	XIO_OPTNAME_ENABLE_KEEPALIVE,
 	/**< configure keep alive variables.type: struct xio_options_keepalive*/
 	XIO_OPTNAME_CONFIG_KEEPALIVE,
+	/**< publish contexts' counters in /dev/shm/xio.<pid>.<ctx> for the
+	 * xio_stat tool. disabled by default. set before creating contexts.
+	 * type: int
+	 */
+	XIO_OPTNAME_ENABLE_STATS_SHM,
+	/**< time the life of one in every N requests, see
+	 * xio_connection_get_breakdowns. 0 (default) disables. type: int
+	 */
+	XIO_OPTNAME_MSG_SAMPLE_RATE,
+	/**< dump the contexts' flight recorders to
+	 * $XDG_RUNTIME_DIR/xio_flight.<pid>.<ctx> (or /tmp when unset) when
+	 * this signal is delivered, see
+	 * xio_context_dump_flight. 0 (default) installs no handler. set before
+	 * creating contexts. type: int
+	 */
+	XIO_OPTNAME_FLIGHT_DUMP_SIGNAL,
+	/**< dump a context's flight recorder on a connection error,
+	 * keepalive timeout or loss of an online connection. disabled by
+	 * default. type: int
+	 */
+	XIO_OPTNAME_FLIGHT_DUMP_ON_ERROR,
+	/**< format log messages on the calling thread but write them from
+	 * a background thread, dropping messages when a thread's queue is
+	 * full. applies to the default log function. disabled by default.
+	 * type: int
+	 */
+	XIO_OPTNAME_LOG_ASYNC,
+	/**< sample the loop thread's hardware performance counters (cycles,
+	 * instructions, cache misses, context switches) per event loop phase
+	 * and report them, with cycles and instructions per message, in the
+	 * context's statistics. costs a system call per loop phase. user space
+	 * only. disabled by default. set before creating contexts. type: int
+	 */
+	XIO_OPTNAME_ENABLE_PERF_COUNTERS,
 
 	/* XIO_OPTLEVEL_ACCELIO/RDMA/TCP */
 	/** message's max in iovec. This flag indicates what will be the max
@@ -1355,12 +1767,20 @@ enum xio_optname {
 	 * xio_connection 2 file descriptors are used.
 	 */
 	XIO_OPTNAME_TCP_DUAL_STREAM,
+	/** large payloads are sent in fragments of this size, so small
+	 * messages on the same socket are not stuck behind them. the
+	 * smaller value of the two peers is used, 0 on either side
+	 * disables fragmentation. default is 64KB
+	 */
+	XIO_OPTNAME_TCP_FRAG_SIZE,
 };
 
 /**
  * Callback prototype for libxio log message handler.
  * The library user may wish to register their own logging function.
- * By default errors go to stderr.
+ * By default messages go to stderr, errors and warnings at most ten a
+ * second from any one call site - the number suppressed is logged once
+ * the second is over.
  * Use xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO, XIO_OPTNAME_LOG_FN, NULL, 0)
  * to restore the default log fn.
  *
@@ -140,6 +140,12 @@ struct xio_msg {
 
 	struct xio_msg_pdata	pdata;		/**< accelio private data     */
 	struct xio_msg		*next;          /* internal use */
+	uint32_t		timeout_us;	/* request deadline after
+						 * submission, 0 - none. on
+						 * receive the time left when
+						 * it was transmitted
+						 */
+	uint32_t		pad;
 };
 
 #define vmsg_sglist_nents(vmsg)					\
@@ -286,6 +292,12 @@ struct xio_context_params {
 	/** per context memory allocator. if not exist use global one           */
 	int			 allocator_assigned;
 	struct xio_mem_allocator mem_allocator;
+
+	/**< deliver message events to a context completion queue harvested	*/
+	/**< by xio_poll_cq instead of the session callbacks. initial depth,	*/
+	/**< the queue grows as needed. 0 - use the callbacks			*/
+	int			cq_depth;
+	int			pad;
 };
 
 /**
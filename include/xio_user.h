@@ -156,6 +156,11 @@ struct xio_msg {
 
 	struct xio_msg_pdata	pdata;		/**< accelio private data     */
 	struct xio_msg		*next;          /**< send list of messages    */
+	uint32_t		timeout_us;	/**< request deadline after   */
+						/**< submission, 0 - none. on */
+						/**< receive the time left    */
+						/**< when it was transmitted  */
+	uint32_t		pad;
 };
 
 /**
@@ -258,11 +263,23 @@ struct xio_context_params {
 	* pass 0 if want the depth to remain default (XIO_MAX_IOV + constant)   */
 	int                     rq_depth;
 
-	int			resereved;
+	/**< allocate every task slab - tasks, transport data and inline	*/
+	/**< buffers - as one prefaulted huge page region (tcp only)		*/
+	int			contig_task_slabs;
 
 	/** per context memory allocator. if not exist use global one           */
 	int			 allocator_assigned;
 	struct xio_mem_allocator mem_allocator;
+
+	/**< lean per connection footprint for many mostly idle connections:	*/
+	/**< tiny task slabs grown on demand, no receive buffers held by idle	*/
+	/**< connections and unused slabs released after idle time (tcp only)	*/
+	int			lean_conns;
+
+	/**< deliver message events to a context completion queue harvested	*/
+	/**< by xio_poll_cq instead of the session callbacks. initial depth,	*/
+	/**< the queue grows as needed. 0 - use the callbacks			*/
+	int			cq_depth;
 };
 
 
@@ -410,6 +427,37 @@ void xio_context_stop_loop(struct xio_context *ctx);
  */
 int xio_context_poll_wait(struct xio_context *ctx, int timeout_ms);
 
+/**
+ * serve runtime tuning requests on a unix datagram socket, from the
+ * context's event loop.  each datagram holds one text request and gets
+ * one text reply:
+ *
+ *	options				list the options, their values and
+ *					whether they reach existing
+ *					connections ("live") or new ones only
+ *	get <option>			read an option
+ *	set <option> <value>		update an option, see xio_set_opt
+ *	conns				list the context's connections
+ *	conn <handle>			list a connection's parameters
+ *	conn <handle> get <param>	read a connection parameter
+ *	conn <handle> set <param> <value>
+ *					update a connection parameter, see
+ *					xio_modify_connection and
+ *					xio_modify_session
+ *
+ * inline sizes can only be lowered at runtime.  failed requests are
+ * answered with "error <reason>".  the socket is created owner only and
+ * removed when the context is destroyed.  the xio_ctl tool sends requests
+ *
+ * @param[in] ctx	The xio context handle
+ * @param[in] path	socket path, a stale socket there is replaced.
+ *			NULL closes the context's socket
+ *
+ * @return 0 on success, or -1 on error.  If an error occurs, call
+ *	    xio_errno function to get the failure reason.
+ */
+int xio_context_open_control(struct xio_context *ctx, const char *path);
+
 
 /*---------------------------------------------------------------------------*/
 /* library initialization routines					     */
@@ -601,6 +649,96 @@ int xio_mempool_alloc(struct xio_mempool *mpool,
  */
 void xio_mempool_free(struct xio_reg_mem *reg_mem);
 
+/*---------------------------------------------------------------------------*/
+/* hedged requests							     */
+/*---------------------------------------------------------------------------*/
+struct xio_hedge;
+
+/**
+ * @struct xio_hedge_ops
+ * @brief completion callbacks of hedged requests
+ */
+struct xio_hedge_ops {
+	/** first response to arrive. rsp is valid only during the callback */
+	/** and is released by the library when it returns		       */
+	int (*on_response)(struct xio_hedge *hedge,
+			   struct xio_msg *req,
+			   struct xio_msg *rsp,
+			   void *cb_user_context);
+
+	/** all copies of the request failed, error holds the last failure   */
+	int (*on_error)(struct xio_hedge *hedge,
+			struct xio_msg *req,
+			enum xio_status error,
+			void *cb_user_context);
+};
+
+/**
+ * @struct xio_hedge_params
+ * @brief hedged requests group parameters
+ */
+struct xio_hedge_params {
+	struct xio_hedge_ops	*ops;		/**< completion callbacks     */
+	struct xio_connection	**conns;	/**< redundant connections    */
+	uint32_t		nconns;		/**< number of connections    */
+	uint32_t		percentile;	/**< latency percentile after */
+						/**< which a request is hedged*/
+						/**< 0 - default (95)	      */
+	uint32_t		min_delay_us;	/**< hedge delay floor, used  */
+						/**< until latency is known   */
+						/**< 0 - default (1000). the  */
+						/**< hedge timer ticks in ms  */
+	uint32_t		pad;
+	void			*user_context;	/**< passed to the callbacks  */
+};
+
+/**
+ * creates a group of redundant connections for hedged requests
+ *
+ * requests are sent on the connection that answers fastest. a request
+ * with no response by the configured percentile of the observed latency is
+ * sent again on the next connection, the first response wins and the other
+ * copy is canceled. meant for small idempotent requests - the request is
+ * copied and may execute more than once. the connections must belong to
+ * ctx and outlive the group
+ *
+ * @param[in] ctx	The xio context handle
+ * @param[in] params	The group parameters
+ *
+ * @return hedged requests group handle, or NULL upon error
+ */
+struct xio_hedge *xio_hedge_create(struct xio_context *ctx,
+				   struct xio_hedge_params *params);
+
+/**
+ * destroys a hedged requests group
+ *
+ * fails while requests await their callbacks. canceled copies still in
+ * flight are released by the library as they complete
+ *
+ * @param[in] hedge	The group handle
+ *
+ * @return 0 on success, or -1 on error.  If an error occurs, call
+ *	    xio_errno function to get the failure reason.
+ */
+int xio_hedge_destroy(struct xio_hedge *hedge);
+
+/**
+ * send a hedged request
+ *
+ * the request out side is copied, so the application may reuse it once
+ * the call returns. the request "in" side only sets the largest expected
+ * response - each copy receives into a private buffer of that size and the
+ * response is delivered through xio_hedge_ops
+ *
+ * @param[in] hedge	The group handle
+ * @param[in] req	request message to send
+ *
+ * @return 0 on success, or -1 on error.  If an error occurs, call
+ *	    xio_errno function to get the failure reason.
+ */
+int xio_hedge_send_request(struct xio_hedge *hedge, struct xio_msg *req);
+
 #ifdef __cplusplus
 }
 #endif
@@ -86,6 +86,28 @@ enum xio_msg_flags_ex {
 	XIO_MSG_FLAG_EX_IMM_READ_RECEIPT  = BIT(10), /**< immediate receipt  */
 	XIO_MSG_FLAG_EX_RECEIPT_FIRST	  = BIT(11), /**< read receipt first */
 	XIO_MSG_FLAG_EX_RECEIPT_LAST	  = BIT(12), /**< read receipt last  */
+	XIO_MSG_FLAG_EX_AGGREGATED	  = BIT(13), /**< packed one way msgs */
+	XIO_MSG_FLAG_EX_CANCELED	  = BIT(14), /**< canceled in flight  */
+	XIO_MSG_FLAG_EX_HOOKED		  = BIT(15), /**< library owned msg   */
+	XIO_MSG_FLAG_EX_SAMPLED		  = BIT(16), /**< lifecycle is timed  */
+};
+
+/* local state bits never sent to the peer */
+#define XIO_MSG_FLAG_EX_LOCAL	(XIO_MSG_FLAG_EX_CANCELED | \
+				 XIO_MSG_FLAG_EX_HOOKED)
+
+struct xio_connection;
+
+/* completion of requests the library sends on its own behalf. such
+ * requests carry XIO_MSG_FLAG_EX_HOOKED and their user_context points to
+ * the hooks, the session callbacks never see them
+ */
+struct xio_msg_hooks {
+	void (*on_response)(struct xio_connection *connection,
+			    struct xio_msg *msg);
+	void (*on_error)(struct xio_connection *connection,
+			 struct xio_msg *msg, enum xio_status error,
+			 enum xio_msg_direction direction);
 };
 
 #define xio_clear_ex_flags(flag) \
@@ -200,7 +222,11 @@ struct xio_options {
 	int			inline_xio_data_align;
 	int			enable_keepalive;
 	int			transport_close_timeout;
-	int			pad;
+	int			enable_stats_shm;
+	int			msg_sample_rate;
+	int			flight_dump_signal;
+	int			flight_dump_on_error;
+	int			enable_perf_counters;
 
 	struct xio_options_keepalive ka;
 };
@@ -222,7 +248,11 @@ PACKED_MEMORY(struct xio_session_hdr {
 	uint16_t		sn;		/* serial number	*/
 	uint16_t		ack_sn;		/* ack serial number	*/
 	uint16_t		credits_msgs;
-	uint16_t		pad[3];
+	uint16_t		pad;
+	uint32_t		timeout_us;	/* time left to deadline, */
+						/* server's share of a	  */
+						/* sampled round trip on  */
+						/* its response		  */
 	uint32_t		receipt_result;
 	uint64_t		credits_bytes;
 	uint64_t		connection;
@@ -236,12 +266,34 @@ PACKED_MEMORY(struct xio_session_hdr {
 	uint16_t		sn;		/* serial number	*/
 	uint16_t		ack_sn;		/* ack serial number	*/
 	uint16_t		credits_msgs;
-	uint16_t		pad[3];
+	uint16_t		pad;
+	uint32_t		timeout_us;	/* time left to deadline, */
+						/* server's share of a	  */
+						/* sampled round trip on  */
+						/* its response		  */
 	uint32_t		receipt_result;
 	uint64_t		credits_bytes;
 });
 #endif
 
+/* header of an aggregated message, the totals let the receiver return the
+ * credits of packed messages it could not unpack
+ */
+PACKED_MEMORY(struct xio_agg_msg_hdr {
+	uint32_t		nr;		/* packed messages	*/
+	uint32_t		pad;
+	uint64_t		bytes;		/* their flow control	*/
+						/* bytes		*/
+});
+
+/* sub header of each one way message packed into an aggregated message */
+PACKED_MEMORY(struct xio_agg_hdr {
+	uint64_t		serial_num;
+	uint32_t		data_len;
+	uint16_t		hdr_len;
+	uint16_t		flags;		/* application flags	*/
+});
+
 /* setup flags */
 #define XIO_CID			1
 
@@ -55,11 +55,16 @@
 #include "xio_context.h"
 #include "xio_nexus.h"
 #include "xio_session.h"
+#include "xio_stats.h"
+#include "xio_flight.h"
 #include "xio_connection.h"
 #include <xio_env_adv.h>
 
 #define MSG_POOL_SZ			1024
 #define XIO_IOV_THRESHOLD		20
+#define XIO_MSG_BATCH_MAX		64
+#define XIO_COMP_BATCH_MAX		1024
+#define XIO_CONNECTION_BREAKDOWNS	32
 /*#define ENABLE_KA_LOGS */
 
 static struct xio_transition xio_transition_table[][2] = {
@@ -126,6 +131,12 @@ static void xio_connection_keepalive_time(int actual_timeout_ms, void *_connecti
 static void xio_close_time_wait(int actual_timeout_ms, void *data);
 static void xio_close_time_wait_handler(int actual_timeout_ms, void *data);
 static void xio_handle_last_ack(void *data);
+static void xio_connection_deadline_handler(int actual_timeout_ms,
+					    void *_connection);
+static void xio_connection_agg_flush_timeout(int actual_timeout_ms,
+					     void *_connection);
+static void xio_connection_comp_timeout(int actual_timeout_ms,
+					void *_connection);
 
 struct xio_managed_rkey {
 	struct list_head	list_entry;
@@ -188,6 +199,284 @@ static inline int xio_is_connection_online(struct xio_connection *connection)
 		   connection->session->state == XIO_SESSION_STATE_ONLINE;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_connection_msg_prio						     */
+/*---------------------------------------------------------------------------*/
+static inline int xio_connection_msg_prio(struct xio_msg *msg)
+{
+	/* fin is queued last, other library messages first */
+	if (!IS_APPLICATION_MSG(msg->type))
+		return IS_FIN(msg->type) ? XIO_MSG_PRIO_NR - 1 : 0;
+
+	return xio_msg_prio(msg);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_queue_msg						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_connection_queue_msg(struct xio_connection *connection,
+					    struct xio_msg_list *msgq,
+					    struct xio_msg *msg)
+{
+	int prio = xio_connection_msg_prio(msg);
+
+	xio_msg_list_insert_tail(&msgq[prio], msg, pdata);
+	if (++connection->prio_queued_msgs[prio] >
+	    connection->prio_max_queued_msgs[prio])
+		connection->prio_max_queued_msgs[prio] =
+			connection->prio_queued_msgs[prio];
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_queue_batch						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_connection_queue_batch(struct xio_connection *connection,
+					      struct xio_msg_list *msgq,
+					      struct xio_msg_list *batch,
+					      uint32_t *nr)
+{
+	int prio;
+
+	for (prio = 0; prio < XIO_MSG_PRIO_NR; prio++) {
+		if (!nr[prio])
+			continue;
+		xio_msg_list_concat(&msgq[prio], &batch[prio], pdata);
+		connection->prio_queued_msgs[prio] += nr[prio];
+		if (connection->prio_queued_msgs[prio] >
+		    connection->prio_max_queued_msgs[prio])
+			connection->prio_max_queued_msgs[prio] =
+				connection->prio_queued_msgs[prio];
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_dequeue_msg						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_connection_dequeue_msg(struct xio_connection *connection,
+					      struct xio_msg_list *msgq,
+					      struct xio_msg *msg)
+{
+	xio_msg_list_remove(msgq, msg, pdata);
+	connection->prio_queued_msgs[xio_connection_msg_prio(msg)]--;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_prio_pending						     */
+/*---------------------------------------------------------------------------*/
+/* returns nonzero if messages of a class more urgent than prio wait */
+static inline int xio_connection_prio_pending(struct xio_connection *connection,
+					      int prio)
+{
+	while (prio--)
+		if (connection->prio_queued_msgs[prio])
+			return 1;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_ns_now						     */
+/*---------------------------------------------------------------------------*/
+static inline uint64_t xio_connection_ns_now(void)
+{
+	struct timespec ts;
+
+	xio_clock_gettime(&ts);
+
+	return (ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_delay_arm						     */
+/*---------------------------------------------------------------------------*/
+/* arms the wait of a coalescing delay. a delay under a millisecond is
+ * polled by re-posting the event, a longer one waits on a timer so the
+ * loop may sleep
+ */
+static void xio_connection_delay_arm(struct xio_connection *connection,
+				     uint32_t delay_us,
+				     struct xio_ev_data *event,
+				     xio_ctx_delayed_work_t *work,
+				     void (*timeout_handler)(int, void *))
+{
+	if (delay_us < XIO_COALESCE_POLL_DELAY_US) {
+		xio_context_add_event(connection->ctx, event);
+		return;
+	}
+	if (xio_ctx_add_delayed_work(connection->ctx, delay_us / 1000,
+				     connection, timeout_handler, work)) {
+		ERROR_LOG("xio_ctx_add_delayed_work failed.\n");
+		/* flush on the next pass rather than hold them forever */
+		xio_context_add_event(connection->ctx, event);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_req_deadline						     */
+/*---------------------------------------------------------------------------*/
+/* a request's deadline in cycles, counted from its submission. 0 - none */
+static inline uint64_t xio_connection_req_deadline(
+		struct xio_connection *connection, struct xio_msg *msg)
+{
+	if (!msg->timeout_us)
+		return 0;
+
+	return msg->timestamp +
+	       xio_stat_ns_to_cycles(msg->timeout_us * 1000ULL,
+				     connection->ctx->stats.hertz);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_req_drop_status					     */
+/*---------------------------------------------------------------------------*/
+/* status a queued request is dropped with instead of transmitting it */
+static inline enum xio_status xio_connection_req_drop_status(
+		struct xio_connection *connection, struct xio_msg *msg)
+{
+	uint64_t deadline;
+
+	if (msg->type != XIO_MSG_TYPE_REQ)
+		return XIO_E_SUCCESS;
+
+	if (unlikely(msg->flags & XIO_MSG_FLAG_EX_CANCELED))
+		return XIO_E_MSG_CANCELED;
+
+	deadline = xio_connection_req_deadline(connection, msg);
+	if (deadline && get_cycles() >= deadline)
+		return XIO_E_TIMEOUT;
+
+	return XIO_E_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_drop_req						     */
+/*---------------------------------------------------------------------------*/
+/* removes a request that was never transmitted from its send queue */
+static void xio_connection_drop_req(struct xio_connection *connection,
+				    struct xio_msg_list *msgq,
+				    struct xio_msg *msg)
+{
+	xio_connection_dequeue_msg(connection, msgq, msg);
+
+	if (connection->enable_flow_control) {
+		struct xio_sg_table_ops	*sgtbl_ops;
+		void			*sgtbl;
+
+		sgtbl	  = xio_sg_table_get(&msg->out);
+		sgtbl_ops = (struct xio_sg_table_ops *)
+			xio_sg_table_ops_get(msg->out.sgl_type);
+
+		connection->tx_queued_msgs--;
+		connection->tx_bytes -= msg->out.header.iov_len +
+					tbl_length(sgtbl_ops, sgtbl);
+	}
+	msg->flags &= ~XIO_MSG_FLAG_EX_CANCELED;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_deadline_arm						     */
+/*---------------------------------------------------------------------------*/
+/* keeps the deadline timer armed for the earliest queued request deadline */
+static void xio_connection_deadline_arm(struct xio_connection *connection,
+					uint64_t deadline)
+{
+	uint64_t now;
+	uint64_t ns = 0;
+
+	if (xio_is_delayed_work_pending(&connection->deadline_work)) {
+		if (deadline >= connection->deadline_next)
+			return;
+		xio_ctx_del_delayed_work(connection->ctx,
+					 &connection->deadline_work);
+	}
+	now = get_cycles();
+	connection->deadline_next = deadline;
+	if (deadline > now)
+		ns = xio_stat_cycles_to_ns(deadline - now,
+					   connection->ctx->stats.hertz);
+
+	if (xio_ctx_add_delayed_work(
+			connection->ctx,
+			(int)((ns + 999999) / 1000000),
+			connection, xio_connection_deadline_handler,
+			&connection->deadline_work))
+		ERROR_LOG("xio_ctx_add_delayed_work failed.\n");
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_deadline_handler					     */
+/*---------------------------------------------------------------------------*/
+static void xio_connection_deadline_handler(int actual_timeout_ms,
+					    void *_connection)
+{
+	struct xio_connection	*connection =
+					(struct xio_connection *)_connection;
+	struct xio_msg_list	expired;
+	struct xio_msg		*pmsg, *tmp_pmsg;
+	uint64_t		now = get_cycles();
+	uint64_t		next = 0;
+	uint64_t		deadline;
+	int			prio;
+
+	xio_msg_list_init(&expired);
+
+	/* requests stuck behind others are dropped here, the head of a
+	 * queue is also checked just before it is transmitted
+	 */
+	for (prio = 0; prio < XIO_MSG_PRIO_NR; prio++) {
+		xio_msg_list_foreach_safe(pmsg, &connection->reqs_msgq[prio],
+					  tmp_pmsg, pdata) {
+			deadline = xio_connection_req_deadline(connection,
+							       pmsg);
+			if (pmsg->type != XIO_MSG_TYPE_REQ || !deadline)
+				continue;
+			if (now >= deadline) {
+				xio_connection_drop_req(
+						connection,
+						&connection->reqs_msgq[prio],
+						pmsg);
+				xio_msg_list_insert_tail(&expired, pmsg, pdata);
+			} else if (!next || deadline < next) {
+				next = deadline;
+			}
+		}
+	}
+	if (next)
+		xio_connection_deadline_arm(connection, next);
+
+	/* notify once the queues are consistent, callbacks may send */
+	while (!xio_msg_list_empty(&expired)) {
+		pmsg = xio_msg_list_first(&expired);
+		xio_msg_list_remove(&expired, pmsg, pdata);
+		xio_session_notify_msg_error(connection, pmsg, XIO_E_TIMEOUT,
+					     XIO_MSG_DIRECTION_OUT);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_requeue_in_flight					     */
+/*---------------------------------------------------------------------------*/
+/* moves a message back from the in flight queue to the head of its class */
+static inline void xio_connection_requeue_in_flight(
+		struct xio_connection *connection,
+		struct xio_msg_list *in_flight_msgq,
+		struct xio_msg_list *msgq,
+		struct xio_msg **first,
+		struct xio_msg *msg)
+{
+	int prio = xio_connection_msg_prio(msg);
+
+	xio_msg_list_remove(in_flight_msgq, msg, pdata);
+	if (first[prio])
+		xio_msg_list_insert_before(first[prio], msg, pdata);
+	else
+		xio_msg_list_insert_tail(&msgq[prio], msg, pdata);
+	if (++connection->prio_queued_msgs[prio] >
+	    connection->prio_max_queued_msgs[prio])
+		connection->prio_max_queued_msgs[prio] =
+			connection->prio_queued_msgs[prio];
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_connection_nexus_safe_close					     */
 /*---------------------------------------------------------------------------*/
@@ -214,6 +503,49 @@ static void xio_connection_nexus_safe_disconnect(struct xio_connection *connecti
 	}
 }
 
+static const struct xio_stat_template xio_connection_stats[] = {
+	{ "TX_MSGS",		XIO_STAT_TYPE_COUNTER,		0 },
+	{ "TX_BYTES",		XIO_STAT_TYPE_COUNTER,		0 },
+	{ "RX_MSGS",		XIO_STAT_TYPE_COUNTER,		0 },
+	{ "RX_BYTES",		XIO_STAT_TYPE_COUNTER,		0 },
+	{ "QUEUED_MSGS",	XIO_STAT_TYPE_GAUGE,		0 },
+	{ "TX_MSG_SIZE",	XIO_STAT_TYPE_HISTOGRAM,	0 },
+	{ "RTT",		XIO_STAT_TYPE_LATENCY,		0 },
+	{ "APP_HOLD",		XIO_STAT_TYPE_LATENCY,		0 },
+	{ "QUEUEING",		XIO_STAT_TYPE_LATENCY,		0 },
+};
+
+static const struct xio_stat_template xio_session_stats[] = {
+	{ "TX_MSGS",		XIO_STAT_TYPE_COUNTER,		0 },
+	{ "RX_MSGS",		XIO_STAT_TYPE_COUNTER,		0 },
+	{ "CONNECTIONS",	XIO_STAT_TYPE_GAUGE,		0 },
+};
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_stats_refresh						     */
+/*---------------------------------------------------------------------------*/
+static void xio_connection_stats_refresh(struct xio_stat_set *set)
+{
+	struct xio_connection	*connection =
+				(struct xio_connection *)set->owner;
+	uint64_t		queued = 0;
+	int			prio;
+
+	for (prio = 0; prio < XIO_MSG_PRIO_NR; prio++)
+		queued += connection->prio_queued_msgs[prio];
+
+	xio_stat_set_gauge(set, XIO_CONNECTION_STAT_QUEUED_MSGS, queued);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_ses_stats_refresh					     */
+/*---------------------------------------------------------------------------*/
+static void xio_connection_ses_stats_refresh(struct xio_stat_set *set)
+{
+	/* every connection of the session on this context holds a ref */
+	xio_stat_set_gauge(set, XIO_SESSION_STAT_CONNECTIONS, set->refcnt);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_connection_create						     */
 /*---------------------------------------------------------------------------*/
@@ -223,6 +555,7 @@ struct xio_connection *xio_connection_create(struct xio_session *session,
 					     void *cb_user_context)
 {
 		struct xio_connection *connection;
+		int i;
 
 		if (!ctx  || !session) {
 			xio_set_error(EINVAL);
@@ -235,6 +568,32 @@ struct xio_connection *xio_connection_create(struct xio_session *session,
 			xio_set_error(ENOMEM);
 			return NULL;
 		}
+		xio_ctx_mem_add(ctx, XIO_MEM_CLASS_CONNECTION,
+				sizeof(*connection), 1);
+
+		connection->stats = xio_stat_set_get(
+				ctx, XIO_STAT_SCOPE_CONNECTION, connection);
+		if (!connection->stats)
+			goto cleanup;
+		connection->stats->refresh = xio_connection_stats_refresh;
+		if (xio_stat_register_all(ctx, connection->stats,
+					  xio_connection_stats,
+					  ARRAY_SIZE(xio_connection_stats)))
+			goto cleanup;
+
+		connection->ses_stats = xio_stat_set_get(
+				ctx, XIO_STAT_SCOPE_SESSION, session);
+		if (!connection->ses_stats)
+			goto cleanup;
+		if (connection->ses_stats->refcnt == 1) {
+			connection->ses_stats->refresh =
+					xio_connection_ses_stats_refresh;
+			if (xio_stat_register_all(
+					ctx, connection->ses_stats,
+					xio_session_stats,
+					ARRAY_SIZE(xio_session_stats)))
+				goto cleanup;
+		}
 
 		connection->session	= session;
 		connection->nexus	= NULL;
@@ -259,9 +618,13 @@ struct xio_connection *xio_connection_create(struct xio_session *session,
 		INIT_LIST_HEAD(&connection->io_tasks_list);
 		INIT_LIST_HEAD(&connection->post_io_tasks_list);
 		INIT_LIST_HEAD(&connection->pre_send_list);
+		INIT_LIST_HEAD(&connection->agg_rx_list);
+		xio_nexus_txq_init(&connection->nexus_txq, session->tx_weight);
 
-		xio_msg_list_init(&connection->reqs_msgq);
-		xio_msg_list_init(&connection->rsps_msgq);
+		for (i = 0; i < XIO_MSG_PRIO_NR; i++) {
+			xio_msg_list_init(&connection->reqs_msgq[i]);
+			xio_msg_list_init(&connection->rsps_msgq[i]);
+		}
 
 		xio_msg_list_init(&connection->in_flight_reqs_msgq);
 		xio_msg_list_init(&connection->in_flight_rsps_msgq);
@@ -272,6 +635,14 @@ struct xio_connection *xio_connection_create(struct xio_session *session,
 		spin_unlock(&ctx->ctx_list_lock);
 
 		return connection;
+
+cleanup:
+		xio_stat_set_put(ctx, connection->ses_stats);
+		xio_stat_set_put(ctx, connection->stats);
+		xio_ctx_mem_sub(ctx, XIO_MEM_CLASS_CONNECTION,
+				sizeof(*connection), 1);
+		xio_context_kfree(ctx, connection);
+		return NULL;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -312,6 +683,30 @@ static void xio_connection_set_ow_send_comp_params(struct xio_msg *msg)
 	set_bits(XIO_MSG_FLAG_IMM_SEND_COMP, &msg->flags);
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_connection_stamp_rsp						     */
+/*---------------------------------------------------------------------------*/
+/* reports the time the sampled request spent on the server */
+static void xio_connection_stamp_rsp(struct xio_connection *connection,
+				     struct xio_task *task,
+				     struct xio_session_hdr *hdr)
+{
+	uint64_t hertz = connection->ctx->stats.hertz;
+	uint64_t recv = task->stamps[XIO_TASK_STAMP_RECV];
+	uint64_t deliver = task->imsg.timestamp;
+	uint64_t now = get_cycles();
+	uint16_t queue_ns, app_ns;
+
+	/* a response has no deadline, its timeout_us word carries both */
+	queue_ns = xio_stat_ns_pack(
+		xio_stat_cycles_to_ns(deliver > recv ? deliver - recv : 0,
+				      hertz));
+	app_ns = xio_stat_ns_pack(
+		xio_stat_cycles_to_ns(now > deliver ? now - deliver : 0,
+				      hertz));
+	hdr->timeout_us = ((uint32_t)queue_ns << 16) | app_ns;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_connection_send							     */
 /*---------------------------------------------------------------------------*/
@@ -427,7 +822,9 @@ int xio_connection_send(struct xio_connection *connection,
 	task->nexus		= connection->nexus;
 	task->connection	= connection;
 	task->omsg		= msg;
-	task->omsg_flags	= (uint16_t)msg->flags;
+	/* the transports put these on the wire, local state stays home */
+	task->omsg_flags	= (uint16_t)(msg->flags &
+					     ~XIO_MSG_FLAG_EX_LOCAL);
 	task->omsg->next	= NULL;
 	task->last_in_rxq	= 0;
 
@@ -436,11 +833,14 @@ int xio_connection_send(struct xio_connection *connection,
 
 	/* optimize for send complete */
 	if (msg->type == XIO_ONE_WAY_REQ &&
-	    connection->session->ses_ops.on_ow_msg_send_complete)
+	    (connection->session->ses_ops.on_ow_msg_send_complete ||
+	     connection->session->ses_ops.on_msg_send_complete_batch ||
+	     xio_connection_cq_enabled(connection)))
 		xio_connection_set_ow_send_comp_params(msg);
 
 	if (msg->type != XIO_MSG_TYPE_RDMA) {
-		hdr.flags		= (uint32_t)msg->flags;
+		hdr.flags		= (uint32_t)(msg->flags &
+						     ~XIO_MSG_FLAG_EX_LOCAL);
 		hdr.dest_session_id	= connection->session->peer_session_id;
 		if (!task->is_control || task->tlv_type == XIO_ACK_REQ) {
 			if (IS_REQUEST(msg->type)) {
@@ -468,6 +868,33 @@ int xio_connection_send(struct xio_connection *connection,
 				}
 			}
 		}
+		/* time one in every msg_sample_rate requests, its response
+		 * reports the server's share of the round trip
+		 */
+		if (msg->type == XIO_MSG_TYPE_REQ && !is_control &&
+		    unlikely(xio_connection_sample(connection))) {
+			task->sampled = 1;
+			task->stamps[XIO_TASK_STAMP_SEND] = get_cycles();
+			task->stamps[XIO_TASK_STAMP_XMIT] = 0;
+		}
+		if (unlikely(task->sampled)) {
+			hdr.flags |= XIO_MSG_FLAG_EX_SAMPLED;
+			if (IS_RESPONSE(msg->type) && !standalone_receipt)
+				xio_connection_stamp_rsp(connection, task,
+							 &hdr);
+		}
+		/* the peer learns how much of the deadline is left */
+		if (msg->type == XIO_MSG_TYPE_REQ && msg->timeout_us) {
+			uint64_t deadline = xio_connection_req_deadline(
+							connection, msg);
+			uint64_t now = get_cycles();
+
+			hdr.timeout_us = (now < deadline) ?
+				(uint32_t)((xio_stat_cycles_to_ns(
+					deadline - now,
+					connection->ctx->stats.hertz) +
+					    999) / 1000) : 1;
+		}
 #ifdef XIO_SESSION_DEBUG
 		hdr.connection = uint64_from_ptr(connection);
 		hdr.session = uint64_from_ptr(connection->session);
@@ -489,7 +916,8 @@ int xio_connection_send(struct xio_connection *connection,
 					connection);
 	}
 
-	retval = xio_nexus_send(connection->nexus, task);
+	retval = xio_nexus_send(connection->nexus, &connection->nexus_txq,
+				task);
 	if (retval != 0) {
 		ERROR_LOG("xio_nexus_send failed with %d\n", retval);
 		rc = (retval == -EAGAIN) ? EAGAIN : xio_errno();
@@ -507,6 +935,12 @@ int xio_connection_send(struct xio_connection *connection,
 		}
 		goto cleanup;
 	}
+	/* time the message waited in the connection's queues */
+	if (!is_control && !standalone_receipt && msg->timestamp)
+		xio_connection_stat_lat(connection,
+					XIO_CONNECTION_STAT_QUEUEING,
+					XIO_CONTEXT_STAT_QUEUEING,
+					get_cycles() - msg->timestamp);
 	return 0;
 
 cleanup:
@@ -523,19 +957,17 @@ cleanup:
 /*---------------------------------------------------------------------------*/
 static int xio_connection_flush_msgs(struct xio_connection *connection)
 {
-	struct xio_msg		*pmsg, *tmp_pmsg, *omsg = NULL;
+	struct xio_msg		*pmsg, *tmp_pmsg;
+	struct xio_msg		*first[XIO_MSG_PRIO_NR];
+	int			prio;
 
-	if (!xio_msg_list_empty(&connection->reqs_msgq))
-		omsg = xio_msg_list_first(&connection->reqs_msgq);
+	for (prio = 0; prio < XIO_MSG_PRIO_NR; prio++)
+		first[prio] = xio_msg_list_first(&connection->reqs_msgq[prio]);
 	xio_msg_list_foreach_safe(pmsg, &connection->in_flight_reqs_msgq,
 				  tmp_pmsg, pdata) {
-		xio_msg_list_remove(&connection->in_flight_reqs_msgq,
-				    pmsg, pdata);
-		if (omsg)
-			xio_msg_list_insert_before(omsg, pmsg, pdata);
-		else
-			xio_msg_list_insert_tail(&connection->reqs_msgq,
-						 pmsg, pdata);
+		xio_connection_requeue_in_flight(
+				connection, &connection->in_flight_reqs_msgq,
+				connection->reqs_msgq, first, pmsg);
 
 		if (connection->enable_flow_control &&
 		    (pmsg->type == XIO_MSG_TYPE_REQ ||
@@ -559,20 +991,13 @@ static int xio_connection_flush_msgs(struct xio_connection *connection)
 		}
 	}
 
-	if (!xio_msg_list_empty(&connection->rsps_msgq))
-		omsg = xio_msg_list_first(&connection->rsps_msgq);
-	else
-		omsg = NULL;
-
+	for (prio = 0; prio < XIO_MSG_PRIO_NR; prio++)
+		first[prio] = xio_msg_list_first(&connection->rsps_msgq[prio]);
 	xio_msg_list_foreach_safe(pmsg, &connection->in_flight_rsps_msgq,
 				  tmp_pmsg, pdata) {
-		xio_msg_list_remove(&connection->in_flight_rsps_msgq,
-				    pmsg, pdata);
-		if (omsg)
-			xio_msg_list_insert_before(omsg, pmsg, pdata);
-		else
-			xio_msg_list_insert_tail(&connection->rsps_msgq,
-						 pmsg, pdata);
+		xio_connection_requeue_in_flight(
+				connection, &connection->in_flight_rsps_msgq,
+				connection->rsps_msgq, first, pmsg);
 	}
 
 	return 0;
@@ -586,25 +1011,31 @@ static void xio_connection_notify_req_msgs_flush(struct xio_connection
 						 enum xio_status status)
 {
 	struct xio_msg		*pmsg, *tmp_pmsg;
-
-	xio_msg_list_foreach_safe(pmsg, &connection->reqs_msgq,
-				  tmp_pmsg, pdata) {
-		xio_msg_list_remove(&connection->reqs_msgq, pmsg, pdata);
-		if (!IS_APPLICATION_MSG(pmsg->type)) {
-			if (test_flag(XIO_FIN_REQ, &pmsg->type) &&
-                            connection->state != XIO_CONNECTION_STATE_DISCONNECTED) {
-				connection->fin_request_flushed = 1;
-				/* since fin req was not really sent, need to
-				 * "undo" the kref updates done in
-				 * xio_send_fin_req() */
-				kref_put(&connection->kref, xio_connection_post_destroy);
-				kref_put(&connection->kref, xio_connection_post_destroy);
+	int			prio;
+
+	for (prio = 0; prio < XIO_MSG_PRIO_NR; prio++) {
+		xio_msg_list_foreach_safe(pmsg, &connection->reqs_msgq[prio],
+					  tmp_pmsg, pdata) {
+			xio_connection_dequeue_msg(
+					connection,
+					&connection->reqs_msgq[prio], pmsg);
+			if (!IS_APPLICATION_MSG(pmsg->type)) {
+				if (test_flag(XIO_FIN_REQ, &pmsg->type) &&
+				    connection->state !=
+					XIO_CONNECTION_STATE_DISCONNECTED) {
+					connection->fin_request_flushed = 1;
+					/* since fin req was not really sent, need to
+					 * "undo" the kref updates done in
+					 * xio_send_fin_req() */
+					kref_put(&connection->kref, xio_connection_post_destroy);
+					kref_put(&connection->kref, xio_connection_post_destroy);
+				}
+				continue;
 			}
-			continue;
+			xio_session_notify_msg_error(connection, pmsg,
+						     status,
+						     XIO_MSG_DIRECTION_OUT);
 		}
-		xio_session_notify_msg_error(connection, pmsg,
-					     status,
-					     XIO_MSG_DIRECTION_OUT);
 	}
 }
 
@@ -616,26 +1047,31 @@ static void xio_connection_notify_rsp_msgs_flush(struct xio_connection
 						 enum xio_status status)
 {
 	struct xio_msg		*pmsg, *tmp_pmsg;
+	int			prio;
+
+	for (prio = 0; prio < XIO_MSG_PRIO_NR; prio++) {
+		xio_msg_list_foreach_safe(pmsg, &connection->rsps_msgq[prio],
+					  tmp_pmsg, pdata) {
+			xio_connection_dequeue_msg(
+					connection,
+					&connection->rsps_msgq[prio], pmsg);
+			if (pmsg->type == XIO_ONE_WAY_RSP) {
+				xio_context_msg_pool_put(pmsg);
+				continue;
+			}
 
-	xio_msg_list_foreach_safe(pmsg, &connection->rsps_msgq,
-				  tmp_pmsg, pdata) {
-		xio_msg_list_remove(&connection->rsps_msgq, pmsg, pdata);
-		if (pmsg->type == XIO_ONE_WAY_RSP) {
-			xio_context_msg_pool_put(pmsg);
-			continue;
-		}
-
-		/* this is read receipt  */
-		if (IS_RESPONSE(pmsg->type) &&
-		    (xio_app_receipt_request(pmsg) ==
-		     XIO_MSG_FLAG_EX_RECEIPT_FIRST)) {
-			continue;
+			/* this is read receipt  */
+			if (IS_RESPONSE(pmsg->type) &&
+			    (xio_app_receipt_request(pmsg) ==
+			     XIO_MSG_FLAG_EX_RECEIPT_FIRST)) {
+				continue;
+			}
+			if (!IS_APPLICATION_MSG(pmsg->type))
+				continue;
+			xio_session_notify_msg_error(connection, pmsg,
+						     status,
+						     XIO_MSG_DIRECTION_OUT);
 		}
-		if (!IS_APPLICATION_MSG(pmsg->type))
-			continue;
-		xio_session_notify_msg_error(connection, pmsg,
-					     status,
-					     XIO_MSG_DIRECTION_OUT);
 	}
 }
 
@@ -644,6 +1080,8 @@ static void xio_connection_notify_rsp_msgs_flush(struct xio_connection
 /*---------------------------------------------------------------------------*/
 int xio_connection_notify_msgs_flush(struct xio_connection *connection)
 {
+	xio_connection_deliver_pending(connection);
+
 	xio_connection_notify_req_msgs_flush(connection, XIO_E_MSG_FLUSHED);
 
 	xio_connection_notify_rsp_msgs_flush(connection, XIO_E_MSG_FLUSHED);
@@ -663,6 +1101,11 @@ int xio_connection_flush_tasks(struct xio_connection *connection)
 	if (!(connection->nexus))
 		return 0;
 
+	/* messages still pending for the application hold io tasks */
+	xio_connection_deliver_pending(connection);
+
+	xio_nexus_txq_flush(&connection->nexus_txq);
+
 	if (!list_empty(&connection->post_io_tasks_list)) {
 		TRACE_LOG("post_io_list not empty!\n");
 		list_for_each_entry_safe(ptask, pnext_task,
@@ -819,6 +1262,192 @@ static int xio_connection_restart_tasks(struct xio_connection *connection)
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_connection_agg_msg_len						     */
+/*---------------------------------------------------------------------------*/
+static inline size_t xio_connection_agg_msg_len(struct xio_msg *msg,
+						 size_t *tx_bytes)
+{
+	struct xio_sg_table_ops	*sgtbl_ops;
+	void			*sgtbl;
+
+	/* requests need their own task to match the response */
+	if (msg->type != XIO_ONE_WAY_REQ ||
+	    msg->flags & XIO_MSG_FLAG_REQUEST_READ_RECEIPT)
+		return 0;
+
+	sgtbl		= xio_sg_table_get(&msg->out);
+	sgtbl_ops	= (struct xio_sg_table_ops *)
+				xio_sg_table_ops_get(msg->out.sgl_type);
+	*tx_bytes	= msg->out.header.iov_len +
+				tbl_length(sgtbl_ops, sgtbl);
+
+	/* the peer unpacks each message into a task of its own */
+	if (msg->out.header.iov_len > (size_t)g_options.max_inline_xio_hdr ||
+	    *tx_bytes - msg->out.header.iov_len >
+				(size_t)g_options.max_inline_xio_data)
+		return 0;
+
+	return ALIGN(sizeof(struct xio_agg_hdr) + *tx_bytes, 8);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_agg_pack						     */
+/*---------------------------------------------------------------------------*/
+static void xio_connection_agg_pack(struct xio_agg_carrier *carrier,
+				    struct xio_msg *msg,
+				    size_t tx_bytes, size_t len)
+{
+	struct xio_agg_hdr	hdr;
+	struct xio_agg_hdr	*tmp_hdr;
+	struct xio_sg_table_ops	*sgtbl_ops;
+	void			*sgtbl;
+	void			*sg;
+	uint8_t			*ptr = carrier->buf + carrier->len;
+	unsigned int		i;
+
+	hdr.serial_num	= msg->sn;
+	hdr.hdr_len	= (uint16_t)msg->out.header.iov_len;
+	hdr.data_len	= (uint32_t)(tx_bytes - msg->out.header.iov_len);
+	hdr.flags	= (uint16_t)msg->flags;
+
+	tmp_hdr = (struct xio_agg_hdr *)ptr;
+	PACK_LLVAL(&hdr, tmp_hdr, serial_num);
+	PACK_LVAL(&hdr, tmp_hdr, data_len);
+	PACK_SVAL(&hdr, tmp_hdr, hdr_len);
+	PACK_SVAL(&hdr, tmp_hdr, flags);
+	ptr += sizeof(*tmp_hdr);
+
+	if (hdr.hdr_len) {
+		memcpy(ptr, msg->out.header.iov_base, hdr.hdr_len);
+		ptr += hdr.hdr_len;
+	}
+
+	sgtbl		= xio_sg_table_get(&msg->out);
+	sgtbl_ops	= (struct xio_sg_table_ops *)
+				xio_sg_table_ops_get(msg->out.sgl_type);
+	for_each_sge(sgtbl, sgtbl_ops, sg, i) {
+		memcpy(ptr, sge_addr(sgtbl_ops, sg),
+		       sge_length(sgtbl_ops, sg));
+		ptr += sge_length(sgtbl_ops, sg);
+	}
+
+	carrier->msgs[carrier->nr++] = msg;
+	carrier->len	+= (uint32_t)len;
+	carrier->bytes	+= tx_bytes;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_agg_xmit						     */
+/*---------------------------------------------------------------------------*/
+/* packs the one way messages at the head of the queue into one wire message.
+ * returns 0 if sent, 1 if the batch is held back waiting for more messages,
+ * 2 if the head message should be sent on its own, negative errno otherwise
+ */
+static int xio_connection_agg_xmit(struct xio_connection *connection,
+				   struct xio_msg_list *msgq,
+				   struct xio_msg_list *in_flight_msgq)
+{
+	struct xio_agg_carrier	*carrier;
+	struct xio_msg		*msg;
+	size_t			max_bytes = connection->agg_max_bytes;
+	size_t			total = 0;
+	size_t			tx_bytes = 0, len;
+	uint32_t		max_nr = XIO_AGG_MAX_MSGS;
+	uint32_t		i, nr = 0;
+	int			full = 0;
+	int			retval;
+
+	if (connection->enable_flow_control) {
+		max_nr = min(max_nr, (uint32_t)connection->peer_credits_msgs);
+		max_bytes = min(max_bytes,
+				(size_t)connection->peer_credits_bytes);
+		/* the carrier's own header is charged as well */
+		max_bytes = (max_bytes > sizeof(struct xio_agg_msg_hdr)) ?
+			max_bytes - sizeof(struct xio_agg_msg_hdr) : 0;
+	}
+
+	xio_msg_list_foreach(msg, msgq, pdata) {
+		len = xio_connection_agg_msg_len(msg, &tx_bytes);
+		if (!len || nr == max_nr || total + len > max_bytes) {
+			full = 1;
+			break;
+		}
+		total += len;
+		nr++;
+	}
+	if (!nr)
+		return 2;
+
+	if (!full && nr < max_nr && !connection->agg_flush) {
+		if (!connection->agg_armed) {
+			connection->agg_armed = 1;
+			connection->agg_start_ns = xio_connection_ns_now();
+			xio_connection_delay_arm(
+					connection,
+					connection->agg_max_delay_us,
+					&connection->agg_flush_event,
+					&connection->agg_flush_work,
+					xio_connection_agg_flush_timeout);
+		}
+		return 1;
+	}
+	if (nr == 1)
+		return 2;
+
+	carrier = (struct xio_agg_carrier *)
+			xio_objpool_alloc(connection->agg_pool);
+	if (unlikely(!carrier))
+		return 2;
+
+	memset(carrier, 0, sizeof(*carrier));
+	i = 0;
+	xio_msg_list_foreach(msg, msgq, pdata) {
+		if (i++ == nr)
+			break;
+		len = xio_connection_agg_msg_len(msg, &tx_bytes);
+		xio_connection_agg_pack(carrier, msg, tx_bytes, len);
+	}
+
+	carrier->hdr.nr			= htonl(carrier->nr);
+	carrier->hdr.bytes		= htonll(carrier->bytes);
+
+	msg				= &carrier->msg;
+	msg->type			= XIO_ONE_WAY_REQ;
+	msg->sn				= carrier->msgs[0]->sn;
+	msg->flags			= XIO_MSG_FLAG_EX_AGGREGATED;
+	msg->in.sgl_type		= XIO_SGL_TYPE_IOV;
+	msg->out.header.iov_base	= &carrier->hdr;
+	msg->out.header.iov_len		= sizeof(carrier->hdr);
+	msg->out.sgl_type		= XIO_SGL_TYPE_IOV;
+	msg->out.data_iov.max_nents	= XIO_IOVLEN;
+	msg->out.data_iov.nents		= 1;
+	msg->out.data_iov.sglist[0].iov_base = carrier->buf;
+	msg->out.data_iov.sglist[0].iov_len  = carrier->len;
+
+	retval = xio_connection_send(connection, msg);
+	if (retval) {
+		xio_objpool_free(carrier);
+		return (retval == -EAGAIN) ? -EAGAIN : 2;
+	}
+
+	/* the carrier consumed one credit and its own length, the peer
+	 * returns credits per packed message
+	 */
+	if (connection->enable_flow_control) {
+		connection->peer_credits_msgs -= (uint16_t)(nr - 1);
+		connection->peer_credits_bytes += sizeof(carrier->hdr) +
+					carrier->len - carrier->bytes;
+	}
+	for (i = 0; i < nr; i++) {
+		xio_connection_dequeue_msg(connection, msgq, carrier->msgs[i]);
+		xio_msg_list_insert_tail(in_flight_msgq, carrier->msgs[i],
+					 pdata);
+	}
+
+	return 0;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_connection_xmit_inl						     */
 /*---------------------------------------------------------------------------*/
@@ -833,6 +1462,7 @@ static inline int xio_connection_xmit_inl(
 	struct xio_task *t;
 	struct xio_tasks_pool *q;
     struct xio_msg *msg;
+	enum xio_status status;
 
     preempt_disable();
 
@@ -842,7 +1472,43 @@ static inline int xio_connection_xmit_inl(
 		return rc;
 	}
 
+	/* never transmit a request that expired or was canceled */
+	status = xio_connection_req_drop_status(connection, msg);
+	if (unlikely(status != XIO_E_SUCCESS)) {
+		xio_connection_drop_req(connection, msgq, msg);
+		xio_session_notify_msg_error(connection, msg, status,
+					     XIO_MSG_DIRECTION_OUT);
+		*retry_cnt = 0;
+		preempt_enable();
+		return 0;
+	}
+
+	/* fin is sent only after all other classes drained */
+	if (unlikely(IS_FIN(msg->type) &&
+		     xio_connection_prio_pending(connection,
+						 XIO_MSG_PRIO_NR - 1))) {
+		(*retry_cnt)++;
+		preempt_enable();
+		return 1;
+	}
+
+	/* only one way requests are packed, responses fall through */
+	if (connection->agg_max_bytes) {
+		retval = xio_connection_agg_xmit(connection, msgq,
+						 in_flight_msgq);
+		if (retval == 0) {
+			*retry_cnt = 0;
+			preempt_enable();
+			goto refill;
+		} else if (retval != 2) {
+			(*retry_cnt)++;
+			preempt_enable();
+			return 1;
+		}
+	}
+
 	retval = xio_connection_send(connection, msg);
+	XIO_TRACE4(connection_xmit, connection, msg->sn, msg->type, retval);
 	if (retval) {
 		if (retval == -EAGAIN) {
 			(*retry_cnt)++;
@@ -862,12 +1528,12 @@ static inline int xio_connection_xmit_inl(
 			(*retry_cnt)++;
 			rc = 1;
 		} else  {
-			xio_msg_list_remove(msgq, msg, pdata);
+			xio_connection_dequeue_msg(connection, msgq, msg);
 			rc = retval;
 		}
 	} else {
 		*retry_cnt = 0;
-		xio_msg_list_remove(msgq, msg, pdata);
+		xio_connection_dequeue_msg(connection, msgq, msg);
 		if (IS_APPLICATION_MSG(msg->type)) {
 			xio_msg_list_insert_tail(
 					in_flight_msgq, msg,
@@ -876,140 +1542,513 @@ static inline int xio_connection_xmit_inl(
 	}
 	preempt_enable();
 
-	q = connection->nexus->primary_tasks_pool;
-	t = list_first_entry_or_null(&q->stack, struct xio_task,
-			tasks_list_entry);
-	if (unlikely(!t || list_is_last(&t->tasks_list_entry, &q->stack))) {
-		if (q->curr_used != q->params.max_nr - 1)
-			xio_tasks_pool_alloc_slab(q, connection->nexus->transport_hndl);
+refill:
+	q = connection->nexus->primary_tasks_pool;
+	t = list_first_entry_or_null(&q->stack, struct xio_task,
+			tasks_list_entry);
+	if (unlikely(!t || list_is_last(&t->tasks_list_entry, &q->stack))) {
+		if (q->curr_used != q->params.max_nr - 1)
+			xio_tasks_pool_alloc_slab(q, connection->nexus->transport_hndl);
+	}
+
+	return rc;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_xmit_prio						     */
+/*---------------------------------------------------------------------------*/
+/* transmits up to budget messages of one priority class, alternating
+ * between requests and responses. returns the number of messages sent
+ */
+static int xio_connection_xmit_prio(struct xio_connection *connection,
+				    int prio, int budget, int *retval)
+{
+	int    retry_cnt = 0;
+	int    sent = 0;
+
+	struct xio_msg_list *msgq1, *in_flight_msgq1;
+	struct xio_msg_list *msgq2, *in_flight_msgq2;
+	void (*flush_msgq1)(struct xio_connection *, enum xio_status);
+	void (*flush_msgq2)(struct xio_connection *, enum xio_status);
+
+	if (connection->send_req_toggle == 0) {
+		msgq1		= &connection->reqs_msgq[prio];
+		in_flight_msgq1	= &connection->in_flight_reqs_msgq;
+		flush_msgq1	= &xio_connection_notify_req_msgs_flush;
+		msgq2		= &connection->rsps_msgq[prio];
+		in_flight_msgq2	= &connection->in_flight_rsps_msgq;
+		flush_msgq2	= &xio_connection_notify_rsp_msgs_flush;
+	} else {
+		msgq1		= &connection->rsps_msgq[prio];
+		in_flight_msgq1	= &connection->in_flight_rsps_msgq;
+		flush_msgq1	= &xio_connection_notify_rsp_msgs_flush;
+		msgq2		= &connection->reqs_msgq[prio];
+		in_flight_msgq2	= &connection->in_flight_reqs_msgq;
+		flush_msgq2	= &xio_connection_notify_req_msgs_flush;
+	}
+
+	while (retry_cnt < 2 && sent < budget) {
+		*retval = xio_connection_xmit_inl(connection,
+						  msgq1, in_flight_msgq1,
+						  flush_msgq1,
+						  &retry_cnt);
+		if (*retval < 0) {
+			connection->send_req_toggle =
+				1 - connection->send_req_toggle;
+			break;
+		}
+		/* retry count is reset whenever a message went out */
+		if (!retry_cnt && ++sent == budget)
+			break;
+		*retval = xio_connection_xmit_inl(connection,
+						  msgq2, in_flight_msgq2,
+						  flush_msgq2,
+						  &retry_cnt);
+		if (*retval < 0)
+			break;
+		if (!retry_cnt)
+			sent++;
+	}
+
+	return sent;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_xmit							     */
+/*---------------------------------------------------------------------------*/
+static int xio_connection_xmit(struct xio_connection *connection)
+{
+	int    retval = 0;
+	int    prio, sent;
+	int    weighted = connection->prio_weights[0];
+
+	/* strict priority drains each class before the next one, weighted
+	 * rounds send up to the class weight from every class in turn
+	 */
+	do {
+		sent = 0;
+		for (prio = 0; prio < XIO_MSG_PRIO_NR; prio++) {
+			if (!connection->prio_queued_msgs[prio])
+				continue;
+			sent += xio_connection_xmit_prio(
+					connection, prio,
+					weighted ? connection->prio_weights[prio] :
+						   INT_MAX,
+					&retval);
+			if (retval < 0)
+				goto exit;
+		}
+	} while (weighted && sent);
+
+exit:
+	if (retval < 0) {
+		xio_set_error(-retval);
+		ERROR_LOG("failed to send message - %s\n",
+			  xio_strerror(-retval));
+		return -1;
+	} else {
+		return 0;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_agg_flush_handler					     */
+/*---------------------------------------------------------------------------*/
+static void xio_connection_agg_flush_handler(void *_connection)
+{
+	struct xio_connection *connection = (struct xio_connection *)_connection;
+
+	/* a sub millisecond delay, keep the loop polling till it ends */
+	if (connection->agg_max_delay_us < XIO_COALESCE_POLL_DELAY_US &&
+	    xio_connection_ns_now() - connection->agg_start_ns <
+	    connection->agg_max_delay_us * 1000ULL) {
+		xio_context_add_event(connection->ctx,
+				      &connection->agg_flush_event);
+		return;
+	}
+	connection->agg_armed = 0;
+
+	if (!xio_is_connection_online(connection))
+		return;
+
+	connection->agg_flush = 1;
+	xio_connection_xmit(connection);
+	connection->agg_flush = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_agg_flush_timeout					     */
+/*---------------------------------------------------------------------------*/
+static void xio_connection_agg_flush_timeout(int actual_timeout_ms,
+					     void *_connection)
+{
+	xio_connection_agg_flush_handler(_connection);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_remove_in_flight					     */
+/*---------------------------------------------------------------------------*/
+int xio_connection_remove_in_flight(struct xio_connection *connection,
+				    struct xio_msg *msg)
+{
+	if (!IS_APPLICATION_MSG(msg->type))
+		return 0;
+
+	if (IS_REQUEST(msg->type) || msg->type == XIO_MSG_TYPE_RDMA)
+		xio_msg_list_remove(
+			&connection->in_flight_reqs_msgq, msg, pdata);
+	else if (IS_RESPONSE(msg->type))
+		xio_msg_list_remove(
+			&connection->in_flight_rsps_msgq, msg, pdata);
+	else {
+		ERROR_LOG("unexpected message type %u\n", msg->type);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_remove_msg_from_queue					     */
+/*---------------------------------------------------------------------------*/
+int xio_connection_remove_msg_from_queue(struct xio_connection *connection,
+					 struct xio_msg *msg)
+{
+	int prio;
+
+	if (!IS_APPLICATION_MSG(msg->type))
+		return 0;
+
+	prio = xio_connection_msg_prio(msg);
+	if (IS_REQUEST(msg->type) || msg->type == XIO_MSG_TYPE_RDMA)
+		xio_connection_dequeue_msg(
+				connection, &connection->reqs_msgq[prio], msg);
+	else if (IS_RESPONSE(msg->type))
+		xio_connection_dequeue_msg(
+				connection, &connection->rsps_msgq[prio], msg);
+	else {
+		ERROR_LOG("unexpected message type %u\n", msg->type);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_safe_remove_msg_from_queue				     */
+/*---------------------------------------------------------------------------*/
+void xio_connection_safe_remove_msg_from_queue(struct xio_connection *connection,
+					       struct xio_msg *msg)
+{
+	struct xio_msg *var;
+	int removed  = 0;
+	int prio;
+
+	for (prio = 0; prio < XIO_MSG_PRIO_NR && !removed; prio++) {
+		xio_msg_list_safe_remove(&connection->reqs_msgq[prio], msg,
+					 pdata, var, &removed);
+		if (!removed)
+			xio_msg_list_safe_remove(&connection->rsps_msgq[prio],
+						 msg, pdata, var, &removed);
+		if (removed)
+			connection->prio_queued_msgs[prio]--;
+	}
+	if (!removed)
+		xio_msg_list_safe_remove(&connection->in_flight_reqs_msgq, msg,
+					 pdata, var, &removed);
+	if (!removed)
+		xio_msg_list_safe_remove(&connection->in_flight_rsps_msgq, msg,
+					 pdata, var, &removed);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_batch_flush						     */
+/*---------------------------------------------------------------------------*/
+void xio_connection_batch_flush(struct xio_connection *connection)
+{
+	uint32_t nr = connection->batch_nr;
+
+	if (!nr)
+		return;
+
+	connection->batch_nr	= 0;
+	connection->batch_busy	= 1;
+#ifdef XIO_THREAD_SAFE_DEBUG
+	xio_ctx_debug_thread_unlock(connection->ctx);
+#endif
+	connection->ses_ops.on_msg_batch(connection->session,
+					 connection->batch_msgs, (int)nr,
+					 connection->cb_user_context);
+#ifdef XIO_THREAD_SAFE_DEBUG
+	xio_ctx_debug_thread_lock(connection->ctx);
+#endif
+	connection->batch_busy	= 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_batch_handler						     */
+/*---------------------------------------------------------------------------*/
+/* ends a batch the transport did not mark as last */
+static void xio_connection_batch_handler(void *_connection)
+{
+	struct xio_connection *connection = (struct xio_connection *)_connection;
+
+	connection->batch_armed = 0;
+	xio_connection_batch_flush(connection);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_batch_add						     */
+/*---------------------------------------------------------------------------*/
+void xio_connection_batch_add(struct xio_connection *connection,
+			      struct xio_msg *msg, int last_in_rxq)
+{
+	if (unlikely(!connection->batch_msgs)) {
+		connection->batch_msgs = (struct xio_msg **)
+			xio_context_kcalloc(connection->ctx,
+					    XIO_MSG_BATCH_MAX,
+					    sizeof(*connection->batch_msgs),
+					    GFP_KERNEL);
+		connection->batch_event.handler	= xio_connection_batch_handler;
+		connection->batch_event.data	= connection;
+	}
+	/* messages arriving while the application holds the batch, or
+	 * with no memory for one, are passed alone
+	 */
+	if (unlikely(!connection->batch_msgs || connection->batch_busy)) {
+#ifdef XIO_THREAD_SAFE_DEBUG
+		xio_ctx_debug_thread_unlock(connection->ctx);
+#endif
+		connection->ses_ops.on_msg_batch(connection->session, &msg, 1,
+						 connection->cb_user_context);
+#ifdef XIO_THREAD_SAFE_DEBUG
+		xio_ctx_debug_thread_lock(connection->ctx);
+#endif
+		return;
+	}
+
+	connection->batch_msgs[connection->batch_nr++] = msg;
+	if (last_in_rxq || connection->batch_nr == XIO_MSG_BATCH_MAX) {
+		xio_connection_batch_flush(connection);
+		return;
+	}
+	if (!connection->batch_armed) {
+		connection->batch_armed = 1;
+		xio_context_add_event(connection->ctx,
+				      &connection->batch_event);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_comp_flush						     */
+/*---------------------------------------------------------------------------*/
+void xio_connection_comp_flush(struct xio_connection *connection)
+{
+	uint32_t nr = connection->comp_nr;
+
+	if (!nr)
+		return;
+
+	connection->comp_nr	= 0;
+	connection->comp_busy	= 1;
+#ifdef XIO_THREAD_SAFE_DEBUG
+	xio_ctx_debug_thread_unlock(connection->ctx);
+#endif
+	connection->ses_ops.on_msg_send_complete_batch(
+					connection->session,
+					connection->comp_msgs, (int)nr,
+					connection->cb_user_context);
+#ifdef XIO_THREAD_SAFE_DEBUG
+	xio_ctx_debug_thread_lock(connection->ctx);
+#endif
+	connection->comp_busy	= 0;
+
+	/* coalescing was modified from within the callback */
+	if (!connection->comp_cap) {
+		xio_context_kfree(connection->ctx, connection->comp_msgs);
+		connection->comp_msgs = NULL;
 	}
-
-	return rc;
 }
 
 /*---------------------------------------------------------------------------*/
-/* xio_connection_xmit							     */
+/* xio_connection_comp_handler						     */
 /*---------------------------------------------------------------------------*/
-static int xio_connection_xmit(struct xio_connection *connection)
+static void xio_connection_comp_handler(void *_connection)
 {
-	int    retval = 0;
-	int    retry_cnt = 0;
-
-	struct xio_msg_list *msgq1, *in_flight_msgq1;
-	struct xio_msg_list *msgq2, *in_flight_msgq2;
-	void (*flush_msgq1)(struct xio_connection *, enum xio_status);
-	void (*flush_msgq2)(struct xio_connection *, enum xio_status);
+	struct xio_connection *connection = (struct xio_connection *)_connection;
 
-	if (connection->send_req_toggle == 0) {
-		msgq1		= &connection->reqs_msgq;
-		in_flight_msgq1	= &connection->in_flight_reqs_msgq;
-		flush_msgq1	= &xio_connection_notify_req_msgs_flush;
-		msgq2		= &connection->rsps_msgq;
-		in_flight_msgq2	= &connection->in_flight_rsps_msgq;
-		flush_msgq2	= &xio_connection_notify_rsp_msgs_flush;
-	} else {
-		msgq1		= &connection->rsps_msgq;
-		in_flight_msgq1	= &connection->in_flight_rsps_msgq;
-		flush_msgq1	= &xio_connection_notify_rsp_msgs_flush;
-		msgq2		= &connection->reqs_msgq;
-		in_flight_msgq2	= &connection->in_flight_reqs_msgq;
-		flush_msgq2	= &xio_connection_notify_req_msgs_flush;
+	/* a sub millisecond delay, keep the loop polling till it ends */
+	if (connection->comp_nr &&
+	    connection->comp_max_delay_us < XIO_COALESCE_POLL_DELAY_US &&
+	    xio_connection_ns_now() - connection->comp_start_ns <
+	    connection->comp_max_delay_us * 1000ULL) {
+		xio_context_add_event(connection->ctx,
+				      &connection->comp_event);
+		return;
 	}
+	connection->comp_armed = 0;
+	xio_connection_comp_flush(connection);
+}
 
-	while (retry_cnt < 2) {
-		retval = xio_connection_xmit_inl(connection,
-						 msgq1, in_flight_msgq1,
-						 flush_msgq1,
-						 &retry_cnt);
-		if (retval < 0) {
-			connection->send_req_toggle =
-				1 - connection->send_req_toggle;
-			break;
-		}
-		retval = xio_connection_xmit_inl(connection,
-						 msgq2, in_flight_msgq2,
-						 flush_msgq2,
-						 &retry_cnt);
-		if (retval < 0)
-			break;
+/*---------------------------------------------------------------------------*/
+/* xio_connection_comp_timeout						     */
+/*---------------------------------------------------------------------------*/
+static void xio_connection_comp_timeout(int actual_timeout_ms,
+					void *_connection)
+{
+	xio_connection_comp_handler(_connection);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_comp_add						     */
+/*---------------------------------------------------------------------------*/
+void xio_connection_comp_add(struct xio_connection *connection,
+			     struct xio_msg *msg)
+{
+	if (unlikely(!connection->comp_msgs)) {
+		connection->comp_cap = connection->comp_max_msgs ?
+				connection->comp_max_msgs : XIO_MSG_BATCH_MAX;
+		connection->comp_msgs = (struct xio_msg **)
+			xio_context_kcalloc(connection->ctx,
+					    connection->comp_cap,
+					    sizeof(*connection->comp_msgs),
+					    GFP_KERNEL);
+		connection->comp_event.handler	= xio_connection_comp_handler;
+		connection->comp_event.data	= connection;
+	}
+	/* completions arriving while the application holds the batch, or
+	 * with no memory for one, are passed alone
+	 */
+	if (unlikely(!connection->comp_msgs || connection->comp_busy)) {
+#ifdef XIO_THREAD_SAFE_DEBUG
+		xio_ctx_debug_thread_unlock(connection->ctx);
+#endif
+		connection->ses_ops.on_msg_send_complete_batch(
+					connection->session, &msg, 1,
+					connection->cb_user_context);
+#ifdef XIO_THREAD_SAFE_DEBUG
+		xio_ctx_debug_thread_lock(connection->ctx);
+#endif
+		return;
 	}
 
-	if (retval < 0) {
-		xio_set_error(-retval);
-		ERROR_LOG("failed to send message - %s\n",
-			  xio_strerror(-retval));
-		return -1;
-	} else {
-		return 0;
+	if (!connection->comp_nr)
+		connection->comp_start_ns = xio_connection_ns_now();
+	connection->comp_msgs[connection->comp_nr++] = msg;
+	if (connection->comp_nr == connection->comp_cap) {
+		xio_connection_comp_flush(connection);
+		return;
+	}
+	if (!connection->comp_armed) {
+		connection->comp_armed = 1;
+		xio_connection_delay_arm(connection,
+					 connection->comp_max_delay_us,
+					 &connection->comp_event,
+					 &connection->comp_work,
+					 xio_connection_comp_timeout);
 	}
 }
 
 /*---------------------------------------------------------------------------*/
-/* xio_connection_remove_in_flight					     */
+/* xio_context_cq_resize						     */
 /*---------------------------------------------------------------------------*/
-int xio_connection_remove_in_flight(struct xio_connection *connection,
-				    struct xio_msg *msg)
+int xio_context_cq_resize(struct xio_context *ctx, uint32_t size)
 {
-	if (!IS_APPLICATION_MSG(msg->type))
-		return 0;
+	struct xio_cq_event	*cq;
+	uint32_t		i, n = ctx->cq_tail - ctx->cq_head;
 
-	if (IS_REQUEST(msg->type) || msg->type == XIO_MSG_TYPE_RDMA)
-		xio_msg_list_remove(
-			&connection->in_flight_reqs_msgq, msg, pdata);
-	else if (IS_RESPONSE(msg->type))
-		xio_msg_list_remove(
-			&connection->in_flight_rsps_msgq, msg, pdata);
-	else {
-		ERROR_LOG("unexpected message type %u\n", msg->type);
-		return -EINVAL;
+	cq = (struct xio_cq_event *)xio_context_kcalloc(ctx, size, sizeof(*cq),
+						       GFP_KERNEL);
+	if (!cq) {
+		xio_set_error(ENOMEM);
+		ERROR_LOG("completion queue allocation failed. size:%u\n",
+			  size);
+		return -1;
 	}
+	for (i = 0; i < n; i++)
+		cq[i] = ctx->cq[(ctx->cq_head + i) & (ctx->cq_size - 1)];
+
+	if (ctx->cq)
+		xio_context_kfree(ctx, ctx->cq);
+	ctx->cq		= cq;
+	ctx->cq_size	= size;
+	ctx->cq_head	= 0;
+	ctx->cq_tail	= n;
 
 	return 0;
 }
 
 /*---------------------------------------------------------------------------*/
-/* xio_connection_remove_msg_from_queue					     */
+/* xio_connection_cq_push						     */
 /*---------------------------------------------------------------------------*/
-int xio_connection_remove_msg_from_queue(struct xio_connection *connection,
-					 struct xio_msg *msg)
+void xio_connection_cq_push(struct xio_connection *connection,
+			    enum xio_cq_event_type type,
+			    struct xio_msg *msg, int last_in_rxq,
+			    enum xio_status status,
+			    enum xio_msg_direction direction)
 {
-	if (!IS_APPLICATION_MSG(msg->type))
-		return 0;
+	struct xio_context	*ctx = connection->ctx;
+	struct xio_cq_event	*ev;
 
-	if (IS_REQUEST(msg->type) || msg->type == XIO_MSG_TYPE_RDMA)
-		xio_msg_list_remove(
-				&connection->reqs_msgq, msg, pdata);
-	else if (IS_RESPONSE(msg->type))
-		xio_msg_list_remove(
-				&connection->rsps_msgq, msg, pdata);
-	else {
-		ERROR_LOG("unexpected message type %u\n", msg->type);
-		return -EINVAL;
+	/* events are never dropped - a full queue doubles */
+	if (unlikely(ctx->cq_tail - ctx->cq_head == ctx->cq_size) &&
+	    xio_context_cq_resize(ctx, ctx->cq_size << 1)) {
+		ERROR_LOG("completion queue overflow. event %d lost\n", type);
+		return;
 	}
+	ev = &ctx->cq[ctx->cq_tail++ & (ctx->cq_size - 1)];
+	ev->type		= type;
+	ev->status		= status;
+	ev->direction		= direction;
+	ev->last_in_rxq		= last_in_rxq;
+	ev->session		= connection->session;
+	ev->conn		= connection;
+	ev->msg			= msg;
+	ev->conn_user_context	= connection->cb_user_context;
+}
 
-	return 0;
+/*---------------------------------------------------------------------------*/
+/* xio_connection_cq_purge						     */
+/*---------------------------------------------------------------------------*/
+static void xio_connection_cq_purge(struct xio_connection *connection)
+{
+	struct xio_context	*ctx = connection->ctx;
+	uint32_t		mask = ctx->cq_size - 1;
+	uint32_t		i, j = ctx->cq_head;
+
+	for (i = ctx->cq_head; i != ctx->cq_tail; i++) {
+		if (ctx->cq[i & mask].conn == connection)
+			continue;
+		if (i != j)
+			ctx->cq[j & mask] = ctx->cq[i & mask];
+		j++;
+	}
+	if (j != ctx->cq_tail)
+		ERROR_LOG("connection %p destroyed with %u events not " \
+			  "harvested\n", connection, ctx->cq_tail - j);
+	ctx->cq_tail = j;
 }
 
 /*---------------------------------------------------------------------------*/
-/* xio_connection_safe_remove_msg_from_queue				     */
+/* xio_poll_cq								     */
 /*---------------------------------------------------------------------------*/
-void xio_connection_safe_remove_msg_from_queue(struct xio_connection *connection,
-					       struct xio_msg *msg)
+int xio_poll_cq(struct xio_context *ctx, struct xio_cq_event *events,
+		int nevents)
 {
-	struct xio_msg *var;
-	int removed  = 0;
-	xio_msg_list_safe_remove(&connection->reqs_msgq, msg,
-				 pdata, var, &removed);
-	if (!removed)
-		xio_msg_list_safe_remove(&connection->rsps_msgq, msg,
-					 pdata, var, &removed);
-	if (!removed)
-		xio_msg_list_safe_remove(&connection->in_flight_reqs_msgq, msg,
-					 pdata, var, &removed);
-	if (!removed)
-		xio_msg_list_safe_remove(&connection->in_flight_rsps_msgq, msg,
-					 pdata, var, &removed);
+	uint32_t n, i;
+
+	if (!ctx || !ctx->cq || !events || nevents < 0) {
+		xio_set_error(EINVAL);
+		ERROR_LOG("poll cq failed. invalid parameters\n");
+		return -1;
+	}
+	n = min(ctx->cq_tail - ctx->cq_head, (uint32_t)nevents);
+	for (i = 0; i < n; i++)
+		events[i] = ctx->cq[ctx->cq_head++ & (ctx->cq_size - 1)];
+
+	return (int)n;
 }
+EXPORT_SYMBOL(xio_poll_cq);
 
 /*---------------------------------------------------------------------------*/
 /* xio_connection_reconnect						     */
@@ -1070,13 +2109,17 @@ int xio_connection_restart(struct xio_connection *connection)
 int xio_send_request(struct xio_connection *connection,
 		     struct xio_msg *msg)
 {
-	struct xio_msg_list	reqs_msgq;
+	struct xio_msg_list	reqs_msgq[XIO_MSG_PRIO_NR];
+	uint32_t		nr_prio[XIO_MSG_PRIO_NR];
 	struct xio_msg		*pmsg;
 	struct xio_sg_table_ops	*sgtbl_ops;
 	void			*sgtbl;
 	size_t			tx_bytes;
+	uint64_t		deadline;
+	uint64_t		first_deadline = 0;
 	int			nr = -1;
 	int			retval = 0;
+	int			prio;
 #ifdef XIO_CFLAG_STAT_COUNTERS
 	struct xio_statistics	*stats;
 #endif
@@ -1101,7 +2144,10 @@ int xio_send_request(struct xio_connection *connection,
 #endif
 
 	if (msg->next) {
-		xio_msg_list_init(&reqs_msgq);
+		for (prio = 0; prio < XIO_MSG_PRIO_NR; prio++) {
+			xio_msg_list_init(&reqs_msgq[prio]);
+			nr_prio[prio] = 0;
+		}
 		nr = 0;
 	}
 
@@ -1159,30 +2205,43 @@ int xio_send_request(struct xio_connection *connection,
 			retval = -1;
 			goto send;
 		}
-#ifdef XIO_CFLAG_STAT_COUNTERS
 		pmsg->timestamp = get_cycles();
+#ifdef XIO_CFLAG_STAT_COUNTERS
 		xio_stat_inc(stats, XIO_STAT_TX_MSG);
 		xio_stat_add(stats, XIO_STAT_TX_BYTES, tx_bytes);
 #endif
+		xio_connection_stat_tx(connection, tx_bytes);
 
 		pmsg->sn = xio_session_get_sn(connection->session);
 		pmsg->type = XIO_MSG_TYPE_REQ;
+		XIO_TRACE4(send_request, connection, pmsg->sn, tx_bytes,
+			   connection->tx_queued_msgs);
+		pmsg->flags &= ~XIO_MSG_FLAG_EX_CANCELED;
+		if (pmsg->timeout_us) {
+			deadline = xio_connection_req_deadline(connection,
+							       pmsg);
+			if (!first_deadline || deadline < first_deadline)
+				first_deadline = deadline;
+		}
 
 		if (connection->enable_flow_control) {
 			connection->tx_queued_msgs++;
 			connection->tx_bytes += tx_bytes;
 		}
-		if (nr == -1)
-			xio_msg_list_insert_tail(&connection->reqs_msgq, pmsg,
-						 pdata);
-		else {
+		if (nr == -1) {
+			xio_connection_queue_msg(connection,
+						 connection->reqs_msgq, pmsg);
+		} else {
 			nr++;
-			xio_msg_list_insert_tail(&reqs_msgq, pmsg, pdata);
+			prio = xio_connection_msg_prio(pmsg);
+			xio_msg_list_insert_tail(&reqs_msgq[prio], pmsg, pdata);
+			nr_prio[prio]++;
 		}
 		pmsg = pmsg->next;
 	}
 	if (nr > 0)
-		xio_msg_list_concat(&connection->reqs_msgq, &reqs_msgq, pdata);
+		xio_connection_queue_batch(connection, connection->reqs_msgq,
+					   reqs_msgq, nr_prio);
 
 send:
 	/* do not xmit until connection is assigned */
@@ -1193,6 +2252,10 @@ send:
 #endif
 			return -1;
 		}
+	/* requests left queued are dropped once their deadline passes */
+	if (first_deadline &&
+	    xio_connection_prio_pending(connection, XIO_MSG_PRIO_NR))
+		xio_connection_deadline_arm(connection, first_deadline);
 #ifdef XIO_THREAD_SAFE_DEBUG
 	xio_ctx_debug_thread_unlock(connection->ctx);
 #endif
@@ -1201,6 +2264,59 @@ send:
 }
 EXPORT_SYMBOL(xio_send_request);
 
+/*---------------------------------------------------------------------------*/
+/* xio_cancel_request							     */
+/*---------------------------------------------------------------------------*/
+int xio_cancel_request(struct xio_connection *connection,
+		       struct xio_msg *req)
+{
+	struct xio_msg_list	*msgq;
+	struct xio_msg		*pmsg;
+
+	if (!connection || !req || req->type != XIO_MSG_TYPE_REQ) {
+		xio_set_error(EINVAL);
+		ERROR_LOG("cancel request failed. invalid request\n");
+		return -1;
+	}
+#ifdef XIO_THREAD_SAFE_DEBUG
+	xio_ctx_debug_thread_lock(connection->ctx);
+#endif
+	/* not transmitted yet - drop it at once */
+	msgq = &connection->reqs_msgq[xio_connection_msg_prio(req)];
+	xio_msg_list_foreach(pmsg, msgq, pdata) {
+		if (pmsg != req)
+			continue;
+		xio_connection_drop_req(connection, msgq, req);
+		xio_session_notify_msg_error(connection, req,
+					     XIO_E_MSG_CANCELED,
+					     XIO_MSG_DIRECTION_OUT);
+#ifdef XIO_THREAD_SAFE_DEBUG
+		xio_ctx_debug_thread_unlock(connection->ctx);
+#endif
+		return 0;
+	}
+
+	/* the peer may still answer into the request "in" side, so the
+	 * request completes as canceled when its response arrives
+	 */
+	xio_msg_list_foreach(pmsg, &connection->in_flight_reqs_msgq, pdata) {
+		if (pmsg != req)
+			continue;
+		req->flags |= XIO_MSG_FLAG_EX_CANCELED;
+#ifdef XIO_THREAD_SAFE_DEBUG
+		xio_ctx_debug_thread_unlock(connection->ctx);
+#endif
+		return 0;
+	}
+#ifdef XIO_THREAD_SAFE_DEBUG
+	xio_ctx_debug_thread_unlock(connection->ctx);
+#endif
+	xio_set_error(XIO_E_MSG_CANCEL_FAILED);
+
+	return -1;
+}
+EXPORT_SYMBOL(xio_cancel_request);
+
 /*---------------------------------------------------------------------------*/
 /* xio_send_single_rsp							     */
 /*---------------------------------------------------------------------------*/
@@ -1245,7 +2361,7 @@ void xio_send_single_rsp(struct xio_msg *msg, struct xio_task *task)
 
 	task->state = XIO_TASK_STATE_READ;
 	pmsg->flags |= XIO_MSG_FLAG_EX_RECEIPT_LAST;
-	xio_msg_list_insert_tail(&connection->rsps_msgq, pmsg, pdata);
+	xio_connection_queue_msg(connection, connection->rsps_msgq, pmsg);
 
 }
 
@@ -1354,10 +2470,15 @@ int xio_send_response(struct xio_msg *msg)
 			goto send;
 		}
 
-#ifdef XIO_CFLAG_STAT_COUNTERS
 		/* Server latency */
+		pmsg->timestamp = get_cycles();
+		xio_connection_stat_lat(connection,
+					XIO_CONNECTION_STAT_APP_HOLD,
+					XIO_CONTEXT_STAT_APP_HOLD,
+					pmsg->timestamp - task->imsg.timestamp);
+#ifdef XIO_CFLAG_STAT_COUNTERS
 		xio_stat_add(stats, XIO_STAT_APPDELAY,
-			     get_cycles() - task->imsg.timestamp);
+			     pmsg->timestamp - task->imsg.timestamp);
 #endif
 #ifdef XIO_CFLAG_EXTRA_CHECKS
 		valid = xio_session_is_valid_out_msg(connection->session, pmsg);
@@ -1378,13 +2499,14 @@ int xio_send_response(struct xio_msg *msg)
 		}
 #endif
 
-#ifdef XIO_CFLAG_STAT_COUNTERS
 		sgtbl		= xio_sg_table_get(vmsg);
 		sgtbl_ops	= (struct xio_sg_table_ops *)
 					xio_sg_table_ops_get(vmsg->sgl_type);
 		bytes		= vmsg->header.iov_len +
 					  tbl_length(sgtbl_ops, sgtbl);
 
+		xio_connection_stat_tx(connection, bytes);
+#ifdef XIO_CFLAG_STAT_COUNTERS
 		xio_stat_inc(stats, XIO_STAT_TX_MSG);
 		xio_stat_add(stats, XIO_STAT_TX_BYTES, bytes);
 #endif
@@ -1458,7 +2580,7 @@ int xio_connection_send_read_receipt(struct xio_connection *connection,
 	rsp->in.header.iov_len = 0;
 	rsp->in.data_tbl.nents = 0;
 
-	xio_msg_list_insert_tail(&connection->rsps_msgq, rsp, pdata);
+	xio_connection_queue_msg(connection, connection->rsps_msgq, rsp);
 
 	/* do not xmit until connection is assigned */
 	if (xio_is_connection_online(connection))
@@ -1478,13 +2600,15 @@ static int xio_send_typed_msg(struct xio_connection *connection,
 			      struct xio_msg *msg,
 			      enum xio_msg_type msg_type)
 {
-	struct xio_msg_list	reqs_msgq;
+	struct xio_msg_list	reqs_msgq[XIO_MSG_PRIO_NR];
+	uint32_t		nr_prio[XIO_MSG_PRIO_NR];
 	struct xio_msg		*pmsg = msg;
 	struct xio_sg_table_ops	*sgtbl_ops;
 	void			*sgtbl;
 	size_t			tx_bytes;
 	int			nr = -1;
 	int			retval = 0;
+	int			prio;
 #ifdef XIO_CFLAG_STAT_COUNTERS
 	struct xio_statistics	*stats = &connection->ctx->stats;
 #endif
@@ -1501,7 +2625,10 @@ static int xio_send_typed_msg(struct xio_connection *connection,
 	}
 
 	if (msg->next) {
-		xio_msg_list_init(&reqs_msgq);
+		for (prio = 0; prio < XIO_MSG_PRIO_NR; prio++) {
+			xio_msg_list_init(&reqs_msgq[prio]);
+			nr_prio[prio] = 0;
+		}
 		nr = 0;
 	}
 
@@ -1548,11 +2675,12 @@ static int xio_send_typed_msg(struct xio_connection *connection,
 			retval = -1;
 			goto send;
 		}
-#ifdef XIO_CFLAG_STAT_COUNTERS
 		pmsg->timestamp = get_cycles();
+#ifdef XIO_CFLAG_STAT_COUNTERS
 		xio_stat_inc(stats, XIO_STAT_TX_MSG);
 		xio_stat_add(stats, XIO_STAT_TX_BYTES, tx_bytes);
 #endif
+		xio_connection_stat_tx(connection, tx_bytes);
 		pmsg->sn = xio_session_get_sn(connection->session);
 		pmsg->type = msg_type;
 
@@ -1564,18 +2692,21 @@ static int xio_send_typed_msg(struct xio_connection *connection,
 				connection->tx_queued_msgs,
 				connection->tx_bytes);
 		}
-		if (nr == -1)
-			xio_msg_list_insert_tail(&connection->reqs_msgq, pmsg,
-						 pdata);
-		else {
+		if (nr == -1) {
+			xio_connection_queue_msg(connection,
+						 connection->reqs_msgq, pmsg);
+		} else {
 			nr++;
-			xio_msg_list_insert_tail(&reqs_msgq, pmsg, pdata);
+			prio = xio_connection_msg_prio(pmsg);
+			xio_msg_list_insert_tail(&reqs_msgq[prio], pmsg, pdata);
+			nr_prio[prio]++;
 		}
 
 		pmsg = pmsg->next;
 	}
 	if (nr > 0)
-		xio_msg_list_concat(&connection->reqs_msgq, &reqs_msgq, pdata);
+		xio_connection_queue_batch(connection, connection->reqs_msgq,
+					   reqs_msgq, nr_prio);
 
 send:
 	/* do not xmit until connection is assigned */
@@ -1649,6 +2780,7 @@ int xio_connection_xmit_msgs(struct xio_connection *connection)
 /*---------------------------------------------------------------------------*/
 static int xio_connection_flush_all_tasks(struct xio_connection *connection)
 {
+	xio_nexus_txq_flush(&connection->nexus_txq);
 	if (!list_empty(&connection->io_tasks_list)) {
 		TRACE_LOG("io_tasks_list not empty! connection:%p\n", connection);
 		xio_tasks_list_flush(&connection->io_tasks_list);
@@ -1661,6 +2793,10 @@ static int xio_connection_flush_all_tasks(struct xio_connection *connection)
 		TRACE_LOG("pre_send_list not empty! connection:%p\n", connection);
 		xio_tasks_list_flush(&connection->pre_send_list);
 	}
+	if (!list_empty(&connection->agg_rx_list)) {
+		TRACE_LOG("agg_rx_list not empty! connection:%p\n", connection);
+		xio_tasks_list_flush(&connection->agg_rx_list);
+	}
 
 	return 0;
 }
@@ -1695,6 +2831,23 @@ static void xio_connection_post_close(void *_connection)
 
 	xio_context_disable_event(&connection->disconnect_event);
 
+	xio_context_disable_event(&connection->agg_flush_event);
+
+	xio_context_disable_event(&connection->batch_event);
+
+	xio_context_disable_event(&connection->comp_event);
+
+	xio_context_disable_event(&connection->credits_event);
+
+	xio_ctx_del_delayed_work(connection->ctx,
+				 &connection->agg_flush_work);
+
+	xio_ctx_del_delayed_work(connection->ctx,
+				 &connection->agg_rx_work);
+
+	xio_ctx_del_delayed_work(connection->ctx,
+				 &connection->comp_work);
+
 	xio_ctx_del_work(connection->ctx, &connection->hello_work);
 
 	xio_ctx_del_delayed_work(connection->ctx,
@@ -1712,6 +2865,9 @@ static void xio_connection_post_close(void *_connection)
 	xio_ctx_del_delayed_work(connection->ctx,
 				 &connection->ka.timer);
 
+	xio_ctx_del_delayed_work(connection->ctx,
+				 &connection->deadline_work);
+
 	xio_ctx_del_work(connection->ctx, &connection->disconnect_work);
 
 	xio_ctx_del_work(connection->ctx, &connection->teardown_work);
@@ -1722,10 +2878,30 @@ static void xio_connection_post_close(void *_connection)
 
 	xio_connection_detach_of_tasks(connection);
 
+	if (connection->agg_pool)
+		xio_objpool_destroy(connection->agg_pool);
+
+	if (connection->batch_msgs)
+		xio_context_kfree(connection->ctx, connection->batch_msgs);
+
+	if (connection->comp_msgs)
+		xio_context_kfree(connection->ctx, connection->comp_msgs);
+
+	if (connection->breakdowns)
+		xio_context_kfree(connection->ctx, connection->breakdowns);
+
+	if (connection->ctx->cq)
+		xio_connection_cq_purge(connection);
+
+	xio_stat_set_put(connection->ctx, connection->ses_stats);
+	xio_stat_set_put(connection->ctx, connection->stats);
+
 	spin_lock(&connection->ctx->ctx_list_lock);
 	list_del(&connection->ctx_list_entry);
 	spin_unlock(&connection->ctx->ctx_list_lock);
 
+	xio_ctx_mem_sub(connection->ctx, XIO_MEM_CLASS_CONNECTION,
+			sizeof(*connection), 1);
 	xio_context_kfree(connection->ctx, connection);
 
 }
@@ -1763,6 +2939,59 @@ void xio_connection_queue_io_task(struct xio_connection *connection,
 	list_move_tail(&task->tasks_list_entry, &connection->io_tasks_list);
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_connection_credits_ack_handler					     */
+/*---------------------------------------------------------------------------*/
+static void xio_connection_credits_ack_handler(void *_connection)
+{
+	struct xio_connection *connection = (struct xio_connection *)_connection;
+
+	/* nothing to do if the credits went out in a message header */
+	if (connection->state == XIO_CONNECTION_STATE_ONLINE &&
+	    ((connection->credits_msgs >=
+	      connection->rx_queue_watermark_msgs) ||
+	     (connection->credits_bytes >=
+	      connection->rx_queue_watermark_bytes)))
+		xio_send_credits_ack(connection);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_credits_ack_sched					     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_connection_credits_ack_sched(
+		struct xio_connection *connection)
+{
+	if (connection->state != XIO_CONNECTION_STATE_ONLINE ||
+	    ((connection->credits_msgs <
+	      connection->rx_queue_watermark_msgs) &&
+	     (connection->credits_bytes <
+	      connection->rx_queue_watermark_bytes)))
+		return;
+
+	/* every session header carries the pending credits. defer the
+	 * standalone ack to the next loop iteration, so that requests and
+	 * responses sent meanwhile carry the credits instead
+	 */
+	connection->credits_event.handler = xio_connection_credits_ack_handler;
+	connection->credits_event.data = connection;
+	xio_context_add_event(connection->ctx, &connection->credits_event);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_return_credits					     */
+/*---------------------------------------------------------------------------*/
+/* returns the credits of received messages that were never delivered */
+void xio_connection_return_credits(struct xio_connection *connection,
+				   uint32_t msgs, uint64_t bytes)
+{
+	if (!connection->enable_flow_control)
+		return;
+
+	connection->credits_msgs += (uint16_t)msgs;
+	connection->credits_bytes += bytes;
+	xio_connection_credits_ack_sched(connection);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_release_response_task						     */
 /*---------------------------------------------------------------------------*/
@@ -1855,12 +3084,7 @@ int xio_release_response(struct xio_msg *msg)
 			connection->credits_msgs++;
 			connection->credits_bytes += bytes;
 
-			if (connection->state == XIO_CONNECTION_STATE_ONLINE &&
-			    ((connection->credits_msgs >=
-			      connection->rx_queue_watermark_msgs) ||
-			     (connection->credits_bytes >=
-			      connection->rx_queue_watermark_bytes)))
-				xio_send_credits_ack(connection);
+			xio_connection_credits_ack_sched(connection);
 		}
 
 		list_move_tail(&task->tasks_list_entry,
@@ -1936,12 +3160,7 @@ int xio_release_msg(struct xio_msg *msg)
 
 			connection->credits_msgs++;
 			connection->credits_bytes += bytes;
-			if (connection->state == XIO_CONNECTION_STATE_ONLINE &&
-			    ((connection->credits_msgs >=
-			      connection->rx_queue_watermark_msgs) ||
-			     (connection->credits_bytes >=
-			      connection->rx_queue_watermark_bytes)))
-				xio_send_credits_ack(connection);
+			xio_connection_credits_ack_sched(connection);
 		}
 
 		list_move_tail(&task->tasks_list_entry,
@@ -2090,7 +3309,7 @@ int xio_send_fin_req(struct xio_connection *connection)
 	msg->out.data_tbl.nents	= 0;
 
 	/* insert to the tail of the queue */
-	xio_msg_list_insert_tail(&connection->reqs_msgq, msg, pdata);
+	xio_connection_queue_msg(connection, connection->reqs_msgq, msg);
 
 	DEBUG_LOG("send fin request. session:%p, connection:%p\n",
 		  connection->session, connection);
@@ -2137,7 +3356,7 @@ int xio_send_fin_ack(struct xio_connection *connection, struct xio_task *task)
 	msg->out.data_tbl.nents	= 0;
 
 	/* insert to the tail of the queue */
-	xio_msg_list_insert_tail(&connection->rsps_msgq, msg, pdata);
+	xio_connection_queue_msg(connection, connection->rsps_msgq, msg);
 
 	DEBUG_LOG("send fin response. session:%p, connection:%p\n",
 		  connection->session, connection);
@@ -2374,6 +3593,71 @@ int xio_modify_connection(struct xio_connection *connection,
 		else
 			connection->disconnect_timeout = XIO_DEF_CONNECTION_TIMEOUT;
         }
+	if (test_bits(XIO_CONNECTION_ATTR_AGGREGATION, &attr_mask)) {
+		if (attr->agg_max_bytes && !connection->agg_pool) {
+			/* carriers are sent inline, size them accordingly */
+			connection->agg_pool = xio_objpool_create(
+					connection->ctx,
+					sizeof(struct xio_agg_carrier) +
+					g_options.max_inline_xio_data,
+					2, 8);
+			if (!connection->agg_pool) {
+				ERROR_LOG("failed to create aggregation pool\n");
+				xio_set_error(ENOMEM);
+				return -1;
+			}
+			connection->agg_flush_event.handler =
+					xio_connection_agg_flush_handler;
+			connection->agg_flush_event.data = connection;
+		}
+		connection->agg_max_bytes = min(attr->agg_max_bytes,
+				(uint32_t)g_options.max_inline_xio_data);
+		connection->agg_max_delay_us = min(attr->agg_max_delay_us,
+					(uint32_t)XIO_COALESCE_MAX_DELAY_US);
+		/* release a batch that may be held back */
+		if (!connection->agg_max_bytes && connection->agg_armed) {
+			xio_context_disable_event(&connection->agg_flush_event);
+			xio_ctx_del_delayed_work(connection->ctx,
+						 &connection->agg_flush_work);
+			connection->agg_armed = 0;
+			if (xio_is_connection_online(connection))
+				xio_connection_xmit(connection);
+		}
+	}
+	if (test_bits(XIO_CONNECTION_ATTR_PRIO_WEIGHTS, &attr_mask)) {
+		int prio, weighted = 0;
+
+		for (prio = 0; prio < XIO_MSG_PRIO_NR; prio++)
+			weighted |= attr->prio_weights[prio];
+		/* in weighted mode every class gets at least one slot */
+		for (prio = 0; prio < XIO_MSG_PRIO_NR; prio++)
+			connection->prio_weights[prio] =
+				(weighted && !attr->prio_weights[prio]) ?
+					1 : attr->prio_weights[prio];
+	}
+	if (test_bits(XIO_CONNECTION_ATTR_LATENCY, &attr_mask)) {
+		/* start the distributions over, e.g. per reporting period */
+		memset(&connection->stats->slots[XIO_CONNECTION_STAT_RTT], 0,
+		       3 * XIO_STAT_LAT_SLOTS *
+		       sizeof(*connection->stats->slots));
+	}
+	if (test_bits(XIO_CONNECTION_ATTR_COMP_COALESCING, &attr_mask)) {
+		/* pending completions go out under the old settings */
+		xio_connection_comp_flush(connection);
+		connection->comp_max_msgs = min(attr->comp_max_msgs,
+						(uint32_t)XIO_COMP_BATCH_MAX);
+		connection->comp_max_delay_us = min(attr->comp_max_delay_us,
+					(uint32_t)XIO_COALESCE_MAX_DELAY_US);
+		/* sized again on the next completion, or once the
+		 * application returns the batch it holds
+		 */
+		if (connection->comp_msgs && !connection->comp_busy) {
+			xio_context_kfree(connection->ctx,
+					  connection->comp_msgs);
+			connection->comp_msgs = NULL;
+		}
+		connection->comp_cap = 0;
+	}
 		/*
 	memset(&nattr, 0, sizeof(nattr));
 	if (test_bits(XIO_CONNECTION_ATTR_TOS, &attr_mask)) {
@@ -2423,6 +3707,40 @@ int xio_query_connection(struct xio_connection *connection,
         if (test_bits(XIO_CONNECTION_ATTR_DISCONNECT_TIMEOUT, &attr_mask))
                 attr->disconnect_timeout_secs = connection->disconnect_timeout/1000;
 
+	if (attr_mask & XIO_CONNECTION_ATTR_AGGREGATION) {
+		attr->agg_max_bytes = connection->agg_max_bytes;
+		attr->agg_max_delay_us = connection->agg_max_delay_us;
+	}
+
+	if (attr_mask & XIO_CONNECTION_ATTR_COMP_COALESCING) {
+		attr->comp_max_msgs = connection->comp_max_msgs;
+		attr->comp_max_delay_us = connection->comp_max_delay_us;
+	}
+
+	if (attr_mask & XIO_CONNECTION_ATTR_LATENCY) {
+		uint64_t *slots = connection->stats->slots;
+		uint64_t hertz = connection->ctx->stats.hertz;
+
+		xio_stat_latency(&slots[XIO_CONNECTION_STAT_RTT], hertz,
+				 &attr->rtt);
+		xio_stat_latency(&slots[XIO_CONNECTION_STAT_APP_HOLD], hertz,
+				 &attr->app_hold);
+		xio_stat_latency(&slots[XIO_CONNECTION_STAT_QUEUEING], hertz,
+				 &attr->queueing);
+	}
+
+	if (attr_mask & XIO_CONNECTION_ATTR_PRIO_WEIGHTS)
+		memcpy(attr->prio_weights, connection->prio_weights,
+		       sizeof(attr->prio_weights));
+
+	if (attr_mask & XIO_CONNECTION_ATTR_PRIO_STATS) {
+		memcpy(attr->prio_queued_msgs, connection->prio_queued_msgs,
+		       sizeof(attr->prio_queued_msgs));
+		memcpy(attr->prio_max_queued_msgs,
+		       connection->prio_max_queued_msgs,
+		       sizeof(attr->prio_max_queued_msgs));
+	}
+
 	if (attr_mask & XIO_CONNECTION_ATTR_PROTO)
 		attr->proto = (enum xio_proto)
 					xio_nexus_get_proto(connection->nexus);
@@ -2447,6 +3765,99 @@ int xio_query_connection(struct xio_connection *connection,
 }
 EXPORT_SYMBOL(xio_query_connection);
 
+/*---------------------------------------------------------------------------*/
+/* xio_connection_stat_breakdown					     */
+/*---------------------------------------------------------------------------*/
+void xio_connection_stat_breakdown(struct xio_connection *connection,
+				   struct xio_task *req_task,
+				   struct xio_task *rsp_task,
+				   struct xio_session_hdr *hdr)
+{
+	struct xio_msg		 *omsg = req_task->omsg;
+	struct xio_msg_breakdown *bd;
+	uint64_t		 cycles[XIO_MSG_STAGE_NR];
+	uint64_t		 hertz = connection->ctx->stats.hertz;
+	uint64_t		 submit = omsg->timestamp;
+	uint64_t		 sent = req_task->stamps[XIO_TASK_STAMP_SEND];
+	uint64_t		 xmit = req_task->stamps[XIO_TASK_STAMP_XMIT];
+	uint64_t		 recv = rsp_task->stamps[XIO_TASK_STAMP_RECV];
+	uint64_t		 now = get_cycles();
+	uint64_t		 server;
+	int			 i;
+
+	/* transports that do not stamp the transmission */
+	if (!xmit)
+		xmit = sent;
+
+	cycles[XIO_MSG_STAGE_QUEUED] = sent > submit ? sent - submit : 0;
+	cycles[XIO_MSG_STAGE_XMIT] = xmit > sent ? xmit - sent : 0;
+	cycles[XIO_MSG_STAGE_SERVER_QUEUE] = xio_stat_ns_to_cycles(
+			xio_stat_ns_unpack(hdr->timeout_us >> 16), hertz);
+	cycles[XIO_MSG_STAGE_SERVER_APP] = xio_stat_ns_to_cycles(
+			xio_stat_ns_unpack(hdr->timeout_us & 0xffff), hertz);
+	server = cycles[XIO_MSG_STAGE_SERVER_QUEUE] +
+		 cycles[XIO_MSG_STAGE_SERVER_APP];
+	/* the clocks differ, the wire gets what the server did not spend */
+	cycles[XIO_MSG_STAGE_WIRE] = recv > xmit + server ?
+					recv - xmit - server : 0;
+	cycles[XIO_MSG_STAGE_DELIVER] = now > recv ? now - recv : 0;
+
+	for (i = 0; i < XIO_MSG_STAGE_NR; i++)
+		xio_stat_set_lat(connection->ctx->stat_set,
+				 XIO_CONTEXT_STAT_STAGE +
+				 i * XIO_STAT_LAT_SLOTS, cycles[i]);
+
+	if (unlikely(!connection->breakdowns)) {
+		connection->breakdowns = (struct xio_msg_breakdown *)
+			xio_context_kcalloc(connection->ctx,
+					    XIO_CONNECTION_BREAKDOWNS,
+					    sizeof(*connection->breakdowns),
+					    GFP_KERNEL);
+		if (!connection->breakdowns)
+			return;
+	}
+	/* the ring keeps the latest, the oldest is overwritten */
+	bd = &connection->breakdowns[(connection->bd_first +
+				      connection->bd_nr) %
+				     XIO_CONNECTION_BREAKDOWNS];
+	if (connection->bd_nr == XIO_CONNECTION_BREAKDOWNS)
+		connection->bd_first = (connection->bd_first + 1) %
+					XIO_CONNECTION_BREAKDOWNS;
+	else
+		connection->bd_nr++;
+
+	bd->user_context = omsg->user_context;
+	bd->sn		 = omsg->sn;
+	bd->total_ns	 = xio_stat_cycles_to_ns(now > submit ?
+						 now - submit : 0, hertz);
+	for (i = 0; i < XIO_MSG_STAGE_NR; i++)
+		bd->stage_ns[i] = xio_stat_cycles_to_ns(cycles[i], hertz);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_get_breakdowns					     */
+/*---------------------------------------------------------------------------*/
+int xio_connection_get_breakdowns(struct xio_connection *connection,
+				  struct xio_msg_breakdown *bd, int nr)
+{
+	int i;
+
+	if (!connection || !bd || nr < 0) {
+		xio_set_error(EINVAL);
+		ERROR_LOG("invalid parameters\n");
+		return -1;
+	}
+	for (i = 0; i < nr && connection->bd_nr; i++) {
+		bd[i] = connection->breakdowns[connection->bd_first];
+		connection->bd_first = (connection->bd_first + 1) %
+					XIO_CONNECTION_BREAKDOWNS;
+		connection->bd_nr--;
+	}
+
+	return i;
+}
+EXPORT_SYMBOL(xio_connection_get_breakdowns);
+
 /*---------------------------------------------------------------------------*/
 /* xio_connection_send_hello_req					     */
 /*---------------------------------------------------------------------------*/
@@ -2710,6 +4121,8 @@ int xio_connection_destroy(struct xio_connection *connection)
 				 &connection->fin_ack_timeout_work);
 	xio_ctx_del_delayed_work(connection->ctx,
 				 &connection->ka.timer);
+	xio_ctx_del_delayed_work(connection->ctx,
+				 &connection->deadline_work);
 
 	kref_put(&connection->kref, xio_connection_post_destroy);
 #ifdef XIO_THREAD_SAFE_DEBUG
@@ -2813,6 +4226,9 @@ void xio_connection_sched_disconnect_event(struct xio_connection *connection)
 	xio_ctx_del_delayed_work(connection->ctx,
 				 &connection->ka.timer);
 
+	xio_ctx_del_delayed_work(connection->ctx,
+				 &connection->deadline_work);
+
 	xio_ctx_del_work(connection->ctx, &connection->disconnect_work);
 
 	xio_ctx_del_delayed_work(connection->ctx, &connection->connect_work);
@@ -3395,7 +4811,7 @@ int xio_send_credits_ack(struct xio_connection *connection)
 	msg->out.data_tbl.nents	= 0;
 
 	/* insert to the head of the queue */
-	xio_msg_list_insert_tail(&connection->reqs_msgq, msg, pdata);
+	xio_connection_queue_msg(connection, connection->reqs_msgq, msg);
 
 	DEBUG_LOG("send credits_msgs ack. session:%p, connection:%p\n",
 		  connection->session, connection);
@@ -3727,6 +5143,9 @@ void xio_connection_keepalive_intvl(int actual_timeout_ms, void *_connection)
 	}
 
 	connection->ka.timedout = 1;
+	xio_flight_rec(connection->ctx, XIO_FLIGHT_KA_TIMEOUT, connection,
+		       connection->state, connection->ka.probes + 1,
+		       connection->ka.options.probes, 0);
 
     if (++connection->ka.probes == connection->ka.options.probes) {
         ERROR_LOG("connection keepalive timeout. connection:%p probes:[%d]\n",
@@ -59,6 +59,43 @@ enum xio_connection_state {
 
 #define         XIO_DEF_CONNECTION_TIMEOUT	300000
 
+/* most one way messages packed into one aggregated message */
+#define		XIO_AGG_MAX_MSGS		64
+
+/* longest aggregation or completion coalescing delay. delays under a
+ * millisecond are polled from the loop, longer ones wait on a timer
+ */
+#define		XIO_COALESCE_MAX_DELAY_US	1000000
+#define		XIO_COALESCE_POLL_DELAY_US	1000
+
+/* retry period of aggregated messages waiting for free tasks */
+#define		XIO_AGG_RX_RETRY_MS		1
+
+/* handles in connection->stats - slot offsets in registration order */
+enum xio_connection_stat {
+	XIO_CONNECTION_STAT_TX_MSGS,
+	XIO_CONNECTION_STAT_TX_BYTES,
+	XIO_CONNECTION_STAT_RX_MSGS,
+	XIO_CONNECTION_STAT_RX_BYTES,
+	XIO_CONNECTION_STAT_QUEUED_MSGS,
+	XIO_CONNECTION_STAT_TX_MSG_SIZE,
+	XIO_CONNECTION_STAT_RTT		= XIO_CONNECTION_STAT_TX_MSG_SIZE +
+					  XIO_STAT_HIST_SLOTS,
+	XIO_CONNECTION_STAT_APP_HOLD	= XIO_CONNECTION_STAT_RTT +
+					  XIO_STAT_LAT_SLOTS,
+	XIO_CONNECTION_STAT_QUEUEING	= XIO_CONNECTION_STAT_APP_HOLD +
+					  XIO_STAT_LAT_SLOTS
+};
+
+/* handles in connection->ses_stats, shared by the session's connections
+ * on one context
+ */
+enum xio_session_stat {
+	XIO_SESSION_STAT_TX_MSGS,
+	XIO_SESSION_STAT_RX_MSGS,
+	XIO_SESSION_STAT_CONNECTIONS
+};
+
 struct xio_transition {
 	int				valid;
 	enum xio_connection_state	next_state;
@@ -75,6 +112,17 @@ struct xio_ka {
 	struct xio_options_keepalive	options;
 };
 
+/* wire message carrying packed one way messages - see XIO_MSG_FLAG_EX_AGGREGATED */
+struct xio_agg_carrier {
+	struct xio_msg			msg;
+	struct xio_msg			*msgs[XIO_AGG_MAX_MSGS];
+	uint32_t			nr;
+	uint32_t			len;
+	uint64_t			bytes;	/* flow control bytes of msgs */
+	struct xio_agg_msg_hdr		hdr;	/* packed totals, wire order  */
+	uint8_t				buf[];
+};
+
 struct xio_connection {
 	struct xio_ka			ka;
 	struct xio_nexus		*nexus;
@@ -106,7 +154,7 @@ struct xio_connection {
 	uint16_t			disconnecting;
 	uint16_t			restarted;
 
-	uint64_t			latest_delivered;
+	uint64_t			latest_delivered[XIO_MSG_PRIO_NR];
 
 	uint16_t			is_flushed;
 	uint16_t			send_req_toggle;
@@ -120,8 +168,12 @@ struct xio_connection {
 	uint32_t			disconnect_timeout;
 	enum xio_connection_state	state;
 
-	struct xio_msg_list		reqs_msgq;
-	struct xio_msg_list		rsps_msgq;
+	/* transmit queues per priority class */
+	struct xio_msg_list		reqs_msgq[XIO_MSG_PRIO_NR];
+	struct xio_msg_list		rsps_msgq[XIO_MSG_PRIO_NR];
+	uint32_t			prio_queued_msgs[XIO_MSG_PRIO_NR];
+	uint32_t			prio_max_queued_msgs[XIO_MSG_PRIO_NR];
+	uint16_t			prio_weights[XIO_MSG_PRIO_NR];
 	struct xio_msg_list		in_flight_reqs_msgq;
 	struct xio_msg_list		in_flight_rsps_msgq;
 
@@ -131,6 +183,7 @@ struct xio_connection {
 	xio_delayed_work_handle_t	fin_req_timeout_work;
 	xio_delayed_work_handle_t	fin_ack_timeout_work;
 	struct xio_ev_data		disconnect_event;
+	struct xio_ev_data		credits_event;
 
 	struct list_head		managed_rkey_list;
 	struct list_head		io_tasks_list;
@@ -147,10 +200,59 @@ struct xio_connection {
 
 	uint32_t			nexus_attr_mask;
 	struct xio_nexus_init_attr	nexus_attr;
+	/* share of a nexus shared with other connections */
+	struct xio_nexus_txq		nexus_txq;
 
 	xio_work_handle_t		teardown_work;
 	xio_delayed_work_handle_t	connect_work;
 
+	/* earliest queued request deadline the timer is armed for, cycles */
+	uint64_t			deadline_next;
+	xio_delayed_work_handle_t	deadline_work;
+
+	/* one way messages aggregation */
+	uint32_t			agg_max_bytes;
+	uint32_t			agg_max_delay_us;
+	uint64_t			agg_start_ns;
+	uint16_t			agg_flush;
+	uint16_t			agg_armed;
+	uint32_t			agg_pad;
+	struct xio_objpool		*agg_pool;
+	struct xio_ev_data		agg_flush_event;
+	xio_delayed_work_handle_t	agg_flush_work;
+	/* received requests held back until the tasks pool has room */
+	struct list_head		agg_rx_list;
+	xio_delayed_work_handle_t	agg_rx_work;
+
+	/* messages of one transport poll pending for on_msg_batch */
+	struct xio_msg			**batch_msgs;
+	uint32_t			batch_nr;
+	uint16_t			batch_armed;
+	uint16_t			batch_busy;
+	struct xio_ev_data		batch_event;
+
+	/* send completions pending for on_msg_send_complete_batch */
+	uint32_t			comp_max_msgs;
+	uint32_t			comp_max_delay_us;
+	uint64_t			comp_start_ns;
+	struct xio_msg			**comp_msgs;
+	uint32_t			comp_nr;
+	uint32_t			comp_cap;
+	uint16_t			comp_armed;
+	uint16_t			comp_busy;
+	uint32_t			comp_pad;
+	struct xio_ev_data		comp_event;
+	xio_delayed_work_handle_t	comp_work;
+
+	struct xio_stat_set		*stats;
+	struct xio_stat_set		*ses_stats;
+
+	/* breakdowns of the last sampled requests, see XIO_MSG_FLAG_EX_SAMPLED */
+	uint32_t			sample_count;
+	uint16_t			bd_first;
+	uint16_t			bd_nr;
+	struct xio_msg_breakdown	*breakdowns;
+
 #ifdef XIO_SESSION_DEBUG
 	uint64_t			peer_connection;
 	uint64_t			peer_session;
@@ -208,6 +310,9 @@ int xio_connection_release_read_receipt(struct xio_connection *connection,
 
 void xio_release_response_task(struct xio_task *task);
 
+void xio_connection_return_credits(struct xio_connection *connection,
+				   uint32_t msgs, uint64_t bytes);
+
 int xio_send_fin_ack(struct xio_connection *connection,
 		     struct xio_task *task);
 
@@ -228,6 +333,100 @@ int xio_connection_remove_msg_from_queue(struct xio_connection *connection,
 void xio_connection_safe_remove_msg_from_queue(struct xio_connection *connection,
 					       struct xio_msg *msg);
 
+void xio_connection_batch_add(struct xio_connection *connection,
+			      struct xio_msg *msg, int last_in_rxq);
+
+void xio_connection_batch_flush(struct xio_connection *connection);
+
+void xio_connection_comp_add(struct xio_connection *connection,
+			     struct xio_msg *msg);
+
+void xio_connection_comp_flush(struct xio_connection *connection);
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_deliver_pending					     */
+/*---------------------------------------------------------------------------*/
+/* hand over batched messages and completions before other notifications */
+static inline void xio_connection_deliver_pending(
+				struct xio_connection *connection)
+{
+	xio_connection_batch_flush(connection);
+	xio_connection_comp_flush(connection);
+}
+
+void xio_connection_cq_push(struct xio_connection *connection,
+			    enum xio_cq_event_type type,
+			    struct xio_msg *msg, int last_in_rxq,
+			    enum xio_status status,
+			    enum xio_msg_direction direction);
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_stat_tx						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_connection_stat_tx(struct xio_connection *connection,
+					  uint64_t bytes)
+{
+	struct xio_stat_set *set = connection->stats;
+
+	xio_stat_set_inc(set, XIO_CONNECTION_STAT_TX_MSGS);
+	xio_stat_set_add(set, XIO_CONNECTION_STAT_TX_BYTES, bytes);
+	xio_stat_set_hist(set, XIO_CONNECTION_STAT_TX_MSG_SIZE, bytes);
+	xio_stat_set_inc(connection->ses_stats, XIO_SESSION_STAT_TX_MSGS);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_stat_rx						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_connection_stat_rx(struct xio_connection *connection,
+					  uint64_t bytes)
+{
+	struct xio_stat_set *set = connection->stats;
+
+	xio_stat_set_inc(set, XIO_CONNECTION_STAT_RX_MSGS);
+	xio_stat_set_add(set, XIO_CONNECTION_STAT_RX_BYTES, bytes);
+	xio_stat_set_inc(connection->ses_stats, XIO_SESSION_STAT_RX_MSGS);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_stat_lat						     */
+/*---------------------------------------------------------------------------*/
+/* records a delay in cycles on the connection and on its context */
+static inline void xio_connection_stat_lat(struct xio_connection *connection,
+					   int conn_stat, int ctx_stat,
+					   uint64_t cycles)
+{
+	xio_stat_set_lat(connection->stats, conn_stat, cycles);
+	xio_stat_set_lat(connection->ctx->stat_set, ctx_stat, cycles);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_sample						     */
+/*---------------------------------------------------------------------------*/
+/* picks one in every XIO_OPTNAME_MSG_SAMPLE_RATE requests to be timed */
+static inline int xio_connection_sample(struct xio_connection *connection)
+{
+	if (likely(!g_options.msg_sample_rate) ||
+	    ++connection->sample_count <
+			(uint32_t)g_options.msg_sample_rate)
+		return 0;
+
+	connection->sample_count = 0;
+	return 1;
+}
+
+void xio_connection_stat_breakdown(struct xio_connection *connection,
+				   struct xio_task *req_task,
+				   struct xio_task *rsp_task,
+				   struct xio_session_hdr *hdr);
+
+/*---------------------------------------------------------------------------*/
+/* xio_connection_cq_enabled						     */
+/*---------------------------------------------------------------------------*/
+static inline int xio_connection_cq_enabled(struct xio_connection *connection)
+{
+	return connection->ctx->cq != NULL;
+}
+
 int xio_connection_send_hello_req(struct xio_connection *connection);
 
 int xio_connection_send_hello_rsp(struct xio_connection *connection,
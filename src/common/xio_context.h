@@ -67,9 +67,8 @@ enum xio_counters {
 	XIO_STAT_RX_BYTES,
 	XIO_STAT_DELAY,
 	XIO_STAT_APPDELAY,
-	/* user can register 10 more messages */
-	XIO_STAT_USER_FIRST,
-	XIO_STAT_LAST = 16
+	/* further counters live in the context's xio_stat_set */
+	XIO_STAT_LAST
 };
 
 typedef int (*poll_completions_fn_t)(void *, int);
@@ -79,8 +78,15 @@ typedef int (*poll_completions_fn_t)(void *, int);
 /*---------------------------------------------------------------------------*/
 struct xio_statistics {
 	uint64_t	hertz;
-	uint64_t	counter[XIO_STAT_LAST];
+	/* local_counter or the published segment's counters */
+	uint64_t	*counter;
+	/* odd while a counter is updated - readers retry */
+	uint32_t	*seq;
+	void		*shm;
 	char		*name[XIO_STAT_LAST];
+	uint64_t	local_counter[XIO_STAT_LAST];
+	uint32_t	local_seq;
+	uint32_t	pad;
 };
 
 struct xio_context {
@@ -112,24 +118,44 @@ struct xio_context {
 	uint32_t			prealloc_xio_inline_bufs:1;
 	uint32_t			register_internal_mempool:1;
 	uint32_t			allocator_assigned:1;
-	uint32_t			resereved:27;
+	uint32_t			contig_task_slabs:1;
+	uint32_t			lean_conns:1;
+	uint32_t			resereved:25;
 
 	/* context allocator */
 	struct xio_mem_allocator 	mem_allocator;
 	struct xio_statistics		stats;
+	struct xio_mem_stats		mem_stats[XIO_MEM_CLASS_LAST];
 	void				*user_context;
 	struct xio_workqueue		*workqueue;
 	struct list_head		ctx_list;  /* per context storage */
+	/* struct xio_stat_set of the context and of the objects it runs */
+	struct list_head		stat_sets;
+	struct xio_stat_set		*stat_set;
+	/* recent connection and transport events */
+	struct xio_flight		*flight;
+	/* loop thread hardware counters - user space only */
+	struct xio_perf_counters	*perf;
 
 	/* list of sessions using this connection */
 	struct xio_observable		observable;
 	void				*netlink_sock;
+	/* runtime tuning socket - user space only */
+	struct xio_control		*control;
+	/* transports' tx/rx iovec scratch - shared by all connections */
+	void				*iov_scratch;
+	/* message events harvested by xio_poll_cq - NULL for callbacks */
+	struct xio_cq_event		*cq;
 	xio_work_handle_t               destroy_ctx_work;
+	xio_ctx_delayed_work_t		shrink_work;
+	xio_ctx_delayed_work_t		flight_work;
 	spinlock_t                      ctx_list_lock;
 
 	int				max_conns_per_ctx;
 	int				rq_depth;
-	int				pad;
+	uint32_t			cq_size;	/* power of two */
+	uint32_t			cq_head;	/* free running */
+	uint32_t			cq_tail;
 #ifdef XIO_THREAD_SAFE_DEBUG
 	int                             nptrs;
 	int				pad1;
@@ -153,6 +179,7 @@ void xio_context_unreg_observer(struct xio_context *conn,
 /*---------------------------------------------------------------------------*/
 /* xio_add_counter							     */
 /*---------------------------------------------------------------------------*/
+/* returns the handle for xio_stat_set_inc/add on ctx->stat_set or -1 */
 int xio_add_counter(struct xio_context *ctx, char *name);
 
 /*---------------------------------------------------------------------------*/
@@ -161,20 +188,21 @@ int xio_add_counter(struct xio_context *ctx, char *name);
 int xio_del_counter(struct xio_context *ctx, int counter);
 
 /*---------------------------------------------------------------------------*/
-/* xio_ctx_stat_add							     */
+/* xio_stat_write_begin							     */
 /*---------------------------------------------------------------------------*/
-static inline void xio_ctx_stat_add(struct xio_context *ctx,
-				    int counter, uint64_t val)
+static inline void xio_stat_write_begin(struct xio_statistics *stats)
 {
-	ctx->stats.counter[counter] += val;
+	(*stats->seq)++;
+	xio_smp_wmb();
 }
 
 /*---------------------------------------------------------------------------*/
-/* xio_ctx_stat_inc							     */
+/* xio_stat_write_end							     */
 /*---------------------------------------------------------------------------*/
-static inline void xio_ctx_stat_inc(struct xio_context *ctx, int counter)
+static inline void xio_stat_write_end(struct xio_statistics *stats)
 {
-	ctx->stats.counter[counter]++;
+	xio_smp_wmb();
+	(*stats->seq)++;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -183,7 +211,9 @@ static inline void xio_ctx_stat_inc(struct xio_context *ctx, int counter)
 static inline void xio_stat_add(struct xio_statistics *stats,
 				int counter, uint64_t val)
 {
+	xio_stat_write_begin(stats);
 	stats->counter[counter] += val;
+	xio_stat_write_end(stats);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -191,9 +221,70 @@ static inline void xio_stat_add(struct xio_statistics *stats,
 /*---------------------------------------------------------------------------*/
 static inline void xio_stat_inc(struct xio_statistics *stats, int counter)
 {
+	xio_stat_write_begin(stats);
 	stats->counter[counter]++;
+	xio_stat_write_end(stats);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_ctx_stat_add							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_ctx_stat_add(struct xio_context *ctx,
+				    int counter, uint64_t val)
+{
+	xio_stat_add(&ctx->stats, counter, val);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_ctx_stat_inc							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_ctx_stat_inc(struct xio_context *ctx, int counter)
+{
+	xio_stat_inc(&ctx->stats, counter);
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_ctx_mem_add							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_ctx_mem_add(struct xio_context *ctx,
+				   enum xio_mem_class mem_class,
+				   size_t bytes, size_t objs)
+{
+	struct xio_mem_stats *mem_stats;
+	uint64_t	     curr;
+
+	if (!ctx)
+		return;
+
+	/* pools may grow from foreign threads - peak is best effort */
+	mem_stats = &ctx->mem_stats[mem_class];
+	curr = xio_sync_fetch_and_add64(&mem_stats->bytes, bytes) + bytes;
+	xio_sync_fetch_and_add64(&mem_stats->objs, objs);
+	if (curr > mem_stats->peak_bytes)
+		mem_stats->peak_bytes = curr;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_ctx_mem_sub							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_ctx_mem_sub(struct xio_context *ctx,
+				   enum xio_mem_class mem_class,
+				   size_t bytes, size_t objs)
+{
+	if (!ctx)
+		return;
+
+	xio_sync_fetch_and_add64(&ctx->mem_stats[mem_class].bytes,
+				 -(uint64_t)bytes);
+	xio_sync_fetch_and_add64(&ctx->mem_stats[mem_class].objs,
+				 -(uint64_t)objs);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_context_cq_resize						     */
+/*---------------------------------------------------------------------------*/
+int xio_context_cq_resize(struct xio_context *ctx, uint32_t size);
+
 /*---------------------------------------------------------------------------*/
 /* xio_ctx_add_delayed_work						     */
 /*---------------------------------------------------------------------------*/
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <sys/hashtable.h>
+#include <xio_os.h>
+#include "libxio.h"
+#include "xio_log.h"
+#include "xio_common.h"
+#include "xio_hash.h"
+#include "xio_protocol.h"
+#include "xio_mbuf.h"
+#include "xio_task.h"
+#include "xio_observer.h"
+#include "xio_transport.h"
+#include "xio_msg_list.h"
+#include "xio_ev_data.h"
+#include "xio_objpool.h"
+#include "xio_workqueue.h"
+#include "xio_sg_table.h"
+#include "xio_context.h"
+#include "xio_nexus.h"
+#include "xio_session.h"
+#include "xio_stats.h"
+#include "xio_connection.h"
+#include "xio_flight.h"
+
+/*---------------------------------------------------------------------------*/
+/* xio_flight_sample							     */
+/*---------------------------------------------------------------------------*/
+static void xio_flight_sample(int actual_timeout_ms, void *data)
+{
+	struct xio_context	*ctx = (struct xio_context *)data;
+	struct xio_connection	*connection;
+
+	spin_lock(&ctx->ctx_list_lock);
+	list_for_each_entry(connection, &ctx->ctx_list, ctx_list_entry) {
+		if (connection->state != XIO_CONNECTION_STATE_ONLINE)
+			continue;
+		xio_flight_rec(ctx, XIO_FLIGHT_QUEUES, connection,
+			       connection->state,
+			       connection->tx_queued_msgs,
+			       connection->credits_msgs,
+			       connection->peer_credits_msgs);
+	}
+	spin_unlock(&ctx->ctx_list_lock);
+
+	xio_ctx_add_delayed_work(ctx, XIO_FLIGHT_SAMPLE_MS, ctx,
+				 xio_flight_sample, &ctx->flight_work);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_flight_create							     */
+/*---------------------------------------------------------------------------*/
+int xio_flight_create(struct xio_context *ctx)
+{
+	ctx->flight = (struct xio_flight *)xio_context_kcalloc(
+			ctx, 1, sizeof(*ctx->flight), GFP_KERNEL);
+	if (!ctx->flight) {
+		/* the context runs without a recorder */
+		ERROR_LOG("xio_context_kcalloc failed. %m\n");
+		return -1;
+	}
+
+	return xio_ctx_add_delayed_work(ctx, XIO_FLIGHT_SAMPLE_MS, ctx,
+					xio_flight_sample, &ctx->flight_work);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_flight_destroy							     */
+/*---------------------------------------------------------------------------*/
+void xio_flight_destroy(struct xio_context *ctx)
+{
+	if (!ctx->flight)
+		return;
+
+	xio_ctx_del_delayed_work(ctx, &ctx->flight_work);
+	xio_context_kfree(ctx, ctx->flight);
+	ctx->flight = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_flight_rec							     */
+/*---------------------------------------------------------------------------*/
+void xio_flight_rec(struct xio_context *ctx, enum xio_flight_event event,
+		    const void *obj, uint32_t state,
+		    uint32_t a, uint32_t b, uint32_t c)
+{
+	struct xio_flight	*flight = ctx->flight;
+	struct xio_flight_rec	*rec;
+
+	if (unlikely(!flight))
+		return;
+
+	rec = &flight->recs[flight->head & (XIO_FLIGHT_RECORDS - 1)];
+	rec->cycles	= get_cycles();
+	rec->obj	= (uint64_t)(uintptr_t)obj;
+	rec->event	= (uint16_t)event;
+	rec->state	= (uint16_t)state;
+	rec->a		= a;
+	rec->b		= b;
+	rec->c		= c;
+
+	/* the record is complete before it is counted */
+	xio_smp_wmb();
+	flight->head++;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_flight_error							     */
+/*---------------------------------------------------------------------------*/
+void xio_flight_error(struct xio_context *ctx)
+{
+	if (ctx->flight && ctx->flight->on_error)
+		ctx->flight->on_error(ctx);
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef XIO_FLIGHT_H
+#define XIO_FLIGHT_H
+
+/*
+ * flight recorder - a ring of the most recent connection and transport
+ * events of a context.  the context's thread is the only writer, so a
+ * record is filled in place and published by advancing head.  readers
+ * (a dump on demand, on signal or on a fatal connection error) copy the
+ * last XIO_FLIGHT_RECORDS records, oldest first, after a
+ * struct xio_flight_dump header.  the decoder is xio_flight
+ */
+#define XIO_FLIGHT_RECORDS		1024	/* power of two */
+#define XIO_FLIGHT_SAMPLE_MS		1000
+#define XIO_FLIGHT_MAGIC		0x58494652	/* "XIFR" */
+#define XIO_FLIGHT_VERSION		1
+#define XIO_FLIGHT_DUMP_DIR		"/tmp"	/* $XDG_RUNTIME_DIR first */
+#define XIO_FLIGHT_DUMP_PREFIX		"xio_flight."
+
+enum xio_flight_event {
+	/* obj: connection, a: enum xio_session_event, b: reason */
+	XIO_FLIGHT_SESSION_EVENT,
+	/* obj: nexus, a: enum xio_transport_event, b: reason */
+	XIO_FLIGHT_TRANSPORT_EVENT,
+	/* obj: connection, a: enum xio_status, b: direction, c: msg sn */
+	XIO_FLIGHT_MSG_ERROR,
+	/* obj: connection, a: probes sent, b: probes allowed */
+	XIO_FLIGHT_KA_TIMEOUT,
+	/* obj: connection, a: queued msgs, b: credits, c: peer credits */
+	XIO_FLIGHT_QUEUES,
+	XIO_FLIGHT_EVENT_LAST
+};
+
+/*---------------------------------------------------------------------------*/
+/* structs								     */
+/*---------------------------------------------------------------------------*/
+struct xio_flight_rec {
+	uint64_t	cycles;
+	uint64_t	obj;
+	uint16_t	event;		/* enum xio_flight_event	*/
+	uint16_t	state;		/* of obj - connection or nexus	*/
+	uint32_t	a;
+	uint32_t	b;
+	uint32_t	c;
+};
+
+struct xio_context;
+
+struct xio_flight {
+	uint64_t		head;		/* records ever written */
+	/* dumps the context when the recorder sees a fatal error */
+	void			(*on_error)(struct xio_context *ctx);
+	uint32_t		id;		/* names the dump file */
+	uint32_t		slot;		/* of the signal's dump */
+	struct xio_flight_rec	recs[XIO_FLIGHT_RECORDS];
+};
+
+/* file header - nrecs records follow, oldest first */
+struct xio_flight_dump {
+	uint32_t	magic;
+	uint16_t	version;
+	uint16_t	rec_size;
+	uint32_t	nrecs;
+	int32_t		pid;
+	uint32_t	ctx_id;
+	int32_t		cpuid;
+	uint64_t	hertz;		/* of the records' cycles	*/
+	uint64_t	head;		/* records ever written		*/
+	uint64_t	cycles;		/* at the dump			*/
+	uint64_t	time_ns;	/* wall clock at the dump	*/
+};
+
+/*---------------------------------------------------------------------------*/
+/* xio_flight_create							     */
+/*---------------------------------------------------------------------------*/
+int xio_flight_create(struct xio_context *ctx);
+
+/*---------------------------------------------------------------------------*/
+/* xio_flight_destroy							     */
+/*---------------------------------------------------------------------------*/
+void xio_flight_destroy(struct xio_context *ctx);
+
+/*---------------------------------------------------------------------------*/
+/* xio_flight_rec							     */
+/*---------------------------------------------------------------------------*/
+void xio_flight_rec(struct xio_context *ctx, enum xio_flight_event event,
+		    const void *obj, uint32_t state,
+		    uint32_t a, uint32_t b, uint32_t c);
+
+/*---------------------------------------------------------------------------*/
+/* xio_flight_error							     */
+/*---------------------------------------------------------------------------*/
+void xio_flight_error(struct xio_context *ctx);
+
+#endif /* XIO_FLIGHT_H */
@@ -48,6 +48,7 @@
 #include "xio_workqueue.h"
 #include "xio_protocol.h"
 #include "xio_mbuf.h"
+#include "xio_sg_table.h"
 #include "xio_task.h"
 #include "xio_transport.h"
 #include "xio_context.h"
@@ -56,6 +57,8 @@
 #include "xio_session.h"
 #include "xio_nexus.h"
 #include "xio_msg_list.h"
+#include "xio_stats.h"
+#include "xio_flight.h"
 #include "xio_connection.h"
 #include <xio_env_adv.h>
 
@@ -99,8 +102,9 @@ static void xio_nexus_on_transport_closed(struct xio_nexus *nexus,
 					  *event_data);
 static int xio_nexus_flush_all_tasks(struct xio_nexus *nexus);
 static int xio_nexus_destroy(struct xio_nexus *nexus);
-static int xio_nexus_xmit(struct xio_nexus *nexus);
+static int xio_nexus_xmit(struct xio_nexus *nexus, int new_round);
 static void xio_nexus_trans_release_handler(void *nexus_);
+static void xio_nexus_tx_handler(void *nexus_);
 static void xio_nexus_trans_error_handler(void *ev_params_);
 static void xio_nexus_disconnect_handler(void *nexus_);
 
@@ -1248,6 +1252,26 @@ static int xio_on_server_event(void *observer, void *sender, int event,
 	return 0;
 }
 
+static const struct xio_stat_template xio_nexus_stats[] = {
+	{ "TX_TASKS",		XIO_STAT_TYPE_COUNTER,		0 },
+	{ "RX_TASKS",		XIO_STAT_TYPE_COUNTER,		0 },
+};
+
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_stats_create						     */
+/*---------------------------------------------------------------------------*/
+static int xio_nexus_stats_create(struct xio_nexus *nexus)
+{
+	nexus->stats = xio_stat_set_get(nexus->ctx, XIO_STAT_SCOPE_NEXUS,
+					nexus);
+	if (!nexus->stats)
+		return -1;
+
+	return xio_stat_register_all(nexus->ctx, nexus->stats,
+				     xio_nexus_stats,
+				     ARRAY_SIZE(xio_nexus_stats));
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_nexus_create							     */
 /*---------------------------------------------------------------------------*/
@@ -1269,6 +1293,8 @@ struct xio_nexus *xio_nexus_create(struct xio_nexus *parent_nexus,
 		ERROR_LOG("xio_context_kcalloc failed. %m\n");
 		return NULL;
 	}
+	xio_ctx_mem_add(transport_hndl->ctx, XIO_MEM_CLASS_NEXUS,
+			sizeof(*nexus), 1);
 
 	XIO_OBSERVER_INIT(&nexus->trans_observer, nexus,
 			  xio_nexus_on_transport_event);
@@ -1288,6 +1314,8 @@ struct xio_nexus *xio_nexus_create(struct xio_nexus *parent_nexus,
 			  xio_on_context_event);
 
 	INIT_LIST_HEAD(&nexus->tx_queue);
+	INIT_LIST_HEAD(&nexus->tx_txqs);
+	nexus->tx_round = 1;
 
 	xio_context_reg_observer(transport_hndl->ctx, &nexus->ctx_observer);
 
@@ -1302,6 +1330,9 @@ struct xio_nexus *xio_nexus_create(struct xio_nexus *parent_nexus,
 	nexus->ctx			= transport_hndl->ctx;
 	mutex_init(&nexus->lock_connect);
 
+	if (xio_nexus_stats_create(nexus))
+		goto cleanup;
+
 	xio_nexus_cache_add(nexus, &nexus->cid);
 
 	/* add  the new nexus as observer to server */
@@ -1345,6 +1376,9 @@ struct xio_nexus *xio_nexus_create(struct xio_nexus *parent_nexus,
 	nexus->trans_error_event.handler	= xio_nexus_trans_error_handler;
 	nexus->trans_error_event.data		= NULL;
 
+	nexus->tx_event.handler			= xio_nexus_tx_handler;
+	nexus->tx_event.data			= nexus;
+
 	DEBUG_LOG("nexus: [new] ptr:%p, transport_hndl:%p\n", nexus,
 		  nexus->transport_hndl);
 
@@ -1490,6 +1524,16 @@ static void xio_nexus_trans_release_handler(void *nexus_)
 	xio_nexus_release(nexus);
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_tx_handler							     */
+/*---------------------------------------------------------------------------*/
+static void xio_nexus_tx_handler(void *nexus_)
+{
+	struct xio_nexus *nexus = (struct xio_nexus *)nexus_;
+
+	xio_nexus_xmit(nexus, 1);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_nexus_disconnect_handler						     */
 /*---------------------------------------------------------------------------*/
@@ -1590,6 +1634,7 @@ static int xio_nexus_on_new_message(struct xio_nexus *nexus,
 	struct xio_task	*task = event_data->msg.task;
 
 	task->nexus = nexus;
+	xio_stat_set_inc(nexus->stats, XIO_NEXUS_STAT_RX_TASKS);
 	switch (task->tlv_type) {
 	case XIO_NEXUS_SETUP_RSP:
 		retval = xio_nexus_on_recv_setup_rsp(nexus, task);
@@ -1695,6 +1740,35 @@ static int xio_nexus_on_assign_in_buf(struct xio_nexus *nexus,
 	return retval;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_flight_event						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_nexus_flight_event(
+		struct xio_nexus *nexus, int event,
+		union xio_transport_event_data *ev_data)
+{
+	uint32_t reason = 0;
+
+	switch (event) {
+	case XIO_TRANSPORT_EVENT_NEW_MESSAGE:
+	case XIO_TRANSPORT_EVENT_SEND_COMPLETION:
+	case XIO_TRANSPORT_EVENT_DIRECT_RDMA_COMPLETION:
+	case XIO_TRANSPORT_EVENT_ASSIGN_IN_BUF:
+		/* data path */
+		return;
+	case XIO_TRANSPORT_EVENT_MESSAGE_ERROR:
+		reason = ev_data->msg_error.reason;
+		break;
+	case XIO_TRANSPORT_EVENT_ERROR:
+		reason = ev_data->error.reason;
+		break;
+	default:
+		break;
+	}
+	xio_flight_rec(nexus->ctx, XIO_FLIGHT_TRANSPORT_EVENT, nexus,
+		       nexus->state, event, reason, 0);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_nexus_on_transport_event		                                     */
 /*---------------------------------------------------------------------------*/
@@ -1707,6 +1781,8 @@ static int xio_nexus_on_transport_event(void *observer, void *sender,
 	union xio_transport_event_data *ev_data =
 			(union xio_transport_event_data *)event_data;
 
+	xio_nexus_flight_event(nexus, event, ev_data);
+
 	switch (event) {
 	case XIO_TRANSPORT_EVENT_NEW_MESSAGE:
 /*
@@ -1802,8 +1878,9 @@ static int xio_nexus_on_transport_event(void *observer, void *sender,
 		break;
 	};
 
-	if (tx && !list_empty(&nexus->tx_queue))
-		xio_nexus_xmit(nexus);
+	if (tx && (!list_empty(&nexus->tx_queue) ||
+		   !list_empty(&nexus->tx_txqs)))
+		xio_nexus_xmit(nexus, 0);
 
 	return 0;
 }
@@ -1818,6 +1895,7 @@ static int xio_nexus_destroy(struct xio_nexus *nexus)
 	xio_context_disable_event(&nexus->trans_release_event);
 	xio_context_disable_event(&nexus->trans_error_event);
 	xio_context_disable_event(&nexus->disconnect_event);
+	xio_context_disable_event(&nexus->tx_event);
 
 	xio_context_kfree(nexus->ctx, nexus->trans_error_event.data);
 	nexus->trans_error_event.data = NULL;
@@ -1858,6 +1936,9 @@ static int xio_nexus_destroy(struct xio_nexus *nexus)
 	XIO_OBSERVER_DESTROY(&nexus->srv_observer);
 	mutex_destroy(&nexus->lock_connect);
 
+	xio_stat_set_put(nexus->ctx, nexus->stats);
+
+	xio_ctx_mem_sub(nexus->ctx, XIO_MEM_CLASS_NEXUS, sizeof(*nexus), 1);
 	xio_context_kfree(nexus->ctx, nexus);
 
 	return 0;
@@ -1941,10 +2022,13 @@ struct xio_nexus *xio_nexus_open(struct xio_context *ctx,
 		ERROR_LOG("xio_context_kcalloc failed. %m\n");
 		return NULL;
 	}
+	xio_ctx_mem_add(ctx, XIO_MEM_CLASS_NEXUS, sizeof(*nexus), 1);
 	XIO_OBSERVER_INIT(&nexus->trans_observer, nexus,
 			  xio_nexus_on_transport_event);
 	XIO_OBSERVABLE_INIT(&nexus->observable, nexus);
 	INIT_LIST_HEAD(&nexus->tx_queue);
+	INIT_LIST_HEAD(&nexus->tx_txqs);
+	nexus->tx_round = 1;
 	mutex_init(&nexus->lock_connect);
 
 	xio_nexus_init_observers_htbl(nexus);
@@ -1976,6 +2060,9 @@ struct xio_nexus *xio_nexus_open(struct xio_context *ctx,
 	}
 
 	nexus->ctx = ctx;
+	if (xio_nexus_stats_create(nexus))
+		goto cleanup;
+
 	nexus->transport_hndl = transport->open(
 					transport, ctx,
 					&nexus->trans_observer,
@@ -2021,6 +2108,9 @@ struct xio_nexus *xio_nexus_open(struct xio_context *ctx,
 	nexus->trans_error_event.handler	= xio_nexus_trans_error_handler;
 	nexus->trans_error_event.data		= NULL;
 
+	nexus->tx_event.handler			= xio_nexus_tx_handler;
+	nexus->tx_event.data			= nexus;
+
 	xio_nexus_cache_add(nexus, &nexus->cid);
 
 	DEBUG_LOG("nexus: [new] nexus:%p, transport_hndl:%p\n", nexus,
@@ -2362,31 +2452,112 @@ void xio_nexus_force_close(struct xio_nexus *nexus)
 /*---------------------------------------------------------------------------*/
 static int xio_nexus_flush_all_tasks(struct xio_nexus *nexus)
 {
+	struct xio_nexus_txq *txq;
+
 	if (!list_empty(&nexus->tx_queue)) {
 		DEBUG_LOG("tx_queue not empty! nexus:%p\n", nexus);
 		xio_tasks_list_flush(&nexus->tx_queue);
 	}
+	while (!list_empty(&nexus->tx_txqs)) {
+		txq = list_first_entry(&nexus->tx_txqs,
+				       struct xio_nexus_txq, txq_list_entry);
+		DEBUG_LOG("txq not empty! nexus:%p\n", nexus);
+		xio_nexus_txq_flush(txq);
+	}
 
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_txq_flush							     */
+/*---------------------------------------------------------------------------*/
+void xio_nexus_txq_flush(struct xio_nexus_txq *txq)
+{
+	list_del_init(&txq->txq_list_entry);
+	txq->deficit = 0;
+	if (!list_empty(&txq->tx_queue))
+		xio_tasks_list_flush(&txq->tx_queue);
+}
+
 static struct xio_task *find_first_response_task(struct xio_nexus *nexus)
 {
 	struct xio_task *task;
+	struct xio_nexus_txq *txq;
+
 	list_for_each_entry(task,&nexus->tx_queue, tasks_list_entry) {
 		if (IS_RESPONSE(task->tlv_type))
 			return task;
 	}
+	list_for_each_entry(txq, &nexus->tx_txqs, txq_list_entry) {
+		list_for_each_entry(task, &txq->tx_queue, tasks_list_entry) {
+			if (IS_RESPONSE(task->tlv_type))
+				return task;
+		}
+	}
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_next_task							     */
+/*---------------------------------------------------------------------------*/
+/* picks the next task for the transport. nexus messages go first, then any
+ * backlogged txq whose deficit covers its head task. a new round drops the
+ * idle txqs and adds a quantum to the others
+ */
+static struct xio_task *xio_nexus_next_task(struct xio_nexus *nexus,
+					    struct xio_nexus_txq **ptxq,
+					    int new_round)
+{
+	struct xio_nexus_txq *txq, *tmp_txq;
+	struct xio_task *task;
+
+	*ptxq = NULL;
+	if (!list_empty(&nexus->tx_queue))
+		return list_first_entry(&nexus->tx_queue,
+					struct xio_task, tasks_list_entry);
+retry:
+	list_for_each_entry(txq, &nexus->tx_txqs, txq_list_entry) {
+		if (list_empty(&txq->tx_queue))
+			continue;
+		task = list_first_entry(&txq->tx_queue,
+					struct xio_task, tasks_list_entry);
+		if (txq->deficit >= task->tx_cost) {
+			txq->deficit -= task->tx_cost;
+			*ptxq = txq;
+			return task;
+		}
+	}
+	if (!new_round)
+		return NULL;
+
+	nexus->tx_round++;
+	list_for_each_entry_safe(txq, tmp_txq, &nexus->tx_txqs,
+				 txq_list_entry) {
+		if (list_empty(&txq->tx_queue)) {
+			list_del_init(&txq->txq_list_entry);
+		} else {
+			txq->deficit += txq->quantum;
+			txq->round = nexus->tx_round;
+		}
+	}
+	if (!list_empty(&nexus->tx_txqs))
+		goto retry;
+
 	return NULL;
 }
 
 /*---------------------------------------------------------------------------*/
 /* xio_nexus_xmit							     */
 /*---------------------------------------------------------------------------*/
-static int xio_nexus_xmit(struct xio_nexus *nexus)
+/* sends what the txqs' deficits cover. the rest waits for the tx event that
+ * starts new rounds, so a burst of one txq cannot get ahead of the tasks
+ * other txqs queue meanwhile by more than its quantum
+ */
+static int xio_nexus_xmit(struct xio_nexus *nexus, int new_round)
 {
 	int		retval = 0;
 	struct xio_task *task;
+	struct xio_nexus_txq *txq;
 
 	if (!nexus->transport) {
 		ERROR_LOG("transport not initialized. nexus:%p\n", nexus);
@@ -2399,16 +2570,22 @@ static int xio_nexus_xmit(struct xio_nexus *nexus)
 		return 0;
 
 	while (1) {
-		if (list_empty(&nexus->tx_queue))
+		task = xio_nexus_next_task(nexus, &txq, new_round);
+		if (!task) {
+			if (!new_round && !list_empty(&nexus->tx_txqs))
+				xio_context_add_event(nexus->ctx,
+						      &nexus->tx_event);
 			break;
+		}
 
-		task = list_first_entry(&nexus->tx_queue,
-					struct xio_task,  tasks_list_entry);
 		retval = nexus->transport->send(nexus->transport_hndl, task);
 		if (retval != 0) {
 			union xio_nexus_event_data nexus_event_data;
 
 			if (xio_errno() == EAGAIN) {
+				/* not sent, keep the charge for next time */
+				if (txq)
+					txq->deficit += task->tx_cost;
 				if (IS_REQUEST(task->tlv_type)) {
 					task = find_first_response_task(nexus);
 					if (!task)
@@ -2441,15 +2618,40 @@ static int xio_nexus_xmit(struct xio_nexus *nexus)
 					&nexus_event_data);
 			break;
 		}
+		/* a drained txq leaves the list, what is left of its
+		 * deficit lasts until the round ends
+		 */
+		if (txq && list_empty(&txq->tx_queue))
+			list_del_init(&txq->txq_list_entry);
 	}
 
 	return retval;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_task_cost							     */
+/*---------------------------------------------------------------------------*/
+static inline uint32_t xio_nexus_task_cost(struct xio_task *task)
+{
+	struct xio_msg		*msg = task->omsg;
+	struct xio_sg_table_ops	*sgtbl_ops;
+
+	/* connection control messages are not charged */
+	if (!msg || !IS_APPLICATION_MSG(task->tlv_type))
+		return 0;
+
+	sgtbl_ops = (struct xio_sg_table_ops *)
+			xio_sg_table_ops_get(msg->out.sgl_type);
+
+	return (uint32_t)(msg->out.header.iov_len +
+			  tbl_length(sgtbl_ops, xio_sg_table_get(&msg->out)));
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_nexus_send							     */
 /*---------------------------------------------------------------------------*/
-int xio_nexus_send(struct xio_nexus *nexus, struct xio_task *task)
+int xio_nexus_send(struct xio_nexus *nexus, struct xio_nexus_txq *txq,
+		   struct xio_task *task)
 {
 	int		retval;
 
@@ -2461,13 +2663,27 @@ int xio_nexus_send(struct xio_nexus *nexus, struct xio_task *task)
 		return 0;
 
 	/* push to end of the queue - prioritize ka */
-	if (IS_KEEPALIVE(task->tlv_type))
+	if (IS_KEEPALIVE(task->tlv_type)) {
 		list_move(&task->tasks_list_entry, &nexus->tx_queue);
-	else
+	} else if (!txq) {
 		list_move_tail(&task->tasks_list_entry, &nexus->tx_queue);
+	} else {
+		task->tx_cost = xio_nexus_task_cost(task);
+		list_move_tail(&task->tasks_list_entry, &txq->tx_queue);
+		if (list_empty(&txq->txq_list_entry)) {
+			/* a fresh quantum once per round */
+			if (txq->round != nexus->tx_round) {
+				txq->deficit = txq->quantum;
+				txq->round = nexus->tx_round;
+			}
+			list_add_tail(&txq->txq_list_entry, &nexus->tx_txqs);
+		}
+	}
+
+	xio_stat_set_inc(nexus->stats, XIO_NEXUS_STAT_TX_TASKS);
 
 	/* xmit it to the transport */
-	retval = xio_nexus_xmit(nexus);
+	retval = xio_nexus_xmit(nexus, 0);
 
 	return retval;
 }
@@ -2837,12 +3053,18 @@ void xio_nexus_set_server(struct xio_nexus *nexus, struct xio_server *server)
 /*---------------------------------------------------------------------------*/
 void xio_nexus_dump_tasks_queues(struct xio_nexus *nexus)
 {
+	struct xio_nexus_txq *txq;
 
 	if (!list_empty(&nexus->tx_queue)) {
 		xio_dump_task_list("nexus", nexus,
 				   &nexus->tx_queue,
 				   "tx_queue");
 	}
+	list_for_each_entry(txq, &nexus->tx_txqs, txq_list_entry) {
+		xio_dump_task_list("nexus", nexus,
+				   &txq->tx_queue,
+				   "txq");
+	}
 	if (nexus->transport->dump_tasks_queues) {
 		nexus->transport->dump_tasks_queues(nexus->transport_hndl);
 	}
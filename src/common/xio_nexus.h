@@ -47,6 +47,14 @@ extern "C" {
 /*---------------------------------------------------------------------------*/
 struct xio_nexus;
 
+/*---------------------------------------------------------------------------*/
+/* defines								     */
+/*---------------------------------------------------------------------------*/
+#define XIO_NEXUS_TXQ_QUANTUM		16384 /* bytes a weight 1 queue may
+					       * send per round
+					       */
+#define XIO_NEXUS_TXQ_MAX_WEIGHT	65535
+
 /*---------------------------------------------------------------------------*/
 /* enum									     */
 /*---------------------------------------------------------------------------*/
@@ -123,6 +131,17 @@ struct xio_nexus_attr {
 	uint8_t			pad[3];
 };
 
+/* transmit queue of one nexus user. the txqs of a nexus are served deficit
+ * round robin, tasks wait here until their queue's turn
+ */
+struct xio_nexus_txq {
+	struct list_head		tx_queue;
+	struct list_head		txq_list_entry;
+	int64_t				deficit;
+	uint32_t			quantum;
+	uint32_t			round;	/* of the last quantum */
+};
+
 struct xio_nexus_init_attr {
 	uint8_t			tos;	 /**< type of service RFC 2474 */
 	uint8_t			pad[3];
@@ -131,6 +150,12 @@ struct xio_nexus_init_attr {
 /**
  * Connection data type
  */
+/* handles in nexus->stats */
+enum xio_nexus_stat {
+	XIO_NEXUS_STAT_TX_TASKS,
+	XIO_NEXUS_STAT_RX_TASKS
+};
+
 struct xio_nexus {
 	struct xio_transport		*transport;
 	struct xio_transport_base	*transport_hndl;
@@ -154,6 +179,9 @@ struct xio_nexus {
 
 	struct list_head		observers_htbl;
 	struct list_head		tx_queue;
+	struct list_head		tx_txqs;	/* backlogged txqs */
+	uint32_t			tx_round;
+	uint32_t			tx_pad;
 	struct xio_server		*server;
 
 	/* Client side for reconnect */
@@ -167,12 +195,14 @@ struct xio_nexus {
 	struct xio_ev_data		disconnect_event;
 	struct xio_ev_data		trans_release_event;
 	struct xio_ev_data		trans_error_event;
+	struct xio_ev_data		tx_event;	/* starts tx rounds */
 	spinlock_t			nexus_obs_lock;
 	int				released:1;
 	int 				defered_close:1;
 	int 				pad2:30;
 	struct mutex			lock_connect;      /* lock nexus connect */
 	struct xio_context		*ctx;
+	struct xio_stat_set		*stats;
 
 	HT_ENTRY(xio_nexus, xio_key_int32) nexus_htbl;
 };
@@ -228,7 +258,26 @@ int xio_nexus_poll(struct xio_nexus *nexus,
 /*---------------------------------------------------------------------------*/
 /* xio_nexus_send							     */
 /*---------------------------------------------------------------------------*/
-int xio_nexus_send(struct xio_nexus *nexus, struct xio_task *task);
+int xio_nexus_send(struct xio_nexus *nexus, struct xio_nexus_txq *txq,
+		   struct xio_task *task);
+
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_txq_init							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_nexus_txq_init(struct xio_nexus_txq *txq,
+				      uint32_t weight)
+{
+	INIT_LIST_HEAD(&txq->tx_queue);
+	INIT_LIST_HEAD(&txq->txq_list_entry);
+	txq->deficit = 0;
+	txq->quantum = weight * XIO_NEXUS_TXQ_QUANTUM;
+	txq->round = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_nexus_txq_flush							     */
+/*---------------------------------------------------------------------------*/
+void xio_nexus_txq_flush(struct xio_nexus_txq *txq);
 
 /*---------------------------------------------------------------------------*/
 /* xio_nexus_cancel_req							     */
@@ -52,6 +52,8 @@
 /*---------------------------------------------------------------------------*/
 struct xio_mem_chunk {
 	struct list_head	chunk_entry;
+	size_t			alloc_sz;
+	uint64_t		nr;
 };
 
 struct xio_mem_obj {
@@ -80,8 +82,6 @@ static int xio_objpool_realloc(struct xio_objpool *p, int size, int n)
 	size_t			alloc_sz;
 	char			*buf;
 
-	p->total_nr += n;
-
 	alloc_sz =  sizeof(*chunk) +
 			n*(sizeof(*obj) + sizeof(obj)  + size);
 
@@ -89,7 +89,12 @@ static int xio_objpool_realloc(struct xio_objpool *p, int size, int n)
 	if (!buf)
 		goto err;
 
+	p->total_nr += n;
+
 	chunk = (struct xio_mem_chunk *)buf;
+	chunk->alloc_sz = alloc_sz;
+	chunk->nr = n;
+	xio_ctx_mem_add(p->ctx, XIO_MEM_CLASS_OBJPOOL, alloc_sz, n);
 
 	list_add(&chunk->chunk_entry, &p->chunks_list);
 
@@ -112,7 +117,7 @@ err:
 }
 
 /*---------------------------------------------------------------------------*/
-/* xio_objpool_realloc							     */
+/* xio_objpool_create							     */
 /*---------------------------------------------------------------------------*/
 struct xio_objpool *xio_objpool_create(struct xio_context *ctx,
 				       int size, int init_nr, int grow_nr)
@@ -134,8 +139,10 @@ struct xio_objpool *xio_objpool_create(struct xio_context *ctx,
 	INIT_LIST_HEAD(&p->chunks_list);
 
 	retval = xio_objpool_realloc(p, size, init_nr);
-	if (retval == -1)
+	if (retval == -1) {
+		xio_context_kfree(ctx, p);
 		return NULL;
+	}
 
 	return p;
 }
@@ -151,6 +158,8 @@ void xio_objpool_destroy(struct xio_objpool *p)
 	list_for_each_entry_safe(chunk, tmp_chunk,
 				 &p->chunks_list, chunk_entry) {
 		list_del(&chunk->chunk_entry);
+		xio_ctx_mem_sub(p->ctx, XIO_MEM_CLASS_OBJPOOL,
+				chunk->alloc_sz, chunk->nr);
 		xio_context_vfree(p->ctx, chunk);
 	}
 	xio_context_kfree(p->ctx, p);
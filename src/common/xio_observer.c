@@ -39,6 +39,7 @@
 #include <xio_os.h>
 #include "xio_log.h"
 #include "xio_common.h"
+#include "xio_hash.h"
 #include "xio_observer.h"
 #include <xio_env_adv.h>
 #include "xio_ev_data.h"
@@ -47,6 +48,8 @@
 #include "xio_workqueue.h"
 #include "xio_context.h"
 
+/* below this many observers a list walk beats hashing */
+#define XIO_OBSERVABLE_HASH_MIN		16
 
 /*---------------------------------------------------------------------------*/
 /* xio_observer_create							     */
@@ -95,9 +98,7 @@ struct xio_observable *xio_observable_create(void *impl)
 		return NULL;
 	}
 
-	INIT_LIST_HEAD(&observable->observers_list);
-
-	observable->impl = impl;
+	XIO_OBSERVABLE_INIT(observable, impl);
 
 	return observable;
 }
@@ -108,6 +109,8 @@ struct xio_observable *xio_observable_create(void *impl)
 void xio_observable_destroy(struct xio_observable *observable)
 {
 	INIT_LIST_HEAD(&observable->observers_list);
+	if (observable->hash)
+		xio_context_kfree(NULL, observable->hash);
 
 	observable->impl = NULL;
 
@@ -115,13 +118,122 @@ void xio_observable_destroy(struct xio_observable *observable)
 }
 
 /*---------------------------------------------------------------------------*/
-/* xio_observable_unreg_all_observers					     */
+/* xio_observable_hash_bucket						     */
+/*---------------------------------------------------------------------------*/
+static inline struct xio_observer_node **xio_observable_hash_bucket(
+				struct xio_observable *observable,
+				struct xio_observer *observer)
+{
+	return &observable->hash[int64_hash((uint64_t)(uintptr_t)observer) &
+				 observable->hash_mask];
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_observable_hash_lookup						     */
+/*---------------------------------------------------------------------------*/
+static struct xio_observer_node *xio_observable_hash_lookup(
+				struct xio_observable *observable,
+				struct xio_observer *observer)
+{
+	struct xio_observer_node *observer_node;
+
+	observer_node = *xio_observable_hash_bucket(observable, observer);
+	while (observer_node && observer_node->observer != observer)
+		observer_node = observer_node->hash_next;
+
+	return observer_node;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_observable_hash_remove						     */
+/*---------------------------------------------------------------------------*/
+static void xio_observable_hash_remove(struct xio_observable *observable,
+				       struct xio_observer_node *observer_node)
+{
+	struct xio_observer_node **pnode;
+
+	pnode = xio_observable_hash_bucket(observable,
+					   observer_node->observer);
+	while (*pnode && *pnode != observer_node)
+		pnode = &(*pnode)->hash_next;
+	if (*pnode)
+		*pnode = observer_node->hash_next;
+	observer_node->hash_next = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_observable_hash_grow						     */
+/*---------------------------------------------------------------------------*/
+/* keeps the chains at about one node. a failure keeps the current table,
+ * or the list walks when there is none
+ */
+static void xio_observable_hash_grow(struct xio_observable *observable)
+{
+	struct xio_observer_node **hash, **bucket, *observer_node;
+	uint32_t size = XIO_OBSERVABLE_HASH_MIN * 2;
+
+	while (size < observable->observers_nr * 2)
+		size <<= 1;
+
+	hash = (struct xio_observer_node **)xio_context_kcalloc(NULL,
+				size, sizeof(*hash), GFP_KERNEL);
+	if (!hash)
+		return;
+
+	xio_context_kfree(NULL, observable->hash);
+	observable->hash = hash;
+	observable->hash_mask = size - 1;
+
+	list_for_each_entry(observer_node, &observable->observers_list,
+			    observers_list_node) {
+		bucket = xio_observable_hash_bucket(observable,
+						    observer_node->observer);
+		observer_node->hash_next = *bucket;
+		*bucket = observer_node;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_observable_hash_free						     */
+/*---------------------------------------------------------------------------*/
+static void xio_observable_hash_free(struct xio_observable *observable)
+{
+	if (!observable->hash)
+		return;
+
+	xio_context_kfree(NULL, observable->hash);
+	observable->hash = NULL;
+	observable->hash_mask = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_observable_lookup						     */
+/*---------------------------------------------------------------------------*/
+static struct xio_observer_node *xio_observable_lookup(
+				struct xio_observable *observable,
+				struct xio_observer *observer)
+{
+	struct xio_observer_node *observer_node;
+
+	if (observable->hash)
+		return xio_observable_hash_lookup(observable, observer);
+
+	list_for_each_entry(observer_node, &observable->observers_list,
+			    observers_list_node) {
+		if (observer_node->observer == observer)
+			return observer_node;
+	}
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_observable_find							     */
 /*---------------------------------------------------------------------------*/
 static struct xio_observer_node *xio_observable_find(
 				struct xio_observable *observable,
 				struct xio_observer *observer)
 {
-	struct xio_observer_node *observer_node, *tmp_observer_node;
+	struct xio_observer_node *observer_node;
 
 	if (observable->observer_node &&
 	    observable->observer_node->observer == observer) {
@@ -131,18 +243,14 @@ static struct xio_observer_node *xio_observable_find(
 		return observable->observer_node;
 	}
 
-	list_for_each_entry_safe(observer_node, tmp_observer_node,
-				 &observable->observers_list,
-				 observers_list_node) {
-		if (observer_node->observer == observer) {
-			ERROR_LOG("already exist: " \
-				  "observable:%p, observer:%p\n",
-				  observable, observer_node->observer);
-			observable->observer_node = observer_node;
-			return observer_node;
-		}
+	observer_node = xio_observable_lookup(observable, observer);
+	if (observer_node) {
+		ERROR_LOG("already exist: " \
+			  "observable:%p, observer:%p\n",
+			  observable, observer_node->observer);
+		observable->observer_node = observer_node;
 	}
-	return NULL;
+	return observer_node;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -174,6 +282,20 @@ void xio_observable_reg_observer(struct xio_observable *observable,
 
 	list_add(&observer_node->observers_list_node,
 		 &observable->observers_list);
+	observable->observers_nr++;
+
+	/* hashed right away, a failed grow then leaves a complete table */
+	if (observable->hash) {
+		struct xio_observer_node **bucket;
+
+		bucket = xio_observable_hash_bucket(observable, observer);
+		observer_node->hash_next = *bucket;
+		*bucket = observer_node;
+	}
+	if (observable->observers_nr >= XIO_OBSERVABLE_HASH_MIN &&
+	    (!observable->hash ||
+	     observable->observers_nr > observable->hash_mask + 1))
+		xio_observable_hash_grow(observable);
 }
 EXPORT_SYMBOL(xio_observable_reg_observer);
 
@@ -183,20 +305,22 @@ EXPORT_SYMBOL(xio_observable_reg_observer);
 void xio_observable_unreg_observer(struct xio_observable *observable,
 				   struct xio_observer *observer)
 {
-	struct xio_observer_node *observer_node, *tmp_observer_node;
+	struct xio_observer_node *observer_node;
 
-	list_for_each_entry_safe(observer_node, tmp_observer_node,
-				 &observable->observers_list,
-				observers_list_node) {
-		if (observer == observer_node->observer) {
-			if (observable->observer_node == observer_node)
-				observable->observer_node = NULL;
-
-			list_del(&observer_node->observers_list_node);
-			xio_context_kfree(NULL, observer_node);
-			break;
-		}
-	}
+	observer_node = xio_observable_lookup(observable, observer);
+	if (!observer_node)
+		return;
+
+	if (observable->observer_node == observer_node)
+		observable->observer_node = NULL;
+
+	if (observable->hash)
+		xio_observable_hash_remove(observable, observer_node);
+	list_del(&observer_node->observers_list_node);
+	xio_context_kfree(NULL, observer_node);
+
+	if (!--observable->observers_nr)
+		xio_observable_hash_free(observable);
 }
 EXPORT_SYMBOL(xio_observable_unreg_observer);
 
@@ -283,6 +407,8 @@ void xio_observable_unreg_all_observers(struct xio_observable *observable)
 		xio_context_kfree(NULL, observer_node);
 	}
 	observable->observer_node = NULL;
+	observable->observers_nr = 0;
+	xio_observable_hash_free(observable);
 }
 EXPORT_SYMBOL(xio_observable_unreg_all_observers);
 
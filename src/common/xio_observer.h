@@ -65,6 +65,7 @@ struct xio_observer {
 struct xio_observer_node {
 	struct xio_observer	*observer;
 	struct list_head	observers_list_node;
+	struct xio_observer_node *hash_next;
 };
 
 /*---------------------------------------------------------------------------*/
@@ -74,6 +75,10 @@ struct xio_observable {
 	void			*impl;
 	struct list_head	observers_list;
 	struct xio_observer_node *observer_node; /* for one observer */
+	/* observers by address, once there are XIO_OBSERVABLE_HASH_MIN */
+	struct xio_observer_node **hash;
+	uint32_t		hash_mask;
+	uint32_t		observers_nr;
 };
 
 struct xio_observer_event{
@@ -86,7 +91,8 @@ struct xio_observer_event{
 
 #define XIO_OBSERVABLE_INIT(name, obj) \
 	{ (name)->impl = obj; INIT_LIST_HEAD(&(name)->observers_list); \
-	  (name)->observer_node = NULL; }
+	  (name)->observer_node = NULL; (name)->hash = NULL; \
+	  (name)->hash_mask = 0; (name)->observers_nr = 0; }
 
 #define XIO_OBSERVABLE_DESTROY(name) \
 	{ (name)->impl = NULL; INIT_LIST_HEAD(&(name)->observers_list); \
@@ -61,7 +61,11 @@
 #define XIO_OPTVAL_DEF_KEEPALIVE_INTVL			20
 #define XIO_OPTVAL_DEF_KEEPALIVE_TIME			60
 #define XIO_OPTVAL_DEF_TRANSPORT_CLOSE_TIMEOUT		60000
-#define XIO_OPTVAL_DEF_PAD				0
+#define XIO_OPTVAL_DEF_ENABLE_STATS_SHM			0
+#define XIO_OPTVAL_DEF_MSG_SAMPLE_RATE			0
+#define XIO_OPTVAL_DEF_FLIGHT_DUMP_SIGNAL		0
+#define XIO_OPTVAL_DEF_FLIGHT_DUMP_ON_ERROR		0
+#define XIO_OPTVAL_DEF_ENABLE_PERF_COUNTERS		0
 
 /* xio options */
 struct xio_options			g_options = {
@@ -79,7 +83,11 @@ struct xio_options			g_options = {
 	XIO_OPTVAL_DEF_INLINE_XIO_DATA_ALIGN,	/* inline_xio_data_align */
 	XIO_OPTVAL_DEF_ENABLE_KEEPALIVE,
 	XIO_OPTVAL_DEF_TRANSPORT_CLOSE_TIMEOUT, /* transport_close_timeout */
-	XIO_OPTVAL_DEF_PAD,
+	XIO_OPTVAL_DEF_ENABLE_STATS_SHM,	/* enable_stats_shm */
+	XIO_OPTVAL_DEF_MSG_SAMPLE_RATE,		/* msg_sample_rate */
+	XIO_OPTVAL_DEF_FLIGHT_DUMP_SIGNAL,	/* flight_dump_signal */
+	XIO_OPTVAL_DEF_FLIGHT_DUMP_ON_ERROR,	/* flight_dump_on_error */
+	XIO_OPTVAL_DEF_ENABLE_PERF_COUNTERS,	/* enable_perf_counters */
 	{
 		XIO_OPTVAL_DEF_KEEPALIVE_PROBES,
 		XIO_OPTVAL_DEF_KEEPALIVE_TIME,
@@ -115,6 +123,10 @@ static int xio_general_set_opt(void *xio_obj, int optname,
 		if (optlen != sizeof(enum xio_log_level))
 			return -1;
 		return xio_set_log_level(*((enum xio_log_level *)optval));
+	case XIO_OPTNAME_LOG_ASYNC:
+		if (optlen != sizeof(int))
+			break;
+		return xio_set_log_async(*((int *)optval));
 	case XIO_OPTNAME_DISABLE_HUGETBL:
 		xio_disable_huge_pages(*((int *)optval));
 		return 0;
@@ -272,6 +284,31 @@ static int xio_general_set_opt(void *xio_obj, int optname,
 	case XIO_OPTNAME_ENABLE_KEEPALIVE:
 		g_options.enable_keepalive = *((int *)optval);
 		return 0;
+	case XIO_OPTNAME_ENABLE_STATS_SHM:
+		if (optlen != sizeof(int))
+			break;
+		g_options.enable_stats_shm = !!*((int *)optval);
+		return 0;
+	case XIO_OPTNAME_MSG_SAMPLE_RATE:
+		if (optlen != sizeof(int) || *((int *)optval) < 0)
+			break;
+		g_options.msg_sample_rate = *((int *)optval);
+		return 0;
+	case XIO_OPTNAME_FLIGHT_DUMP_SIGNAL:
+		if (optlen != sizeof(int) || *((int *)optval) < 0)
+			break;
+		g_options.flight_dump_signal = *((int *)optval);
+		return 0;
+	case XIO_OPTNAME_FLIGHT_DUMP_ON_ERROR:
+		if (optlen != sizeof(int))
+			break;
+		g_options.flight_dump_on_error = !!*((int *)optval);
+		return 0;
+	case XIO_OPTNAME_ENABLE_PERF_COUNTERS:
+		if (optlen != sizeof(int))
+			break;
+		g_options.enable_perf_counters = !!*((int *)optval);
+		return 0;
 	case XIO_OPTNAME_CONFIG_KEEPALIVE:
 		if (optlen == sizeof(struct xio_options_keepalive)) {
 			memcpy(&g_options.ka, optval, optlen);
@@ -307,6 +344,10 @@ static int xio_general_get_opt(void  *xio_obj, int optname,
 		*((enum xio_log_level *)optval) = xio_get_log_level();
 		*optlen = sizeof(enum xio_log_level);
 		return 0;
+	case XIO_OPTNAME_LOG_ASYNC:
+		*((int *)optval) = xio_get_log_async();
+		*optlen = sizeof(int);
+		return 0;
 	case XIO_OPTNAME_MAX_IN_IOVLEN:
 		*optlen = sizeof(int);
 		*((int *)optval) = g_options.max_in_iovsz;
@@ -359,6 +400,26 @@ static int xio_general_get_opt(void  *xio_obj, int optname,
 		*optlen = sizeof(int);
 		*((int *)optval) = g_options.enable_keepalive;
 		return 0;
+	case XIO_OPTNAME_ENABLE_STATS_SHM:
+		*optlen = sizeof(int);
+		*((int *)optval) = g_options.enable_stats_shm;
+		return 0;
+	case XIO_OPTNAME_MSG_SAMPLE_RATE:
+		*optlen = sizeof(int);
+		*((int *)optval) = g_options.msg_sample_rate;
+		return 0;
+	case XIO_OPTNAME_FLIGHT_DUMP_SIGNAL:
+		*optlen = sizeof(int);
+		*((int *)optval) = g_options.flight_dump_signal;
+		return 0;
+	case XIO_OPTNAME_FLIGHT_DUMP_ON_ERROR:
+		*optlen = sizeof(int);
+		*((int *)optval) = g_options.flight_dump_on_error;
+		return 0;
+	case XIO_OPTNAME_ENABLE_PERF_COUNTERS:
+		*optlen = sizeof(int);
+		*((int *)optval) = g_options.enable_perf_counters;
+		return 0;
 	case XIO_OPTNAME_CONFIG_KEEPALIVE:
 		if (*optlen == sizeof(struct xio_options_keepalive)) {
 			memcpy(optval, &g_options.ka, *optlen);
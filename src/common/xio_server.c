@@ -54,6 +54,7 @@
 #include "xio_context.h"
 #include "xio_session.h"
 #include "xio_nexus.h"
+#include "xio_stats.h"
 #include "xio_connection.h"
 #include "xio_server.h"
 #include <xio_env_adv.h>
@@ -54,6 +54,8 @@
 #include "xio_workqueue.h"
 #include "xio_context.h"
 #include "xio_nexus.h"
+#include "xio_stats.h"
+#include "xio_flight.h"
 #include "xio_connection.h"
 #include "xio_sessions_cache.h"
 #include "xio_session.h"
@@ -247,6 +249,7 @@ void xio_session_write_header(struct xio_task *task,
 	PACK_SVAL(hdr, tmp_hdr, sn);
 	PACK_SVAL(hdr, tmp_hdr, ack_sn);
 	PACK_SVAL(hdr, tmp_hdr, credits_msgs);
+	PACK_LVAL(hdr, tmp_hdr, timeout_us);
 	PACK_LVAL(hdr, tmp_hdr, receipt_result);
 	PACK_LLVAL(hdr, tmp_hdr, credits_bytes);
 #ifdef XIO_SESSION_DEBUG
@@ -276,6 +279,7 @@ void xio_session_read_header(struct xio_task *task,
 	UNPACK_SVAL(tmp_hdr, hdr, sn);
 	UNPACK_SVAL(tmp_hdr, hdr, ack_sn);
 	UNPACK_SVAL(tmp_hdr, hdr, credits_msgs);
+	UNPACK_LVAL(tmp_hdr, hdr, timeout_us);
 	UNPACK_LVAL(tmp_hdr, hdr, receipt_result);
 	UNPACK_LLVAL(tmp_hdr, hdr, credits_bytes);
 #ifdef XIO_SESSION_DEBUG
@@ -284,6 +288,21 @@ void xio_session_read_header(struct xio_task *task,
 #endif
 
 	xio_mbuf_inc(&task->mbuf, sizeof(struct xio_session_hdr));
+
+	task->sampled = !!(hdr->flags & XIO_MSG_FLAG_EX_SAMPLED);
+	if (unlikely(task->sampled))
+		task->stamps[XIO_TASK_STAMP_RECV] = get_cycles();
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_session_flight_event						     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_session_flight_event(
+		struct xio_connection *connection,
+		struct xio_session_event_data *event)
+{
+	xio_flight_rec(connection->ctx, XIO_FLIGHT_SESSION_EVENT, connection,
+		       connection->state, event->event, event->reason, 0);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -328,6 +347,8 @@ void xio_session_notify_new_connection(struct xio_session *session,
 		.private_data_len = 0,
 	};
 
+	xio_session_flight_event(connection, &event);
+
 	if (session->ses_ops.on_session_event) {
 #ifdef XIO_THREAD_SAFE_DEBUG
 		xio_ctx_debug_thread_unlock(connection->ctx);
@@ -358,6 +379,8 @@ void xio_session_notify_connection_established(
 		.private_data_len = 0,
 	};
 
+	xio_session_flight_event(connection, &event);
+
 	if (session->ses_ops.on_session_event) {
 #ifdef XIO_THREAD_SAFE_DEBUG
 		xio_ctx_debug_thread_unlock(connection->ctx);
@@ -391,6 +414,8 @@ void xio_session_notify_connection_rejected(
 		.private_data_len = 0,
 	};
 
+	xio_session_flight_event(connection, &event);
+
 	if (session->ses_ops.on_session_event) {
 #ifdef XIO_THREAD_SAFE_DEBUG
 		xio_ctx_debug_thread_unlock(connection->ctx);
@@ -427,6 +452,9 @@ void xio_session_notify_connection_closed(struct xio_session *session,
 		return;
 
 	connection->cd_bit = 1;
+	xio_connection_deliver_pending(connection);
+
+	xio_session_flight_event(connection, &event);
 
 	if (session->ses_ops.on_session_event) {
 #ifdef XIO_THREAD_SAFE_DEBUG
@@ -466,6 +494,12 @@ void xio_session_notify_connection_disconnected(
 		return;
 
 	connection->cd_bit = 1;
+	xio_connection_deliver_pending(connection);
+
+	xio_session_flight_event(connection, &event);
+	/* the peer went away without closing the connection */
+	if (connection->state == XIO_CONNECTION_STATE_ONLINE)
+		xio_flight_error(connection->ctx);
 
 	if (session->ses_ops.on_session_event) {
 #ifdef XIO_THREAD_SAFE_DEBUG
@@ -500,6 +534,8 @@ void xio_session_notify_connection_refused(struct xio_session *session,
 		.private_data_len = 0,
 	};
 
+	xio_session_flight_event(connection, &event);
+
 	if (session->ses_ops.on_session_event) {
 #ifdef XIO_THREAD_SAFE_DEBUG
 		xio_ctx_debug_thread_unlock(connection->ctx);
@@ -532,6 +568,10 @@ void xio_session_notify_connection_teardown(struct xio_session *session,
 		.private_data_len = 0,
 	};
 
+	xio_connection_deliver_pending(connection);
+
+	xio_session_flight_event(connection, &event);
+
 	if (session->ses_ops.on_session_event) {
 #ifdef XIO_THREAD_SAFE_DEBUG
 		xio_ctx_debug_thread_unlock(connection->ctx);
@@ -562,6 +602,11 @@ void xio_session_notify_connection_error(struct xio_session *session,
 		.private_data_len = 0,
 	};
 
+	xio_connection_deliver_pending(connection);
+
+	xio_session_flight_event(connection, &event);
+	xio_flight_error(connection->ctx);
+
 	if (session->ses_ops.on_session_event) {
 #ifdef XIO_THREAD_SAFE_DEBUG
 		xio_ctx_debug_thread_unlock(connection->ctx);
@@ -593,6 +638,8 @@ void xio_session_notify_reconnecting(struct xio_session *session,
 		.private_data_len = 0,
 	};
 
+	xio_session_flight_event(connection, &event);
+
 	if (session->ses_ops.on_session_event) {
 #ifdef XIO_THREAD_SAFE_DEBUG
 		xio_ctx_debug_thread_unlock(connection->ctx);
@@ -622,6 +669,8 @@ void xio_session_notify_reconnected(struct xio_session *session,
 		.private_data_len = 0,
 	};
 
+	xio_session_flight_event(connection, &event);
+
 	if (session->ses_ops.on_session_event) {
 #ifdef XIO_THREAD_SAFE_DEBUG
 		xio_ctx_debug_thread_unlock(connection->ctx);
@@ -637,57 +686,27 @@ void xio_session_notify_reconnected(struct xio_session *session,
 }
 
 /*---------------------------------------------------------------------------*/
-/* xio_on_req_recv				                             */
+/* xio_session_deliver_req				                     */
 /*---------------------------------------------------------------------------*/
-static int xio_on_req_recv(struct xio_connection *connection,
-			   struct xio_task *task)
+static void xio_session_deliver_req(struct xio_connection *connection,
+				    struct xio_task *task, uint32_t hdr_flags)
 {
-	struct xio_session_hdr	hdr;
 	struct xio_msg		*msg = &task->imsg;
 	enum xio_status         stat;
-#ifdef XIO_CFLAG_STAT_COUNTERS
-	struct xio_statistics *stats = &connection->ctx->stats;
-	struct xio_vmsg *vmsg = &msg->in;
+	int			prio;
+	struct xio_vmsg		*vmsg = &msg->in;
 	struct xio_sg_table_ops	*sgtbl_ops;
 	void			*sgtbl;
+	uint64_t		rx_bytes;
+#ifdef XIO_CFLAG_STAT_COUNTERS
+	struct xio_statistics *stats = &connection->ctx->stats;
+#endif
 
 	sgtbl		= xio_sg_table_get(&msg->in);
 	sgtbl_ops	= (struct xio_sg_table_ops *)
 				xio_sg_table_ops_get(msg->in.sgl_type);
-#endif
-
-	/* read session header */
-	xio_session_read_header(task, &hdr);
+	rx_bytes	= vmsg->header.iov_len + tbl_length(sgtbl_ops, sgtbl);
 
-	if (connection->req_exp_sn == hdr.sn) {
-		connection->req_exp_sn++;
-		connection->req_ack_sn = hdr.sn;
-		if (connection->enable_flow_control) {
-			connection->peer_credits_msgs += hdr.credits_msgs;
-			connection->peer_credits_bytes += hdr.credits_bytes;
-		}
-		connection->restarted = 0;
-	} else {
-		if (unlikely(connection->restarted))
-			connection->restarted = 0;
-		else
-			ERROR_LOG("ERROR: sn expected:%d, sn arrived:%d\n",
-				  connection->req_exp_sn, hdr.sn);
-		connection->req_exp_sn = hdr.sn + 1;
-	}
-	connection->ka.io_rcv = 1;
-	/*
-	DEBUG_LOG("[%s] sn:%d, exp:%d, ack:%d, credits:%d, peer_credits:%d\n",
-		  __func__,
-		  connection->req_sn, connection->req_exp_sn,
-		  connection->req_ack_sn,
-		  connection->credits_msgs, connection->peer_credits_msgs);
-	*/
-#ifdef XIO_SESSION_DEBUG
-	connection->peer_connection = hdr.connection;
-	connection->peer_session = hdr.session;
-#endif
-	msg->sn		= hdr.serial_num;
 	msg->flags	= task->imsg_flags;
 	msg->next	= NULL;
 
@@ -704,16 +723,16 @@ static int xio_on_req_recv(struct xio_connection *connection,
 	/* add ref to task avoiding race when user call release or send
 	 * completion
 	 */
-	if (hdr.flags & XIO_MSG_FLAG_REQUEST_READ_RECEIPT)
+	if (hdr_flags & XIO_MSG_FLAG_REQUEST_READ_RECEIPT)
 		xio_task_addref(task);
 
-#ifdef XIO_CFLAG_STAT_COUNTERS
+	xio_connection_stat_rx(connection, rx_bytes);
 	msg->timestamp = get_cycles();
+#ifdef XIO_CFLAG_STAT_COUNTERS
 	xio_stat_inc(stats, XIO_STAT_RX_MSG);
-	xio_stat_add(stats, XIO_STAT_RX_BYTES,
-		     vmsg->header.iov_len + tbl_length(sgtbl_ops, sgtbl));
+	xio_stat_add(stats, XIO_STAT_RX_BYTES, rx_bytes);
 #endif
-	if (test_bits(XIO_MSG_FLAG_EX_IMM_READ_RECEIPT, &hdr.flags)) {
+	if (test_bits(XIO_MSG_FLAG_EX_IMM_READ_RECEIPT, &hdr_flags)) {
 		xio_task_addref(task);
 		/* send receipt before calling the callback */
 		xio_connection_send_read_receipt(connection, msg);
@@ -730,25 +749,37 @@ static int xio_on_req_recv(struct xio_connection *connection,
 	} else {
 		/* check for repeated msgs */
 		/* repeated msgs will not be delivered to the application since they were already delivered */
-		if (connection->latest_delivered < msg->sn || connection->latest_delivered == 0) {
-#ifdef XIO_THREAD_SAFE_DEBUG
-			xio_ctx_debug_thread_unlock(connection->ctx);
-#endif
+		prio = xio_msg_prio(msg);
+		if (connection->latest_delivered[prio] < msg->sn ||
+		    connection->latest_delivered[prio] == 0) {
 			xio_connection_safe_remove_msg_from_queue(connection, msg);
-			connection->latest_delivered = msg->sn;
+			connection->latest_delivered[prio] = msg->sn;
 			task->unassign_user_context = NULL;
 			task->unassign_data_in_buf = NULL;
-			connection->ses_ops.on_msg(
+			if (xio_connection_cq_enabled(connection)) {
+				xio_connection_cq_push(
+					connection, XIO_CQ_EVENT_MSG, msg,
+					task->last_in_rxq, XIO_E_SUCCESS,
+					XIO_MSG_DIRECTION_IN);
+			} else if (connection->ses_ops.on_msg_batch) {
+				xio_connection_batch_add(connection, msg,
+							 task->last_in_rxq);
+			} else {
+#ifdef XIO_THREAD_SAFE_DEBUG
+				xio_ctx_debug_thread_unlock(connection->ctx);
+#endif
+				connection->ses_ops.on_msg(
 					connection->session, msg,
 					task->last_in_rxq,
 					connection->cb_user_context);
 #ifdef XIO_THREAD_SAFE_DEBUG
-			xio_ctx_debug_thread_lock(connection->ctx);
+				xio_ctx_debug_thread_lock(connection->ctx);
 #endif
+			}
 		}
 	}
 
-	if (hdr.flags & XIO_MSG_FLAG_REQUEST_READ_RECEIPT) {
+	if (hdr_flags & XIO_MSG_FLAG_REQUEST_READ_RECEIPT) {
 		if (task->state == XIO_TASK_STATE_DELIVERED) {
 			xio_connection_send_read_receipt(connection, msg);
 		} else {
@@ -756,6 +787,251 @@ static int xio_on_req_recv(struct xio_connection *connection,
 			xio_tasks_pool_put(task);
 		}
 	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_session_agg_unpack				                     */
+/*---------------------------------------------------------------------------*/
+/* unpack one way messages of an aggregated message, each into its own task,
+ * so they are delivered and released exactly as if sent separately.
+ * returns 1 if the tasks pool ran dry. the carrier then holds only the
+ * messages left to unpack and is kept for a retry. a message too long for
+ * a task is delivered as an XIO_E_MSG_SIZE error
+ */
+static int xio_session_agg_unpack(struct xio_connection *connection,
+				  struct xio_task *task)
+{
+	struct xio_agg_msg_hdr	*agg_hdr;
+	struct xio_agg_hdr	hdr;
+	struct xio_agg_hdr	*tmp_hdr;
+	struct xio_task		*sub_task;
+	struct xio_msg		*imsg;
+	struct xio_sg_table_ops	*sgtbl_ops;
+	void			*sgtbl;
+	void			*sg;
+	void			*carrier_sg;
+	uint8_t			*ptr, *end;
+	size_t			len;
+	uint32_t		nr = 0, delivered = 0;
+	uint64_t		bytes = 0, delivered_bytes = 0;
+
+	if (task->imsg.in.header.iov_len != sizeof(*agg_hdr)) {
+		ERROR_LOG("invalid aggregated message. hdr_len:%zd\n",
+			  task->imsg.in.header.iov_len);
+		goto cleanup;
+	}
+	agg_hdr	= (struct xio_agg_msg_hdr *)task->imsg.in.header.iov_base;
+	nr	= ntohl(agg_hdr->nr);
+	bytes	= ntohll(agg_hdr->bytes);
+
+	sgtbl		= xio_sg_table_get(&task->imsg.in);
+	sgtbl_ops	= (struct xio_sg_table_ops *)
+				xio_sg_table_ops_get(task->imsg.in.sgl_type);
+	if (tbl_nents(sgtbl_ops, sgtbl) != 1) {
+		ERROR_LOG("invalid aggregated message. nents:%d\n",
+			  tbl_nents(sgtbl_ops, sgtbl));
+		goto cleanup;
+	}
+	carrier_sg = sge_first(sgtbl_ops, sgtbl);
+	ptr	= (uint8_t *)sge_addr(sgtbl_ops, carrier_sg);
+	end	= ptr + sge_length(sgtbl_ops, carrier_sg);
+
+	while (ptr + sizeof(hdr) <= end) {
+		tmp_hdr = (struct xio_agg_hdr *)ptr;
+		UNPACK_LLVAL(tmp_hdr, &hdr, serial_num);
+		UNPACK_LVAL(tmp_hdr, &hdr, data_len);
+		UNPACK_SVAL(tmp_hdr, &hdr, hdr_len);
+		UNPACK_SVAL(tmp_hdr, &hdr, flags);
+
+		len = (size_t)hdr.hdr_len + hdr.data_len;
+		if (ptr + sizeof(hdr) + len > end) {
+			ERROR_LOG("truncated aggregated message\n");
+			break;
+		}
+		sub_task = xio_nexus_get_primary_task(connection->nexus);
+		if (unlikely(!sub_task)) {
+			/* keep the rest, with what is left to account for */
+			bytes = (bytes > delivered_bytes) ?
+					bytes - delivered_bytes : 0;
+			agg_hdr->nr	= htonl(nr - delivered);
+			agg_hdr->bytes	= htonll(bytes);
+			sge_set_addr(sgtbl_ops, carrier_sg, ptr);
+			sge_set_length(sgtbl_ops, carrier_sg,
+				       (size_t)(end - ptr));
+			return 1;
+		}
+		ptr += ALIGN(sizeof(hdr) + len, 8);
+
+		sub_task->tlv_type	= XIO_ONE_WAY_REQ;
+		sub_task->session	= task->session;
+		sub_task->connection	= connection;
+		sub_task->nexus		= task->nexus;
+		sub_task->imsg_flags	= hdr.flags;
+		sub_task->status	= 0;
+		sub_task->last_in_rxq	= (ptr >= end) ? task->last_in_rxq : 0;
+
+		imsg			= &sub_task->imsg;
+		imsg->type		= XIO_ONE_WAY_REQ;
+		imsg->sn		= hdr.serial_num;
+		imsg->timeout_us	= 0;
+		clr_bits(XIO_MSG_HINT_ASSIGNED_DATA_IN_BUF, &imsg->hints);
+
+		sgtbl		= xio_sg_table_get(&imsg->in);
+		sgtbl_ops	= (struct xio_sg_table_ops *)
+				xio_sg_table_ops_get(imsg->in.sgl_type);
+		if (unlikely(len > sub_task->mbuf.buf.buflen)) {
+			/* the peer packs only what fits a task, unless its
+			 * inline limits are larger than ours
+			 */
+			ERROR_LOG("aggregated message too long. len:%zd\n",
+				  len);
+			sub_task->status	= XIO_E_MSG_SIZE;
+			imsg->in.header.iov_len	= 0;
+			imsg->in.header.iov_base = NULL;
+			tbl_set_nents(sgtbl_ops, sgtbl, 0);
+		} else {
+			memcpy(sub_task->mbuf.buf.head,
+			       (uint8_t *)tmp_hdr + sizeof(hdr), len);
+			imsg->in.header.iov_len	= hdr.hdr_len;
+			imsg->in.header.iov_base = hdr.hdr_len ?
+						sub_task->mbuf.buf.head : NULL;
+			if (hdr.data_len) {
+				tbl_set_nents(sgtbl_ops, sgtbl, 1);
+				sg = sge_first(sgtbl_ops, sgtbl);
+				sge_set_addr(sgtbl_ops, sg,
+					     sum_to_ptr((uint8_t *)
+						sub_task->mbuf.buf.head,
+						hdr.hdr_len));
+				sge_set_length(sgtbl_ops, sg, hdr.data_len);
+				sge_set_mr(sgtbl_ops, sg, NULL);
+			} else {
+				tbl_set_nents(sgtbl_ops, sgtbl, 0);
+			}
+		}
+
+		/* released like any one way message, that returns its
+		 * credits
+		 */
+		delivered++;
+		delivered_bytes += len;
+		xio_session_deliver_req(connection, sub_task, hdr.flags);
+	}
+
+cleanup:
+	if (delivered < nr) {
+		ERROR_LOG("dropped %u of %u aggregated messages\n",
+			  nr - delivered, nr);
+		xio_connection_return_credits(
+				connection, nr - delivered,
+				bytes > delivered_bytes ?
+					bytes - delivered_bytes : 0);
+	}
+	/* the carrier itself takes no credits, the packed messages do */
+	list_move_tail(&task->tasks_list_entry,
+		       &connection->post_io_tasks_list);
+	xio_tasks_pool_put(task);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_session_rx_resume				                     */
+/*---------------------------------------------------------------------------*/
+static void xio_session_rx_resume(int actual_timeout_ms, void *_connection)
+{
+	struct xio_connection	*connection =
+					(struct xio_connection *)_connection;
+	struct xio_task		*task;
+
+	while (!list_empty(&connection->agg_rx_list)) {
+		task = list_first_entry(&connection->agg_rx_list,
+					struct xio_task, tasks_list_entry);
+		if (task->rx_hdr_flags & XIO_MSG_FLAG_EX_AGGREGATED) {
+			if (xio_session_agg_unpack(connection, task))
+				break;
+		} else {
+			xio_session_deliver_req(connection, task,
+						task->rx_hdr_flags);
+		}
+	}
+	if (!list_empty(&connection->agg_rx_list) &&
+	    xio_ctx_add_delayed_work(connection->ctx, XIO_AGG_RX_RETRY_MS,
+				     connection, xio_session_rx_resume,
+				     &connection->agg_rx_work))
+		ERROR_LOG("xio_ctx_add_delayed_work failed.\n");
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_session_rx_hold					                     */
+/*---------------------------------------------------------------------------*/
+/* back pressure - a request waits for released tasks, requests received
+ * after it wait behind it to keep the order of delivery
+ */
+static void xio_session_rx_hold(struct xio_connection *connection,
+				struct xio_task *task, uint32_t hdr_flags)
+{
+	int first = list_empty(&connection->agg_rx_list);
+
+	task->rx_hdr_flags = hdr_flags;
+	list_move_tail(&task->tasks_list_entry, &connection->agg_rx_list);
+	if (first &&
+	    xio_ctx_add_delayed_work(connection->ctx, XIO_AGG_RX_RETRY_MS,
+				     connection, xio_session_rx_resume,
+				     &connection->agg_rx_work))
+		ERROR_LOG("xio_ctx_add_delayed_work failed.\n");
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_on_req_recv				                             */
+/*---------------------------------------------------------------------------*/
+static int xio_on_req_recv(struct xio_connection *connection,
+			   struct xio_task *task)
+{
+	struct xio_session_hdr	hdr;
+	struct xio_msg		*msg = &task->imsg;
+
+	/* read session header */
+	xio_session_read_header(task, &hdr);
+	XIO_TRACE5(on_req_recv, connection, task->ltid, task->rtid,
+		   hdr.serial_num, connection->state);
+
+	if (connection->req_exp_sn == hdr.sn) {
+		connection->req_exp_sn++;
+		connection->req_ack_sn = hdr.sn;
+		if (connection->enable_flow_control) {
+			connection->peer_credits_msgs += hdr.credits_msgs;
+			connection->peer_credits_bytes += hdr.credits_bytes;
+		}
+		connection->restarted = 0;
+	} else {
+		if (unlikely(connection->restarted))
+			connection->restarted = 0;
+		else
+			ERROR_LOG("ERROR: sn expected:%d, sn arrived:%d\n",
+				  connection->req_exp_sn, hdr.sn);
+		connection->req_exp_sn = hdr.sn + 1;
+	}
+	connection->ka.io_rcv = 1;
+	/*
+	DEBUG_LOG("[%s] sn:%d, exp:%d, ack:%d, credits:%d, peer_credits:%d\n",
+		  __func__,
+		  connection->req_sn, connection->req_exp_sn,
+		  connection->req_ack_sn,
+		  connection->credits_msgs, connection->peer_credits_msgs);
+	*/
+#ifdef XIO_SESSION_DEBUG
+	connection->peer_connection = hdr.connection;
+	connection->peer_session = hdr.session;
+#endif
+	msg->sn		= hdr.serial_num;
+	msg->timeout_us	= hdr.timeout_us;
+
+	if (unlikely(!list_empty(&connection->agg_rx_list)))
+		xio_session_rx_hold(connection, task, hdr.flags);
+	else if (!(hdr.flags & XIO_MSG_FLAG_EX_AGGREGATED))
+		xio_session_deliver_req(connection, task, hdr.flags);
+	else if (xio_session_agg_unpack(connection, task))
+		xio_session_rx_hold(connection, task, hdr.flags);
 
 	return 0;
 }
@@ -790,6 +1066,8 @@ static int xio_on_rsp_recv(struct xio_connection *connection,
 
 	/* read session header */
 	xio_session_read_header(task, &hdr);
+	XIO_TRACE5(on_rsp_recv, connection, task->ltid, sender_task->ltid,
+		   hdr.serial_num, connection->state);
 
 	/* standalone receipt */
 	if (xio_app_receipt_request(&hdr) ==
@@ -883,7 +1161,14 @@ static int xio_on_rsp_recv(struct xio_connection *connection,
 
 		if (omsg->flags &
 		    XIO_MSG_FLAG_REQUEST_READ_RECEIPT) {
-			if (connection->ses_ops.on_msg_delivered) {
+			if (xio_connection_cq_enabled(connection)) {
+				xio_connection_safe_remove_msg_from_queue(
+							connection, omsg);
+				xio_connection_cq_push(
+					connection, XIO_CQ_EVENT_MSG_DELIVERED,
+					omsg, task->last_in_rxq,
+					XIO_E_SUCCESS, XIO_MSG_DIRECTION_OUT);
+			} else if (connection->ses_ops.on_msg_delivered) {
 #ifdef XIO_THREAD_SAFE_DEBUG
 				xio_ctx_debug_thread_unlock(connection->ctx);
 #endif
@@ -898,7 +1183,16 @@ static int xio_on_rsp_recv(struct xio_connection *connection,
 #endif
 			}
 		} else {
-			if (connection->ses_ops.on_ow_msg_send_complete) {
+			if (xio_connection_cq_enabled(connection)) {
+				xio_connection_cq_push(
+					connection,
+					XIO_CQ_EVENT_OW_MSG_SEND_COMPLETE,
+					omsg, 0, XIO_E_SUCCESS,
+					XIO_MSG_DIRECTION_OUT);
+			} else if (connection->ses_ops.
+				   on_msg_send_complete_batch) {
+				xio_connection_comp_add(connection, omsg);
+			} else if (connection->ses_ops.on_ow_msg_send_complete) {
 #ifdef XIO_THREAD_SAFE_DEBUG
 				xio_ctx_debug_thread_unlock(connection->ctx);
 #endif
@@ -914,7 +1208,17 @@ static int xio_on_rsp_recv(struct xio_connection *connection,
 		xio_release_response_task(task);
 	} else {
 		if (xio_app_receipt_first_request(&hdr)) {
-			if (connection->ses_ops.on_msg_delivered) {
+			if (xio_connection_cq_enabled(connection)) {
+				omsg->receipt_res =
+				    (enum xio_receipt_result)hdr.receipt_result;
+				omsg->sn	  = hdr.serial_num;
+				xio_connection_safe_remove_msg_from_queue(
+							connection, omsg);
+				xio_connection_cq_push(
+					connection, XIO_CQ_EVENT_MSG_DELIVERED,
+					omsg, task->last_in_rxq,
+					XIO_E_SUCCESS, XIO_MSG_DIRECTION_OUT);
+			} else if (connection->ses_ops.on_msg_delivered) {
 				omsg->receipt_res =
 				    (enum xio_receipt_result)hdr.receipt_result;
 				omsg->sn	  = hdr.serial_num;
@@ -943,25 +1247,78 @@ static int xio_on_rsp_recv(struct xio_connection *connection,
 			}
 		}
 		if (xio_app_receipt_last_request(&hdr)) {
-#ifdef XIO_CFLAG_STAT_COUNTERS
 			struct xio_vmsg *vmsg = &msg->in;
 			struct xio_sg_table_ops	*sgtbl_ops;
 			void			*sgtbl;
+			uint64_t		rx_bytes;
 
 			sgtbl		= xio_sg_table_get(&msg->in);
 			sgtbl_ops	= (struct xio_sg_table_ops *)
 					xio_sg_table_ops_get(msg->in.sgl_type);
-			xio_stat_add(stats, XIO_STAT_RX_BYTES,
-				     vmsg->header.iov_len +
-				     tbl_length(sgtbl_ops, sgtbl));
+			rx_bytes	= vmsg->header.iov_len +
+					  tbl_length(sgtbl_ops, sgtbl);
+			xio_connection_stat_rx(connection, rx_bytes);
+			xio_connection_stat_lat(connection,
+						XIO_CONNECTION_STAT_RTT,
+						XIO_CONTEXT_STAT_RTT,
+						get_cycles() - omsg->timestamp);
+			if (unlikely(hdr.flags & XIO_MSG_FLAG_EX_SAMPLED))
+				xio_connection_stat_breakdown(connection,
+							      sender_task,
+							      task, &hdr);
+#ifdef XIO_CFLAG_STAT_COUNTERS
+			xio_stat_add(stats, XIO_STAT_RX_BYTES, rx_bytes);
 #endif
 			omsg->request	= msg;
-			if (task->status) {
+			if (unlikely(omsg->flags & XIO_MSG_FLAG_EX_CANCELED)) {
+				/* canceled while in flight, the response is
+				 * released here and never delivered
+				 */
+				omsg->flags &= ~XIO_MSG_FLAG_EX_CANCELED;
+				task->status = 0;
+#ifdef XIO_THREAD_SAFE_DEBUG
+				xio_ctx_debug_thread_unlock(connection->ctx);
+#endif
+				xio_release_response(omsg);
+#ifdef XIO_THREAD_SAFE_DEBUG
+				xio_ctx_debug_thread_lock(connection->ctx);
+#endif
+				omsg->sn	= hdr.serial_num;
+				omsg->type	= XIO_MSG_TYPE_REQ;
+				xio_session_notify_msg_error(
+					connection, omsg,
+					XIO_E_MSG_CANCELED,
+					XIO_MSG_DIRECTION_OUT);
+			} else if (task->status) {
 				xio_session_notify_msg_error(
 					connection, omsg,
 					(enum xio_status)task->status,
 					XIO_MSG_DIRECTION_IN);
 				task->status = 0;
+			} else if (unlikely(omsg->flags &
+					    XIO_MSG_FLAG_EX_HOOKED)) {
+				struct xio_msg_hooks *hooks =
+					(struct xio_msg_hooks *)
+						omsg->user_context;
+#ifdef XIO_THREAD_SAFE_DEBUG
+				xio_ctx_debug_thread_unlock(connection->ctx);
+#endif
+				hooks->on_response(connection, omsg);
+#ifdef XIO_THREAD_SAFE_DEBUG
+				xio_ctx_debug_thread_lock(connection->ctx);
+#endif
+			} else if (xio_connection_cq_enabled(connection)) {
+				xio_connection_safe_remove_msg_from_queue(
+							connection, omsg);
+				xio_connection_cq_push(
+					connection, XIO_CQ_EVENT_MSG, omsg,
+					task->last_in_rxq, XIO_E_SUCCESS,
+					XIO_MSG_DIRECTION_IN);
+			} else if (connection->ses_ops.on_msg_batch) {
+				xio_connection_safe_remove_msg_from_queue(
+							connection, omsg);
+				xio_connection_batch_add(connection, omsg,
+							 task->last_in_rxq);
 			} else {
 #ifdef XIO_THREAD_SAFE_DEBUG
 				xio_ctx_debug_thread_unlock(connection->ctx);
@@ -1013,7 +1370,18 @@ static int xio_on_rsp_send_comp(
 		 */
 
 		xio_clear_ex_flags(&task->omsg->flags);
-		if (connection->ses_ops.on_msg_send_complete) {
+		if (xio_connection_cq_enabled(connection)) {
+			xio_connection_safe_remove_msg_from_queue(connection,
+								  task->omsg);
+			xio_connection_cq_push(
+				connection, XIO_CQ_EVENT_MSG_SEND_COMPLETE,
+				task->omsg, 0, XIO_E_SUCCESS,
+				XIO_MSG_DIRECTION_OUT);
+		} else if (connection->ses_ops.on_msg_send_complete_batch) {
+			xio_connection_safe_remove_msg_from_queue(connection,
+								  task->omsg);
+			xio_connection_comp_add(connection, task->omsg);
+		} else if (connection->ses_ops.on_msg_send_complete) {
 #ifdef XIO_THREAD_SAFE_DEBUG
 			xio_ctx_debug_thread_unlock(connection->ctx);
 #endif
@@ -1068,27 +1436,15 @@ int xio_on_credits_ack_recv(struct xio_connection *connection,
 }
 
 /*---------------------------------------------------------------------------*/
-/* xio_on_ow_req_send_comp				                     */
+/* xio_session_ow_msg_send_comp				                     */
 /*---------------------------------------------------------------------------*/
-static int xio_on_ow_req_send_comp(
-		struct xio_connection *connection,
-		struct xio_task *task)
+static void xio_session_ow_msg_send_comp(struct xio_connection *connection,
+					 struct xio_msg *omsg,
+					 uint64_t omsg_flags)
 {
 #ifdef XIO_CFLAG_STAT_COUNTERS
 	struct xio_statistics	*stats = &connection->ctx->stats;
-#endif
-	struct xio_msg		*omsg = task->omsg;
-
-	if (connection->is_flushed) {
-		xio_tasks_pool_put(task);
-		goto exit;
-	}
 
-	if (!omsg || omsg->flags & XIO_MSG_FLAG_REQUEST_READ_RECEIPT ||
-	    task->omsg_flags & XIO_MSG_FLAG_REQUEST_READ_RECEIPT ||
-	    task->omsg->flags & XIO_MSG_FLAG_EX_IMM_READ_RECEIPT)
-		return 0;
-#ifdef XIO_CFLAG_STAT_COUNTERS
 	xio_stat_add(stats, XIO_STAT_DELAY,
 		     get_cycles() - omsg->timestamp);
 	xio_stat_inc(stats, XIO_STAT_RX_MSG); /* need to replace with
@@ -1096,7 +1452,7 @@ static int xio_on_ow_req_send_comp(
 					       */
 #endif
 	xio_connection_remove_in_flight(connection, omsg);
-	omsg->flags = task->omsg_flags;
+	omsg->flags = omsg_flags;
 	xio_clear_ex_flags(&omsg->flags);
 
 	if (connection->enable_flow_control) {
@@ -1116,7 +1472,14 @@ static int xio_on_ow_req_send_comp(
 	/* send completion notification to
 	 * release request
 	 */
-	if (connection->ses_ops.on_ow_msg_send_complete) {
+	if (xio_connection_cq_enabled(connection)) {
+		xio_connection_cq_push(connection,
+				       XIO_CQ_EVENT_OW_MSG_SEND_COMPLETE,
+				       omsg, 0, XIO_E_SUCCESS,
+				       XIO_MSG_DIRECTION_OUT);
+	} else if (connection->ses_ops.on_msg_send_complete_batch) {
+		xio_connection_comp_add(connection, omsg);
+	} else if (connection->ses_ops.on_ow_msg_send_complete) {
 #ifdef XIO_THREAD_SAFE_DEBUG
 		xio_ctx_debug_thread_unlock(connection->ctx);
 #endif
@@ -1127,6 +1490,46 @@ static int xio_on_ow_req_send_comp(
 		xio_ctx_debug_thread_lock(connection->ctx);
 #endif
 	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_on_ow_req_send_comp				                     */
+/*---------------------------------------------------------------------------*/
+static int xio_on_ow_req_send_comp(
+		struct xio_connection *connection,
+		struct xio_task *task)
+{
+	struct xio_msg		*omsg = task->omsg;
+	struct xio_agg_carrier	*carrier = NULL;
+	uint32_t		i;
+
+	if (task->omsg_flags & XIO_MSG_FLAG_EX_AGGREGATED)
+		carrier = container_of(omsg, struct xio_agg_carrier, msg);
+
+	if (connection->is_flushed) {
+		if (carrier)
+			xio_objpool_free(carrier);
+		xio_tasks_pool_put(task);
+		goto exit;
+	}
+
+	if (carrier) {
+		/* complete the packed messages in the order they were sent */
+		for (i = 0; i < carrier->nr; i++)
+			xio_session_ow_msg_send_comp(connection,
+						     carrier->msgs[i],
+						     carrier->msgs[i]->flags);
+		xio_objpool_free(carrier);
+		xio_tasks_pool_put(task);
+		goto exit;
+	}
+
+	if (!omsg || omsg->flags & XIO_MSG_FLAG_REQUEST_READ_RECEIPT ||
+	    task->omsg_flags & XIO_MSG_FLAG_REQUEST_READ_RECEIPT ||
+	    task->omsg->flags & XIO_MSG_FLAG_EX_IMM_READ_RECEIPT)
+		return 0;
+
+	xio_session_ow_msg_send_comp(connection, omsg, task->omsg_flags);
 	xio_tasks_pool_put(task);
 
 exit:
@@ -1302,7 +1705,36 @@ int xio_on_nexus_message_error(struct xio_session *session,
 	xio_connection_remove_msg_from_queue(task->connection, task->omsg);
 	xio_connection_queue_io_task(task->connection, task);
 
-	if (task->session->ses_ops.on_msg_error && IS_APPLICATION_MSG(task->tlv_type)) {
+	if (IS_APPLICATION_MSG(task->tlv_type) && task->omsg &&
+	    unlikely(task->omsg->flags & XIO_MSG_FLAG_EX_HOOKED)) {
+		/* library owned messages never reach the application */
+		struct xio_msg_hooks *hooks =
+				(struct xio_msg_hooks *)task->omsg->user_context;
+
+		xio_connection_safe_remove_msg_from_queue(task->connection,
+							  task->omsg);
+		task->unassign_user_context = NULL;
+		task->unassign_data_in_buf = NULL;
+#ifdef XIO_THREAD_SAFE_DEBUG
+		xio_ctx_debug_thread_unlock(task->connection->ctx);
+#endif
+		hooks->on_error(task->connection, task->omsg,
+				event_data->msg_error.reason,
+				event_data->msg_error.direction);
+#ifdef XIO_THREAD_SAFE_DEBUG
+		xio_ctx_debug_thread_lock(task->connection->ctx);
+#endif
+	} else if (xio_connection_cq_enabled(task->connection) &&
+		   IS_APPLICATION_MSG(task->tlv_type)) {
+		xio_connection_safe_remove_msg_from_queue(task->connection,
+							  task->omsg);
+		task->unassign_user_context = NULL;
+		task->unassign_data_in_buf = NULL;
+		xio_connection_cq_push(task->connection,
+				       XIO_CQ_EVENT_MSG_ERROR, task->omsg, 0,
+				       event_data->msg_error.reason,
+				       event_data->msg_error.direction);
+	} else if (task->session->ses_ops.on_msg_error && IS_APPLICATION_MSG(task->tlv_type)) {
 #ifdef XIO_THREAD_SAFE_DEBUG
 		xio_ctx_debug_thread_unlock(task->connection->ctx);
 #endif
@@ -1677,6 +2109,7 @@ struct xio_session *xio_session_create(struct xio_session_params *params)
 	session->rcv_queue_depth_msgs	= g_options.rcv_queue_depth_msgs;
 	session->snd_queue_depth_bytes	= g_options.snd_queue_depth_bytes;
 	session->rcv_queue_depth_bytes	= g_options.rcv_queue_depth_bytes;
+	session->tx_weight		= 1;
 	session->connection_srv_first	= NULL;
 
 	memcpy(&session->ses_ops, params->ses_ops,
@@ -1874,6 +2307,14 @@ int xio_query_session(struct xio_session *session,
 	if (attr_mask & XIO_SESSION_ATTR_URI)
 		attr->uri = session->uri;
 
+	if (attr_mask & XIO_SESSION_ATTR_TX_WEIGHT)
+		attr->tx_weight = session->tx_weight;
+
+	if (attr_mask & XIO_SESSION_ATTR_SND_QUEUE_DEPTH) {
+		attr->snd_queue_depth_msgs = session->snd_queue_depth_msgs;
+		attr->snd_queue_depth_bytes = session->snd_queue_depth_bytes;
+	}
+
 	return 0;
 }
 EXPORT_SYMBOL(xio_query_session);
@@ -1885,15 +2326,52 @@ int xio_modify_session(struct xio_session *session,
 		       struct xio_session_attr *attr,
 		       int attr_mask)
 {
+	struct xio_connection *connection;
+
 	if (!session || !attr) {
 		xio_set_error(EINVAL);
 		ERROR_LOG("invalid parameters\n");
 		return -1;
 	}
 
+	if ((attr_mask & XIO_SESSION_ATTR_TX_WEIGHT) &&
+	    (attr->tx_weight == 0 ||
+	     attr->tx_weight > XIO_NEXUS_TXQ_MAX_WEIGHT)) {
+		xio_set_error(EINVAL);
+		ERROR_LOG("invalid tx weight %u\n", attr->tx_weight);
+		return -1;
+	}
+	/* the session keeps the message depth in 16 bits */
+	if ((attr_mask & XIO_SESSION_ATTR_SND_QUEUE_DEPTH) &&
+	    (attr->snd_queue_depth_msgs == 0 ||
+	     attr->snd_queue_depth_msgs > USHRT_MAX ||
+	     attr->snd_queue_depth_bytes == 0)) {
+		xio_set_error(EINVAL);
+		ERROR_LOG("invalid send queue depth %u msgs %llu bytes\n",
+			  attr->snd_queue_depth_msgs,
+			  (unsigned long long)attr->snd_queue_depth_bytes);
+		return -1;
+	}
+
 	if (attr_mask & XIO_SESSION_ATTR_USER_CTX)
 		session->cb_user_context = attr->user_context;
 
+	if (attr_mask & XIO_SESSION_ATTR_TX_WEIGHT) {
+		session->tx_weight = attr->tx_weight;
+		spin_lock(&session->connections_list_lock);
+		list_for_each_entry(connection, &session->connections_list,
+				    connections_list_entry)
+			connection->nexus_txq.quantum =
+				attr->tx_weight * XIO_NEXUS_TXQ_QUANTUM;
+		spin_unlock(&session->connections_list_lock);
+	}
+
+	/* bounds messages queued from now on, already queued ones stay */
+	if (attr_mask & XIO_SESSION_ATTR_SND_QUEUE_DEPTH) {
+		session->snd_queue_depth_msgs = attr->snd_queue_depth_msgs;
+		session->snd_queue_depth_bytes = attr->snd_queue_depth_bytes;
+	}
+
 	return 0;
 }
 EXPORT_SYMBOL(xio_modify_session);
@@ -1921,8 +2399,35 @@ int xio_session_notify_msg_error(struct xio_connection *connection,
 				 struct xio_msg *msg, enum xio_status result,
 				 enum xio_msg_direction direction)
 {
+	/* flushes follow a recorded disconnect, one per queued message */
+	if (result != XIO_E_MSG_FLUSHED)
+		xio_flight_rec(connection->ctx, XIO_FLIGHT_MSG_ERROR,
+			       connection, connection->state, result,
+			       direction, (uint32_t)msg->sn);
+
+	if (unlikely(msg->flags & XIO_MSG_FLAG_EX_HOOKED)) {
+		struct xio_msg_hooks *hooks =
+				(struct xio_msg_hooks *)msg->user_context;
+
+#ifdef XIO_THREAD_SAFE_DEBUG
+		xio_ctx_debug_thread_unlock(connection->ctx);
+#endif
+		hooks->on_error(connection, msg, result, direction);
+#ifdef XIO_THREAD_SAFE_DEBUG
+		xio_ctx_debug_thread_lock(connection->ctx);
+#endif
+		return 0;
+	}
+	/* messages that arrived before the error are passed first */
+	xio_connection_deliver_pending(connection);
+
 	/* notify the upper layer */
-	if (connection->ses_ops.on_msg_error && IS_APPLICATION_MSG(msg->type)) {
+	if (xio_connection_cq_enabled(connection) &&
+	    IS_APPLICATION_MSG(msg->type)) {
+		xio_connection_safe_remove_msg_from_queue(connection, msg);
+		xio_connection_cq_push(connection, XIO_CQ_EVENT_MSG_ERROR,
+				       msg, 0, result, direction);
+	} else if (connection->ses_ops.on_msg_error && IS_APPLICATION_MSG(msg->type)) {
 #ifdef XIO_THREAD_SAFE_DEBUG
 		xio_ctx_debug_thread_unlock(connection->ctx);
 #endif
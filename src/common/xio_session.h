@@ -118,7 +118,7 @@ struct xio_session {
 
 	uint32_t			teardown_reason;
 	uint32_t			reject_reason;
-	uint32_t			pad1;
+	uint32_t			tx_weight; /* share of shared nexuses */
 	struct mutex                    lock;	   /* lock open connection */
 	spinlock_t                      connections_list_lock;
 	int				disable_teardown;
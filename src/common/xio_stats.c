@@ -0,0 +1,381 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <xio_os.h>
+#include <libxio.h>
+#include "xio_log.h"
+#include "xio_common.h"
+#include <xio_env_adv.h>
+#include "xio_ev_data.h"
+#include "xio_ev_loop.h"
+#include "xio_objpool.h"
+#include "xio_workqueue.h"
+#include "xio_observer.h"
+#include "xio_context.h"
+#include "xio_stats.h"
+
+#define XIO_STAT_SET_GROW_NR		8
+
+static const struct xio_stat_template xio_context_stats[] = {
+	{ "RTT",		XIO_STAT_TYPE_LATENCY,		0 },
+	{ "APP_HOLD",		XIO_STAT_TYPE_LATENCY,		0 },
+	{ "QUEUEING",		XIO_STAT_TYPE_LATENCY,		0 },
+	{ "STAGE_QUEUED",	XIO_STAT_TYPE_LATENCY,		0 },
+	{ "STAGE_XMIT",		XIO_STAT_TYPE_LATENCY,		0 },
+	{ "STAGE_WIRE",		XIO_STAT_TYPE_LATENCY,		0 },
+	{ "STAGE_SERVER_QUEUE",	XIO_STAT_TYPE_LATENCY,		0 },
+	{ "STAGE_SERVER_APP",	XIO_STAT_TYPE_LATENCY,		0 },
+	{ "STAGE_DELIVER",	XIO_STAT_TYPE_LATENCY,		0 },
+};
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_set_get							     */
+/*---------------------------------------------------------------------------*/
+struct xio_stat_set *xio_stat_set_get(struct xio_context *ctx,
+				      enum xio_stat_scope scope, void *owner)
+{
+	struct xio_stat_set *set;
+
+	list_for_each_entry(set, &ctx->stat_sets, sets_list_entry) {
+		if (set->owner == owner && set->scope == scope) {
+			set->refcnt++;
+			return set;
+		}
+	}
+	set = (struct xio_stat_set *)xio_context_kcalloc(ctx, 1, sizeof(*set),
+							 GFP_KERNEL);
+	if (!set) {
+		xio_set_error(ENOMEM);
+		ERROR_LOG("xio_context_kcalloc failed. %m\n");
+		return NULL;
+	}
+	set->owner	= owner;
+	set->scope	= (uint16_t)scope;
+	set->refcnt	= 1;
+	list_add_tail(&set->sets_list_entry, &ctx->stat_sets);
+
+	return set;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_set_free							     */
+/*---------------------------------------------------------------------------*/
+static void xio_stat_set_free(struct xio_context *ctx,
+			      struct xio_stat_set *set)
+{
+	list_del(&set->sets_list_entry);
+	if (set->slots)
+		xio_context_kfree(ctx, set->slots);
+	if (set->descs)
+		xio_context_kfree(ctx, set->descs);
+	xio_context_kfree(ctx, set);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_set_put							     */
+/*---------------------------------------------------------------------------*/
+void xio_stat_set_put(struct xio_context *ctx, struct xio_stat_set *set)
+{
+	if (!set || --set->refcnt)
+		return;
+
+	xio_stat_set_free(ctx, set);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_sets_init							     */
+/*---------------------------------------------------------------------------*/
+int xio_stat_sets_init(struct xio_context *ctx)
+{
+	INIT_LIST_HEAD(&ctx->stat_sets);
+	ctx->stat_set = xio_stat_set_get(ctx, XIO_STAT_SCOPE_CONTEXT, ctx);
+	if (!ctx->stat_set)
+		return -1;
+
+	return xio_stat_register_all(ctx, ctx->stat_set, xio_context_stats,
+				     ARRAY_SIZE(xio_context_stats));
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_sets_destroy						     */
+/*---------------------------------------------------------------------------*/
+void xio_stat_sets_destroy(struct xio_context *ctx)
+{
+	struct xio_stat_set *set, *tmp;
+
+	list_for_each_entry_safe(set, tmp, &ctx->stat_sets, sets_list_entry)
+		xio_stat_set_free(ctx, set);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_nslots							     */
+/*---------------------------------------------------------------------------*/
+static inline uint16_t xio_stat_nslots(enum xio_stat_type type)
+{
+	switch (type) {
+	case XIO_STAT_TYPE_HISTOGRAM:
+		return XIO_STAT_HIST_SLOTS;
+	case XIO_STAT_TYPE_LATENCY:
+		return XIO_STAT_LAT_SLOTS;
+	default:
+		return 1;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_register							     */
+/*---------------------------------------------------------------------------*/
+int xio_stat_register(struct xio_context *ctx, struct xio_stat_set *set,
+		      const char *name, enum xio_stat_type type)
+{
+	struct xio_stat_desc	*desc = NULL;
+	uint16_t		nslots = xio_stat_nslots(type);
+	uint32_t		i;
+
+	/* reuse the slots of an unregistered statistic of the same size */
+	for (i = 0; i < set->ndescs; i++) {
+		if (!set->descs[i].active && set->descs[i].nslots == nslots) {
+			desc = &set->descs[i];
+			break;
+		}
+	}
+	if (!desc) {
+		if (set->ndescs == set->descs_cap) {
+			struct xio_stat_desc *descs;
+
+			descs = (struct xio_stat_desc *)xio_context_kcalloc(
+					ctx, set->descs_cap + XIO_STAT_SET_GROW_NR,
+					sizeof(*descs), GFP_KERNEL);
+			if (!descs)
+				goto nomem;
+			if (set->descs) {
+				memcpy(descs, set->descs,
+				       set->ndescs * sizeof(*descs));
+				xio_context_kfree(ctx, set->descs);
+			}
+			set->descs	= descs;
+			set->descs_cap	+= XIO_STAT_SET_GROW_NR;
+		}
+		if (set->nslots + nslots > set->slots_cap) {
+			uint32_t cap = max(2 * set->slots_cap,
+					   set->nslots + nslots);
+			uint64_t *slots;
+
+			slots = (uint64_t *)xio_context_kcalloc(
+					ctx, cap, sizeof(*slots), GFP_KERNEL);
+			if (!slots)
+				goto nomem;
+			if (set->slots) {
+				memcpy(slots, set->slots,
+				       set->nslots * sizeof(*slots));
+				xio_context_kfree(ctx, set->slots);
+			}
+			set->slots	= slots;
+			set->slots_cap	= cap;
+		}
+		desc		= &set->descs[set->ndescs++];
+		desc->slot	= set->nslots;
+		desc->nslots	= nslots;
+		set->nslots	+= nslots;
+	}
+	strncpy(desc->name, name, XIO_STAT_NAME_LEN - 1);
+	desc->name[XIO_STAT_NAME_LEN - 1] = '\0';
+	desc->type	= (uint8_t)type;
+	desc->active	= 1;
+	memset(&set->slots[desc->slot], 0, nslots * sizeof(*set->slots));
+
+	return (int)desc->slot;
+
+nomem:
+	xio_set_error(ENOMEM);
+	ERROR_LOG("xio_context_kcalloc failed. %m\n");
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_register_all						     */
+/*---------------------------------------------------------------------------*/
+int xio_stat_register_all(struct xio_context *ctx, struct xio_stat_set *set,
+			  const struct xio_stat_template *tmpl, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (xio_stat_register(ctx, set, tmpl[i].name,
+				      tmpl[i].type) == -1)
+			return -1;
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_unregister							     */
+/*---------------------------------------------------------------------------*/
+int xio_stat_unregister(struct xio_stat_set *set, int stat)
+{
+	uint32_t i;
+
+	for (i = 0; i < set->ndescs; i++) {
+		if (set->descs[i].active && (int)set->descs[i].slot == stat) {
+			set->descs[i].active = 0;
+			return 0;
+		}
+	}
+	xio_set_error(EINVAL);
+	ERROR_LOG("statistic %d not registered\n", stat);
+
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_lat_quantile						     */
+/*---------------------------------------------------------------------------*/
+/* upper bound of the bucket holding the num/den quantile, in cycles */
+static uint64_t xio_stat_lat_quantile(const uint64_t *slots,
+				      uint64_t num, uint64_t den)
+{
+	const uint64_t	*buckets = &slots[3];
+	uint64_t	target = (slots[0] * num + den - 1) / den;
+	uint64_t	acc = 0, upper;
+	int		i, shift;
+
+	for (i = 0; i < XIO_STAT_LAT_BUCKETS - 1; i++) {
+		acc += buckets[i];
+		if (acc >= target)
+			break;
+	}
+	if (i < XIO_STAT_LAT_SUB) {
+		upper = i;
+	} else {
+		shift = (i >> XIO_STAT_LAT_SUB_BITS) - 1;
+		upper = (((uint64_t)(i & (XIO_STAT_LAT_SUB - 1)) +
+			  XIO_STAT_LAT_SUB + 1) << shift) - 1;
+	}
+
+	/* the last bucket is open ended */
+	return min(upper, slots[2]);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_latency							     */
+/*---------------------------------------------------------------------------*/
+void xio_stat_latency(const uint64_t *slots, uint64_t hertz,
+		      struct xio_latency_stats *latency)
+{
+	memset(latency, 0, sizeof(*latency));
+	if (!slots[0])
+		return;
+
+	latency->samples = slots[0];
+	latency->mean_ns = xio_stat_cycles_to_ns(slots[1] / slots[0], hertz);
+	latency->p50_ns	 = xio_stat_cycles_to_ns(
+				xio_stat_lat_quantile(slots, 1, 2), hertz);
+	latency->p99_ns	 = xio_stat_cycles_to_ns(
+				xio_stat_lat_quantile(slots, 99, 100), hertz);
+	latency->p999_ns = xio_stat_cycles_to_ns(
+				xio_stat_lat_quantile(slots, 999, 1000), hertz);
+	latency->max_ns	 = xio_stat_cycles_to_ns(slots[2], hertz);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_query_stats							     */
+/*---------------------------------------------------------------------------*/
+int xio_query_stats(struct xio_context *ctx, xio_stat_fn_t fn,
+		    void *user_context)
+{
+	struct xio_stat_set	*set;
+	struct xio_stat_desc	*desc;
+	struct xio_stat		stat;
+	uint64_t		*slots;
+	uint32_t		i;
+	int			retval;
+
+	if (!ctx || !fn) {
+		xio_set_error(EINVAL);
+		ERROR_LOG("invalid parameters\n");
+		return -1;
+	}
+
+	list_for_each_entry(set, &ctx->stat_sets, sets_list_entry) {
+		if (set->refresh)
+			set->refresh(set);
+		for (i = 0; i < set->ndescs; i++) {
+			desc = &set->descs[i];
+			if (!desc->active)
+				continue;
+			slots = &set->slots[desc->slot];
+			memset(&stat, 0, sizeof(stat));
+			stat.name	= desc->name;
+			stat.owner	= set->owner;
+			stat.scope	= (enum xio_stat_scope)set->scope;
+			stat.type	= (enum xio_stat_type)desc->type;
+			stat.value	= slots[0];
+			if (desc->type == XIO_STAT_TYPE_HISTOGRAM) {
+				stat.sum	= slots[1];
+				stat.buckets	= &slots[2];
+			} else if (desc->type == XIO_STAT_TYPE_LATENCY) {
+				xio_stat_latency(slots, ctx->stats.hertz,
+						 &stat.latency);
+				stat.sum	= xio_stat_cycles_to_ns(
+							slots[1],
+							ctx->stats.hertz);
+			}
+			retval = fn(&stat, user_context);
+			if (retval)
+				return retval;
+		}
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL(xio_query_stats);
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_scope_str							     */
+/*---------------------------------------------------------------------------*/
+const char *xio_stat_scope_str(enum xio_stat_scope scope)
+{
+	switch (scope) {
+	case XIO_STAT_SCOPE_CONTEXT: return "context";
+	case XIO_STAT_SCOPE_SESSION: return "session";
+	case XIO_STAT_SCOPE_CONNECTION: return "connection";
+	case XIO_STAT_SCOPE_NEXUS: return "nexus";
+	default: return "scope_unknown";
+	}
+}
+EXPORT_SYMBOL(xio_stat_scope_str);
@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef XIO_STATS_H
+#define XIO_STATS_H
+
+#define XIO_STAT_NAME_LEN		32
+
+struct xio_context;
+
+/*---------------------------------------------------------------------------*/
+/* structs								     */
+/*---------------------------------------------------------------------------*/
+struct xio_stat_desc {
+	char			name[XIO_STAT_NAME_LEN];
+	uint32_t		slot;		/* first value slot - handle */
+	uint16_t		nslots;
+	uint8_t			type;		/* enum xio_stat_type */
+	uint8_t			active;		/* 0 - unregistered */
+};
+
+/* statistics of one object, updated by the owning context's thread only */
+struct xio_stat_set {
+	struct list_head	sets_list_entry;
+	void			*owner;
+	/* sets gauges from the owner's state before the set is read */
+	void			(*refresh)(struct xio_stat_set *set);
+	uint64_t		*slots;
+	struct xio_stat_desc	*descs;
+	uint16_t		scope;		/* enum xio_stat_scope */
+	uint16_t		refcnt;
+	uint32_t		ndescs;
+	uint32_t		descs_cap;
+	uint32_t		nslots;
+	uint32_t		slots_cap;
+	uint32_t		pad;
+};
+
+/* statistics registered together on a new set, histograms last */
+struct xio_stat_template {
+	const char		*name;
+	enum xio_stat_type	type;
+	uint32_t		pad;
+};
+
+/* histogram slots - samples, sum of samples, log2 buckets */
+#define XIO_STAT_HIST_SLOTS		(2 + XIO_STAT_HIST_BUCKETS)
+
+/* latency slots - samples, sum, max and log-linear buckets of cycles:
+ * values below XIO_STAT_LAT_SUB count exactly, larger ones in
+ * XIO_STAT_LAT_SUB buckets per power of two
+ */
+#define XIO_STAT_LAT_SUB_BITS		3
+#define XIO_STAT_LAT_SUB		(1 << XIO_STAT_LAT_SUB_BITS)
+#define XIO_STAT_LAT_MAX_BITS		48
+#define XIO_STAT_LAT_BUCKETS		(XIO_STAT_LAT_SUB * \
+					 (XIO_STAT_LAT_MAX_BITS - \
+					  XIO_STAT_LAT_SUB_BITS + 1))
+#define XIO_STAT_LAT_SLOTS		(3 + XIO_STAT_LAT_BUCKETS)
+
+/* handles in ctx->stat_set, registered before any user counter */
+enum xio_context_stat {
+	XIO_CONTEXT_STAT_RTT		= 0,
+	XIO_CONTEXT_STAT_APP_HOLD	= XIO_STAT_LAT_SLOTS,
+	XIO_CONTEXT_STAT_QUEUEING	= 2 * XIO_STAT_LAT_SLOTS,
+	/* one per enum xio_msg_stage, XIO_STAT_LAT_SLOTS apart */
+	XIO_CONTEXT_STAT_STAGE		= 3 * XIO_STAT_LAT_SLOTS
+};
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_set_get							     */
+/*---------------------------------------------------------------------------*/
+/* the set of owner in that scope, created on first use */
+struct xio_stat_set *xio_stat_set_get(struct xio_context *ctx,
+				      enum xio_stat_scope scope, void *owner);
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_set_put							     */
+/*---------------------------------------------------------------------------*/
+void xio_stat_set_put(struct xio_context *ctx, struct xio_stat_set *set);
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_register							     */
+/*---------------------------------------------------------------------------*/
+/* returns the handle to update the statistic with or -1 */
+int xio_stat_register(struct xio_context *ctx, struct xio_stat_set *set,
+		      const char *name, enum xio_stat_type type);
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_register_all						     */
+/*---------------------------------------------------------------------------*/
+/* on an empty set the handles are the slot offsets in template order */
+int xio_stat_register_all(struct xio_context *ctx, struct xio_stat_set *set,
+			  const struct xio_stat_template *tmpl, int n);
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_unregister							     */
+/*---------------------------------------------------------------------------*/
+int xio_stat_unregister(struct xio_stat_set *set, int stat);
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_sets_init							     */
+/*---------------------------------------------------------------------------*/
+/* creates ctx->stat_set with the context's built in statistics */
+int xio_stat_sets_init(struct xio_context *ctx);
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_latency							     */
+/*---------------------------------------------------------------------------*/
+/* summarizes latency slots counted in cycles of hertz */
+void xio_stat_latency(const uint64_t *slots, uint64_t hertz,
+		      struct xio_latency_stats *latency);
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_sets_destroy						     */
+/*---------------------------------------------------------------------------*/
+/* releases sets left on a context being destroyed */
+void xio_stat_sets_destroy(struct xio_context *ctx);
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_cycles_to_ns						     */
+/*---------------------------------------------------------------------------*/
+static inline uint64_t xio_stat_cycles_to_ns(uint64_t cycles, uint64_t hertz)
+{
+	if (!hertz)
+		return cycles;
+
+	return (cycles / hertz) * 1000000000ULL +
+	       (cycles % hertz) * 1000000000ULL / hertz;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_ns_to_cycles						     */
+/*---------------------------------------------------------------------------*/
+static inline uint64_t xio_stat_ns_to_cycles(uint64_t ns, uint64_t hertz)
+{
+	if (!hertz)
+		return ns;
+
+	return (ns / 1000000000ULL) * hertz +
+	       (ns % 1000000000ULL) * hertz / 1000000000ULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_ns_pack							     */
+/*---------------------------------------------------------------------------*/
+/* packs a duration into 16 bits for the wire: an 11 bit mantissa and a
+ * 5 bit exponent, within 1/1024 of the value up to 73 minutes
+ */
+static inline uint16_t xio_stat_ns_pack(uint64_t ns)
+{
+	unsigned int exp = 0;
+
+	while (ns > 0x7ff) {
+		ns >>= 1;
+		exp++;
+	}
+	if (exp > 31)
+		return 0xffff;
+
+	return (uint16_t)((exp << 11) | ns);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_ns_unpack							     */
+/*---------------------------------------------------------------------------*/
+static inline uint64_t xio_stat_ns_unpack(uint16_t val)
+{
+	return (uint64_t)(val & 0x7ff) << (val >> 11);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_set_inc							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_stat_set_inc(struct xio_stat_set *set, int stat)
+{
+	set->slots[stat]++;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_set_add							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_stat_set_add(struct xio_stat_set *set, int stat,
+				    uint64_t val)
+{
+	set->slots[stat] += val;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_set_gauge							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_stat_set_gauge(struct xio_stat_set *set, int stat,
+				      uint64_t val)
+{
+	set->slots[stat] = val;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_hist_bucket							     */
+/*---------------------------------------------------------------------------*/
+static inline int xio_stat_hist_bucket(uint64_t val)
+{
+	int bucket;
+
+	if (!val)
+		return 0;
+	bucket = 64 - __builtin_clzll(val);
+
+	return bucket < XIO_STAT_HIST_BUCKETS ?
+			bucket : XIO_STAT_HIST_BUCKETS - 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_set_hist							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_stat_set_hist(struct xio_stat_set *set, int stat,
+				     uint64_t val)
+{
+	uint64_t *slots = &set->slots[stat];
+
+	slots[0]++;
+	slots[1] += val;
+	slots[2 + xio_stat_hist_bucket(val)]++;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_lat_bucket							     */
+/*---------------------------------------------------------------------------*/
+static inline int xio_stat_lat_bucket(uint64_t val)
+{
+	int shift;
+
+	if (val < XIO_STAT_LAT_SUB)
+		return (int)val;
+	shift = 63 - __builtin_clzll(val) - XIO_STAT_LAT_SUB_BITS;
+	if (shift >= XIO_STAT_LAT_MAX_BITS - XIO_STAT_LAT_SUB_BITS)
+		return XIO_STAT_LAT_BUCKETS - 1;
+
+	/* the leading bit selects the range, the next ones the sub bucket */
+	return ((shift + 1) << XIO_STAT_LAT_SUB_BITS) +
+	       (int)((val >> shift) & (XIO_STAT_LAT_SUB - 1));
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stat_set_lat							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_stat_set_lat(struct xio_stat_set *set, int stat,
+				    uint64_t val)
+{
+	uint64_t *slots = &set->slots[stat];
+
+	slots[0]++;
+	slots[1] += val;
+	if (val > slots[2])
+		slots[2] = val;
+	slots[3 + xio_stat_lat_bucket(val)]++;
+}
+
+#endif /* XIO_STATS_H */
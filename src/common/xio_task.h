@@ -38,6 +38,8 @@
 #ifndef XIO_TASK_H
 #define XIO_TASK_H
 
+#include "xio_trace.h"
+
 #ifndef list_last_entry
 #define list_last_entry(ptr, type, member) \
 	list_entry((ptr)->prev, type, member)
@@ -59,43 +61,65 @@ struct xio_tasks_pool;
 /*---------------------------------------------------------------------------*/
 /* structs								     */
 /*---------------------------------------------------------------------------*/
+/* cycles at which a sampled request's task passed each point */
+enum xio_task_stamp {
+	XIO_TASK_STAMP_SEND,		/* header written, left the queues */
+	XIO_TASK_STAMP_XMIT,		/* handed whole to the transport   */
+	XIO_TASK_STAMP_RECV,		/* arrived at the session layer	   */
+	XIO_TASK_STAMP_NR
+};
+
+/*
+ * struct xio_task is laid out hot-to-cold: the first two cache lines hold
+ * everything the send/receive paths touch per message (list linkage, owner
+ * pointers, ids, flags and state); mbuf and imsg follow, and metadata that
+ * is only needed at slab setup, on unassign or for debugging is kept last.
+ * Run xio_mem_usage to see field offsets and the cache lines they occupy.
+ */
 struct xio_task {
+	/* cache line 0 */
 	struct list_head	tasks_list_entry;
 	void			*dd_data;
+	void			*pool;
+	void			*context;
 	struct xio_task		*sender_task;  /* client only on receiver */
-	struct xio_mbuf		mbuf;
+	struct xio_msg		*omsg;		/* pointer from user */
+	struct xio_connection	*connection;
 
+	/* cache line 1 */
+	struct xio_session	*session;
+	struct xio_nexus	*nexus;
+	uint64_t		stag;		/* session unique tag */
 	enum xio_task_state	state;		/* task state enum	*/
 	struct kref		kref;
-	uint64_t		stag;		/* session unique tag */
 	uint32_t                tlv_type;
-	uint16_t                is_control;
-	uint16_t                omsg_flags;
-	uint16_t                imsg_flags;
-	uint16_t                last_in_rxq;
 	uint32_t                ltid;           /* local task id        */
 	uint32_t                rtid;           /* remote task id       */
-	uint32_t                magic;
 	int32_t                 status;
+	uint16_t                omsg_flags;
+	uint16_t                imsg_flags;
+	uint16_t                is_control;
+	uint16_t                last_in_rxq;
 	uint32_t                on_hold:1;
 	uint32_t                is_assigned:1;
 	uint32_t		ka_probes:1;
-	uint32_t                pad:29;
+	uint32_t		sampled:1;
+	uint32_t                pad:28;
+	uint32_t		tx_cost;	/* bytes charged by the nexus */
 
-	void			*pool;
-	void			*slab;
-	void			*context;
-	struct xio_session	*session;
-	struct xio_connection	*connection;
-	struct xio_nexus	*nexus;
+	struct xio_mbuf		mbuf;
+	struct xio_msg		imsg;		/* message to the user */
 
+	/* cold */
 	struct xio_vmsg		in_receipt;     /* save in of message with */
 						/* receipt */
-	struct xio_msg		*omsg;		/* pointer from user */
-	struct xio_msg		imsg;		/* message to the user */
-
 	int 			(*unassign_data_in_buf)(struct xio_msg *msg, void *user_context);
 	void			*unassign_user_context;
+	void			*slab;
+	uint32_t                magic;
+	uint32_t		rx_hdr_flags;	/* of a held back receive */
+	/* lifecycle of a sampled message */
+	uint64_t		stamps[XIO_TASK_STAMP_NR];
 };
 
 struct xio_tasks_pool_hooks {
@@ -144,6 +168,8 @@ struct xio_tasks_pool_params {
 	int				pool_dd_data_sz;
 	int				slab_dd_data_sz;
 	int				task_dd_data_sz;
+	int				task_inline_buf_sz;
+	int				pad;
 };
 
 struct xio_tasks_slab {
@@ -155,6 +181,11 @@ struct xio_tasks_slab {
 	uint32_t			nr;
 	uint32_t			huge_alloc;
 	void				*dd_data;
+	void				*inline_bufs; /* contiguous slabs only */
+	uint32_t			alloc_sz;     /* memory accounting */
+	uint32_t			inline_sz;
+	uint32_t			free_nr;      /* pool shrink only */
+	uint32_t			pad;
 };
 
 struct xio_tasks_pool {
@@ -166,7 +197,7 @@ struct xio_tasks_pool {
 	unsigned int			max_used;
 	unsigned int			curr_idx;
 	unsigned int			node_id; /* numa node id */
-	unsigned int			pad;
+	unsigned int			window_max_used; /* since last shrink */
 	struct list_head		slabs_list;
 	struct list_head		on_hold_list;
 	struct list_head		orphans_list;
@@ -200,6 +231,18 @@ static inline void xio_task_reset(struct xio_task *task)
 	task->unassign_user_context = NULL;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_tasks_slab_inline_bufs						     */
+/*---------------------------------------------------------------------------*/
+static inline void *xio_tasks_slab_inline_bufs(void *slab_dd_data)
+{
+	/* slab private data immediately follows struct xio_tasks_slab */
+	struct xio_tasks_slab *s = (struct xio_tasks_slab *)
+			((char *)slab_dd_data - sizeof(struct xio_tasks_slab));
+
+	return s->inline_bufs;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_task_addref							     */
 /*---------------------------------------------------------------------------*/
@@ -248,6 +291,7 @@ static inline void xio_task_release(struct kref *kref)
 	xio_task_reset(task);
 
 	pool->curr_used--;
+	XIO_TRACE3(task_put, pool, task->ltid, pool->curr_used);
 
 	list_move(&task->tasks_list_entry, &pool->stack);
 }
@@ -263,6 +307,11 @@ struct xio_tasks_pool *xio_tasks_pool_create(
 /*---------------------------------------------------------------------------*/
 void xio_tasks_pool_destroy(struct xio_tasks_pool *q);
 
+/*---------------------------------------------------------------------------*/
+/* xio_tasks_pool_shrink						     */
+/*---------------------------------------------------------------------------*/
+void xio_tasks_pool_shrink(struct xio_tasks_pool *q);
+
 /*---------------------------------------------------------------------------*/
 /* xio_tasks_pool_remap							     */
 /*---------------------------------------------------------------------------*/
@@ -311,11 +360,15 @@ static inline struct xio_task *xio_tasks_pool_get(
 	q->curr_used++;
 	if (q->curr_used > q->max_used)
 		q->max_used = q->curr_used;
+	if (q->curr_used > q->window_max_used)
+		q->window_max_used = q->curr_used;
 
 	kref_init(&t->kref);
 	t->tlv_type	= 0xbeef;  /* poison the type */
+	t->sampled	= 0;
 
 	xio_task_reinit(context, t);
+	XIO_TRACE3(task_get, q, t->ltid, q->curr_used);
 
 	if (q->params.pool_hooks.task_post_get)
 		q->params.pool_hooks.task_post_get(context, t);
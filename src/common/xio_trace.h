@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef XIO_TRACE_H
+#define XIO_TRACE_H
+
+/*
+ * static tracepoints of the hot paths for perf, bpftrace and systemtap,
+ * e.g. bpftrace -e 'usdt:libxio.so:libxio:on_rsp_recv { @[arg3] = count(); }'
+ *
+ * built in with --enable-tracepoints when <sys/sdt.h> is found; a probe is
+ * a single nop until a tracer attaches to it, otherwise it compiles out.
+ *
+ * probe		arguments
+ * send_request		connection, sn, bytes, queued msgs
+ * connection_xmit	connection, sn, msg type, xio_connection_send status
+ * tcp_xmit		tcp handle, task ltid, tlv type, tasks left to send
+ * tcp_rx_data		tcp handle, task ltid, tlv type, bytes
+ * on_req_recv		connection, task ltid, peer task id, sn, conn state
+ * on_rsp_recv		connection, task ltid, request task ltid, sn,
+ *			conn state
+ * task_get		tasks pool, task ltid, tasks in use
+ * task_put		tasks pool, task ltid, tasks in use
+ * mempool_alloc	mempool, buffer, length, slab block size
+ * mempool_free		mempool, buffer, length
+ * ev_dispatch		loop, fd, poll events
+ * ev_event		loop, handler, handler data
+ */
+#ifdef XIO_CFLAG_TRACEPOINTS
+#include <sys/sdt.h>
+
+#define XIO_TRACE2(name, a1, a2)					\
+	DTRACE_PROBE2(libxio, name, a1, a2)
+#define XIO_TRACE3(name, a1, a2, a3)					\
+	DTRACE_PROBE3(libxio, name, a1, a2, a3)
+#define XIO_TRACE4(name, a1, a2, a3, a4)				\
+	DTRACE_PROBE4(libxio, name, a1, a2, a3, a4)
+#define XIO_TRACE5(name, a1, a2, a3, a4, a5)				\
+	DTRACE_PROBE5(libxio, name, a1, a2, a3, a4, a5)
+#else
+#define XIO_TRACE2(name, a1, a2)		do { } while (0)
+#define XIO_TRACE3(name, a1, a2, a3)		do { } while (0)
+#define XIO_TRACE4(name, a1, a2, a3, a4)	do { } while (0)
+#define XIO_TRACE5(name, a1, a2, a3, a4, a5)	do { } while (0)
+#endif
+
+#endif /* XIO_TRACE_H */
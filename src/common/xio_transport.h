@@ -142,6 +142,11 @@ struct xio_tasks_pool_ops {
 				   int *pool_dd_size,
 				   int *slab_dd_size,
 				   int *task_dd_size);
+	/* optional - per task inline buffer size to carve out of the slab
+	 * region when the context uses contiguous task slabs
+	 */
+	int	(*pool_get_inline_buf_size)(
+				struct xio_transport_base *transport_hndl);
 
 	int	(*slab_pre_create)(struct xio_transport_base *trans_hndl,
 				   struct xio_context *ctx,
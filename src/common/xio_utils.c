@@ -471,6 +471,25 @@ const char *xio_proto_str(enum xio_proto proto)
 }
 EXPORT_SYMBOL(xio_proto_str);
 
+/*---------------------------------------------------------------------------*/
+/* xio_mem_class_str							     */
+/*---------------------------------------------------------------------------*/
+const char *xio_mem_class_str(enum xio_mem_class mem_class)
+{
+	switch (mem_class) {
+	case XIO_MEM_CLASS_TASKS_POOL: return "tasks_pool";
+	case XIO_MEM_CLASS_INLINE_BUFS: return "inline_bufs";
+	case XIO_MEM_CLASS_MEMPOOL: return "mempool";
+	case XIO_MEM_CLASS_OBJPOOL: return "objpool";
+	case XIO_MEM_CLASS_TRANSPORT: return "transport";
+	case XIO_MEM_CLASS_SCRATCH: return "scratch";
+	case XIO_MEM_CLASS_NEXUS: return "nexus";
+	case XIO_MEM_CLASS_CONNECTION: return "connection";
+	default: return "mem_class_unknown";
+	}
+}
+EXPORT_SYMBOL(xio_mem_class_str);
+
 /*---------------------------------------------------------------------------*/
 /* xio_dump_task_list							     */
 /*---------------------------------------------------------------------------*/
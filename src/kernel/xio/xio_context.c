@@ -56,6 +56,8 @@
 #include "xio_objpool.h"
 #include "xio_workqueue.h"
 #include "xio_context.h"
+#include "xio_stats.h"
+#include "xio_flight.h"
 #include "xio_mempool.h"
 #include "xio_protocol.h"
 #include "xio_mbuf.h"
@@ -180,9 +182,14 @@ struct xio_context *xio_context_create(struct xio_context_params *ctx_params,
 		ERROR_LOG("context's msg_pool create failed. %m\n");
 		goto cleanup2;
 	}
+	if (ctx_params->cq_depth > 0 &&
+	    xio_context_cq_resize(ctx,
+				  roundup_pow_of_two(ctx_params->cq_depth)))
+		goto cleanup3;
 
 	XIO_OBSERVABLE_INIT(&ctx->observable, ctx);
 	INIT_LIST_HEAD(&ctx->ctx_list);
+	INIT_LIST_HEAD(&ctx->stat_sets);
 
 	switch (flags) {
 	case XIO_LOOP_USER_LOOP:
@@ -205,6 +212,8 @@ struct xio_context *xio_context_create(struct xio_context_params *ctx_params,
 		goto cleanup3;
 
 	ctx->stats.hertz = HZ;
+	ctx->stats.counter = ctx->stats.local_counter;
+	ctx->stats.seq = &ctx->stats.local_seq;
 	/* Initialize default counters' name */
 	ctx->stats.name[XIO_STAT_TX_MSG]   = kstrdup("TX_MSG", GFP_KERNEL);
 	ctx->stats.name[XIO_STAT_RX_MSG]   = kstrdup("RX_MSG", GFP_KERNEL);
@@ -213,6 +222,12 @@ struct xio_context *xio_context_create(struct xio_context_params *ctx_params,
 	ctx->stats.name[XIO_STAT_DELAY]    = kstrdup("DELAY", GFP_KERNEL);
 	ctx->stats.name[XIO_STAT_APPDELAY] = kstrdup("APPDELAY", GFP_KERNEL);
 
+	if (xio_stat_sets_init(ctx))
+		goto cleanup3;
+
+	/* the recorder is best effort */
+	xio_flight_create(ctx);
+
 	/* initialize rdma pools only */
 	transport = xio_get_transport("rdma");
 	if (transport && ctx->prealloc_xio_inline_bufs) {
@@ -235,9 +250,14 @@ struct xio_context *xio_context_create(struct xio_context_params *ctx_params,
 	return ctx;
 
 cleanup3:
+	if (ctx->cq)
+		xio_context_kfree(ctx, ctx->cq);
 	xio_objpool_destroy(ctx->msg_pool);
 
 cleanup2:
+	xio_flight_destroy(ctx);
+	if (ctx->stat_set)
+		xio_stat_sets_destroy(ctx);
 	xio_workqueue_destroy(ctx->workqueue);
 
 cleanup1:
@@ -361,6 +381,8 @@ void xio_destroy_context_continue(struct work_struct *work)
 
 	for (i = 0; i < XIO_STAT_LAST; i++)
 		kfree(ctx->stats.name[i]);
+	xio_flight_destroy(ctx);
+	xio_stat_sets_destroy(ctx);
 
 	xio_workqueue_destroy(ctx->workqueue);
 	xio_objpool_destroy(ctx->msg_pool);
@@ -384,6 +406,9 @@ void xio_destroy_context_continue(struct work_struct *work)
 		ctx->mempool = NULL;
 	}
 
+	if (ctx->cq)
+		xio_context_kfree(ctx, ctx->cq);
+
 	xio_context_kfree(NULL, ctx);
 }
 EXPORT_SYMBOL(xio_destroy_context_continue);
@@ -356,6 +356,8 @@ typedef pthread_once_t		thread_once_t;
 	__sync_fetch_and_add((ptr), (value))
 #define  xio_sync_fetch_and_add64(ptr, value) \
 	__sync_fetch_and_add((ptr), (value))
+#define xio_smp_wmb()		__atomic_thread_fence(__ATOMIC_RELEASE)
+#define xio_smp_rmb()		__atomic_thread_fence(__ATOMIC_ACQUIRE)
 
 /*---------------------------------------------------------------------------*/
 #define XIO_F_ALWAYS_INLINE inline __attribute__((always_inline))
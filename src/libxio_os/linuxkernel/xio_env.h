@@ -57,10 +57,21 @@
 	__sync_fetch_and_add((ptr), (value))
 #define  xio_sync_fetch_and_add64(ptr, value) \
 	__sync_fetch_and_add((ptr), (value))
+#define xio_smp_wmb()		smp_wmb()
+#define xio_smp_rmb()		smp_rmb()
 
 /*---------------------------------------------------------------------------*/
 #define XIO_F_ALWAYS_INLINE inline __attribute__ ((always_inline))
 
+/*---------------------------------------------------------------------------*/
+/*------------------- CPU and Clock related things --------------------------*/
+/*---------------------------------------------------------------------------*/
+static inline int xio_clock_gettime(struct timespec *ts)
+{
+	ktime_get_ts(ts);
+	return 0;
+}
+
 /*---------------------------------------------------------------------------*/
 /*-------------------- Socket related things --------------------------------*/
 /*---------------------------------------------------------------------------*/
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define REQ_MAX			512
+#define REPLY_MAX		8192
+#define REPLY_TIMEOUT_MS	2000
+
+/*---------------------------------------------------------------------------*/
+/* usage								     */
+/*---------------------------------------------------------------------------*/
+static void usage(const char *app)
+{
+	printf("usage: %s socket request...\n", app);
+	printf("\tsends a request to a context opened by\n");
+	printf("\txio_context_open_control and prints the reply, e.g.\n");
+	printf("\t%s /tmp/app.ctl options\n", app);
+	printf("\t%s /tmp/app.ctl set max_inline_xio_data 4096\n", app);
+	printf("\t%s /tmp/app.ctl conn 0x1e3f010 set comp_max_msgs 16\n",
+	       app);
+}
+
+int main(int argc, char **argv)
+{
+	struct sockaddr_un	addr;
+	struct pollfd		pfd;
+	char			req[REQ_MAX];
+	char			reply[REPLY_MAX];
+	size_t			len = 0;
+	ssize_t			n;
+	int			i, fd, retval = 1;
+
+	if (argc < 3 || strlen(argv[1]) >= sizeof(addr.sun_path)) {
+		usage(argv[0]);
+		return 1;
+	}
+	for (i = 2; i < argc; i++) {
+		n = snprintf(req + len, sizeof(req) - len, "%s%s",
+			     i > 2 ? " " : "", argv[i]);
+		if (n < 0 || (size_t)n >= sizeof(req) - len) {
+			fprintf(stderr, "request too long\n");
+			return 1;
+		}
+		len += n;
+	}
+
+	fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		perror("socket");
+		return 1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	/* autobind to an abstract address the reply comes back to */
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(sa_family_t))) {
+		perror("bind");
+		goto cleanup;
+	}
+	strcpy(addr.sun_path, argv[1]);
+	if (sendto(fd, req, len, 0, (struct sockaddr *)&addr,
+		   sizeof(addr)) < 0) {
+		fprintf(stderr, "%s: %s\n", argv[1], strerror(errno));
+		goto cleanup;
+	}
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, REPLY_TIMEOUT_MS) <= 0) {
+		fprintf(stderr, "%s: no reply\n", argv[1]);
+		goto cleanup;
+	}
+	n = recv(fd, reply, sizeof(reply), 0);
+	if (n < 0) {
+		perror("recv");
+		goto cleanup;
+	}
+	fwrite(reply, 1, n, stdout);
+	retval = strncmp(reply, "error", 5) ? 0 : 2;
+
+cleanup:
+	close(fd);
+	return retval;
+}
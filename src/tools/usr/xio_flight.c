@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include "libxio.h"
+#include "xio_flight.h"
+
+#define ARRAY_LEN(a)		(sizeof(a) / sizeof((a)[0]))
+
+static const char * const event_str[] = {
+	"session", "transport", "msg_error", "keepalive", "queues"
+};
+
+/* enum xio_connection_state */
+static const char * const connection_state_str[] = {
+	"INIT", "ESTABLISHED", "ONLINE", "FIN_WAIT_1", "FIN_WAIT_2",
+	"CLOSING", "TIME_WAIT", "CLOSE_WAIT", "LAST_ACK", "CLOSED",
+	"DISCONNECTED", "ERROR", "INVALID"
+};
+
+/* enum xio_nexus_state */
+static const char * const nexus_state_str[] = {
+	"INIT", "OPEN", "LISTEN", "CONNECTING", "CONNECTED", "REJECTED",
+	"CLOSED", "DISCONNECTED", "RECONNECT", "ERROR"
+};
+
+/* enum xio_transport_event */
+static const char * const transport_event_str[] = {
+	"new connection", "established", "disconnecting", "disconnected",
+	"closed", "refused", "new message", "send completion",
+	"assign in buf", "message error", "error", "direct rdma completion"
+};
+
+/*---------------------------------------------------------------------------*/
+/* str									     */
+/*---------------------------------------------------------------------------*/
+static const char *str(const char * const *names, size_t n, uint32_t i)
+{
+	return i < n ? names[i] : "?";
+}
+
+/*---------------------------------------------------------------------------*/
+/* cycles_to_ns								     */
+/*---------------------------------------------------------------------------*/
+static uint64_t cycles_to_ns(uint64_t cycles, uint64_t hertz)
+{
+	if (!hertz)
+		return cycles;
+
+	return (cycles / hertz) * 1000000000ULL +
+	       (cycles % hertz) * 1000000000ULL / hertz;
+}
+
+/*---------------------------------------------------------------------------*/
+/* rec_print								     */
+/*---------------------------------------------------------------------------*/
+static void rec_print(const struct xio_flight_dump *dump,
+		      const struct xio_flight_rec *rec)
+{
+	uint64_t	ago = 0;
+	const char	*state;
+
+	/* records are older than the dump, a torn one may not be */
+	if (dump->cycles > rec->cycles)
+		ago = cycles_to_ns(dump->cycles - rec->cycles, dump->hertz);
+	if (rec->event == XIO_FLIGHT_TRANSPORT_EVENT)
+		state = str(nexus_state_str, ARRAY_LEN(nexus_state_str),
+			    rec->state);
+	else
+		state = str(connection_state_str,
+			    ARRAY_LEN(connection_state_str), rec->state);
+
+	printf("-%llu.%06llus %-9s 0x%012llx %-12s ",
+	       (unsigned long long)(ago / 1000000000ULL),
+	       (unsigned long long)(ago % 1000000000ULL / 1000),
+	       str(event_str, ARRAY_LEN(event_str), rec->event),
+	       (unsigned long long)rec->obj, state);
+
+	switch (rec->event) {
+	case XIO_FLIGHT_SESSION_EVENT:
+		printf("%s, reason: %s\n",
+		       xio_session_event_str((enum xio_session_event)rec->a),
+		       xio_strerror(rec->b));
+		break;
+	case XIO_FLIGHT_TRANSPORT_EVENT:
+		printf("%s", str(transport_event_str,
+				 ARRAY_LEN(transport_event_str), rec->a));
+		if (rec->b)
+			printf(", reason: %s", xio_strerror(rec->b));
+		printf("\n");
+		break;
+	case XIO_FLIGHT_MSG_ERROR:
+		printf("%s message sn:%u failed, reason: %s\n",
+		       rec->b == XIO_MSG_DIRECTION_IN ? "incoming" : "outgoing",
+		       rec->c, xio_strerror(rec->a));
+		break;
+	case XIO_FLIGHT_KA_TIMEOUT:
+		printf("keepalive timeout, probe %u/%u\n", rec->a, rec->b);
+		break;
+	case XIO_FLIGHT_QUEUES:
+		printf("queued:%u credits:%u peer credits:%u\n",
+		       rec->a, rec->b, rec->c);
+		break;
+	default:
+		printf("a:%u b:%u c:%u\n", rec->a, rec->b, rec->c);
+		break;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* decode								     */
+/*---------------------------------------------------------------------------*/
+static int decode(const char *file, uint64_t obj)
+{
+	struct xio_flight_dump	dump;
+	struct xio_flight_rec	rec;
+	struct tm		tm;
+	time_t			sec;
+	char			when[32];
+	FILE			*fp;
+	uint32_t		i;
+	int			retval = -1;
+
+	fp = fopen(file, "rb");
+	if (!fp) {
+		fprintf(stderr, "%s: %s\n", file, strerror(errno));
+		return -1;
+	}
+	if (fread(&dump, sizeof(dump), 1, fp) != 1 ||
+	    dump.magic != XIO_FLIGHT_MAGIC) {
+		fprintf(stderr, "%s: not a flight recorder dump\n", file);
+		goto cleanup;
+	}
+	if (dump.version != XIO_FLIGHT_VERSION ||
+	    dump.rec_size != sizeof(rec)) {
+		fprintf(stderr, "%s: unsupported version %u\n", file,
+			dump.version);
+		goto cleanup;
+	}
+
+	sec = (time_t)(dump.time_ns / 1000000000ULL);
+	localtime_r(&sec, &tm);
+	strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+	printf("%s: pid %d context %u cpu %d, dumped %s.%06llu, "
+	       "%u of %llu records\n", file, dump.pid, dump.ctx_id,
+	       dump.cpuid, when,
+	       (unsigned long long)(dump.time_ns % 1000000000ULL / 1000),
+	       dump.nrecs, (unsigned long long)dump.head);
+
+	for (i = 0; i < dump.nrecs; i++) {
+		if (fread(&rec, sizeof(rec), 1, fp) != 1) {
+			fprintf(stderr, "%s: truncated after %u records\n",
+				file, i);
+			goto cleanup;
+		}
+		if (!obj || rec.obj == obj)
+			rec_print(&dump, &rec);
+	}
+	retval = 0;
+
+cleanup:
+	fclose(fp);
+	return retval;
+}
+
+/*---------------------------------------------------------------------------*/
+/* usage								     */
+/*---------------------------------------------------------------------------*/
+static void usage(const char *app)
+{
+	printf("usage: %s [-o object] dump...\n", app);
+	printf("\tdecodes $XDG_RUNTIME_DIR (or %s)/%s<pid>.<ctx> files\n",
+	       XIO_FLIGHT_DUMP_DIR, XIO_FLIGHT_DUMP_PREFIX);
+	printf("\twritten on signal, on error or by xio_context_dump_flight,\n");
+	printf("\toldest record first\n");
+	printf("\t-o\tonly the records of this connection or nexus\n");
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t	obj = 0;
+	int		c, retval = 0;
+
+	while ((c = getopt(argc, argv, "o:h")) != -1) {
+		switch (c) {
+		case 'o':
+			obj = strtoull(optarg, NULL, 16);
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+	if (optind == argc) {
+		usage(argv[0]);
+		return 1;
+	}
+	for (; optind < argc; optind++)
+		if (decode(argv[optind], obj))
+			retval = 1;
+
+	return retval;
+}
@@ -53,6 +53,7 @@
 #include "xio_workqueue.h"
 #include "xio_context.h"
 #include "xio_nexus.h"
+#include "xio_stats.h"
 #include "xio_connection.h"
 #include "xio_session.h"
 
@@ -76,8 +77,366 @@
 	printf(" %6lu\n", sizeof(type)); \
 }
 
+#define CACHE_LINE(off)		((off) / L1_CACHE_BYTES)
+
+#define PRINT_OFFSET(type, field) \
+{ \
+	int i; \
+	size_t off = offsetof(type, field); \
+	size_t sz = sizeof(((type *)0)->field); \
+	       \
+	printf("    %s%n = ", #field, &i); \
+	while (i++ < 48) { \
+		printf("."); \
+	} \
+	printf(" %6lu %6lu   [%lu-%lu]\n", off, sz, \
+	       CACHE_LINE(off), CACHE_LINE(off + sz - 1)); \
+}
+
+static void print_task_layout(void)
+{
+	printf("\nstruct xio_task layout:%*s offset   size   cache lines\n",
+	       30, "");
+	PRINT_OFFSET(struct xio_task, tasks_list_entry);
+	PRINT_OFFSET(struct xio_task, dd_data);
+	PRINT_OFFSET(struct xio_task, pool);
+	PRINT_OFFSET(struct xio_task, context);
+	PRINT_OFFSET(struct xio_task, sender_task);
+	PRINT_OFFSET(struct xio_task, omsg);
+	PRINT_OFFSET(struct xio_task, connection);
+	PRINT_OFFSET(struct xio_task, session);
+	PRINT_OFFSET(struct xio_task, nexus);
+	PRINT_OFFSET(struct xio_task, stag);
+	PRINT_OFFSET(struct xio_task, state);
+	PRINT_OFFSET(struct xio_task, kref);
+	PRINT_OFFSET(struct xio_task, tlv_type);
+	PRINT_OFFSET(struct xio_task, ltid);
+	PRINT_OFFSET(struct xio_task, rtid);
+	PRINT_OFFSET(struct xio_task, status);
+	PRINT_OFFSET(struct xio_task, omsg_flags);
+	PRINT_OFFSET(struct xio_task, imsg_flags);
+	PRINT_OFFSET(struct xio_task, is_control);
+	PRINT_OFFSET(struct xio_task, last_in_rxq);
+	PRINT_OFFSET(struct xio_task, mbuf);
+	PRINT_OFFSET(struct xio_task, imsg);
+	PRINT_OFFSET(struct xio_task, in_receipt);
+	PRINT_OFFSET(struct xio_task, unassign_data_in_buf);
+	PRINT_OFFSET(struct xio_task, unassign_user_context);
+	PRINT_OFFSET(struct xio_task, slab);
+	PRINT_OFFSET(struct xio_task, magic);
+	printf("    hot fields (tasks_list_entry..last_in_rxq) span %lu "
+	       "cache line(s)\n",
+	       CACHE_LINE(offsetof(struct xio_task, last_in_rxq)) + 1);
+}
+
+struct mem_test_data {
+	struct xio_context	*ctx;
+	int			established_nr;
+	int			teardown_nr;
+};
+
+struct mem_server_data {
+	struct mem_test_data	test_data;
+	const char		*uri;
+	int			lean;
+	int			conns_nr;
+	volatile int		ready;
+	volatile int		stop;
+};
+
+static void print_mem_stats(struct xio_context *ctx, const char *title,
+			    int conns_nr)
+{
+	struct xio_context_attr	attr;
+	uint64_t		total = 0;
+	int			i;
+
+	memset(&attr, 0, sizeof(attr));
+	if (xio_query_context(ctx, &attr, XIO_CONTEXT_ATTR_MEM_STATS)) {
+		fprintf(stderr, "xio_query_context failed. %s\n",
+			xio_strerror(xio_errno()));
+		return;
+	}
+
+	printf("\n%s:\n", title);
+	printf("    %-16s %14s %10s %14s\n", "class", "bytes", "objs",
+	       "peak bytes");
+	for (i = 0; i < XIO_MEM_CLASS_LAST; i++) {
+		printf("    %-16s %14llu %10llu %14llu\n",
+		       xio_mem_class_str((enum xio_mem_class)i),
+		       (unsigned long long)attr.mem_stats[i].bytes,
+		       (unsigned long long)attr.mem_stats[i].objs,
+		       (unsigned long long)attr.mem_stats[i].peak_bytes);
+		total += attr.mem_stats[i].bytes;
+	}
+	printf("    %-16s %14llu\n", "total", (unsigned long long)total);
+	if (conns_nr)
+		printf("    %-16s %14llu\n", "per connection",
+		       (unsigned long long)(total / conns_nr));
+}
+
+static struct xio_context *mem_context_create(int lean, int conns_nr)
+{
+	struct xio_context_params	ctx_params;
+
+	memset(&ctx_params, 0, sizeof(ctx_params));
+	ctx_params.max_conns_per_ctx	= conns_nr;
+	ctx_params.lean_conns		= lean;
+
+	return xio_context_create(&ctx_params, 0, -1);
+}
+
+static int on_session_event(struct xio_session *session,
+			    struct xio_session_event_data *event_data,
+			    void *cb_user_context)
+{
+	struct mem_test_data *test_data =
+				(struct mem_test_data *)cb_user_context;
+
+	switch (event_data->event) {
+	case XIO_SESSION_CONNECTION_ESTABLISHED_EVENT:
+		test_data->established_nr++;
+		break;
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		xio_connection_destroy(event_data->conn);
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		test_data->teardown_nr++;
+		xio_session_destroy(session);
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+static int on_server_session_event(struct xio_session *session,
+				   struct xio_session_event_data *event_data,
+				   void *cb_user_context)
+{
+	struct mem_test_data *test_data =
+				(struct mem_test_data *)cb_user_context;
+
+	switch (event_data->event) {
+	case XIO_SESSION_NEW_CONNECTION_EVENT:
+		test_data->established_nr++;
+		break;
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		xio_connection_destroy(event_data->conn);
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		test_data->teardown_nr++;
+		xio_session_destroy(session);
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+static int on_new_session(struct xio_session *session,
+			  struct xio_new_session_req *req,
+			  void *cb_user_context)
+{
+	return xio_accept(session, NULL, 0, NULL, 0);
+}
+
+/* run the loop until cnt reaches nr or ~5 seconds (+100ms/conn) elapse */
+static void run_loop_until(struct xio_context *ctx, int *cnt, int nr)
+{
+	int i;
+
+	for (i = 0; i < 50 + nr && *cnt < nr; i++)
+		xio_context_run_loop(ctx, 100);
+}
+
+/* in process server - accepts every session on its own context */
+static void *mem_server_thread(void *arg)
+{
+	struct mem_server_data	*sdata = (struct mem_server_data *)arg;
+	struct xio_session_ops	ses_ops;
+	struct xio_server	*server;
+
+	memset(&ses_ops, 0, sizeof(ses_ops));
+	ses_ops.on_session_event = on_server_session_event;
+	ses_ops.on_new_session	 = on_new_session;
+
+	sdata->test_data.ctx = mem_context_create(sdata->lean, sdata->conns_nr);
+	if (!sdata->test_data.ctx) {
+		sdata->ready = -1;
+		return NULL;
+	}
+	server = xio_bind(sdata->test_data.ctx, &ses_ops, sdata->uri,
+			  NULL, 0, &sdata->test_data);
+	if (!server) {
+		fprintf(stderr, "xio_bind failed. %s\n",
+			xio_strerror(xio_errno()));
+		xio_context_destroy(sdata->test_data.ctx);
+		sdata->ready = -1;
+		return NULL;
+	}
+	sdata->ready = 1;
+
+	while (!sdata->stop)
+		xio_context_run_loop(sdata->test_data.ctx, 100);
+
+	xio_unbind(server);
+	xio_context_destroy(sdata->test_data.ctx);
+
+	return NULL;
+}
+
+/* open conns_nr client sessions and dump the live accounting */
+static int dump_live_usage(const char *uri, int conns_nr, int lean,
+			   int local_server)
+{
+	struct xio_session_ops		ses_ops;
+	struct xio_session_params	params;
+	struct xio_connection_params	cparams;
+	struct mem_test_data		test_data;
+	struct mem_server_data		sdata;
+	struct xio_connection		**conns;
+	pthread_t			server_thread;
+	int				i;
+
+	conns = (struct xio_connection **)calloc(conns_nr, sizeof(*conns));
+	if (!conns)
+		return -1;
+
+	xio_init();
+
+	memset(&sdata, 0, sizeof(sdata));
+	if (local_server) {
+		sdata.uri	= uri;
+		sdata.lean	= lean;
+		sdata.conns_nr	= conns_nr;
+		if (pthread_create(&server_thread, NULL,
+				   mem_server_thread, &sdata)) {
+			free(conns);
+			xio_shutdown();
+			return -1;
+		}
+		while (!sdata.ready)
+			usleep(1000);
+		if (sdata.ready < 0) {
+			pthread_join(server_thread, NULL);
+			free(conns);
+			xio_shutdown();
+			return -1;
+		}
+	}
+
+	memset(&test_data, 0, sizeof(test_data));
+	test_data.ctx = mem_context_create(lean, conns_nr);
+	if (!test_data.ctx) {
+		fprintf(stderr, "context creation failed. %s\n",
+			xio_strerror(xio_errno()));
+		i = 0;
+		goto stop_server;
+	}
+	print_mem_stats(test_data.ctx, "Idle context", 0);
+
+	memset(&ses_ops, 0, sizeof(ses_ops));
+	ses_ops.on_session_event = on_session_event;
+
+	for (i = 0; i < conns_nr; i++) {
+		struct xio_session *session;
+
+		memset(&params, 0, sizeof(params));
+		params.type		= XIO_SESSION_CLIENT;
+		params.ses_ops		= &ses_ops;
+		params.user_context	= &test_data;
+		params.uri		= uri;
+
+		session = xio_session_create(&params);
+		if (!session)
+			break;
+
+		memset(&cparams, 0, sizeof(cparams));
+		cparams.session			= session;
+		cparams.ctx			= test_data.ctx;
+		cparams.conn_user_context	= &test_data;
+
+		conns[i] = xio_connect(&cparams);
+		if (!conns[i]) {
+			xio_session_destroy(session);
+			break;
+		}
+	}
+	conns_nr = i;
+
+	run_loop_until(test_data.ctx, &test_data.established_nr, conns_nr);
+	printf("\n%d of %d %sconnections established to %s\n",
+	       test_data.established_nr, conns_nr, lean ? "lean " : "", uri);
+	print_mem_stats(test_data.ctx, "Connected",
+			test_data.established_nr);
+	if (local_server)
+		print_mem_stats(sdata.test_data.ctx, "Server",
+				sdata.test_data.established_nr);
+	if (lean) {
+		/* idle pools shrink after two quiet 5 second windows */
+		xio_context_run_loop(test_data.ctx, 11000);
+		print_mem_stats(test_data.ctx, "Connected, idle",
+				test_data.established_nr);
+		if (local_server)
+			print_mem_stats(sdata.test_data.ctx, "Server, idle",
+					sdata.test_data.established_nr);
+	}
+
+	for (i = 0; i < conns_nr; i++)
+		xio_disconnect(conns[i]);
+	run_loop_until(test_data.ctx, &test_data.teardown_nr, conns_nr);
+	print_mem_stats(test_data.ctx, "Disconnected", 0);
+
+	xio_context_destroy(test_data.ctx);
+	i = 1;
+
+stop_server:
+	if (local_server) {
+		sdata.stop = 1;
+		pthread_join(server_thread, NULL);
+	}
+	xio_shutdown();
+	free(conns);
+
+	return i ? 0 : -1;
+}
+
+static void usage(const char *app)
+{
+	printf("usage: %s [-l] [-s] <uri> [connections]\n", app);
+	printf("\t-l\tlean connections mode\n");
+	printf("\t-s\taccept the connections in process\n");
+	printf("without arguments the structures sizes are printed\n");
+}
+
 int main(int argc, char **argv)
 {
+	int lean = 0, local_server = 0, c;
+
+	while ((c = getopt(argc, argv, "lsh")) != -1) {
+		switch (c) {
+		case 'l':
+			lean = 1;
+			break;
+		case 's':
+			local_server = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+	if (optind < argc) {
+		/* live accounting: xio_mem_usage [-l] [-s] <uri> [conns] */
+		return dump_live_usage(argv[optind],
+				       optind + 1 < argc ?
+				       atoi(argv[optind + 1]) : 1,
+				       lean, local_server) ? 1 : 0;
+	}
+
 	printf("\nAPI and Core:\n");
 	PRINT_SIZE(struct xio_context);
 	PRINT_SIZE(struct xio_connection);
@@ -117,6 +476,8 @@ int main(int argc, char **argv)
 	PRINT_SIZE(struct xio_tcp_transport);
 	PRINT_SIZE(struct xio_tcp_work_req);
 
+	print_task_layout();
+
 	printf("\n");
 	return 0;
 }
@@ -0,0 +1,507 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include "libxio.h"
+#include "xio_stats_shm.h"
+
+#define MAX_SEGMENTS		1024
+#define MAX_NAMES		64
+#define SNAPSHOT_RETRIES	1000
+#define RESCAN_NS		1000000000ULL
+#define SEGMENT_LEN		(sizeof(struct xio_stats_shm) + \
+				 XIO_STATS_SHM_REG_SIZE)
+
+struct segment {
+	struct xio_stats_shm	*shm;
+	char			file[64];
+	uint64_t		prev[XIO_STATS_SHM_COUNTERS];
+	int			has_prev;
+	int			seen;
+};
+
+struct total {
+	char			name[XIO_STATS_SHM_NAME_LEN];
+	uint64_t		value;
+	uint64_t		delta;
+};
+
+static struct segment	segments[MAX_SEGMENTS];
+static int		nsegments;
+static struct total	totals[MAX_NAMES];
+static int		ntotals;
+static volatile int	stop;
+static char		*registry;
+
+static const char * const scope_str[] = {
+	"context", "session", "connection", "nexus"
+};
+
+/*---------------------------------------------------------------------------*/
+/* now_ns								     */
+/*---------------------------------------------------------------------------*/
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*---------------------------------------------------------------------------*/
+/* snapshot								     */
+/*---------------------------------------------------------------------------*/
+/* copy the counters between two equal even sequence numbers */
+static int snapshot(const struct xio_stats_shm *shm, uint64_t *counter)
+{
+	uint32_t seq;
+	int	 retries = SNAPSHOT_RETRIES;
+
+	do {
+		seq = __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+		memcpy(counter, (const void *)shm->counter,
+		       sizeof(shm->counter));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&shm->seq, __ATOMIC_RELAXED) == seq)
+			return 0;
+	} while (--retries);
+
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* registry_snapshot							     */
+/*---------------------------------------------------------------------------*/
+/* copy the exported registry between two equal even sequence numbers */
+static int registry_snapshot(const struct xio_stats_shm *shm, char *buf,
+			     uint32_t *nr, uint32_t *len)
+{
+	uint32_t seq;
+	int	 retries = SNAPSHOT_RETRIES;
+
+	do {
+		seq = __atomic_load_n(&shm->reg_seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+		*nr	= shm->reg_nr;
+		*len	= shm->reg_len;
+		if (*len > XIO_STATS_SHM_REG_SIZE)
+			continue;
+		memcpy(buf, (const void *)(shm + 1), *len);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&shm->reg_seq, __ATOMIC_RELAXED) == seq)
+			return 0;
+	} while (--retries);
+
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* hist_quantile							     */
+/*---------------------------------------------------------------------------*/
+/* upper bound of the bucket holding the q quantile */
+static uint64_t hist_quantile(const uint64_t *buckets, uint64_t samples,
+			      double q)
+{
+	uint64_t acc = 0;
+	int	 i;
+
+	for (i = 0; i < XIO_STAT_HIST_BUCKETS; i++) {
+		acc += buckets[i];
+		if (acc && acc >= q * samples)
+			return i ? (1ULL << (i - 1)) * 2 - 1 : 0;
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* registry_print							     */
+/*---------------------------------------------------------------------------*/
+static void registry_print(double elapsed)
+{
+	const struct xio_stats_shm_entry	*entry;
+	struct segment				*seg;
+	uint32_t				nr, len, off, k;
+	int					i;
+
+	for (i = 0; i < nsegments; i++) {
+		seg = &segments[i];
+		if (registry_snapshot(seg->shm, registry, &nr, &len))
+			continue;
+		for (off = 0, k = 0; k < nr && off < len; k++) {
+			entry = (const struct xio_stats_shm_entry *)
+				(registry + off);
+			if (entry->len < sizeof(*entry) ||
+			    entry->len > len - off)
+				break;
+			off += entry->len;
+			printf("%.6f %d.%u %s:0x%llx %.*s", elapsed,
+			       seg->shm->pid, seg->shm->ctx_id,
+			       entry->scope < 4 ? scope_str[entry->scope] :
+			       "unknown",
+			       (unsigned long long)entry->owner,
+			       XIO_STATS_SHM_NAME_LEN, entry->name);
+			if (entry->type == XIO_STAT_TYPE_LATENCY &&
+			    entry->len >= sizeof(*entry) +
+					  sizeof(struct xio_latency_stats)) {
+				const struct xio_latency_stats *lat =
+					(const struct xio_latency_stats *)
+					entry->buckets;
+
+				printf(" samples=%llu mean=%lluns p50=%lluns "
+				       "p99=%lluns p99.9=%lluns max=%lluns\n",
+				       (unsigned long long)lat->samples,
+				       (unsigned long long)lat->mean_ns,
+				       (unsigned long long)lat->p50_ns,
+				       (unsigned long long)lat->p99_ns,
+				       (unsigned long long)lat->p999_ns,
+				       (unsigned long long)lat->max_ns);
+				continue;
+			}
+			if (entry->type != XIO_STAT_TYPE_HISTOGRAM) {
+				printf("=%llu\n",
+				       (unsigned long long)entry->value);
+				continue;
+			}
+			printf(" samples=%llu avg=%.1f p50<=%llu p99<=%llu\n",
+			       (unsigned long long)entry->value,
+			       entry->value ?
+			       (double)entry->sum / entry->value : 0.0,
+			       (unsigned long long)hist_quantile(
+					entry->buckets, entry->value, 0.5),
+			       (unsigned long long)hist_quantile(
+					entry->buckets, entry->value, 0.99));
+		}
+		if (seg->shm->reg_dropped)
+			printf("%.6f %d.%u dropped=%u\n", elapsed,
+			       seg->shm->pid, seg->shm->ctx_id,
+			       seg->shm->reg_dropped);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* segment_attach							     */
+/*---------------------------------------------------------------------------*/
+static struct xio_stats_shm *segment_attach(const char *file, pid_t pid_only)
+{
+	struct xio_stats_shm	*shm;
+	char			path[sizeof(XIO_STATS_SHM_DIR) + 64];
+	int			fd;
+
+	strcpy(path, XIO_STATS_SHM_DIR "/");
+	strcat(path, file);
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+	shm = (struct xio_stats_shm *)mmap(NULL, SEGMENT_LEN, PROT_READ,
+					   MAP_SHARED, fd, 0);
+	close(fd);
+	if (shm == MAP_FAILED)
+		return NULL;
+
+	/* not ready yet or other layout */
+	if (__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) !=
+	    XIO_STATS_SHM_MAGIC ||
+	    shm->version != XIO_STATS_SHM_VERSION ||
+	    shm->size < sizeof(*shm) ||
+	    shm->ncounters > XIO_STATS_SHM_COUNTERS ||
+	    shm->reg_size > XIO_STATS_SHM_REG_SIZE ||
+	    (pid_only && shm->pid != pid_only)) {
+		munmap(shm, SEGMENT_LEN);
+		return NULL;
+	}
+	/* left by a process that died - the owner's user may remove it */
+	if (kill(shm->pid, 0) && errno == ESRCH) {
+		munmap(shm, SEGMENT_LEN);
+		unlink(path);
+		return NULL;
+	}
+
+	return shm;
+}
+
+/*---------------------------------------------------------------------------*/
+/* rescan								     */
+/*---------------------------------------------------------------------------*/
+static void rescan(pid_t pid_only)
+{
+	struct dirent	*ent;
+	DIR		*dir;
+	int		i;
+
+	for (i = 0; i < nsegments; i++)
+		segments[i].seen = 0;
+
+	dir = opendir(XIO_STATS_SHM_DIR);
+	if (!dir)
+		return;
+	while ((ent = readdir(dir))) {
+		if (strncmp(ent->d_name, XIO_STATS_SHM_PREFIX,
+			    strlen(XIO_STATS_SHM_PREFIX)) ||
+		    strlen(ent->d_name) >= sizeof(segments[0].file))
+			continue;
+		for (i = 0; i < nsegments; i++) {
+			if (!strcmp(segments[i].file, ent->d_name)) {
+				segments[i].seen = 1;
+				break;
+			}
+		}
+		if (i < nsegments || nsegments == MAX_SEGMENTS)
+			continue;
+
+		segments[nsegments].shm = segment_attach(ent->d_name, pid_only);
+		if (!segments[nsegments].shm)
+			continue;
+		strcpy(segments[nsegments].file, ent->d_name);
+		segments[nsegments].has_prev = 0;
+		segments[nsegments].seen = 1;
+		nsegments++;
+	}
+	closedir(dir);
+
+	/* the owning contexts were destroyed */
+	for (i = 0; i < nsegments; i++) {
+		if (segments[i].seen)
+			continue;
+		munmap(segments[i].shm, SEGMENT_LEN);
+		segments[i--] = segments[--nsegments];
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* total_get								     */
+/*---------------------------------------------------------------------------*/
+static struct total *total_get(const char *name)
+{
+	int i;
+
+	for (i = 0; i < ntotals; i++)
+		if (!strncmp(totals[i].name, name, XIO_STATS_SHM_NAME_LEN))
+			return &totals[i];
+	if (ntotals == MAX_NAMES)
+		return NULL;
+	strncpy(totals[ntotals].name, name, XIO_STATS_SHM_NAME_LEN - 1);
+
+	return &totals[ntotals++];
+}
+
+/*---------------------------------------------------------------------------*/
+/* sample								     */
+/*---------------------------------------------------------------------------*/
+static void sample(double elapsed, double period, int per_context,
+		   int print_totals)
+{
+	uint64_t	counter[XIO_STATS_SHM_COUNTERS];
+	char		name[XIO_STATS_SHM_NAME_LEN];
+	struct segment	*seg;
+	struct total	*total;
+	int		i, j, ncontexts = 0;
+
+	for (i = 0; i < ntotals; i++)
+		totals[i].value = totals[i].delta = 0;
+
+	for (i = 0; i < nsegments; i++) {
+		seg = &segments[i];
+		if (snapshot(seg->shm, counter))
+			continue;
+		ncontexts++;
+		if (per_context)
+			printf("%.6f %d.%u", elapsed, seg->shm->pid,
+			       seg->shm->ctx_id);
+		for (j = 0; j < seg->shm->ncounters; j++) {
+			memcpy(name, (const void *)seg->shm->name[j],
+			       sizeof(name));
+			name[sizeof(name) - 1] = '\0';
+			if (!name[0])
+				continue;
+			if (per_context) {
+				if (print_totals)
+					printf(" %s=%llu", name,
+					       (unsigned long long)counter[j]);
+				else
+					printf(" %s=%.0f", name,
+					       seg->has_prev ?
+					       (counter[j] - seg->prev[j]) /
+					       period : 0.0);
+				continue;
+			}
+			total = total_get(name);
+			if (!total)
+				continue;
+			total->value += counter[j];
+			if (seg->has_prev)
+				total->delta += counter[j] - seg->prev[j];
+		}
+		if (per_context)
+			printf("\n");
+		memcpy(seg->prev, counter, sizeof(seg->prev));
+		seg->has_prev = 1;
+	}
+	if (per_context)
+		return;
+
+	printf("%.6f contexts=%d", elapsed, ncontexts);
+	for (i = 0; i < ntotals; i++) {
+		if (print_totals)
+			printf(" %s=%llu", totals[i].name,
+			       (unsigned long long)totals[i].value);
+		else
+			printf(" %s=%.0f", totals[i].name,
+			       totals[i].delta / period);
+	}
+	printf("\n");
+}
+
+/*---------------------------------------------------------------------------*/
+/* on_signal								     */
+/*---------------------------------------------------------------------------*/
+static void on_signal(int sig)
+{
+	stop = 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* usage								     */
+/*---------------------------------------------------------------------------*/
+static void usage(const char *app)
+{
+	printf("usage: %s [-i interval_us] [-n samples] [-p pid] [-c] [-t] "
+	       "[-r]\n", app);
+	printf("\t-i\tsampling interval in microseconds (default 1000000)\n");
+	printf("\t-n\tnumber of samples, 0 - till interrupted (default 0)\n");
+	printf("\t-p\tonly the contexts of this process\n");
+	printf("\t-c\ta line per context instead of host totals\n");
+	printf("\t-t\tprint counter values instead of rates per second\n");
+	printf("\t-r\talso print the session, connection and nexus "
+	       "statistics\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct timespec	next;
+	uint64_t	interval_ns = 1000000000ULL;
+	uint64_t	start, last, last_scan, now;
+	long		samples = 0, n;
+	pid_t		pid_only = 0;
+	int		per_context = 0, print_totals = 0, print_reg = 0, c;
+
+	while ((c = getopt(argc, argv, "i:n:p:ctrh")) != -1) {
+		switch (c) {
+		case 'i':
+			interval_ns = strtoull(optarg, NULL, 0) * 1000ULL;
+			break;
+		case 'n':
+			samples = strtol(optarg, NULL, 0);
+			break;
+		case 'p':
+			pid_only = (pid_t)strtol(optarg, NULL, 0);
+			break;
+		case 'c':
+			per_context = 1;
+			break;
+		case 't':
+			print_totals = 1;
+			break;
+		case 'r':
+			print_reg = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+	if (!interval_ns) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (print_reg) {
+		registry = (char *)malloc(XIO_STATS_SHM_REG_SIZE);
+		if (!registry) {
+			perror("malloc");
+			return 1;
+		}
+	}
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	rescan(pid_only);
+	start = last = last_scan = now_ns();
+	/* first sample sets the base for the rates */
+	sample(0, 1, per_context, 1);
+	fflush(stdout);
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	for (n = 0; !stop && (!samples || n < samples); n++) {
+		next.tv_nsec += interval_ns % 1000000000ULL;
+		next.tv_sec += interval_ns / 1000000000ULL +
+			       next.tv_nsec / 1000000000L;
+		next.tv_nsec %= 1000000000L;
+		if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next,
+				    NULL) == EINTR)
+			break;
+		now = now_ns();
+		sample((now - start) / 1e9, (now - last) / 1e9, per_context,
+		       print_totals);
+		if (print_reg)
+			registry_print((now - start) / 1e9);
+		last = now;
+		/* directory scans are slow - not on every sample */
+		if (now - last_scan >= RESCAN_NS) {
+			rescan(pid_only);
+			last_scan = now;
+		}
+		fflush(stdout);
+	}
+	free(registry);
+
+	return 0;
+}
@@ -21,6 +21,10 @@
 #define __ALIGN_XIO(x, a)		__ALIGN_XIO_MASK(x, (typeof(x))(a)-1)
 #define ALIGN(x, a)			__ALIGN_XIO((x), (a))
 
+#ifndef L1_CACHE_BYTES
+#define L1_CACHE_BYTES			64
+#endif
+
 #ifndef roundup
 # define roundup(x, y)  ((((x) + ((y) - 1)) / (y)) * (y))
 #endif /* !defined(roundup) */
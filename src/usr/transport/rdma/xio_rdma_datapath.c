@@ -391,6 +391,8 @@ static int xio_rdma_xmit(struct xio_rdma_transport *rdma_hndl)
 		prev_rdma_task = rdma_task;
 		req_nr++;
 		rdma_hndl->tx_ready_tasks_num--;
+		if (unlikely(task->sampled))
+			task->stamps[XIO_TASK_STAMP_XMIT] = get_cycles();
 		list_move_tail(&task->tasks_list_entry,
 			       &rdma_hndl->in_flight_list);
 	}
@@ -239,6 +239,7 @@ static void xio_tcp_write_setup_msg(struct xio_tcp_transport *tcp_hndl,
 	PACK_LVAL(msg, tmp_msg, max_in_iovsz);
 	PACK_LVAL(msg, tmp_msg, max_out_iovsz);
 	PACK_LVAL(msg, tmp_msg, max_header_len);
+	PACK_LVAL(msg, tmp_msg, frag_sz);
 	PACK_LLVAL(msg, tmp_msg, my_handle);
 
 #ifdef EYAL_TODO
@@ -277,6 +278,7 @@ static void xio_tcp_read_setup_msg(struct xio_tcp_transport *tcp_hndl,
 	UNPACK_LVAL(tmp_msg, msg, max_in_iovsz);
 	UNPACK_LVAL(tmp_msg, msg, max_out_iovsz);
 	UNPACK_LVAL(tmp_msg, msg, max_header_len);
+	UNPACK_LVAL(tmp_msg, msg, frag_sz);
 	UNPACK_LLVAL(tmp_msg, msg, my_handle);
 
 #ifdef EYAL_TODO
@@ -305,6 +307,7 @@ static int xio_tcp_send_setup_req(struct xio_tcp_transport *tcp_hndl,
 	req.max_in_iovsz	= tcp_options.max_in_iovsz;
 	req.max_out_iovsz	= tcp_options.max_out_iovsz;
 	req.max_header_len      = g_options.max_inline_xio_hdr;
+	req.frag_sz		= tcp_options.tcp_frag_sz;
 	req.my_handle		= uint64_from_ptr(tcp_hndl);
 
 	xio_tcp_write_setup_msg(tcp_hndl, task, &req);
@@ -418,6 +421,12 @@ static int xio_tcp_on_setup_msg(struct xio_tcp_transport *tcp_hndl,
 		rsp->max_in_iovsz	= req.max_in_iovsz;
 		rsp->max_out_iovsz	= req.max_out_iovsz;
 		rsp->max_header_len     = req.max_header_len;
+		/* fragment only if both sides agree */
+		if (req.frag_sz && tcp_options.tcp_frag_sz > 0)
+			rsp->frag_sz	= min(req.frag_sz,
+					      (uint32_t)tcp_options.tcp_frag_sz);
+		else
+			rsp->frag_sz	= 0;
 	}
 
 	tcp_hndl->max_inline_buf_sz	= (size_t)rsp->buffer_sz;
@@ -425,6 +434,7 @@ static int xio_tcp_on_setup_msg(struct xio_tcp_transport *tcp_hndl,
 	tcp_hndl->peer_max_in_iovsz	= rsp->max_in_iovsz;
 	tcp_hndl->peer_max_out_iovsz	= rsp->max_out_iovsz;
 	tcp_hndl->peer_max_header      = rsp->max_header_len;
+	tcp_hndl->frag_sz		= rsp->frag_sz;
 
 	tcp_hndl->sn = 0;
 
@@ -513,6 +523,8 @@ static int xio_tcp_write_req_header(struct xio_tcp_transport *tcp_hndl,
 	tmp_req_hdr->flags    = req_hdr->flags;
 	PACK_SVAL(req_hdr, tmp_req_hdr, req_hdr_len);
 	PACK_LVAL(req_hdr, tmp_req_hdr, ltid);
+	tmp_req_hdr->tcp_flags	   = req_hdr->tcp_flags;
+	tmp_req_hdr->pad	   = 0;
 	tmp_req_hdr->in_tcp_op	   = req_hdr->in_tcp_op;
 	tmp_req_hdr->out_tcp_op	   = req_hdr->out_tcp_op;
 
@@ -614,6 +626,7 @@ static int xio_tcp_prep_req_header(struct xio_tcp_transport *tcp_hndl,
 	req_hdr.version		= XIO_TCP_REQ_HEADER_VERSION;
 	req_hdr.req_hdr_len	= sizeof(req_hdr);
 	req_hdr.ltid		= task->ltid;
+	req_hdr.tcp_flags	= 0;
 	req_hdr.in_tcp_op	= tcp_task->in_tcp_op;
 	req_hdr.out_tcp_op	= tcp_task->out_tcp_op;
 	req_hdr.flags		= task->omsg_flags;
@@ -1047,6 +1060,305 @@ static int xio_tcp_write_sn(struct xio_task *task, uint16_t sn)
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_frag_carve							     */
+/*---------------------------------------------------------------------------*/
+static int xio_tcp_frag_carve(struct iovec **piov, size_t *piovlen,
+			      struct iovec *dst, size_t *pdstlen, size_t len)
+{
+	struct iovec	*iov = *piov;
+	size_t		iovlen = *piovlen;
+	size_t		n = 0, chunk;
+
+	while (len && iovlen) {
+		chunk = min(len, iov->iov_len);
+		if (chunk) {
+			dst[n].iov_base = iov->iov_base;
+			dst[n].iov_len = chunk;
+			n++;
+			inc_ptr(iov->iov_base, chunk);
+			iov->iov_len -= chunk;
+			len -= chunk;
+		}
+		if (iov->iov_len == 0) {
+			iov++;
+			iovlen--;
+		}
+	}
+	/* do not leave a tail of empty entries behind */
+	while (iovlen && iov->iov_len == 0) {
+		iov++;
+		iovlen--;
+	}
+	*piov = iov;
+	*piovlen = iovlen;
+	*pdstlen = n;
+
+	return len ? -1 : 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_set_hdr_flags						     */
+/*---------------------------------------------------------------------------*/
+static void xio_tcp_set_hdr_flags(struct xio_task *task, uint8_t flags)
+{
+	uint8_t *pflags;
+
+	/* save the current place */
+	xio_mbuf_push(&task->mbuf);
+	/* goto the first transport header*/
+	xio_mbuf_set_trans_hdr(&task->mbuf);
+
+	if (IS_REQUEST(task->tlv_type))
+		xio_mbuf_inc(&task->mbuf,
+			     offsetof(struct xio_tcp_req_hdr, tcp_flags));
+	else
+		xio_mbuf_inc(&task->mbuf,
+			     offsetof(struct xio_tcp_rsp_hdr, tcp_flags));
+
+	pflags = (uint8_t *)xio_mbuf_get_curr_ptr(&task->mbuf);
+	*pflags |= flags;
+
+	/* pop to the original place */
+	xio_mbuf_pop(&task->mbuf);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_frag_prep							     */
+/*---------------------------------------------------------------------------*/
+static void xio_tcp_frag_prep(struct xio_tcp_transport *tcp_hndl,
+			      struct xio_task *task)
+{
+	XIO_TO_TCP_TASK(task, tcp_task);
+	struct xio_tcp_work_req	*txd = &tcp_task->txd;
+
+	/* data sent via SEND is part of the tlv and is never split */
+	if (!tcp_hndl->frag_sz || tcp_task->out_tcp_op == XIO_TCP_SEND)
+		return;
+
+	if (txd->ctl_msg_len) {
+		/* dual socket - the header goes on its own socket */
+		if (txd->tot_iov_byte_len <= tcp_hndl->frag_sz)
+			return;
+		tcp_task->frag_iov	= txd->msg.msg_iov;
+		tcp_task->frag_iovlen	= txd->msg.msg_iovlen;
+		txd->msg.msg_iovlen	= 0;
+		txd->tot_iov_byte_len	= 0;
+	} else {
+		if (txd->tot_iov_byte_len - txd->msg.msg_iov[0].iov_len <=
+		    tcp_hndl->frag_sz)
+			return;
+		tcp_task->frag_iov	= &txd->msg.msg_iov[1];
+		tcp_task->frag_iovlen	= txd->msg.msg_iovlen - 1;
+		txd->msg.msg_iovlen	= 1;
+		txd->tot_iov_byte_len	= txd->msg.msg_iov[0].iov_len;
+	}
+	tcp_task->frag_task = task;
+	xio_tcp_set_hdr_flags(task, XIO_TCP_HDR_FLAG_FRAGMENTED);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_frag_blocker							     */
+/*---------------------------------------------------------------------------*/
+static struct xio_tcp_task *xio_tcp_frag_blocker(
+		struct xio_tcp_transport *tcp_hndl,
+		struct xio_task *task)
+{
+	struct xio_tcp_task	*tcp_task;
+	struct xio_task		*parent;
+
+	if (!task->connection)
+		return NULL;
+
+	/* messages of a connection keep their order - wait behind the
+	 * latest fragmented message of the same priority class. control
+	 * messages wait for all of them
+	 */
+	list_for_each_entry_reverse(tcp_task, &tcp_hndl->tx_frag_list,
+				    frag_list_entry) {
+		parent = tcp_task->frag_task;
+		if (parent->connection != task->connection)
+			continue;
+		if (!IS_APPLICATION_MSG(task->tlv_type) || !task->omsg ||
+		    xio_msg_prio(parent->omsg) == xio_msg_prio(task->omsg))
+			return tcp_task;
+	}
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_tx_ready_add							     */
+/*---------------------------------------------------------------------------*/
+static void xio_tcp_tx_ready_add(struct xio_tcp_transport *tcp_hndl,
+				 struct xio_task *task, int check_frag)
+{
+	XIO_TO_TCP_TASK(task, tcp_task);
+	struct xio_tcp_task	*blocker = NULL;
+
+	if (IS_KEEPALIVE(task->tlv_type)) {
+		list_move(&task->tasks_list_entry, &tcp_hndl->tx_ready_list);
+		tcp_hndl->tx_ready_tasks_num++;
+		return;
+	}
+
+	if (unlikely(check_frag && !list_empty(&tcp_hndl->tx_frag_list)))
+		blocker = xio_tcp_frag_blocker(tcp_hndl, task);
+
+	if (unlikely(tcp_task->frag_task == task &&
+		     list_empty(&tcp_task->frag_list_entry)))
+		list_add_tail(&tcp_task->frag_list_entry,
+			      &tcp_hndl->tx_frag_list);
+
+	if (unlikely(blocker)) {
+		list_move_tail(&task->tasks_list_entry,
+			       &blocker->frag_held_list);
+		return;
+	}
+	list_move_tail(&task->tasks_list_entry, &tcp_hndl->tx_ready_list);
+	tcp_hndl->tx_ready_tasks_num++;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_frag_queue							     */
+/*---------------------------------------------------------------------------*/
+static int xio_tcp_frag_queue(struct xio_tcp_transport *tcp_hndl,
+			      struct xio_task *parent)
+{
+	XIO_TO_TCP_TASK(parent, tcp_parent);
+	struct xio_tcp_task	*tcp_task;
+	struct xio_tcp_frag_hdr	*frag_hdr;
+	struct xio_task		*task;
+	struct iovec		*data_iov;
+	size_t			data_iovlen, hdr_len, len = 0, i;
+
+	task = xio_tcp_primary_task_alloc(tcp_hndl);
+	if (unlikely(!task)) {
+		/* retried from the next transmit */
+		tcp_hndl->frag_starved = 1;
+		return -1;
+	}
+	tcp_task = (struct xio_tcp_task *)task->dd_data;
+	task->tlv_type = XIO_TCP_FRAG;
+
+	xio_mbuf_reset(&task->mbuf);
+	xio_mbuf_tlv_start(&task->mbuf);
+	memset(xio_mbuf_get_curr_ptr(&task->mbuf), 0, XIO_SESSION_HDR_LEN);
+	xio_mbuf_set_trans_hdr(&task->mbuf);
+
+	/* the data follows the header, single socket sends both at once */
+	data_iov = &tcp_task->txd.msg_iov[1];
+	if (xio_tcp_frag_carve(&tcp_parent->frag_iov,
+			       &tcp_parent->frag_iovlen,
+			       data_iov, &data_iovlen,
+			       tcp_hndl->frag_sz))
+		tcp_parent->frag_iovlen = 0;	/* last fragment */
+	for (i = 0; i < data_iovlen; i++)
+		len += data_iov[i].iov_len;
+
+	frag_hdr = (struct xio_tcp_frag_hdr *)
+			xio_mbuf_get_curr_ptr(&task->mbuf);
+	frag_hdr->version	= XIO_TCP_FRAG_HEADER_VERSION;
+	frag_hdr->flags		= 0;
+	frag_hdr->frag_hdr_len	= htons(sizeof(*frag_hdr));
+	frag_hdr->sn		= 0;
+	frag_hdr->pad		= 0;
+	frag_hdr->ltid		= htonl(parent->ltid);
+	frag_hdr->len		= htonl((uint32_t)len);
+	xio_mbuf_inc(&task->mbuf, sizeof(*frag_hdr));
+
+	if (xio_mbuf_write_tlv(&task->mbuf, task->tlv_type,
+			       xio_mbuf_tlv_payload_len(&task->mbuf)) != 0) {
+		xio_tasks_pool_put(task);
+		xio_transport_notify_observer_error(&tcp_hndl->base,
+						    XIO_E_MSG_SIZE);
+		return -1;
+	}
+	hdr_len = xio_mbuf_get_curr_offset(&task->mbuf);
+
+	tcp_task->txd.msg_iov[0].iov_base = xio_mbuf_buf_head(&task->mbuf);
+	tcp_task->txd.msg_iov[0].iov_len = hdr_len;
+	tcp_task->txd.tot_iov_byte_len = len;
+	if (tcp_hndl->sock.cfd == tcp_hndl->sock.dfd) {
+		tcp_task->txd.ctl_msg_len = 0;
+		tcp_task->txd.tot_iov_byte_len += hdr_len;
+		tcp_task->txd.msg.msg_iov = tcp_task->txd.msg_iov;
+		tcp_task->txd.msg.msg_iovlen = data_iovlen + 1;
+	} else {
+		tcp_task->txd.ctl_msg = xio_mbuf_buf_head(&task->mbuf);
+		tcp_task->txd.ctl_msg_len = hdr_len;
+		tcp_task->txd.msg.msg_iov = data_iov;
+		tcp_task->txd.msg.msg_iovlen = data_iovlen;
+	}
+	tcp_task->txd.msg_len = tcp_task->txd.msg.msg_iovlen;
+	tcp_task->txd.stage = XIO_TCP_TX_BEFORE;
+	tcp_task->out_tcp_op = XIO_TCP_SEND;
+	tcp_task->frag_task = parent;
+	tcp_parent->frag_pending = 1;
+
+	list_add_tail(&task->tasks_list_entry, &tcp_hndl->tx_ready_list);
+	tcp_hndl->tx_ready_tasks_num++;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_frag_refill							     */
+/*---------------------------------------------------------------------------*/
+static void xio_tcp_frag_refill(struct xio_tcp_transport *tcp_hndl)
+{
+	struct xio_tcp_task	*tcp_task;
+
+	tcp_hndl->frag_starved = 0;
+	list_for_each_entry(tcp_task, &tcp_hndl->tx_frag_list,
+			    frag_list_entry) {
+		if (tcp_task->frag_hdr_sent && !tcp_task->frag_pending &&
+		    tcp_task->frag_iovlen &&
+		    xio_tcp_frag_queue(tcp_hndl, tcp_task->frag_task))
+			break;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_frag_sent							     */
+/*---------------------------------------------------------------------------*/
+static struct xio_task *xio_tcp_frag_sent(struct xio_tcp_transport *tcp_hndl,
+					  struct xio_task *task)
+{
+	XIO_TO_TCP_TASK(task, tcp_task);
+	struct xio_task		*parent = tcp_task->frag_task;
+	struct xio_tcp_task	*tcp_parent =
+				(struct xio_tcp_task *)parent->dd_data;
+	struct xio_task		*held;
+
+	if (parent == task) {
+		/* header is out - park it until all the data follows */
+		list_del_init(&task->tasks_list_entry);
+		tcp_parent->frag_hdr_sent = 1;
+	} else {
+		tcp_parent->frag_pending = 0;
+		xio_tasks_pool_put(task);
+	}
+
+	if (tcp_parent->frag_iovlen) {
+		xio_tcp_frag_queue(tcp_hndl, parent);
+		return NULL;
+	}
+
+	/* the message is complete, release whoever waited behind it */
+	list_del_init(&tcp_parent->frag_list_entry);
+	list_add_tail(&parent->tasks_list_entry, &tcp_hndl->in_flight_list);
+
+	while (!list_empty(&tcp_parent->frag_held_list)) {
+		held = list_first_entry(&tcp_parent->frag_held_list,
+					struct xio_task, tasks_list_entry);
+		xio_tcp_tx_ready_add(tcp_hndl, held,
+				     !IS_APPLICATION_MSG(held->tlv_type));
+	}
+
+	return parent;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_tcp_xmit								     */
 /*---------------------------------------------------------------------------*/
@@ -1062,9 +1374,16 @@ int xio_tcp_xmit(struct xio_tcp_transport *tcp_hndl)
 	unsigned int		iov_len;
 	uint64_t		bytes_sent;
 
+	if (unlikely(tcp_hndl->frag_starved &&
+		     tcp_hndl->state == XIO_TRANSPORT_STATE_CONNECTED))
+		xio_tcp_frag_refill(tcp_hndl);
+
 	if (tcp_hndl->tx_ready_tasks_num == 0 ||
 	    tcp_hndl->tx_comp_cnt > COMPLETION_BATCH_MAX ||
 	    tcp_hndl->state != XIO_TRANSPORT_STATE_CONNECTED) {
+		if (unlikely(tcp_hndl->frag_starved))
+			xio_context_add_event(tcp_hndl->base.ctx,
+					      &tcp_hndl->flush_tx_event);
 		xio_set_error(XIO_EAGAIN);
 		return -1;
 	}
@@ -1234,11 +1553,31 @@ int xio_tcp_xmit(struct xio_tcp_transport *tcp_hndl)
 				bytes_sent -= tcp_task->txd.tot_iov_byte_len;
 
 				tcp_hndl->tx_ready_tasks_num--;
+				--tmp_count;
 
-				list_move_tail(&task->tasks_list_entry,
-					       &tcp_hndl->in_flight_list);
+				if (unlikely(tcp_task->frag_task)) {
+					/* fragments complete the message */
+					task = xio_tcp_frag_sent(tcp_hndl,
+								 task);
+					if (!task) {
+						task = list_first_entry(
+						    &tcp_hndl->tx_ready_list,
+						    struct xio_task,
+						    tasks_list_entry);
+						continue;
+					}
+				} else {
+					list_move_tail(&task->tasks_list_entry,
+						       &tcp_hndl->in_flight_list);
+				}
 
 				task_success = task;
+				if (unlikely(task->sampled))
+					task->stamps[XIO_TASK_STAMP_XMIT] =
+								get_cycles();
+				XIO_TRACE4(tcp_xmit, tcp_hndl, task->ltid,
+					   task->tlv_type,
+					   tcp_hndl->tx_ready_tasks_num);
 
 				++tcp_hndl->tx_comp_cnt;
 
@@ -1247,8 +1586,6 @@ int xio_tcp_xmit(struct xio_tcp_transport *tcp_hndl)
 					    (task->omsg->flags &
 						XIO_MSG_FLAG_IMM_SEND_COMP));
 
-				--tmp_count;
-
 				task = list_first_entry(
 					&tcp_hndl->tx_ready_list,
 					struct xio_task,  tasks_list_entry);
@@ -1325,6 +1662,9 @@ handle_completions:
 		}
 	}
 	xio_context_disable_event(&tcp_hndl->flush_tx_event);
+	if (unlikely(tcp_hndl->frag_starved))
+		xio_context_add_event(tcp_hndl->base.ctx,
+				      &tcp_hndl->flush_tx_event);
 
 	return retval < 0 ? retval : 0;
 }
@@ -1555,14 +1895,11 @@ static int xio_tcp_send_req(struct xio_tcp_transport *tcp_hndl,
 
 	xio_task_addref(task);
 
-	tcp_task->out_tcp_op = XIO_TCP_SEND;
+	xio_tcp_frag_prep(tcp_hndl, task);
 
-	if (IS_KEEPALIVE(task->tlv_type))
-		list_move(&task->tasks_list_entry, &tcp_hndl->tx_ready_list);
-	else
-		list_move_tail(&task->tasks_list_entry, &tcp_hndl->tx_ready_list);
+	tcp_task->out_tcp_op = XIO_TCP_SEND;
 
-	tcp_hndl->tx_ready_tasks_num++;
+	xio_tcp_tx_ready_add(tcp_hndl, task, 1);
 
 	retval = xio_tcp_xmit(tcp_hndl);
 	if (retval) {
@@ -1603,6 +1940,7 @@ static int xio_tcp_write_rsp_header(struct xio_tcp_transport *tcp_hndl,
 	PACK_LVAL(rsp_hdr, tmp_rsp_hdr, ltid);
 	PACK_LVAL(rsp_hdr, tmp_rsp_hdr, rtid);
 	tmp_rsp_hdr->out_tcp_op = rsp_hdr->out_tcp_op;
+	tmp_rsp_hdr->tcp_flags = rsp_hdr->tcp_flags;
 	PACK_LVAL(rsp_hdr, tmp_rsp_hdr, status);
 	PACK_SVAL(rsp_hdr, tmp_rsp_hdr, out_num_sge);
 	PACK_SVAL(rsp_hdr, tmp_rsp_hdr, ulp_hdr_len);
@@ -1943,12 +2281,9 @@ static int xio_tcp_send_rsp(struct xio_tcp_transport *tcp_hndl,
 	if (xio_mbuf_write_tlv(&task->mbuf, task->tlv_type, tlv_len) != 0)
 		goto cleanup;
 
-	if (IS_KEEPALIVE(task->tlv_type))
-		list_move(&task->tasks_list_entry, &tcp_hndl->tx_ready_list);
-	else
-		list_move_tail(&task->tasks_list_entry, &tcp_hndl->tx_ready_list);
+	xio_tcp_frag_prep(tcp_hndl, task);
 
-	tcp_hndl->tx_ready_tasks_num++;
+	xio_tcp_tx_ready_add(tcp_hndl, task, 1);
 
 	retval = xio_tcp_xmit(tcp_hndl);
 	if (retval) {
@@ -2003,6 +2338,7 @@ static int xio_tcp_read_req_header(struct xio_tcp_transport *tcp_hndl,
 
 	UNPACK_SVAL(tmp_req_hdr, req_hdr, sn);
 	UNPACK_LVAL(tmp_req_hdr, req_hdr, ltid);
+	req_hdr->tcp_flags = tmp_req_hdr->tcp_flags;
 	req_hdr->out_tcp_op = tmp_req_hdr->out_tcp_op;
 	req_hdr->in_tcp_op = tmp_req_hdr->in_tcp_op;
 
@@ -2080,6 +2416,7 @@ static int xio_tcp_read_rsp_header(struct xio_tcp_transport *tcp_hndl,
 	UNPACK_LVAL(tmp_rsp_hdr, rsp_hdr, rtid);
 	UNPACK_LVAL(tmp_rsp_hdr, rsp_hdr, ltid);
 	rsp_hdr->out_tcp_op = tmp_rsp_hdr->out_tcp_op;
+	rsp_hdr->tcp_flags = tmp_rsp_hdr->tcp_flags;
 	UNPACK_LVAL(tmp_rsp_hdr, rsp_hdr, status);
 	UNPACK_SVAL(tmp_rsp_hdr, rsp_hdr, out_num_sge);
 	UNPACK_SVAL(tmp_rsp_hdr, rsp_hdr, ulp_hdr_len);
@@ -2482,6 +2819,8 @@ static int xio_tcp_on_recv_req_header(struct xio_tcp_transport *tcp_hndl,
 	/* save originator identifier */
 	task->rtid		= req_hdr.ltid;
 	task->imsg_flags	= req_hdr.flags;
+	tcp_task->frag_rx	= !!(req_hdr.tcp_flags &
+				     XIO_TCP_HDR_FLAG_FRAGMENTED);
 
 	imsg		= &task->imsg;
 	sgtbl		= xio_sg_table_get(&imsg->out);
@@ -2652,6 +2991,7 @@ static int xio_tcp_on_recv_rsp_header(struct xio_tcp_transport *tcp_hndl,
 	}
 
 	task->rtid       = rsp_hdr.ltid;
+	tcp_task->frag_rx = !!(rsp_hdr.tcp_flags & XIO_TCP_HDR_FLAG_FRAGMENTED);
 
 	tcp_sender_task = (struct xio_tcp_task *)task->sender_task->dd_data;
 
@@ -2972,6 +3312,135 @@ struct xio_tcp_work_req *xio_tcp_get_data_rxd(struct xio_task *task)
 	return NULL;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_frag_rx_park							     */
+/*---------------------------------------------------------------------------*/
+static struct xio_task *xio_tcp_frag_rx_park(struct xio_tcp_transport *tcp_hndl,
+					     struct xio_task *task)
+{
+	struct list_head	*prev = task->tasks_list_entry.prev;
+	struct xio_tcp_task	*tcp_task;
+	struct xio_task		*task_next;
+
+	/* wait for the fragments outside rx_list */
+	list_move_tail(&task->tasks_list_entry, &tcp_hndl->rx_frag_list);
+
+	/* lean: the parked task may have been the only posted receive */
+	if (tcp_hndl->base.ctx->lean_conns && prev->next == &tcp_hndl->rx_list) {
+		task_next = xio_tcp_primary_task_alloc(tcp_hndl);
+		if (task_next) {
+			tcp_task = (struct xio_tcp_task *)task_next->dd_data;
+			tcp_task->out_tcp_op = XIO_TCP_RECV;
+			list_add_tail(&task_next->tasks_list_entry,
+				      &tcp_hndl->rx_list);
+		}
+	}
+
+	return list_entry(prev->next, struct xio_task, tasks_list_entry);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_on_recv_frag_header						     */
+/*---------------------------------------------------------------------------*/
+static int xio_tcp_on_recv_frag_header(struct xio_tcp_transport *tcp_hndl,
+				       struct xio_task *task)
+{
+	XIO_TO_TCP_TASK(task, tcp_task);
+	struct xio_tcp_frag_hdr	*tmp_frag_hdr;
+	struct xio_tcp_work_req	*rxd = NULL;
+	struct xio_task		*parent = NULL, *ptask;
+	struct xio_tcp_task	*tcp_parent;
+	size_t			iovlen;
+	uint32_t		ltid, len;
+
+	/* point to transport header */
+	xio_mbuf_set_trans_hdr(&task->mbuf);
+	tmp_frag_hdr = (struct xio_tcp_frag_hdr *)
+			xio_mbuf_get_curr_ptr(&task->mbuf);
+
+	if (unlikely(ntohs(tmp_frag_hdr->frag_hdr_len) !=
+		     sizeof(struct xio_tcp_frag_hdr))) {
+		ERROR_LOG("fragment header length's read failed. " \
+			  "arrived:%d expected:%zd\n",
+			  ntohs(tmp_frag_hdr->frag_hdr_len),
+			  sizeof(struct xio_tcp_frag_hdr));
+		goto cleanup;
+	}
+	tcp_task->sn	= ntohs(tmp_frag_hdr->sn);
+	ltid		= ntohl(tmp_frag_hdr->ltid);
+	len		= ntohl(tmp_frag_hdr->len);
+
+	list_for_each_entry(ptask, &tcp_hndl->rx_frag_list, tasks_list_entry) {
+		if (ptask->rtid == ltid) {
+			parent = ptask;
+			break;
+		}
+	}
+	if (parent)
+		rxd = xio_tcp_get_data_rxd(parent);
+	if (unlikely(!rxd || len > rxd->tot_iov_byte_len)) {
+		ERROR_LOG("unexpected fragment. ltid:%u, len:%u\n", ltid, len);
+		goto cleanup;
+	}
+
+	/* the fragment is read straight into the message buffers */
+	if (unlikely(xio_tcp_frag_carve(&rxd->msg.msg_iov,
+					&rxd->msg.msg_iovlen,
+					tcp_task->rxd.msg_iov, &iovlen, len))) {
+		ERROR_LOG("fragment overflows the message. ltid:%u\n", ltid);
+		goto cleanup;
+	}
+	rxd->tot_iov_byte_len -= len;
+
+	tcp_task->rxd.msg.msg_iov	= tcp_task->rxd.msg_iov;
+	tcp_task->rxd.msg.msg_iovlen	= iovlen;
+	tcp_task->rxd.msg_len		= iovlen;
+	tcp_task->rxd.tot_iov_byte_len	= len;
+	tcp_task->out_tcp_op		= XIO_TCP_SEND;
+	tcp_task->frag_task		= parent;
+
+	tcp_parent = (struct xio_tcp_task *)parent->dd_data;
+	tcp_parent->frag_pending++;
+
+	return 0;
+
+cleanup:
+	xio_set_error(XIO_E_MSG_INVALID);
+	xio_transport_notify_observer_error(&tcp_hndl->base,
+					    XIO_E_MSG_INVALID);
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_on_recv_frag_data						     */
+/*---------------------------------------------------------------------------*/
+static int xio_tcp_on_recv_frag_data(struct xio_tcp_transport *tcp_hndl,
+				     struct xio_task *task)
+{
+	XIO_TO_TCP_TASK(task, tcp_task);
+	struct xio_task		*parent = tcp_task->frag_task;
+	struct xio_tcp_task	*tcp_parent =
+				(struct xio_tcp_task *)parent->dd_data;
+
+	xio_tasks_pool_put(task);
+
+	if (--tcp_parent->frag_pending ||
+	    xio_tcp_get_data_rxd(parent)->tot_iov_byte_len)
+		return 0;
+
+	/* all the data arrived - deliver the message */
+	parent->last_in_rxq = 1;
+	if (IS_REQUEST(parent->tlv_type))
+		return xio_tcp_on_recv_req_data(tcp_hndl, parent);
+
+	if (!xio_transport_is_task_routable(parent->sender_task)) {
+		ERROR_LOG("invalid sender task. Releasing incoming response. tcp_hndl:%p\n", tcp_hndl);
+		xio_tasks_pool_put(parent);
+		return 0;
+	}
+	return xio_tcp_on_recv_rsp_data(tcp_hndl, parent);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_tcp_rx_data_handler						     */
 /*---------------------------------------------------------------------------*/
@@ -3060,6 +3529,8 @@ int xio_tcp_rx_data_handler(struct xio_tcp_transport *tcp_hndl, int batch_nr)
 
 			iov_len -= rxd_work->msg.msg_iovlen;
 			bytes_recv -= rxd_work->tot_iov_byte_len;
+			XIO_TRACE4(tcp_rx_data, tcp_hndl, task->ltid,
+				   task->tlv_type, rxd_work->tot_iov_byte_len);
 
 			task = list_first_entry(&task->tasks_list_entry,
 						struct xio_task,
@@ -3097,7 +3568,11 @@ int xio_tcp_rx_data_handler(struct xio_tcp_transport *tcp_hndl, int batch_nr)
                         task->last_in_rxq = (ret_count == (int)last_in_rxq);
 			++ret_count;
 			tcp_task = (struct xio_tcp_task *)task->dd_data;
-			if (IS_REQUEST(task->tlv_type)) {
+			if (task->tlv_type == XIO_TCP_FRAG) {
+				retval =
+					xio_tcp_on_recv_frag_data(tcp_hndl,
+								  task);
+			} else if (IS_REQUEST(task->tlv_type)) {
 				retval =
 					xio_tcp_on_recv_req_data(tcp_hndl,
 							task);
@@ -3164,6 +3639,20 @@ int xio_tcp_rx_ctl_handler(struct xio_tcp_transport *tcp_hndl, int batch_nr)
 	struct xio_task *task, *task_next;
 	int exit;
 	int count;
+	int lean = tcp_hndl->base.ctx->lean_conns;
+
+	/* lean connections grow rx_list on demand - make sure a receive is
+	 * posted, e.g. after an earlier allocation failure
+	 */
+	if (unlikely(lean && list_empty(&tcp_hndl->rx_list) &&
+		     tcp_hndl->state == XIO_TRANSPORT_STATE_CONNECTED)) {
+		task = xio_tcp_primary_task_alloc(tcp_hndl);
+		if (!task)
+			return 0;
+		tcp_task = (struct xio_tcp_task *)task->dd_data;
+		tcp_task->out_tcp_op = XIO_TCP_RECV;
+		list_add_tail(&task->tasks_list_entry, &tcp_hndl->rx_list);
+	}
 
 	task = list_first_entry_or_null(&tcp_hndl->rx_list,
 					struct xio_task,
@@ -3178,10 +3667,11 @@ int xio_tcp_rx_ctl_handler(struct xio_tcp_transport *tcp_hndl, int batch_nr)
 		switch (tcp_task->rxd.stage) {
 		case XIO_TCP_RX_START:
 			/* ORK todo find a better place to rearm rx_list?*/
-			if (tcp_hndl->state ==
+			if (!lean &&
+			    (tcp_hndl->state ==
 					XIO_TRANSPORT_STATE_CONNECTED ||
-			    tcp_hndl->state ==
-					XIO_TRANSPORT_STATE_DISCONNECTED) {
+			     tcp_hndl->state ==
+					XIO_TRANSPORT_STATE_DISCONNECTED)) {
 				task_next =
 					xio_tcp_primary_task_alloc(tcp_hndl);
 				if (!task_next) {
@@ -3257,6 +3747,12 @@ int xio_tcp_rx_ctl_handler(struct xio_tcp_transport *tcp_hndl, int batch_nr)
 			case XIO_NEXUS_SETUP_RSP:
 				xio_tcp_on_setup_msg(tcp_hndl, task);
 				return 1;
+			case XIO_TCP_FRAG:
+				retval = xio_tcp_on_recv_frag_header(tcp_hndl,
+								     task);
+				if (unlikely(retval < 0))
+					return retval;
+				break;
 			default:
 				if (IS_REQUEST(task->tlv_type))
 					retval =
@@ -3273,10 +3769,34 @@ int xio_tcp_rx_ctl_handler(struct xio_tcp_transport *tcp_hndl, int batch_nr)
 					return retval;
 				}
 			}
+			if (unlikely(tcp_task->frag_rx)) {
+				/* the data arrives in fragments - move on to
+				 * the next header
+				 */
+				task = xio_tcp_frag_rx_park(tcp_hndl, task);
+				continue;
+			}
 			tcp_task->rxd.stage = XIO_TCP_RX_IO_DATA;
 			/*fallthrough*/
 		case XIO_TCP_RX_IO_DATA:
 			++count;
+			/* lean: rearm only once a message was read */
+			if (lean &&
+			    list_is_last(&task->tasks_list_entry,
+					 &tcp_hndl->rx_list) &&
+			    (tcp_hndl->state ==
+					XIO_TRANSPORT_STATE_CONNECTED ||
+			     tcp_hndl->state ==
+					XIO_TRANSPORT_STATE_DISCONNECTED)) {
+				task_next =
+					xio_tcp_primary_task_alloc(tcp_hndl);
+				if (!task_next) {
+					exit = 1;
+					break;
+				}
+				list_add_tail(&task_next->tasks_list_entry,
+					      &tcp_hndl->rx_list);
+			}
 			break;
 		default:
 			ERROR_LOG("unknown stage type:%d\n",
@@ -67,6 +67,7 @@
 #define XIO_OPTVAL_DEF_TCP_SO_SNDBUF			4194304
 #define XIO_OPTVAL_DEF_TCP_SO_RCVBUF			4194304
 #define XIO_OPTVAL_DEF_TCP_DUAL_SOCK			1
+#define XIO_OPTVAL_DEF_TCP_FRAG_SIZE			65536
 
 /*---------------------------------------------------------------------------*/
 /* globals								     */
@@ -91,7 +92,7 @@ struct xio_tcp_options			tcp_options = {
 	XIO_OPTVAL_DEF_TCP_SO_SNDBUF,		/*tcp_so_sndbuf*/
 	XIO_OPTVAL_DEF_TCP_SO_RCVBUF,		/*tcp_so_rcvbuf*/
 	XIO_OPTVAL_DEF_TCP_DUAL_SOCK,		/*tcp_dual_sock*/
-	0					/*pad*/
+	XIO_OPTVAL_DEF_TCP_FRAG_SIZE		/*tcp_frag_sz*/
 };
 
 /*---------------------------------------------------------------------------*/
@@ -162,6 +163,25 @@ int xio_tcp_get_inline_buffer_size(void)
 /*---------------------------------------------------------------------------*/
 static int xio_tcp_flush_all_tasks(struct xio_tcp_transport *tcp_hndl)
 {
+	struct xio_tcp_task *tcp_task;
+	struct xio_task *task;
+
+	/* fragmented messages waiting for their data to go out are parked
+	 * outside the task lists, together with the messages held behind them
+	 */
+	while (!list_empty(&tcp_hndl->tx_frag_list)) {
+		tcp_task = list_first_entry(&tcp_hndl->tx_frag_list,
+					    struct xio_tcp_task,
+					    frag_list_entry);
+		task = tcp_task->frag_task;
+		list_del_init(&tcp_task->frag_list_entry);
+		list_splice_tail_init(&tcp_task->frag_held_list,
+				      &tcp_hndl->tx_ready_list);
+		if (list_empty(&task->tasks_list_entry))
+			list_add_tail(&task->tasks_list_entry,
+				      &tcp_hndl->in_flight_list);
+	}
+
 	if (!list_empty(&tcp_hndl->in_flight_list)) {
 		DEBUG_LOG("in_flight_list not empty! tcp_hndl:%p\n", tcp_hndl);
 		xio_tasks_list_flush(&tcp_hndl->in_flight_list);
@@ -186,6 +206,11 @@ static int xio_tcp_flush_all_tasks(struct xio_tcp_transport *tcp_hndl)
 		xio_tasks_list_flush(&tcp_hndl->rx_list);
 	}
 
+	if (!list_empty(&tcp_hndl->rx_frag_list)) {
+		DEBUG_LOG("rx_frag_list not empty! tcp_hndl:%p\n", tcp_hndl);
+		xio_tasks_list_flush(&tcp_hndl->rx_frag_list);
+	}
+
 	tcp_hndl->tx_ready_tasks_num = 0;
 
 	return 0;
@@ -326,6 +351,24 @@ void on_sock_disconnected(struct xio_tcp_transport *tcp_hndl,
 	}
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_hndl_mem_add							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_tcp_hndl_mem_add(struct xio_context *ctx)
+{
+	xio_ctx_mem_add(ctx, XIO_MEM_CLASS_TRANSPORT,
+			sizeof(struct xio_tcp_transport), 1);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_hndl_mem_sub							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_tcp_hndl_mem_sub(struct xio_context *ctx)
+{
+	xio_ctx_mem_sub(ctx, XIO_MEM_CLASS_TRANSPORT,
+			sizeof(struct xio_tcp_transport), 1);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_tcp_post_close							     */
 /*---------------------------------------------------------------------------*/
@@ -335,10 +378,13 @@ static void xio_tcp_post_close(struct xio_tcp_transport *tcp_hndl)
 		  tcp_hndl);
 
 	xio_context_disable_event(&tcp_hndl->disconnect_event);
+	xio_ctx_del_delayed_work(tcp_hndl->base.ctx, &tcp_hndl->ctl_rx_work);
 
 	xio_observable_unreg_all_observers(&tcp_hndl->base.observable);
 
 	if (tcp_hndl->tmp_rx_buf) {
+		xio_ctx_mem_sub(tcp_hndl->base.ctx, XIO_MEM_CLASS_SCRATCH,
+				TMP_RX_BUF_SIZE, 1);
 		xio_context_ufree(tcp_hndl->base.ctx, tcp_hndl->tmp_rx_buf);
 		tcp_hndl->tmp_rx_buf = NULL;
 	}
@@ -347,6 +393,7 @@ static void xio_tcp_post_close(struct xio_tcp_transport *tcp_hndl)
 
 	XIO_OBSERVABLE_DESTROY(&tcp_hndl->base.observable);
 
+	xio_tcp_hndl_mem_sub(tcp_hndl->base.ctx);
 	xio_context_ufree(tcp_hndl->base.ctx, tcp_hndl);
 }
 
@@ -595,6 +642,17 @@ int xio_tcp_dual_sock_rx_ctl_handler(struct xio_tcp_transport *tcp_hndl)
 	return xio_tcp_rx_ctl_handler(tcp_hndl, RX_BATCH);
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_ctl_rx_retry							     */
+/*---------------------------------------------------------------------------*/
+static void xio_tcp_ctl_rx_retry(int actual_timeout_ms, void *xio_tcp_hndl)
+{
+	struct xio_tcp_transport *tcp_hndl = (struct xio_tcp_transport *)
+						xio_tcp_hndl;
+
+	xio_context_add_event(tcp_hndl->base.ctx, &tcp_hndl->ctl_rx_event);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_tcp_consume_ctl_rx						     */
 /*---------------------------------------------------------------------------*/
@@ -613,8 +671,17 @@ void xio_tcp_consume_ctl_rx(void *xio_tcp_hndl)
 
 	if (/*retval > 0 && */ tcp_hndl->tmp_rx_buf_len &&
 	    tcp_hndl->state == XIO_TRANSPORT_STATE_CONNECTED) {
-		xio_context_add_event(tcp_hndl->base.ctx,
-				      &tcp_hndl->ctl_rx_event);
+		/* no progress - e.g. the tasks pool ran dry. retry later
+		 * rather than spin the loop until tasks are released
+		 */
+		if (unlikely(retval == 0))
+			xio_ctx_add_delayed_work(tcp_hndl->base.ctx,
+						 RX_RETRY_MS, tcp_hndl,
+						 xio_tcp_ctl_rx_retry,
+						 &tcp_hndl->ctl_rx_work);
+		else
+			xio_context_add_event(tcp_hndl->base.ctx,
+					      &tcp_hndl->ctl_rx_event);
 	}
 }
 
@@ -878,6 +945,7 @@ struct xio_tcp_transport *xio_tcp_transport_create(
 		ERROR_LOG("xio_context_ucalloc failed. %m\n");
 		return NULL;
 	}
+	xio_tcp_hndl_mem_add(ctx);
 
 	XIO_OBSERVABLE_INIT(&tcp_hndl->base.observable, tcp_hndl);
 
@@ -906,7 +974,9 @@ struct xio_tcp_transport *xio_tcp_transport_create(
 	tcp_hndl->tx_comp_cnt = 0;
 
 	memset(&tcp_hndl->tmp_work, 0, sizeof(struct xio_tcp_work_req));
-	tcp_hndl->tmp_work.msg_iov = tcp_hndl->tmp_iovec;
+	tcp_hndl->tmp_work.msg_iov = xio_transport_iov_scratch_get(ctx);
+	if (!tcp_hndl->tmp_work.msg_iov)
+		goto cleanup;
 
 	/* create tcp socket */
 	if (create_socket) {
@@ -931,6 +1001,8 @@ struct xio_tcp_transport *xio_tcp_transport_create(
 	INIT_LIST_HEAD(&tcp_hndl->tx_comp_list);
 	INIT_LIST_HEAD(&tcp_hndl->rx_list);
 	INIT_LIST_HEAD(&tcp_hndl->io_list);
+	INIT_LIST_HEAD(&tcp_hndl->tx_frag_list);
+	INIT_LIST_HEAD(&tcp_hndl->rx_frag_list);
 
 	INIT_LIST_HEAD(&tcp_hndl->pending_conns);
 
@@ -951,6 +1023,7 @@ struct xio_tcp_transport *xio_tcp_transport_create(
 	return tcp_hndl;
 
 cleanup:
+	xio_tcp_hndl_mem_sub(ctx);
 	xio_context_ufree(ctx, tcp_hndl);
 
 	return NULL;
@@ -1181,6 +1254,8 @@ single_sock:
 			ERROR_LOG("xio_context_ucalloc failed. %m\n");
 			goto cleanup3;
 		}
+		xio_ctx_mem_add(parent_hndl->base.ctx, XIO_MEM_CLASS_SCRATCH,
+				TMP_RX_BUF_SIZE, 1);
 		child_hndl->tmp_rx_buf_cur = child_hndl->tmp_rx_buf;
 	}
 
@@ -1736,6 +1811,8 @@ int xio_tcp_dual_sock_connect(struct xio_tcp_transport *tcp_hndl,
 		ERROR_LOG("xio_context_ucalloc failed. %m\n");
 		return -1;
 	}
+	xio_ctx_mem_add(tcp_hndl->base.ctx, XIO_MEM_CLASS_SCRATCH,
+			TMP_RX_BUF_SIZE, 1);
 	tcp_hndl->tmp_rx_buf_cur = tcp_hndl->tmp_rx_buf;
 
 	tcp_hndl->sock.unique_id = (uint32_t)(get_cycles());
@@ -2051,6 +2128,9 @@ static void xio_tcp_task_init(struct xio_task *task,
 	xio_tcp_rxd_init(&tcp_task->rxd, buf, size);
 	xio_tcp_txd_init(&tcp_task->txd, buf, size);
 
+	INIT_LIST_HEAD(&tcp_task->frag_list_entry);
+	INIT_LIST_HEAD(&tcp_task->frag_held_list);
+
 	/* initialize the mbuf */
 	xio_mbuf_init(&task->mbuf, buf, size, 0);
 }
@@ -2081,6 +2161,10 @@ static int xio_tcp_initial_pool_slab_pre_create(
 			  pool_size);
 		return -1;
 	}
+	tcp_slab->nr = alloc_nr;
+	tcp_slab->alloc_sz = (size_t)pool_size * alloc_nr;
+	xio_ctx_mem_add(ctx, XIO_MEM_CLASS_INLINE_BUFS,
+			tcp_slab->alloc_sz, tcp_slab->nr);
 
 	return 0;
 }
@@ -2177,6 +2261,8 @@ static int xio_tcp_initial_pool_slab_destroy(
 	struct xio_tcp_tasks_slab *tcp_slab =
 		(struct xio_tcp_tasks_slab *)slab_dd_data;
 
+	xio_ctx_mem_sub(tcp_slab->ctx, XIO_MEM_CLASS_INLINE_BUFS,
+			tcp_slab->alloc_sz, tcp_slab->nr);
 	xio_context_ufree(tcp_slab->ctx, tcp_slab->data_pool);
 
 	return 0;
@@ -2261,6 +2347,17 @@ static int xio_tcp_task_pre_put(
 
 	tcp_task->out_tcp_op		= XIO_TCP_NULL;
 
+	if (tcp_task->frag_task == task) {
+		list_del_init(&tcp_task->frag_list_entry);
+		xio_tasks_list_flush(&tcp_task->frag_held_list);
+	}
+	tcp_task->frag_task		= NULL;
+	tcp_task->frag_iov		= NULL;
+	tcp_task->frag_iovlen		= 0;
+	tcp_task->frag_rx		= 0;
+	tcp_task->frag_hdr_sent		= 0;
+	tcp_task->frag_pending		= 0;
+
 	xio_tcp_rxd_init(&tcp_task->rxd,
 			 task->mbuf.buf.head,
 			 task->mbuf.buf.buflen);
@@ -2307,7 +2404,12 @@ static int xio_tcp_primary_pool_slab_pre_create(
 
 	tcp_slab->buf_size = inline_buf_sz;
 
-	if (disable_huge_pages) {
+	/* contiguous slab - inline buffers were carved by the tasks pool */
+	tcp_slab->data_pool = xio_tasks_slab_inline_bufs(slab_dd_data);
+	tcp_slab->pool_owned = !!tcp_slab->data_pool;
+	if (tcp_slab->pool_owned) {
+		DEBUG_LOG("contiguous slab pool buf:%p\n", tcp_slab->data_pool);
+	} else if (disable_huge_pages) {
 		retval = xio_mem_alloc(ctx,
 				       alloc_sz, &tcp_slab->reg_mem);
 		if (retval) {
@@ -2331,6 +2433,13 @@ static int xio_tcp_primary_pool_slab_pre_create(
 		}
 	}
 	tcp_slab->ctx = ctx;
+	if (!tcp_slab->pool_owned) {
+		/* contiguous slabs are accounted by the tasks pool */
+		tcp_slab->nr = alloc_nr;
+		tcp_slab->alloc_sz = alloc_sz;
+		xio_ctx_mem_add(ctx, XIO_MEM_CLASS_INLINE_BUFS,
+				alloc_sz, alloc_nr);
+	}
 	DEBUG_LOG("pool buf:%p\n", tcp_slab->data_pool);
 
 	return 0;
@@ -2345,7 +2454,7 @@ static int xio_tcp_primary_pool_post_create(
 {
 	struct xio_task		*task = NULL;
 	struct xio_tcp_task	*tcp_task = NULL;
-	int			i;
+	int			i, post_nr;
 	struct xio_tcp_transport *tcp_hndl =
 		(struct xio_tcp_transport *)transport_hndl;
 
@@ -2354,7 +2463,9 @@ static int xio_tcp_primary_pool_post_create(
 
 	tcp_hndl->primary_pool_cls.pool = pool;
 
-	for (i = 0; i < RX_LIST_POST_NR; i++) {
+	/* lean connections keep a single receive posted while idle */
+	post_nr = tcp_hndl->base.ctx->lean_conns ? 1 : RX_LIST_POST_NR;
+	for (i = 0; i < post_nr; i++) {
 		/* get ready to receive message */
 		task = xio_tcp_primary_task_alloc(tcp_hndl);
 		if (task == 0) {
@@ -2379,6 +2490,11 @@ static int xio_tcp_primary_pool_slab_destroy(
 	struct xio_tcp_tasks_slab *tcp_slab =
 		(struct xio_tcp_tasks_slab *)slab_dd_data;
 
+	if (tcp_slab->pool_owned)
+		return 0;
+
+	xio_ctx_mem_sub(tcp_slab->ctx, XIO_MEM_CLASS_INLINE_BUFS,
+			tcp_slab->alloc_sz, tcp_slab->nr);
 	if (tcp_slab->reg_mem.addr)
 		xio_mem_free(&tcp_slab->reg_mem);
 	else
@@ -2464,12 +2580,23 @@ static void xio_tcp_primary_pool_get_params(
 			 3 * max_iovsz * sizeof(struct xio_sge);
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_tcp_primary_pool_get_inline_buf_size				     */
+/*---------------------------------------------------------------------------*/
+static int xio_tcp_primary_pool_get_inline_buf_size(
+		struct xio_transport_base *transport_hndl)
+{
+	return xio_tcp_get_inline_buffer_size();
+}
+
 static struct xio_tasks_pool_ops   primary_tasks_pool_ops;
 /*---------------------------------------------------------------------------*/
 static void init_primary_tasks_pool_ops(void)
 {
 	primary_tasks_pool_ops.pool_get_params =
 		xio_tcp_primary_pool_get_params;
+	primary_tasks_pool_ops.pool_get_inline_buf_size =
+		xio_tcp_primary_pool_get_inline_buf_size;
 	primary_tasks_pool_ops.slab_pre_create =
 		xio_tcp_primary_pool_slab_pre_create;
 	primary_tasks_pool_ops.slab_destroy =
@@ -2551,6 +2678,12 @@ static int xio_tcp_set_opt(void *xio_obj,
 		VALIDATE_SZ(sizeof(int));
 		tcp_options.tcp_dual_sock = *((int *)optval);
 		return 0;
+	case XIO_OPTNAME_TCP_FRAG_SIZE:
+		VALIDATE_SZ(sizeof(int));
+		if (*((int *)optval) < 0)
+			break;
+		tcp_options.tcp_frag_sz = *((int *)optval);
+		return 0;
 	default:
 		break;
 	}
@@ -2601,6 +2734,10 @@ static int xio_tcp_get_opt(void  *xio_obj,
 		*((int *)optval) = tcp_options.tcp_dual_sock;
 		*optlen = sizeof(int);
 		return 0;
+	case XIO_OPTNAME_TCP_FRAG_SIZE:
+		*((int *)optval) = tcp_options.tcp_frag_sz;
+		*optlen = sizeof(int);
+		return 0;
 	default:
 		break;
 	}
@@ -72,6 +72,10 @@ extern double				g_mhz;
 
 #define RX_BATCH			32   /* Number of RX tasks to batch */
 
+#define RX_RETRY_MS			1    /* Retry period of buffered rx
+					      * waiting for free tasks
+					      */
+
 #define TCP_DEFAULT_BACKLOG		1024 /* listen socket default backlog */
 
 #define TMP_RX_BUF_SIZE			(RX_BATCH * MAX_HDR_SZ)
@@ -128,7 +132,7 @@ struct xio_tcp_options {
 	int			tcp_so_sndbuf;
 	int			tcp_so_rcvbuf;
 	int			tcp_dual_sock;
-	int			pad;
+	int			tcp_frag_sz;
 };
 
 #define XIO_TCP_REQ_HEADER_VERSION	1
@@ -141,7 +145,8 @@ PACKED_MEMORY(struct xio_tcp_req_hdr {
 	uint16_t		pad0;
 
 	uint32_t		ltid;		/* originator identifier*/
-	uint16_t		pad;
+	uint8_t			tcp_flags;	/* XIO_TCP_HDR_FLAG_*	*/
+	uint8_t			pad;
 	uint8_t			in_tcp_op;	/* opcode  for peers	*/
 	uint8_t			out_tcp_op;
 
@@ -169,7 +174,7 @@ PACKED_MEMORY(struct xio_tcp_rsp_hdr {
 	uint32_t                rtid;           /* remote task id       */
 
 	uint8_t			out_tcp_op;	/* opcode  for peers	*/
-	uint8_t			pad1;
+	uint8_t			tcp_flags;	/* XIO_TCP_HDR_FLAG_*	*/
 	uint16_t		out_num_sge;
 	uint32_t		status;		/* status		*/
 
@@ -180,6 +185,25 @@ PACKED_MEMORY(struct xio_tcp_rsp_hdr {
 	uint64_t		ulp_imm_len;	/* ulp data length	*/
 });
 
+/* the data does not follow the header but arrives in XIO_TCP_FRAG messages */
+#define XIO_TCP_HDR_FLAG_FRAGMENTED	1
+
+#define XIO_TCP_FRAG_HEADER_VERSION	1
+
+/* transport private tlv type, never passed to the nexus */
+#define XIO_TCP_FRAG			BIT(16)
+
+PACKED_MEMORY(struct xio_tcp_frag_hdr {
+	uint8_t			version;	/* fragment version	*/
+	uint8_t			flags;
+	uint16_t		frag_hdr_len;	/* frag header length	*/
+	uint16_t		sn;		/* serial number	*/
+	uint16_t		pad;
+
+	uint32_t		ltid;		/* fragmented task id	*/
+	uint32_t		len;		/* fragment data length	*/
+});
+
 #define XIO_TCP_CONNECT_MSG_VERSION	1
 
 PACKED_MEMORY(struct xio_tcp_connect_msg {
@@ -196,7 +220,7 @@ PACKED_MEMORY(struct xio_tcp_setup_msg {
 	uint32_t		max_in_iovsz;
 	uint32_t		max_out_iovsz;
 	uint32_t                max_header_len;
-	uint32_t		pad;
+	uint32_t		frag_sz;	/* 0 - no fragmentation	*/
 	uint64_t		my_handle;
 });
 
@@ -251,6 +275,20 @@ struct xio_tcp_task {
 	struct xio_sge			*rsp_out_sge;
 
 	xio_work_handle_t		comp_work;
+
+	/* large payloads are sent in fragments interleaved with other
+	 * messages. frag_task is the task itself on the fragmented message
+	 * and the fragmented message on each of its fragments
+	 */
+	struct xio_task			*frag_task;
+	struct list_head		frag_list_entry;
+	struct list_head		frag_held_list;
+	struct iovec			*frag_iov;	/* unsent data	*/
+	size_t				frag_iovlen;
+	uint8_t				frag_rx;
+	uint8_t				frag_hdr_sent;
+	uint16_t			pad1;
+	uint32_t			frag_pending;	/* in progress	*/
 };
 
 struct xio_tcp_tasks_slab {
@@ -258,7 +296,10 @@ struct xio_tcp_tasks_slab {
 	struct xio_context		*ctx;
 	struct xio_reg_mem		reg_mem;
 	int				buf_size;
+	int				pool_owned; /* data_pool is in slab */
+	int				nr;
 	int				pad;
+	size_t				alloc_sz;
 };
 
 struct xio_tcp_pending_conn {
@@ -307,6 +348,9 @@ struct xio_tcp_transport {
 	struct list_head		in_flight_list;
 	struct list_head		rx_list;
 	struct list_head		io_list;
+	/* fragmented messages - still sending or still receiving */
+	struct list_head		tx_frag_list;
+	struct list_head		rx_frag_list;
 
 	struct xio_tcp_socket		sock;
 	uint16_t			is_listen;
@@ -339,11 +383,6 @@ struct xio_tcp_transport {
 
 	struct xio_tcp_setup_msg	setup_rsp;
 
-	/* too big to be on stack - use as temporaries */
-	union {
-		struct xio_msg		dummy_msg;
-	};
-
 	struct list_head		pending_conns;
 
 	void				*tmp_rx_buf;
@@ -351,15 +390,20 @@ struct xio_tcp_transport {
 	uint32_t			tmp_rx_buf_len;
 	uint32_t			peer_max_header;
 
+	/* negotiated fragment size, 0 - fragmentation is off */
+	uint32_t			frag_sz;
+	uint32_t			frag_starved;
+
 	uint32_t			trans_attr_mask;
 	struct xio_transport_attr	trans_attr;
 
+	/* msg_iov points to the context's shared iovec scratch */
 	struct xio_tcp_work_req		tmp_work;
-	struct iovec			tmp_iovec[IOV_MAX];
 
 	struct xio_ev_data              flush_tx_event;
 	struct xio_ev_data		ctl_rx_event;
 	struct xio_ev_data		disconnect_event;
+	xio_delayed_work_handle_t	ctl_rx_work;
 };
 
 int xio_tcp_get_max_header_size(void);
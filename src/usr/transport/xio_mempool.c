@@ -47,6 +47,7 @@
 #include "xio_objpool.h"
 #include "xio_workqueue.h"
 #include "xio_context.h"
+#include "xio_trace.h"
 
 /* Accelio's default mempool profile (don't expose it) */
 #define XIO_MEM_SLABS_NR	4
@@ -105,6 +106,9 @@ struct xio_mem_region {
 	struct xio_mr			*omr;
 	void				*buf;
 	struct list_head		mem_region_entry;
+	size_t				alloc_sz;	/* region + data */
+	int				nr_blocks;
+	int				pad;
 };
 
 struct xio_mem_slab {
@@ -312,6 +316,8 @@ static int xio_mem_slab_free(struct xio_mem_slab *slab)
 			else if (test_bits(XIO_MEMPOOL_FLAG_REGULAR_PAGES_ALLOC,
 					   &slab->pool->flags))
 				xio_context_ufree(slab->pool->ctx, r->buf);
+			xio_ctx_mem_sub(slab->pool->ctx, XIO_MEM_CLASS_MEMPOOL,
+					r->alloc_sz, r->nr_blocks);
 			xio_context_ufree(slab->pool->ctx, r);
 		}
 	}
@@ -452,6 +458,11 @@ static struct xio_mem_block *xio_mem_slab_resize(struct xio_mem_slab *slab,
 
 	slab->curr_mb_nr += nr_blocks;
 
+	region->alloc_sz = region_alloc_sz + data_alloc_sz;
+	region->nr_blocks = nr_blocks;
+	xio_ctx_mem_add(slab->pool->ctx, XIO_MEM_CLASS_MEMPOOL,
+			region->alloc_sz, nr_blocks);
+
 	list_add(&region->mem_region_entry, &slab->mem_regions_list);
 
 	return block;
@@ -684,6 +695,7 @@ retry:
 #else
 	slab->used_mb_nr++;
 #endif
+	XIO_TRACE4(mempool_alloc, p, block->buf, length, slab->mb_size);
 	return 0;
 
 cleanup:
@@ -714,6 +726,8 @@ void xio_mempool_free(struct xio_reg_mem *reg_mem)
 #else
 	block->parent_slab->used_mb_nr--;
 #endif
+	XIO_TRACE3(mempool_free, block->parent_slab->pool, block->buf,
+		   reg_mem->length);
 
 	if (block->parent_slab->pool->safe_mt)
 		safe_release(block->parent_slab, block);
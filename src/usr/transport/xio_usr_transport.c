@@ -165,6 +165,30 @@ struct xio_mempool *xio_transport_mempool_get(
 	return (struct xio_mempool *)ctx->mempool;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_transport_iov_scratch_get					     */
+/*---------------------------------------------------------------------------*/
+struct iovec *xio_transport_iov_scratch_get(struct xio_context *ctx)
+{
+	/* filled and flushed within a single send/recv call on the
+	 * context's thread, so one array serves all its connections
+	 */
+	if (ctx->iov_scratch)
+		return (struct iovec *)ctx->iov_scratch;
+
+	ctx->iov_scratch = xio_context_ucalloc(ctx, IOV_MAX,
+					       sizeof(struct iovec));
+	if (!ctx->iov_scratch) {
+		xio_set_error(ENOMEM);
+		ERROR_LOG("iovec scratch allocation failed\n");
+		return NULL;
+	}
+	xio_ctx_mem_add(ctx, XIO_MEM_CLASS_SCRATCH,
+			IOV_MAX * sizeof(struct iovec), 1);
+
+	return (struct iovec *)ctx->iov_scratch;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_transport_state_str						     */
 /*---------------------------------------------------------------------------*/
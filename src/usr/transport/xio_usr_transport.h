@@ -132,6 +132,8 @@ struct xio_mempool *xio_transport_mempool_get(
 		struct xio_context *ctx,
 		int reg_mr);
 
+struct iovec *xio_transport_iov_scratch_get(struct xio_context *ctx);
+
 char *xio_transport_state_str(enum xio_transport_state state);
 
 #endif  /* XIO_COMMON_TRANSPORT_H */
@@ -56,6 +56,12 @@
 #include "xio_usr_utils.h"
 #include "xio_init.h"
 #include "xio_mem.h"
+#include "xio_stats.h"
+#include "xio_stats_shm.h"
+#include "xio_flight.h"
+#include "xio_flight_dump.h"
+#include "xio_perf_counters.h"
+#include "xio_control.h"
 
 #ifdef XIO_THREAD_SAFE_DEBUG
 #include <execinfo.h>
@@ -64,6 +70,11 @@
 #define MSGPOOL_INIT_NR	8
 #define MSGPOOL_GROW_NR	64
 
+/* lean connections mode - small primary slabs, idle slabs released */
+#define LEAN_POOL_START_NR	16
+#define LEAN_POOL_ALLOC_NR	32
+#define LEAN_POOL_SHRINK_MS	5000
+
 int xio_netlink(struct xio_context *ctx);
 
 /*---------------------------------------------------------------------------*/
@@ -155,6 +166,8 @@ struct xio_context *xio_context_create(struct xio_context_params *ctx_params,
                 ctx->register_internal_mempool =
                         !!ctx_params->register_internal_mempool;
 		ctx->rq_depth = ctx_params->rq_depth;
+		ctx->contig_task_slabs = !!ctx_params->contig_task_slabs;
+		ctx->lean_conns = !!ctx_params->lean_conns;
 	}
 	if (!ctx->max_conns_per_ctx)
 		ctx->max_conns_per_ctx = 100;
@@ -177,10 +190,29 @@ struct xio_context *xio_context_create(struct xio_context_params *ctx_params,
 		ERROR_LOG("context's msg_pool create failed. %m\n");
 		goto cleanup1;
 	}
+	if (xio_stat_sets_init(ctx))
+		goto cleanup2;
+
+	ctx->stats.hertz = g_mhz * 1000000.0 + 0.5;
+	ctx->stats.counter = ctx->stats.local_counter;
+	ctx->stats.seq = &ctx->stats.local_seq;
+	/* Init default counters' name */
+	ctx->stats.name[XIO_STAT_TX_MSG] = strdup("TX_MSG");
+	ctx->stats.name[XIO_STAT_RX_MSG] = strdup("RX_MSG");
+	ctx->stats.name[XIO_STAT_TX_BYTES] = strdup("TX_BYTES");
+	ctx->stats.name[XIO_STAT_RX_BYTES] = strdup("RX_BYTES");
+	ctx->stats.name[XIO_STAT_DELAY] = strdup("DELAY");
+	ctx->stats.name[XIO_STAT_APPDELAY] = strdup("APPDELAY");
 
 	if (-1 == xio_netlink(ctx))
 		goto cleanup2;
 
+	xio_stats_shm_create(ctx);
+	if (!xio_flight_create(ctx))
+		xio_flight_dump_register(ctx);
+	if (xio_perf_counters_create(ctx))
+		WARN_LOG("context's performance counters create failed\n");
+
 	/* initialize rdma pools only */
 	transport = xio_get_transport("rdma");
 	if (transport && ctx->prealloc_xio_inline_bufs) {
@@ -197,6 +229,14 @@ struct xio_context *xio_context_create(struct xio_context_params *ctx_params,
 			goto cleanup2;
 		}
 	}
+	if (ctx_params && ctx_params->cq_depth > 0) {
+		uint32_t cq_size = 1;
+
+		while (cq_size < (uint32_t)ctx_params->cq_depth)
+			cq_size <<= 1;
+		if (xio_context_cq_resize(ctx, cq_size))
+			goto cleanup2;
+	}
 #ifdef XIO_THREAD_SAFE_DEBUG
 	pthread_mutex_init(&ctx->dbg_thread_mutex, NULL);
 #endif
@@ -208,6 +248,11 @@ struct xio_context *xio_context_create(struct xio_context_params *ctx_params,
 	return ctx;
 
 cleanup2:
+	xio_perf_counters_destroy(ctx);
+	xio_flight_dump_unregister(ctx);
+	xio_flight_destroy(ctx);
+	xio_stats_shm_destroy(ctx);
+	xio_stat_sets_destroy(ctx);
 	xio_objpool_destroy(ctx->msg_pool);
 cleanup1:
 	xio_workqueue_destroy(ctx->workqueue);
@@ -328,10 +373,17 @@ int xio_context_destroy(struct xio_context *ctx)
 		close(fd);
 		ctx->netlink_sock = NULL;
 	}
+	xio_control_close(ctx);
+	xio_perf_counters_destroy(ctx);
+	xio_flight_dump_unregister(ctx);
+	xio_flight_destroy(ctx);
+	xio_stats_shm_destroy(ctx);
 	for (i = 0; i < XIO_STAT_LAST; i++)
 		if (ctx->stats.name[i])
 			free(ctx->stats.name[i]);
+	xio_stat_sets_destroy(ctx);
 
+	xio_ctx_del_delayed_work(ctx, &ctx->shrink_work);
 	xio_workqueue_destroy(ctx->workqueue);
 
 	xio_objpool_destroy(ctx->msg_pool);
@@ -352,6 +404,28 @@ int xio_context_destroy(struct xio_context *ctx)
 		xio_mempool_destroy((struct xio_mempool *)ctx->mempool);
 		ctx->mempool = NULL;
 	}
+
+	if (ctx->iov_scratch) {
+		xio_ctx_mem_sub(ctx, XIO_MEM_CLASS_SCRATCH,
+				IOV_MAX * sizeof(struct iovec), 1);
+		xio_context_ufree(ctx, ctx->iov_scratch);
+		ctx->iov_scratch = NULL;
+	}
+
+	if (ctx->cq) {
+		xio_context_kfree(ctx, ctx->cq);
+		ctx->cq = NULL;
+	}
+
+	/* everything accounted to the context should be released by now */
+	for (i = 0; i < XIO_MEM_CLASS_LAST; i++) {
+		if (ctx->mem_stats[i].bytes || ctx->mem_stats[i].objs)
+			ERROR_LOG("context destroy: %s leak - " \
+				  "bytes:%llu, objs:%llu\n",
+				  xio_mem_class_str((enum xio_mem_class)i),
+				  (unsigned long long)ctx->mem_stats[i].bytes,
+				  (unsigned long long)ctx->mem_stats[i].objs);
+	}
 #ifdef XIO_THREAD_SAFE_DEBUG
 	pthread_mutex_destroy(&ctx->dbg_thread_mutex);
 #endif
@@ -414,21 +488,8 @@ int xio_ctx_del_delayed_work(struct xio_context *ctx,
 /*---------------------------------------------------------------------------*/
 int xio_add_counter(struct xio_context *ctx, char *name)
 {
-	int i;
-
-	for (i = XIO_STAT_USER_FIRST; i < XIO_STAT_LAST; i++) {
-		if (!ctx->stats.name[i]) {
-			ctx->stats.name[i] = strdup(name);
-			if (!ctx->stats.name[i]) {
-				ERROR_LOG("stddup failed. %m");
-				return -1;
-			}
-			ctx->stats.counter[i] = 0;
-			return i;
-		}
-	}
-
-	return -1;
+	return xio_stat_register(ctx, ctx->stat_set, name,
+				 XIO_STAT_TYPE_COUNTER);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -436,16 +497,7 @@ int xio_add_counter(struct xio_context *ctx, char *name)
 /*---------------------------------------------------------------------------*/
 int xio_del_counter(struct xio_context *ctx, int counter)
 {
-	if (counter < XIO_STAT_USER_FIRST || counter >= XIO_STAT_LAST) {
-		ERROR_LOG("counter(%d) out of range\n", counter);
-		return -1;
-	}
-
-	/* free the name and mark as free for reuse */
-	free(ctx->stats.name[counter]);
-	ctx->stats.name[counter] = NULL;
-
-	return 0;
+	return xio_stat_unregister(ctx->stat_set, counter);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -484,6 +536,10 @@ int xio_query_context(struct xio_context *ctx,
 	if (attr_mask & XIO_CONTEXT_ATTR_USER_CTX)
 		attr->user_context = ctx->user_context;
 
+	if (attr_mask & XIO_CONTEXT_ATTR_MEM_STATS)
+		memcpy(attr->mem_stats, ctx->mem_stats,
+		       sizeof(attr->mem_stats));
+
 	return 0;
 }
 EXPORT_SYMBOL(xio_query_context);
@@ -731,6 +787,26 @@ void xio_context_set_poll_completions_fn(
 }
 EXPORT_SYMBOL(xio_context_set_poll_completions_fn);
 
+/*---------------------------------------------------------------------------*/
+/* xio_ctx_pools_shrink_handler						     */
+/*---------------------------------------------------------------------------*/
+static void xio_ctx_pools_shrink_handler(int actual_timeout_ms, void *data)
+{
+	struct xio_context	*ctx = (struct xio_context *)data;
+	int			i;
+
+	xio_ctx_del_delayed_work(ctx, &ctx->shrink_work);
+
+	for (i = 0; i < XIO_PROTO_LAST; i++) {
+		xio_tasks_pool_shrink(ctx->initial_tasks_pool[i]);
+		xio_tasks_pool_shrink(ctx->primary_tasks_pool[i]);
+	}
+
+	xio_ctx_add_delayed_work(ctx, LEAN_POOL_SHRINK_MS, ctx,
+				 xio_ctx_pools_shrink_handler,
+				 &ctx->shrink_work);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_ctx_pool_create							     */
 /*-------------------------------------/--------------------------------------*/
@@ -815,7 +891,14 @@ int xio_ctx_pool_create(struct xio_context *ctx, enum xio_proto proto,
 	if (ctx->prealloc_xio_inline_bufs) {
 		params.start_nr = params.max_nr;
 		params.alloc_nr = 0;
+	} else if (ctx->lean_conns &&
+		   pool_cls == XIO_CONTEXT_POOL_CLASS_PRIMARY) {
+		params.start_nr = min(params.start_nr, LEAN_POOL_START_NR);
+		params.alloc_nr = min(params.alloc_nr, LEAN_POOL_ALLOC_NR);
 	}
+	if (ctx->contig_task_slabs && pool_ops->pool_get_inline_buf_size)
+		params.task_inline_buf_sz =
+			pool_ops->pool_get_inline_buf_size(NULL);
 	params.pool_hooks.slab_pre_create  =
 		(int (*)(void *, struct xio_context *, int, void *, void *))
 				pool_ops->slab_pre_create;
@@ -851,6 +934,10 @@ int xio_ctx_pool_create(struct xio_context *ctx, enum xio_proto proto,
 		ERROR_LOG("xio_tasks_pool_create failed\n");
 		return -1;
 	}
+	if (ctx->lean_conns)
+		xio_ctx_add_delayed_work(ctx, LEAN_POOL_SHRINK_MS, ctx,
+					 xio_ctx_pools_shrink_handler,
+					 &ctx->shrink_work);
 
 	return 0;
 }
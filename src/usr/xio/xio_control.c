@@ -0,0 +1,692 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <sys/hashtable.h>
+#include <xio_os.h>
+#include <sys/un.h>
+#include "libxio.h"
+#include "xio_log.h"
+#include "xio_common.h"
+#include "xio_hash.h"
+#include "xio_protocol.h"
+#include "xio_mbuf.h"
+#include "xio_task.h"
+#include "xio_observer.h"
+#include "xio_transport.h"
+#include "xio_msg_list.h"
+#include "xio_ev_data.h"
+#include "xio_ev_loop.h"
+#include "xio_objpool.h"
+#include "xio_workqueue.h"
+#include "xio_sg_table.h"
+#include "xio_context.h"
+#include "xio_nexus.h"
+#include "xio_session.h"
+#include "xio_stats.h"
+#include "xio_connection.h"
+#include "xio_control.h"
+
+/* one request and one reply per datagram */
+#define XIO_CONTROL_REQ_MAX		512
+#define XIO_CONTROL_REPLY_MAX		8192
+#define XIO_CONTROL_ARGS_MAX		8
+
+/* option scopes */
+#define XIO_CONTROL_LIVE		(1 << 0)  /* existing objects too */
+#define XIO_CONTROL_LOWER_ONLY		(1 << 1)  /* sizes buffers at setup */
+
+struct xio_control {
+	int			fd;
+	int			pad;
+	char			path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+};
+
+struct xio_control_reply {
+	size_t			len;
+	char			buf[XIO_CONTROL_REPLY_MAX];
+};
+
+struct xio_control_opt {
+	const char		*name;
+	int			level;
+	int			optname;
+	int			optlen;
+	int			flags;
+};
+
+static const struct xio_control_opt xio_control_opts[] = {
+	{ "log_level", XIO_OPTLEVEL_ACCELIO, XIO_OPTNAME_LOG_LEVEL,
+	  sizeof(enum xio_log_level), XIO_CONTROL_LIVE },
+	{ "log_async", XIO_OPTLEVEL_ACCELIO, XIO_OPTNAME_LOG_ASYNC,
+	  sizeof(int), XIO_CONTROL_LIVE },
+	{ "enable_keepalive", XIO_OPTLEVEL_ACCELIO,
+	  XIO_OPTNAME_ENABLE_KEEPALIVE, sizeof(int), XIO_CONTROL_LIVE },
+	{ "msg_sample_rate", XIO_OPTLEVEL_ACCELIO, XIO_OPTNAME_MSG_SAMPLE_RATE,
+	  sizeof(int), XIO_CONTROL_LIVE },
+	{ "flight_dump_on_error", XIO_OPTLEVEL_ACCELIO,
+	  XIO_OPTNAME_FLIGHT_DUMP_ON_ERROR, sizeof(int), XIO_CONTROL_LIVE },
+	{ "enable_flow_control", XIO_OPTLEVEL_ACCELIO,
+	  XIO_OPTNAME_ENABLE_FLOW_CONTROL, sizeof(int), 0 },
+	/* the setter reads a uint64_t */
+	{ "snd_queue_depth_msgs", XIO_OPTLEVEL_ACCELIO,
+	  XIO_OPTNAME_SND_QUEUE_DEPTH_MSGS, sizeof(uint64_t), 0 },
+	{ "rcv_queue_depth_msgs", XIO_OPTLEVEL_ACCELIO,
+	  XIO_OPTNAME_RCV_QUEUE_DEPTH_MSGS, sizeof(int), 0 },
+	{ "snd_queue_depth_bytes", XIO_OPTLEVEL_ACCELIO,
+	  XIO_OPTNAME_SND_QUEUE_DEPTH_BYTES, sizeof(uint64_t), 0 },
+	{ "rcv_queue_depth_bytes", XIO_OPTLEVEL_ACCELIO,
+	  XIO_OPTNAME_RCV_QUEUE_DEPTH_BYTES, sizeof(uint64_t), 0 },
+	{ "max_inline_xio_header", XIO_OPTLEVEL_ACCELIO,
+	  XIO_OPTNAME_MAX_INLINE_XIO_HEADER, sizeof(int),
+	  XIO_CONTROL_LIVE | XIO_CONTROL_LOWER_ONLY },
+	{ "max_inline_xio_data", XIO_OPTLEVEL_ACCELIO,
+	  XIO_OPTNAME_MAX_INLINE_XIO_DATA, sizeof(int),
+	  XIO_CONTROL_LIVE | XIO_CONTROL_LOWER_ONLY },
+	{ "tcp_no_delay", XIO_OPTLEVEL_TCP, XIO_OPTNAME_TCP_NO_DELAY,
+	  sizeof(int), 0 },
+	{ "tcp_so_sndbuf", XIO_OPTLEVEL_TCP, XIO_OPTNAME_TCP_SO_SNDBUF,
+	  sizeof(int), 0 },
+	{ "tcp_so_rcvbuf", XIO_OPTLEVEL_TCP, XIO_OPTNAME_TCP_SO_RCVBUF,
+	  sizeof(int), 0 },
+	{ "tcp_frag_size", XIO_OPTLEVEL_TCP, XIO_OPTNAME_TCP_FRAG_SIZE,
+	  sizeof(int), 0 },
+};
+
+/* the keepalive parameters are one option, struct xio_options_keepalive */
+static const struct {
+	const char		*name;
+	size_t			offset;
+} xio_control_ka[] = {
+	{ "keepalive_probes", offsetof(struct xio_options_keepalive, probes) },
+	{ "keepalive_time", offsetof(struct xio_options_keepalive, time) },
+	{ "keepalive_intvl", offsetof(struct xio_options_keepalive, intvl) },
+};
+
+enum xio_control_param_obj {
+	XIO_CONTROL_PARAM_CONNECTION,
+	XIO_CONTROL_PARAM_SESSION
+};
+
+/* connection parameters, set through xio_modify_connection/session */
+static const struct {
+	const char		*name;
+	int			obj;		/* enum xio_control_param_obj */
+	int			attr_mask;
+	size_t			offset;
+	size_t			size;
+} xio_control_params[] = {
+#define XIO_CONN_PARAM(name, mask, field)				\
+	{ #name, XIO_CONTROL_PARAM_CONNECTION, XIO_CONNECTION_ATTR_##mask, \
+	  offsetof(struct xio_connection_attr, field),			\
+	  sizeof(((struct xio_connection_attr *)0)->field) }
+#define XIO_SES_PARAM(name, mask, field)				\
+	{ #name, XIO_CONTROL_PARAM_SESSION, XIO_SESSION_ATTR_##mask,	\
+	  offsetof(struct xio_session_attr, field),			\
+	  sizeof(((struct xio_session_attr *)0)->field) }
+	XIO_CONN_PARAM(disconnect_timeout, DISCONNECT_TIMEOUT,
+		       disconnect_timeout_secs),
+	XIO_CONN_PARAM(agg_max_bytes, AGGREGATION, agg_max_bytes),
+	XIO_CONN_PARAM(agg_max_delay_us, AGGREGATION, agg_max_delay_us),
+	XIO_CONN_PARAM(comp_max_msgs, COMP_COALESCING, comp_max_msgs),
+	XIO_CONN_PARAM(comp_max_delay_us, COMP_COALESCING, comp_max_delay_us),
+	XIO_SES_PARAM(tx_weight, TX_WEIGHT, tx_weight),
+	XIO_SES_PARAM(snd_queue_depth_msgs, SND_QUEUE_DEPTH,
+		      snd_queue_depth_msgs),
+	XIO_SES_PARAM(snd_queue_depth_bytes, SND_QUEUE_DEPTH,
+		      snd_queue_depth_bytes),
+#undef XIO_CONN_PARAM
+#undef XIO_SES_PARAM
+};
+
+/*---------------------------------------------------------------------------*/
+/* xio_control_printf							     */
+/*---------------------------------------------------------------------------*/
+static void xio_control_printf(struct xio_control_reply *reply,
+			       const char *fmt, ...)
+{
+	size_t	room = sizeof(reply->buf) - reply->len;
+	va_list	ap;
+	int	n;
+
+	if (room <= 1)
+		return;
+
+	va_start(ap, fmt);
+	n = vsnprintf(reply->buf + reply->len, room, fmt, ap);
+	va_end(ap);
+	if (n < 0)
+		return;
+
+	reply->len += min((size_t)n, room - 1);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_control_error							     */
+/*---------------------------------------------------------------------------*/
+static void xio_control_error(struct xio_control_reply *reply, int error)
+{
+	reply->len = 0;
+	xio_control_printf(reply, "error %s\n", xio_strerror(error));
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_control_parse							     */
+/*---------------------------------------------------------------------------*/
+static int xio_control_parse(const char *str, uint64_t *val)
+{
+	char *end;
+
+	if (*str == '-')
+		return -1;
+	errno = 0;
+	*val = strtoull(str, &end, 0);
+	if (errno || end == str || *end)
+		return -1;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_control_get_opt							     */
+/*---------------------------------------------------------------------------*/
+static int xio_control_get_opt(const struct xio_control_opt *opt,
+			       uint64_t *val)
+{
+	union {
+		int		i;
+		uint64_t	u64;
+	} optval;
+	int optlen = sizeof(optval);
+
+	memset(&optval, 0, sizeof(optval));
+	if (xio_get_opt(NULL, opt->level, opt->optname, &optval, &optlen))
+		return -1;
+
+	*val = (optlen == sizeof(uint64_t)) ? optval.u64 :
+					      (uint64_t)(unsigned)optval.i;
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_control_set_opt							     */
+/*---------------------------------------------------------------------------*/
+static int xio_control_set_opt(const struct xio_control_opt *opt,
+			       uint64_t val)
+{
+	union {
+		int		i;
+		uint64_t	u64;
+	} optval;
+	uint64_t cur;
+
+	if (opt->optlen == sizeof(int) && val > INT_MAX) {
+		xio_set_error(EINVAL);
+		return -1;
+	}
+	/* the transports sized their buffers by the value at setup */
+	if (opt->flags & XIO_CONTROL_LOWER_ONLY) {
+		if (xio_control_get_opt(opt, &cur))
+			return -1;
+		if (val > cur) {
+			xio_set_error(EPERM);
+			return -1;
+		}
+	}
+	memset(&optval, 0, sizeof(optval));
+	if (opt->optlen == sizeof(uint64_t))
+		optval.u64 = val;
+	else
+		optval.i = (int)val;
+
+	return xio_set_opt(NULL, opt->level, opt->optname, &optval,
+			   opt->optlen);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_control_ka							     */
+/*---------------------------------------------------------------------------*/
+static int xio_control_ka_opt(int idx, int set, uint64_t *val)
+{
+	struct xio_options_keepalive	ka;
+	int				optlen = sizeof(ka);
+	int				*field;
+
+	if (xio_get_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+			XIO_OPTNAME_CONFIG_KEEPALIVE, &ka, &optlen))
+		return -1;
+	field = (int *)((char *)&ka + xio_control_ka[idx].offset);
+	if (!set) {
+		*val = (uint64_t)*field;
+		return 0;
+	}
+	if (*val > INT_MAX) {
+		xio_set_error(EINVAL);
+		return -1;
+	}
+	*field = (int)*val;
+
+	return xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+			   XIO_OPTNAME_CONFIG_KEEPALIVE, &ka, sizeof(ka));
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_control_options							     */
+/*---------------------------------------------------------------------------*/
+static void xio_control_options(struct xio_control_reply *reply)
+{
+	const struct xio_control_opt	*opt;
+	uint64_t			val;
+	size_t				i;
+
+	for (i = 0; i < ARRAY_SIZE(xio_control_opts); i++) {
+		opt = &xio_control_opts[i];
+		if (xio_control_get_opt(opt, &val))
+			continue;
+		xio_control_printf(reply, "%s %llu %s\n", opt->name,
+				   (unsigned long long)val,
+				   !(opt->flags & XIO_CONTROL_LIVE) ? "new" :
+				   (opt->flags & XIO_CONTROL_LOWER_ONLY) ?
+					"live,lower-only" : "live");
+	}
+	for (i = 0; i < ARRAY_SIZE(xio_control_ka); i++) {
+		if (xio_control_ka_opt(i, 0, &val))
+			continue;
+		xio_control_printf(reply, "%s %llu new\n",
+				   xio_control_ka[i].name,
+				   (unsigned long long)val);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_control_option							     */
+/*---------------------------------------------------------------------------*/
+static void xio_control_option(struct xio_control_reply *reply,
+			       int argc, char **argv)
+{
+	int		set = !strcmp(argv[0], "set");
+	uint64_t	val = 0;
+	size_t		i;
+
+	if (argc != (set ? 3 : 2) ||
+	    (set && xio_control_parse(argv[2], &val))) {
+		xio_control_error(reply, EINVAL);
+		return;
+	}
+	for (i = 0; i < ARRAY_SIZE(xio_control_opts); i++) {
+		if (strcmp(argv[1], xio_control_opts[i].name))
+			continue;
+		if (set ? xio_control_set_opt(&xio_control_opts[i], val) :
+			  xio_control_get_opt(&xio_control_opts[i], &val))
+			goto error;
+		goto done;
+	}
+	for (i = 0; i < ARRAY_SIZE(xio_control_ka); i++) {
+		if (strcmp(argv[1], xio_control_ka[i].name))
+			continue;
+		if (xio_control_ka_opt(i, set, &val))
+			goto error;
+		goto done;
+	}
+	xio_control_error(reply, ENOENT);
+	return;
+
+done:
+	if (set)
+		xio_control_printf(reply, "ok\n");
+	else
+		xio_control_printf(reply, "%s %llu\n", argv[1],
+				   (unsigned long long)val);
+	return;
+
+error:
+	xio_control_error(reply, xio_errno());
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_control_lookup_connection					     */
+/*---------------------------------------------------------------------------*/
+static struct xio_connection *xio_control_lookup_connection(
+		struct xio_context *ctx, const char *handle)
+{
+	struct xio_connection	*connection, *found = NULL;
+	uint64_t		addr;
+
+	if (xio_control_parse(handle, &addr))
+		return NULL;
+
+	spin_lock(&ctx->ctx_list_lock);
+	list_for_each_entry(connection, &ctx->ctx_list, ctx_list_entry) {
+		if ((uintptr_t)connection == (uintptr_t)addr) {
+			found = connection;
+			break;
+		}
+	}
+	spin_unlock(&ctx->ctx_list_lock);
+
+	return found;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_control_conns							     */
+/*---------------------------------------------------------------------------*/
+static void xio_control_conns(struct xio_context *ctx,
+			      struct xio_control_reply *reply)
+{
+	struct xio_connection *connection;
+
+	spin_lock(&ctx->ctx_list_lock);
+	list_for_each_entry(connection, &ctx->ctx_list, ctx_list_entry) {
+		xio_control_printf(reply, "%p %s %s\n", connection,
+				   xio_connection_state_str(
+						connection->state),
+				   (connection->session &&
+				    connection->session->uri) ?
+					connection->session->uri : "-");
+	}
+	spin_unlock(&ctx->ctx_list_lock);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_control_param							     */
+/*---------------------------------------------------------------------------*/
+static int xio_control_param(struct xio_connection *connection, int idx,
+			     int set, uint64_t *val)
+{
+	struct xio_connection_attr	cattr;
+	struct xio_session_attr		sattr;
+	int				mask = xio_control_params[idx].attr_mask;
+	size_t				size = xio_control_params[idx].size;
+	char				*field;
+	int				conn;
+
+	conn = (xio_control_params[idx].obj == XIO_CONTROL_PARAM_CONNECTION);
+	memset(&cattr, 0, sizeof(cattr));
+	memset(&sattr, 0, sizeof(sattr));
+	if (conn ? xio_query_connection(connection, &cattr, mask) :
+		   xio_query_session(connection->session, &sattr, mask))
+		return -1;
+
+	field = (conn ? (char *)&cattr : (char *)&sattr) +
+		xio_control_params[idx].offset;
+	if (!set) {
+		if (size == sizeof(uint16_t))
+			*val = *(uint16_t *)field;
+		else if (size == sizeof(uint32_t))
+			*val = *(uint32_t *)field;
+		else
+			*val = *(uint64_t *)field;
+		return 0;
+	}
+	if (size < sizeof(uint64_t) && (*val >> (size * 8))) {
+		xio_set_error(EINVAL);
+		return -1;
+	}
+	if (size == sizeof(uint16_t))
+		*(uint16_t *)field = (uint16_t)*val;
+	else if (size == sizeof(uint32_t))
+		*(uint32_t *)field = (uint32_t)*val;
+	else
+		*(uint64_t *)field = *val;
+
+	return conn ? xio_modify_connection(connection, &cattr, mask) :
+		      xio_modify_session(connection->session, &sattr, mask);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_control_conn							     */
+/*---------------------------------------------------------------------------*/
+static void xio_control_conn(struct xio_context *ctx,
+			     struct xio_control_reply *reply,
+			     int argc, char **argv)
+{
+	struct xio_connection	*connection;
+	uint64_t		val = 0;
+	size_t			i;
+	int			set;
+
+	if (argc < 2) {
+		xio_control_error(reply, EINVAL);
+		return;
+	}
+	connection = xio_control_lookup_connection(ctx, argv[1]);
+	if (!connection || !connection->session) {
+		xio_control_error(reply, ENOENT);
+		return;
+	}
+	if (argc == 2) {
+		for (i = 0; i < ARRAY_SIZE(xio_control_params); i++) {
+			if (xio_control_param(connection, i, 0, &val))
+				continue;
+			xio_control_printf(reply, "%s %llu\n",
+					   xio_control_params[i].name,
+					   (unsigned long long)val);
+		}
+		return;
+	}
+	set = !strcmp(argv[2], "set");
+	if ((!set && strcmp(argv[2], "get")) || argc != (set ? 5 : 4) ||
+	    (set && xio_control_parse(argv[4], &val))) {
+		xio_control_error(reply, EINVAL);
+		return;
+	}
+	for (i = 0; i < ARRAY_SIZE(xio_control_params); i++) {
+		if (strcmp(argv[3], xio_control_params[i].name))
+			continue;
+		if (xio_control_param(connection, i, set, &val)) {
+			xio_control_error(reply, xio_errno());
+			return;
+		}
+		if (set)
+			xio_control_printf(reply, "ok\n");
+		else
+			xio_control_printf(reply, "%s %llu\n", argv[3],
+					   (unsigned long long)val);
+		return;
+	}
+	xio_control_error(reply, ENOENT);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_control_request							     */
+/*---------------------------------------------------------------------------*/
+static void xio_control_request(struct xio_context *ctx, char *req,
+				struct xio_control_reply *reply)
+{
+	char	*argv[XIO_CONTROL_ARGS_MAX];
+	char	*saveptr = NULL;
+	char	*tok;
+	int	argc = 0;
+
+	for (tok = strtok_r(req, " \t\r\n", &saveptr); tok;
+	     tok = strtok_r(NULL, " \t\r\n", &saveptr)) {
+		if (argc == XIO_CONTROL_ARGS_MAX) {
+			xio_control_error(reply, EINVAL);
+			return;
+		}
+		argv[argc++] = tok;
+	}
+	if (!argc || !strcmp(argv[0], "help")) {
+		xio_control_printf(reply,
+			"options\n"
+			"get <option>\n"
+			"set <option> <value>\n"
+			"conns\n"
+			"conn <handle> [get <param> | set <param> <value>]\n");
+	} else if (!strcmp(argv[0], "options")) {
+		xio_control_options(reply);
+	} else if (!strcmp(argv[0], "get") || !strcmp(argv[0], "set")) {
+		xio_control_option(reply, argc, argv);
+	} else if (!strcmp(argv[0], "conns")) {
+		xio_control_conns(ctx, reply);
+	} else if (!strcmp(argv[0], "conn")) {
+		xio_control_conn(ctx, reply, argc, argv);
+	} else {
+		xio_control_error(reply, EOPNOTSUPP);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_control_handler							     */
+/*---------------------------------------------------------------------------*/
+static void xio_control_handler(int fd, int events, void *data)
+{
+	struct xio_context		*ctx = (struct xio_context *)data;
+	struct xio_control_reply	reply;
+	struct sockaddr_un		peer;
+	socklen_t			peer_len;
+	char				req[XIO_CONTROL_REQ_MAX];
+	ssize_t				len;
+
+	while (1) {
+		peer_len = sizeof(peer);
+		len = recvfrom(fd, req, sizeof(req) - 1, 0,
+			       (struct sockaddr *)&peer, &peer_len);
+		if (len < 0) {
+			if (errno != EAGAIN && errno != EINTR)
+				ERROR_LOG("control recvfrom failed. %m\n");
+			if (errno != EINTR)
+				return;
+			continue;
+		}
+		req[len] = '\0';
+		reply.len = 0;
+		xio_control_request(ctx, req, &reply);
+
+		/* unbound senders get no reply */
+		if (peer_len <= sizeof(sa_family_t))
+			continue;
+		if (sendto(fd, reply.buf, reply.len, MSG_DONTWAIT,
+			   (struct sockaddr *)&peer, peer_len) < 0)
+			DEBUG_LOG("control reply failed. %m\n");
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_context_open_control						     */
+/*---------------------------------------------------------------------------*/
+int xio_context_open_control(struct xio_context *ctx, const char *path)
+{
+	struct xio_control	*control;
+	struct sockaddr_un	addr;
+	struct stat		st;
+
+	if (!ctx) {
+		xio_set_error(EINVAL);
+		return -1;
+	}
+	if (!path) {
+		xio_control_close(ctx);
+		return 0;
+	}
+	if (ctx->control) {
+		xio_set_error(EBUSY);
+		ERROR_LOG("context %p control socket is open\n", ctx);
+		return -1;
+	}
+	if (!*path || strlen(path) >= sizeof(addr.sun_path)) {
+		xio_set_error(ENAMETOOLONG);
+		ERROR_LOG("invalid control socket path\n");
+		return -1;
+	}
+	control = (struct xio_control *)xio_context_ucalloc(ctx, 1,
+							    sizeof(*control));
+	if (!control) {
+		xio_set_error(ENOMEM);
+		return -1;
+	}
+	strcpy(control->path, path);
+
+	control->fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK |
+			     SOCK_CLOEXEC, 0);
+	if (control->fd < 0) {
+		xio_set_error(errno);
+		ERROR_LOG("socket failed. %m\n");
+		goto cleanup;
+	}
+	/* a socket left behind by a previous run */
+	if (!lstat(path, &st) && S_ISSOCK(st.st_mode))
+		unlink(path);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	if (bind(control->fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		xio_set_error(errno);
+		ERROR_LOG("control socket bind to %s failed. %m\n", path);
+		goto cleanup1;
+	}
+	/* the socket changes the process' options - owner only */
+	if (chmod(path, S_IRUSR | S_IWUSR)) {
+		xio_set_error(errno);
+		ERROR_LOG("chmod %s failed. %m\n", path);
+		goto cleanup2;
+	}
+	if (xio_ev_loop_add(ctx->ev_loop, control->fd, XIO_POLLIN,
+			    xio_control_handler, ctx))
+		goto cleanup2;
+
+	ctx->control = control;
+	DEBUG_LOG("context %p control socket %s\n", ctx, path);
+
+	return 0;
+
+cleanup2:
+	unlink(path);
+cleanup1:
+	close(control->fd);
+cleanup:
+	xio_context_ufree(ctx, control);
+	return -1;
+}
+EXPORT_SYMBOL(xio_context_open_control);
+
+/*---------------------------------------------------------------------------*/
+/* xio_control_close							     */
+/*---------------------------------------------------------------------------*/
+void xio_control_close(struct xio_context *ctx)
+{
+	struct xio_control *control = ctx->control;
+
+	if (!control)
+		return;
+
+	xio_ev_loop_del(ctx->ev_loop, control->fd);
+	close(control->fd);
+	unlink(control->path);
+	ctx->control = NULL;
+	xio_context_ufree(ctx, control);
+}
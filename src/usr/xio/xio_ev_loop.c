@@ -49,8 +49,8 @@
 #include "xio_workqueue.h"
 #include "xio_observer.h"
 #include "xio_context.h"
-
-#define MAX_DELETED_EVENTS	1024
+#include "xio_trace.h"
+#include "xio_perf_counters.h"
 
 /*---------------------------------------------------------------------------*/
 /* structs                                                                   */
@@ -69,7 +69,8 @@ struct xio_ev_loop {
 	struct list_head		events_list;
 	struct xio_context		*ctx;
 	struct xio_ev_data		*tev_next;	
-	struct xio_ev_data		*deleted_events[MAX_DELETED_EVENTS];
+	/* handlers deleted while their events may still be dispatched */
+	struct list_head		deleted_events_list;
 };
 
 /*---------------------------------------------------------------------------*/
@@ -199,13 +200,10 @@ int xio_ev_loop_del(void *loop_hndl, int fd)
 			ERROR_LOG("event lookup failed. fd:%d\n", fd);
 			return -1;
 		}
-		list_del(&tev->events_list_entry);
-		if (loop->deleted_events_nr < MAX_DELETED_EVENTS) {
-			loop->deleted_events[loop->deleted_events_nr] = tev;
-			loop->deleted_events_nr++;
-		} else {
-			ERROR_LOG("failed to delete event\n");
-		}
+		/* no bound - a mass teardown closes thousands at once */
+		list_move_tail(&tev->events_list_entry,
+			       &loop->deleted_events_list);
+		loop->deleted_events_nr++;
 	}
 
 	ret = epoll_ctl(loop->efd, EPOLL_CTL_DEL, fd, NULL);
@@ -269,6 +267,7 @@ void *xio_ev_loop_create(struct xio_context *ctx)
 
 	INIT_LIST_HEAD(&loop->poll_events_list);
 	INIT_LIST_HEAD(&loop->events_list);
+	INIT_LIST_HEAD(&loop->deleted_events_list);
 
 	loop->ctx		= ctx;
 	loop->stop_loop		= 0;
@@ -382,6 +381,7 @@ static int xio_ev_loop_exec_scheduled(struct xio_ev_loop *loop)
 			event_handler		= tev->handler;
 			event_data		= tev->data;
 			events_list_entry	= &tev->events_list_entry;
+			XIO_TRACE3(ev_event, loop, event_handler, event_data);
 			event_handler(event_data);
 			if (events_list_entry == last_sched)
 				break;
@@ -399,15 +399,31 @@ static int xio_ev_loop_exec_scheduled(struct xio_ev_loop *loop)
 static inline int xio_ev_loop_deleted_event_lookup(struct xio_ev_loop *loop,
 						   struct xio_ev_data *tev)
 {
-	int j;
+	struct xio_ev_data *deleted;
 
-	for (j = 0; j < loop->deleted_events_nr; j++) {
-		if (loop->deleted_events[j] == tev)
+	list_for_each_entry(deleted, &loop->deleted_events_list,
+			    events_list_entry) {
+		if (deleted == tev)
 			return 1;
 	}
 	return 0;
 }
 
+/*---------------------------------------------------------------------------*/
+/* xio_ev_loop_free_deleted						     */
+/*---------------------------------------------------------------------------*/
+static void xio_ev_loop_free_deleted(struct xio_ev_loop *loop)
+{
+	struct xio_ev_data *tev, *tmp_tev;
+
+	list_for_each_entry_safe(tev, tmp_tev, &loop->deleted_events_list,
+				 events_list_entry) {
+		list_del(&tev->events_list_entry);
+		xio_context_ufree(loop->ctx, tev);
+	}
+	loop->deleted_events_nr = 0;
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_ev_loop_run_helper                                                    */
 /*---------------------------------------------------------------------------*/
@@ -422,20 +438,23 @@ static inline int xio_ev_loop_run_helper(void *loop_hndl, int timeout)
 	int			wait_time = timeout;
 	uint32_t		out_events;
 	cycles_t		start_cycle  = 0;
+	struct xio_perf_counters *perf = loop->ctx ? loop->ctx->perf : NULL;
 
 	if (timeout != -1)
 		start_cycle = get_cycles();
 
 retry:
+	if (unlikely(perf))
+		xio_perf_counters_phase(perf, XIO_PERF_PHASE_SCHEDULED);
 	work_remains = xio_ev_loop_exec_scheduled(loop);
 	tmout = work_remains ? 0 : timeout;
 
 	/* free deleted event handlers */
 	if (unlikely(loop->deleted_events_nr))
-		while (loop->deleted_events_nr)
-			xio_context_ufree(loop->ctx,
-				loop->deleted_events[--loop->deleted_events_nr]);
+		xio_ev_loop_free_deleted(loop);
 
+	if (unlikely(perf))
+		xio_perf_counters_phase(perf, XIO_PERF_PHASE_WAIT);
 	nevent = epoll_wait(loop->efd, events, ARRAY_SIZE(events), tmout);
 	if (unlikely(nevent < 0)) {
 		if (errno != EINTR) {
@@ -445,6 +464,9 @@ retry:
 		}
 		goto retry;
 	} else if (nevent > 0) {
+		if (unlikely(perf))
+			xio_perf_counters_phase(perf,
+						XIO_PERF_PHASE_DISPATCH);
 		/* save the epoll modify in "stop" while dispatching handlers */
 		loop->in_dispatch = 1;
 		for (i = 0; i < nevent; i++) {
@@ -464,6 +486,8 @@ retry:
 					epoll_to_xio_poll_events(
 							events[i].events);
 				/* (fd != loop->wakeup_event) */
+				XIO_TRACE3(ev_dispatch, loop, tev->fd,
+					   out_events);
 				tev->ev_handler(tev->fd, out_events,
 						tev->data);
 			} else {
@@ -507,11 +531,12 @@ retry:
 			xio_ev_loop_exec_scheduled(loop);
 
 		/* free deleted event handlers */
-		while (loop->deleted_events_nr)
-			xio_context_ufree(loop->ctx,
-					  loop->deleted_events[--loop->deleted_events_nr]);
+		xio_ev_loop_free_deleted(loop);
 	}
 
+	if (unlikely(perf))
+		xio_perf_counters_phase(perf, XIO_PERF_PHASE_NONE);
+
 	loop->stop_loop = 0;
 	loop->wakeup_armed = 0;
 
@@ -581,8 +606,7 @@ void xio_ev_loop_destroy(void *loop_hndl)
 	}
 
 	/* free deleted event handlers */
-	while (loop->deleted_events_nr)
-		xio_context_ufree(loop->ctx, loop->deleted_events[--loop->deleted_events_nr]);
+	xio_ev_loop_free_deleted(loop);
 
 	xio_ev_loop_del(loop, loop->wakeup_event);
 
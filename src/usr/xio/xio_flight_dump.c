@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <xio_os.h>
+#include <signal.h>
+#include "libxio.h"
+#include "xio_log.h"
+#include "xio_common.h"
+#include "xio_observer.h"
+#include "xio_ev_data.h"
+#include "xio_ev_loop.h"
+#include "xio_objpool.h"
+#include "xio_workqueue.h"
+#include "xio_context.h"
+#include "xio_flight.h"
+#include "xio_flight_dump.h"
+
+#define XIO_FLIGHT_MAX_CTXS		64
+#define XIO_FLIGHT_PATH_LEN		192
+
+/* contexts the signal handler dumps - slots are claimed lock free */
+static struct xio_context *xio_flight_ctxs[XIO_FLIGHT_MAX_CTXS];
+static int xio_flight_signum;
+/* dump files are named by the context's id, unique in the process */
+static uint32_t xio_flight_next_id;
+/* resolved ahead, getenv is no business of a signal handler */
+static char xio_flight_dir[XIO_FLIGHT_PATH_LEN - 48] = XIO_FLIGHT_DUMP_DIR;
+static thread_once_t xio_flight_dir_once = THREAD_ONCE_INIT;
+
+/*---------------------------------------------------------------------------*/
+/* xio_flight_write_all							     */
+/*---------------------------------------------------------------------------*/
+static int xio_flight_write_all(int fd, const void *buf, size_t len)
+{
+	const char	*p = (const char *)buf;
+	ssize_t		n;
+
+	while (len) {
+		n = write(fd, p, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		p += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_flight_write							     */
+/*---------------------------------------------------------------------------*/
+/* async signal safe - called from the dump signal's handler */
+static int xio_flight_write(struct xio_context *ctx, int fd)
+{
+	struct xio_flight	*flight = ctx->flight;
+	struct xio_flight_dump	dump;
+	struct timespec		ts;
+	uint64_t		head;
+	uint32_t		nrecs, first, n;
+
+	head = flight->head;
+	xio_smp_rmb();
+	/* when the ring is full its oldest slot may be the one the
+	 * interrupted writer is filling - leave it out
+	 */
+	nrecs = head < XIO_FLIGHT_RECORDS - 1 ? (uint32_t)head :
+						  XIO_FLIGHT_RECORDS - 1;
+	first = (uint32_t)(head - nrecs) & (XIO_FLIGHT_RECORDS - 1);
+
+	memset(&dump, 0, sizeof(dump));
+	clock_gettime(CLOCK_REALTIME, &ts);
+	dump.magic	= XIO_FLIGHT_MAGIC;
+	dump.version	= XIO_FLIGHT_VERSION;
+	dump.rec_size	= sizeof(struct xio_flight_rec);
+	dump.nrecs	= nrecs;
+	dump.pid	= (int32_t)getpid();
+	dump.ctx_id	= flight->id;
+	dump.cpuid	= ctx->cpuid;
+	dump.hertz	= ctx->stats.hertz;
+	dump.head	= head;
+	dump.cycles	= get_cycles();
+	dump.time_ns	= ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+	if (xio_flight_write_all(fd, &dump, sizeof(dump)))
+		return -1;
+
+	n = min(nrecs, XIO_FLIGHT_RECORDS - first);
+	if (xio_flight_write_all(fd, &flight->recs[first],
+				 n * sizeof(struct xio_flight_rec)))
+		return -1;
+
+	return xio_flight_write_all(fd, flight->recs,
+				    (nrecs - n) * sizeof(struct xio_flight_rec));
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_flight_utoa							     */
+/*---------------------------------------------------------------------------*/
+static char *xio_flight_utoa(char *p, unsigned long val)
+{
+	char		tmp[24];
+	int		i = 0;
+
+	do {
+		tmp[i++] = '0' + val % 10;
+		val /= 10;
+	} while (val);
+	while (i)
+		*p++ = tmp[--i];
+
+	return p;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_flight_dir_init							     */
+/*---------------------------------------------------------------------------*/
+/* dumps go to the user's private runtime directory when there is one */
+static void xio_flight_dir_init(void)
+{
+	const char *dir = getenv("XDG_RUNTIME_DIR");
+
+	if (dir && dir[0] == '/' && strlen(dir) < sizeof(xio_flight_dir))
+		strcpy(xio_flight_dir, dir);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_flight_dump_file							     */
+/*---------------------------------------------------------------------------*/
+/* async signal safe - the path is built without stdio. the name is
+ * predictable, so links and files of other users planted there are
+ * refused rather than followed or overwritten
+ */
+static int xio_flight_dump_file(struct xio_context *ctx, char *path)
+{
+	static const char	prefix[] = "/" XIO_FLIGHT_DUMP_PREFIX;
+	struct stat		st;
+	size_t			len = strlen(xio_flight_dir);
+	char			*p = path;
+	int			fd, retval;
+
+	memcpy(p, xio_flight_dir, len);
+	memcpy(p + len, prefix, sizeof(prefix) - 1);
+	p = xio_flight_utoa(p + len + sizeof(prefix) - 1,
+			    (unsigned long)getpid());
+	*p++ = '.';
+	p = xio_flight_utoa(p, ctx->flight->id);
+	*p = 0;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) || !S_ISREG(st.st_mode) ||
+	    st.st_uid != geteuid()) {
+		close(fd);
+		errno = EEXIST;
+		return -1;
+	}
+	retval = ftruncate(fd, 0) ? -1 : xio_flight_write(ctx, fd);
+	close(fd);
+
+	return retval;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_flight_signal_handler						     */
+/*---------------------------------------------------------------------------*/
+static void xio_flight_signal_handler(int signum)
+{
+	struct xio_context	*ctx;
+	char			path[XIO_FLIGHT_PATH_LEN];
+	int			saved_errno = errno;
+	int			i;
+
+	for (i = 0; i < XIO_FLIGHT_MAX_CTXS; i++) {
+		ctx = xio_flight_ctxs[i];
+		if (ctx)
+			xio_flight_dump_file(ctx, path);
+	}
+	errno = saved_errno;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_flight_on_error							     */
+/*---------------------------------------------------------------------------*/
+static void xio_flight_on_error(struct xio_context *ctx)
+{
+	char	path[XIO_FLIGHT_PATH_LEN];
+
+	if (!g_options.flight_dump_on_error)
+		return;
+
+	if (xio_flight_dump_file(ctx, path))
+		WARN_LOG("flight recorder dump to %s failed. %m\n", path);
+	else
+		WARN_LOG("flight recorder dumped to %s\n", path);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_flight_dump_register						     */
+/*---------------------------------------------------------------------------*/
+void xio_flight_dump_register(struct xio_context *ctx)
+{
+	struct sigaction	sa;
+	int			i;
+
+	if (!ctx->flight)
+		return;
+
+	thread_once(&xio_flight_dir_once, xio_flight_dir_init);
+
+	ctx->flight->on_error = xio_flight_on_error;
+	ctx->flight->id = xio_sync_fetch_and_add32(&xio_flight_next_id, 1);
+	for (i = 0; i < XIO_FLIGHT_MAX_CTXS; i++) {
+		if (xio_sync_bool_compare_and_swap(&xio_flight_ctxs[i],
+						   NULL, ctx))
+			break;
+	}
+	ctx->flight->slot = i;
+	if (i == XIO_FLIGHT_MAX_CTXS) {
+		/* dumped on error or on demand only */
+		DEBUG_LOG("flight recorder: no dump slot. ctx:%p\n", ctx);
+	}
+
+	if (!g_options.flight_dump_signal ||
+	    g_options.flight_dump_signal == xio_flight_signum)
+		return;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = xio_flight_signal_handler;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	if (sigaction(g_options.flight_dump_signal, &sa, NULL)) {
+		WARN_LOG("flight recorder: sigaction %d failed. %m\n",
+			 g_options.flight_dump_signal);
+		return;
+	}
+	xio_flight_signum = g_options.flight_dump_signal;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_flight_dump_unregister						     */
+/*---------------------------------------------------------------------------*/
+void xio_flight_dump_unregister(struct xio_context *ctx)
+{
+	if (!ctx->flight || ctx->flight->slot >= XIO_FLIGHT_MAX_CTXS)
+		return;
+
+	xio_flight_ctxs[ctx->flight->slot] = NULL;
+	xio_smp_wmb();
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_context_dump_flight						     */
+/*---------------------------------------------------------------------------*/
+int xio_context_dump_flight(struct xio_context *ctx, int fd)
+{
+	if (!ctx->flight) {
+		xio_set_error(ENOMEM);
+		return -1;
+	}
+	if (xio_flight_write(ctx, fd)) {
+		xio_set_error(errno);
+		return -1;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL(xio_context_dump_flight);
@@ -0,0 +1,682 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <xio_os.h>
+#include "libxio.h"
+#include "xio_log.h"
+#include "xio_common.h"
+#include "xio_observer.h"
+#include "xio_ev_data.h"
+#include "xio_ev_loop.h"
+#include "xio_objpool.h"
+#include "xio_workqueue.h"
+#include "xio_sg_table.h"
+#include "xio_context.h"
+
+#define XIO_HEDGE_DEF_PERCENTILE	95
+#define XIO_HEDGE_DEF_MIN_DELAY_US	1000
+#define XIO_HEDGE_HIST_BUCKETS		128
+#define XIO_HEDGE_MIN_SAMPLES		64
+#define XIO_HEDGE_WINDOW		4096
+#define XIO_HEDGE_UPDATE_MASK		31
+
+/* copy of a request, the primary or its hedge */
+enum xio_hedge_copy_state {
+	XIO_HEDGE_COPY_IDLE,
+	XIO_HEDGE_COPY_SENT,
+	XIO_HEDGE_COPY_SETTLED,
+};
+
+struct xio_hedge_conn {
+	struct xio_connection		*conn;
+	uint64_t			srtt_ns;	/* smoothed latency */
+};
+
+struct xio_hedge_req {
+	struct xio_msg_hooks		hooks;		/* must be first */
+	struct xio_hedge		*hedge;
+	struct xio_msg			*req;
+	struct list_head		pending_entry;
+	struct xio_msg			copy[2];
+	uint64_t			sent_ns[2];
+	void				*in_buf[2];	/* private responses */
+	uint32_t			conn_idx[2];
+	uint32_t			in_len;
+	uint32_t			hdr_len;
+	uint32_t			timeout_us;
+	uint32_t			prio_flags;
+	uint8_t				state[2];
+	uint8_t				done;
+	uint8_t				busy;
+	uint32_t			out_len;
+	uint8_t				out_buf[];
+};
+
+struct xio_hedge {
+	struct xio_context		*ctx;
+	struct xio_hedge_ops		ops;
+	void				*cb_user_context;
+	struct xio_hedge_conn		*conns;
+	struct xio_objpool		*req_pool;
+	uint32_t			nconns;
+	uint32_t			percentile;
+	uint64_t			min_delay_ns;
+	uint64_t			delay_ns;
+	uint32_t			nreqs;		/* incl. losing copies */
+	uint32_t			nactive;	/* not yet completed */
+	uint32_t			nsamples;
+	int				destroyed;
+	uint32_t			hist[XIO_HEDGE_HIST_BUCKETS];
+
+	/* requests waiting for the hedge delay, in send order */
+	struct list_head		pending_list;
+	xio_delayed_work_handle_t	hedge_work;
+	struct xio_ev_data		hedge_event;
+	int				event_armed;
+	int				pad;
+};
+
+static void xio_hedge_on_response(struct xio_connection *connection,
+				  struct xio_msg *msg);
+static void xio_hedge_on_error(struct xio_connection *connection,
+			       struct xio_msg *msg, enum xio_status error,
+			       enum xio_msg_direction direction);
+
+/*---------------------------------------------------------------------------*/
+/* xio_hedge_ns_now							     */
+/*---------------------------------------------------------------------------*/
+static inline uint64_t xio_hedge_ns_now(void)
+{
+	struct timespec ts;
+
+	xio_clock_gettime(&ts);
+
+	return (ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_hedge_bucket							     */
+/*---------------------------------------------------------------------------*/
+/* log2 buckets of microseconds split in four, within 25% of the value */
+static inline int xio_hedge_bucket(uint64_t us)
+{
+	int e;
+
+	if (us < 4)
+		return (int)us;
+	e = 63 - __builtin_clzll(us);
+	if (e > 32)
+		return XIO_HEDGE_HIST_BUCKETS - 1;
+
+	return 4 + (e - 2) * 4 + (int)((us >> (e - 2)) & 3);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_hedge_bucket_us							     */
+/*---------------------------------------------------------------------------*/
+/* upper bound of a bucket */
+static inline uint64_t xio_hedge_bucket_us(int bucket)
+{
+	int e, sub;
+
+	if (bucket < 4)
+		return bucket + 1;
+	e   = (bucket - 4) / 4 + 2;
+	sub = (bucket - 4) % 4;
+
+	return (uint64_t)(4 + sub + 1) << (e - 2);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_hedge_add_sample							     */
+/*---------------------------------------------------------------------------*/
+static void xio_hedge_add_sample(struct xio_hedge *hedge,
+				 struct xio_hedge_conn *hconn,
+				 uint64_t lat_ns)
+{
+	uint64_t target, sum = 0;
+	int	 i;
+
+	hconn->srtt_ns = hconn->srtt_ns ?
+		hconn->srtt_ns - (hconn->srtt_ns >> 3) + (lat_ns >> 3) :
+		lat_ns;
+
+	hedge->hist[xio_hedge_bucket(lat_ns / 1000)]++;
+	if (++hedge->nsamples == XIO_HEDGE_WINDOW) {
+		/* age the window so the delay follows the servers */
+		hedge->nsamples = 0;
+		for (i = 0; i < XIO_HEDGE_HIST_BUCKETS; i++) {
+			hedge->hist[i] >>= 1;
+			hedge->nsamples += hedge->hist[i];
+		}
+	}
+	if (hedge->nsamples < XIO_HEDGE_MIN_SAMPLES ||
+	    (hedge->nsamples & XIO_HEDGE_UPDATE_MASK))
+		return;
+
+	target = (uint64_t)hedge->nsamples * hedge->percentile / 100;
+	for (i = 0; i < XIO_HEDGE_HIST_BUCKETS - 1; i++) {
+		sum += hedge->hist[i];
+		if (sum > target)
+			break;
+	}
+	hedge->delay_ns = max(xio_hedge_bucket_us(i) * 1000,
+			      hedge->min_delay_ns);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_hedge_pick							     */
+/*---------------------------------------------------------------------------*/
+/* fastest connection other than skip */
+static int xio_hedge_pick(struct xio_hedge *hedge, int skip)
+{
+	uint32_t i;
+	int	 best = -1;
+
+	for (i = 0; i < hedge->nconns; i++) {
+		if ((int)i == skip)
+			continue;
+		if (best < 0 ||
+		    hedge->conns[i].srtt_ns < hedge->conns[best].srtt_ns)
+			best = i;
+	}
+
+	return best;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_hedge_submit							     */
+/*---------------------------------------------------------------------------*/
+static int xio_hedge_submit(struct xio_hedge_req *hreq, int i, int idx)
+{
+	struct xio_hedge	*hedge = hreq->hedge;
+
+	/* the copy may fail and settle from within xio_send_request */
+	hreq->conn_idx[i] = idx;
+	hreq->sent_ns[i]  = xio_hedge_ns_now();
+	hreq->state[i]	  = XIO_HEDGE_COPY_SENT;
+	if (xio_send_request(hedge->conns[idx].conn, &hreq->copy[i]) == 0)
+		return 0;
+	/* a copy that got its type was queued - only the transmission
+	 * failed and the copy still completes through its hooks. copies
+	 * start zeroed, see xio_hedge_send_copy
+	 */
+	if (hreq->state[i] != XIO_HEDGE_COPY_SENT ||
+	    hreq->copy[i].type == XIO_MSG_TYPE_REQ)
+		return 0;
+	hreq->state[i]	  = XIO_HEDGE_COPY_IDLE;
+
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_hedge_send_copy							     */
+/*---------------------------------------------------------------------------*/
+/* sends copy i on the fastest connection other than skip */
+static int xio_hedge_send_copy(struct xio_hedge_req *hreq, int i, int skip)
+{
+	struct xio_hedge	*hedge = hreq->hedge;
+	struct xio_msg		*msg = &hreq->copy[i];
+	uint32_t		hdr_len = hreq->hdr_len;
+	int			idx;
+
+	memset(msg, 0, sizeof(*msg));
+	msg->out.header.iov_base	= hdr_len ? hreq->out_buf : NULL;
+	msg->out.header.iov_len		= hdr_len;
+	msg->out.sgl_type		= XIO_SGL_TYPE_IOV;
+	msg->out.data_iov.max_nents	= XIO_IOVLEN;
+	if (hreq->out_len > hdr_len) {
+		msg->out.data_iov.nents			= 1;
+		msg->out.data_iov.sglist[0].iov_base	=
+						hreq->out_buf + hdr_len;
+		msg->out.data_iov.sglist[0].iov_len	=
+						hreq->out_len - hdr_len;
+	}
+	/* each copy receives into its own buffer, the caller's in side
+	 * only sizes it - the losing copy may still be written to
+	 */
+	msg->in.sgl_type		= XIO_SGL_TYPE_IOV;
+	msg->in.data_iov.max_nents	= XIO_IOVLEN;
+	if (hreq->in_len) {
+		if (!hreq->in_buf[i]) {
+			hreq->in_buf[i] = umalloc(hreq->in_len);
+			if (!hreq->in_buf[i]) {
+				xio_set_error(ENOMEM);
+				ERROR_LOG("malloc failed. %m\n");
+				return -1;
+			}
+		}
+		msg->in.data_iov.nents			= 1;
+		msg->in.data_iov.sglist[0].iov_base	= hreq->in_buf[i];
+		msg->in.data_iov.sglist[0].iov_len	= hreq->in_len;
+	}
+	msg->flags			= XIO_MSG_FLAG_EX_HOOKED |
+					  hreq->prio_flags;
+	msg->timeout_us			= hreq->timeout_us;
+	msg->user_context		= hreq;
+
+	idx = xio_hedge_pick(hedge, skip);
+	if (idx < 0)
+		return -1;
+	if (xio_hedge_submit(hreq, i, idx) == 0)
+		return 0;
+
+	/* a primary falls back to the next fastest connection */
+	if (skip < 0) {
+		idx = xio_hedge_pick(hedge, idx);
+		if (idx >= 0 && xio_hedge_submit(hreq, i, idx) == 0)
+			return 0;
+	}
+
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_hedge_free							     */
+/*---------------------------------------------------------------------------*/
+static void xio_hedge_free(struct xio_hedge_req *hreq)
+{
+	ufree(hreq->in_buf[0]);
+	ufree(hreq->in_buf[1]);
+	xio_objpool_free(hreq);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_hedge_release							     */
+/*---------------------------------------------------------------------------*/
+static void xio_hedge_release(struct xio_hedge *hedge)
+{
+	xio_objpool_destroy(hedge->req_pool);
+	ufree(hedge->conns);
+	ufree(hedge);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_hedge_finish							     */
+/*---------------------------------------------------------------------------*/
+static inline void xio_hedge_finish(struct xio_hedge_req *hreq)
+{
+	hreq->done = 1;
+	hreq->hedge->nactive--;
+	list_del_init(&hreq->pending_entry);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_hedge_put							     */
+/*---------------------------------------------------------------------------*/
+static void xio_hedge_put(struct xio_hedge_req *hreq)
+{
+	struct xio_hedge *hedge = hreq->hedge;
+
+	if (!hreq->done || hreq->busy ||
+	    hreq->state[0] == XIO_HEDGE_COPY_SENT ||
+	    hreq->state[1] == XIO_HEDGE_COPY_SENT)
+		return;
+
+	xio_hedge_free(hreq);
+	/* the last losing copy completes a deferred destroy */
+	if (--hedge->nreqs == 0 && hedge->destroyed)
+		xio_hedge_release(hedge);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_hedge_arm							     */
+/*---------------------------------------------------------------------------*/
+static void xio_hedge_handler(int actual_timeout_ms, void *data);
+
+static void xio_hedge_arm(struct xio_hedge *hedge, uint64_t now)
+{
+	struct xio_hedge_req	*hreq;
+	uint64_t		due;
+
+	if (hedge->event_armed ||
+	    xio_is_delayed_work_pending(&hedge->hedge_work))
+		return;
+
+	hreq = list_first_entry(&hedge->pending_list,
+				struct xio_hedge_req, pending_entry);
+	due = hreq->sent_ns[0] + hedge->delay_ns;
+
+	/* timers tick in milliseconds, a hedge is sent at most a
+	 * millisecond late rather than spin the loop till it is due
+	 */
+	if (due > now) {
+		if (xio_ctx_add_delayed_work(
+				hedge->ctx,
+				(int)((due - now + 999999) / 1000000),
+				hedge, xio_hedge_handler,
+				&hedge->hedge_work) == 0)
+			return;
+		ERROR_LOG("xio_ctx_add_delayed_work failed.\n");
+	}
+	hedge->event_armed = 1;
+	xio_context_add_event(hedge->ctx, &hedge->hedge_event);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_hedge_handler							     */
+/*---------------------------------------------------------------------------*/
+static void xio_hedge_handler(int actual_timeout_ms, void *data)
+{
+	struct xio_hedge	*hedge = (struct xio_hedge *)data;
+	struct xio_hedge_req	*hreq;
+	uint64_t		now = xio_hedge_ns_now();
+
+	while (!list_empty(&hedge->pending_list)) {
+		hreq = list_first_entry(&hedge->pending_list,
+					struct xio_hedge_req, pending_entry);
+		if (now < hreq->sent_ns[0] + hedge->delay_ns) {
+			xio_hedge_arm(hedge, now);
+			return;
+		}
+		list_del_init(&hreq->pending_entry);
+		xio_hedge_send_copy(hreq, 1, hreq->conn_idx[0]);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_hedge_event_handler						     */
+/*---------------------------------------------------------------------------*/
+static void xio_hedge_event_handler(void *data)
+{
+	struct xio_hedge *hedge = (struct xio_hedge *)data;
+
+	hedge->event_armed = 0;
+	xio_hedge_handler(0, hedge);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_hedge_on_response						     */
+/*---------------------------------------------------------------------------*/
+static void xio_hedge_on_response(struct xio_connection *connection,
+				  struct xio_msg *msg)
+{
+	struct xio_hedge_req	*hreq = (struct xio_hedge_req *)
+						msg->user_context;
+	struct xio_hedge	*hedge = hreq->hedge;
+	int			i = (msg == &hreq->copy[1]);
+	int			other = 1 - i;
+
+	xio_hedge_add_sample(hedge, &hedge->conns[hreq->conn_idx[i]],
+			     xio_hedge_ns_now() - hreq->sent_ns[i]);
+
+	if (!hreq->done) {
+		xio_hedge_finish(hreq);
+		if (hedge->ops.on_response)
+			hedge->ops.on_response(hedge, hreq->req, msg,
+					       hedge->cb_user_context);
+	}
+	xio_release_response(msg);
+
+	/* the copy settles only now so the cancel below can not free hreq */
+	if (hreq->state[other] == XIO_HEDGE_COPY_SENT)
+		xio_cancel_request(hedge->conns[hreq->conn_idx[other]].conn,
+				   &hreq->copy[other]);
+	hreq->state[i] = XIO_HEDGE_COPY_SETTLED;
+
+	xio_hedge_put(hreq);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_hedge_on_error							     */
+/*---------------------------------------------------------------------------*/
+static void xio_hedge_on_error(struct xio_connection *connection,
+			       struct xio_msg *msg, enum xio_status error,
+			       enum xio_msg_direction direction)
+{
+	struct xio_hedge_req	*hreq = (struct xio_hedge_req *)
+						msg->user_context;
+	struct xio_hedge	*hedge = hreq->hedge;
+	int			i = (msg == &hreq->copy[1]);
+	int			other = 1 - i;
+
+	if (direction == XIO_MSG_DIRECTION_IN)
+		xio_release_response(msg);
+	hreq->state[i] = XIO_HEDGE_COPY_SETTLED;
+
+	if (!hreq->done) {
+		/* the primary failed before its hedge was due - send it now */
+		if (hreq->state[other] == XIO_HEDGE_COPY_IDLE &&
+		    error != XIO_E_TIMEOUT) {
+			list_del_init(&hreq->pending_entry);
+			if (xio_hedge_send_copy(hreq, other,
+						hreq->conn_idx[i]) == 0)
+				return;
+		}
+		if (hreq->state[other] != XIO_HEDGE_COPY_SENT) {
+			xio_hedge_finish(hreq);
+			if (hedge->ops.on_error)
+				hedge->ops.on_error(hedge, hreq->req, error,
+						    hedge->cb_user_context);
+		}
+	}
+	xio_hedge_put(hreq);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_hedge_create							     */
+/*---------------------------------------------------------------------------*/
+struct xio_hedge *xio_hedge_create(struct xio_context *ctx,
+				   struct xio_hedge_params *params)
+{
+	struct xio_hedge	*hedge;
+	uint32_t		i;
+
+	if (!ctx || !params || !params->conns || !params->nconns ||
+	    !params->ops || params->percentile > 99) {
+		xio_set_error(EINVAL);
+		ERROR_LOG("invalid hedge parameters\n");
+		return NULL;
+	}
+	for (i = 0; i < params->nconns; i++) {
+		if (!params->conns[i]) {
+			xio_set_error(EINVAL);
+			ERROR_LOG("invalid hedge connection %u\n", i);
+			return NULL;
+		}
+	}
+
+	hedge = (struct xio_hedge *)ucalloc(1, sizeof(*hedge));
+	if (!hedge) {
+		xio_set_error(ENOMEM);
+		ERROR_LOG("calloc failed. %m\n");
+		return NULL;
+	}
+	hedge->conns = (struct xio_hedge_conn *)
+			ucalloc(params->nconns, sizeof(*hedge->conns));
+	if (!hedge->conns) {
+		xio_set_error(ENOMEM);
+		ERROR_LOG("calloc failed. %m\n");
+		goto cleanup;
+	}
+	hedge->req_pool = xio_objpool_create(
+				ctx,
+				sizeof(struct xio_hedge_req) +
+				g_options.max_inline_xio_hdr +
+				g_options.max_inline_xio_data,
+				16, 16);
+	if (!hedge->req_pool) {
+		ERROR_LOG("failed to create hedge requests pool\n");
+		goto cleanup;
+	}
+	for (i = 0; i < params->nconns; i++)
+		hedge->conns[i].conn = params->conns[i];
+
+	hedge->ctx		= ctx;
+	hedge->ops		= *params->ops;
+	hedge->cb_user_context	= params->user_context;
+	hedge->nconns		= params->nconns;
+	hedge->percentile	= params->percentile ? params->percentile :
+				  XIO_HEDGE_DEF_PERCENTILE;
+	hedge->min_delay_ns	= 1000ULL * (params->min_delay_us ?
+						params->min_delay_us :
+						XIO_HEDGE_DEF_MIN_DELAY_US);
+	hedge->delay_ns		= hedge->min_delay_ns;
+	INIT_LIST_HEAD(&hedge->pending_list);
+	hedge->hedge_event.handler	= xio_hedge_event_handler;
+	hedge->hedge_event.data		= hedge;
+
+	return hedge;
+
+cleanup:
+	ufree(hedge->conns);
+	ufree(hedge);
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_hedge_destroy							     */
+/*---------------------------------------------------------------------------*/
+int xio_hedge_destroy(struct xio_hedge *hedge)
+{
+	if (!hedge) {
+		xio_set_error(EINVAL);
+		return -1;
+	}
+	if (hedge->nactive) {
+		xio_set_error(EBUSY);
+		ERROR_LOG("hedge destroy failed. %u requests in flight\n",
+			  hedge->nactive);
+		return -1;
+	}
+	xio_ctx_del_delayed_work(hedge->ctx, &hedge->hedge_work);
+	if (hedge->event_armed)
+		xio_context_disable_event(&hedge->hedge_event);
+
+	/* canceled copies still on the wire hold the group until they end */
+	if (hedge->nreqs) {
+		hedge->destroyed = 1;
+		return 0;
+	}
+	xio_hedge_release(hedge);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_hedge_send_request						     */
+/*---------------------------------------------------------------------------*/
+int xio_hedge_send_request(struct xio_hedge *hedge, struct xio_msg *req)
+{
+	struct xio_hedge_req	*hreq;
+	struct xio_sg_table_ops	*sgtbl_ops;
+	void			*sgtbl;
+	void			*sg;
+	size_t			data_len;
+	uint8_t			*ptr;
+	unsigned int		i;
+
+	if (!hedge || !req) {
+		xio_set_error(EINVAL);
+		return -1;
+	}
+	sgtbl		= xio_sg_table_get(&req->out);
+	sgtbl_ops	= (struct xio_sg_table_ops *)
+				xio_sg_table_ops_get(req->out.sgl_type);
+	data_len	= tbl_length(sgtbl_ops, sgtbl);
+	if (req->out.header.iov_len > (size_t)g_options.max_inline_xio_hdr ||
+	    data_len > (size_t)g_options.max_inline_xio_data) {
+		xio_set_error(EMSGSIZE);
+		ERROR_LOG("hedged request too long. hdr:%zd data:%zd\n",
+			  req->out.header.iov_len, data_len);
+		return -1;
+	}
+
+	hreq = (struct xio_hedge_req *)xio_objpool_alloc(hedge->req_pool);
+	if (!hreq) {
+		xio_set_error(ENOMEM);
+		ERROR_LOG("hedge requests pool is empty\n");
+		return -1;
+	}
+	hreq->hooks.on_response	= xio_hedge_on_response;
+	hreq->hooks.on_error	= xio_hedge_on_error;
+	hreq->hedge		= hedge;
+	hreq->req		= req;
+	hreq->state[0]		= XIO_HEDGE_COPY_IDLE;
+	hreq->state[1]		= XIO_HEDGE_COPY_IDLE;
+	hreq->done		= 0;
+	hreq->busy		= 1;
+	hreq->in_buf[0]		= NULL;
+	hreq->in_buf[1]		= NULL;
+	sgtbl_ops		= (struct xio_sg_table_ops *)
+					xio_sg_table_ops_get(req->in.sgl_type);
+	hreq->in_len		= (uint32_t)tbl_length(sgtbl_ops,
+					xio_sg_table_get(&req->in));
+	INIT_LIST_HEAD(&hreq->pending_entry);
+
+	/* both copies share one private image of the request, the hedge
+	 * copy is built after the application may have reused it
+	 */
+	hreq->hdr_len		= (uint32_t)req->out.header.iov_len;
+	hreq->timeout_us	= req->timeout_us;
+	hreq->prio_flags	= (uint32_t)(req->flags &
+					     XIO_MSG_FLAG_PRIO_MASK);
+	ptr = hreq->out_buf;
+	if (req->out.header.iov_len) {
+		memcpy(ptr, req->out.header.iov_base, req->out.header.iov_len);
+		ptr += req->out.header.iov_len;
+	}
+	for_each_sge(sgtbl, sgtbl_ops, sg, i) {
+		memcpy(ptr, sge_addr(sgtbl_ops, sg), sge_length(sgtbl_ops, sg));
+		ptr += sge_length(sgtbl_ops, sg);
+	}
+	hreq->out_len = (uint32_t)(ptr - hreq->out_buf);
+
+	hedge->nreqs++;
+	hedge->nactive++;
+	if (xio_hedge_send_copy(hreq, 0, -1)) {
+		hedge->nreqs--;
+		hedge->nactive--;
+		xio_hedge_free(hreq);
+		return -1;
+	}
+	hreq->busy = 0;
+
+	if (unlikely(hreq->done)) {
+		/* completed from within the send */
+		xio_hedge_put(hreq);
+		return 0;
+	}
+	if (hedge->nconns > 1 && hreq->state[1] == XIO_HEDGE_COPY_IDLE) {
+		list_add_tail(&hreq->pending_entry, &hedge->pending_list);
+		xio_hedge_arm(hedge, hreq->sent_ns[0]);
+	}
+
+	return 0;
+}
@@ -38,6 +38,7 @@
 #include <xio_os.h>
 #include "libxio.h"
 #include "xio_log.h"
+#include "xio_common.h"
 
 void xio_vlog(const char *file, unsigned line, const char *function,
 	      unsigned level, const char *fmt, ...);
@@ -47,31 +48,73 @@ xio_log_fn		xio_vlog_fn = xio_vlog;
 
 #define LOG_TIME_FMT "%04d/%02d/%02d-%02d:%02d:%02d.%05ld"
 
+#define XIO_LOG_MSG_LEN			512
+#define XIO_LOG_RING_SLOTS		256	/* power of two */
+#define XIO_LOG_IDLE_US			5000
+#define XIO_LOG_SITES			256	/* power of two */
+#define XIO_LOG_SITE_BURST		10	/* messages per second */
+
+static const char * const level_str[] = {
+	"FATAL", "ERROR", "WARN", "INFO", "DEBUG", "TRACE"
+};
+
+/* a message formatted by the logging thread and written by the writer */
+struct xio_log_rec {
+	struct timeval		tv;
+	const char		*file;
+	uint32_t		line;
+	uint32_t		level;
+	char			msg[XIO_LOG_MSG_LEN];
+};
+
+/* single producer - the owning thread, single consumer - the writer */
+struct xio_log_ring {
+	struct xio_log_ring	*next;
+	uint32_t		head;		/* written by the owner	  */
+	uint32_t		tail;		/* written by the writer  */
+	uint32_t		dropped;	/* ring was full	  */
+	uint32_t		reported;	/* drops already reported */
+	int			owned;		/* 0 - free for a thread  */
+	int			pad;
+	struct xio_log_rec	recs[XIO_LOG_RING_SLOTS];
+};
+
+/* repeats of one error or warning call site within a second */
+struct xio_log_site {
+	const char		*file;
+	uint32_t		line;
+	uint32_t		count;
+	uint64_t		sec;
+	uint32_t		suppressed;
+	uint32_t		level;
+};
+
+static struct xio_log_site	xio_log_sites[XIO_LOG_SITES];
+/* second of the last sweep for suppressed counts, synchronous mode */
+static uint64_t			xio_log_sweep_sec;
+
+/* rings are never freed, a thread that exits leaves its ring to the next */
+static struct xio_log_ring	*xio_log_rings;
+static __thread struct xio_log_ring *xio_log_ring;
+static pthread_key_t		xio_log_ring_key;
+static pthread_once_t		xio_log_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t		xio_log_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t		xio_log_writer_thread;
+static volatile int		xio_log_async;
+static volatile int		xio_log_stop;
+
 /*---------------------------------------------------------------------------*/
-/* xio_vlog								     */
+/* xio_log_write							     */
 /*---------------------------------------------------------------------------*/
-void xio_vlog(const char *file, unsigned line, const char *function,
-	      unsigned level, const char *fmt, ...)
+static void xio_log_write(const struct timeval *tv, const char *file,
+			  unsigned line, unsigned level, const char *msg)
 {
-	va_list			args;
 	const char		*short_file;
-	struct timeval		tv;
 	struct tm		t;
-	char			buf[2048];
 	char			buf2[256];
-	int			length = 0;
-	static const char * const level_str[] = {
-		"FATAL", "ERROR", "WARN", "INFO", "DEBUG", "TRACE"
-	};
-	time_t time1;
+	time_t			time1;
 
-	va_start(args, fmt);
-	length = vsnprintf(buf, sizeof(buf), fmt, args);
-	va_end(args);
-	buf[length] = 0;
-
-	gettimeofday(&tv, NULL);
-	time1 = (time_t)tv.tv_sec;
+	time1 = (time_t)tv->tv_sec;
 	localtime_r(&time1, &t);
 
 	short_file = strrchr(file, '/');
@@ -81,14 +124,344 @@ void xio_vlog(const char *file, unsigned line, const char *function,
 	/*
 	fprintf(stderr,
 		"[%012lu.%06lu] %-28s [%-5s] - %s",
-		tv.tv_sec, tv.tv_usec, buf2, level_str[level], buf);
+		tv->tv_sec, tv->tv_usec, buf2, level_str[level], msg);
 	*/
 	fprintf(stderr,
 		"[" LOG_TIME_FMT "] %-28s [%-5s] - %s",
 		t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
-		t.tm_hour, t.tm_min, t.tm_sec, tv.tv_usec,
+		t.tm_hour, t.tm_min, t.tm_sec, tv->tv_usec,
 		buf2,
-		level_str[level], buf);
+		level_str[level], msg);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_site_allow							     */
+/*---------------------------------------------------------------------------*/
+static void xio_log_site_report(struct xio_log_site *site,
+				const struct timeval *tv, int direct);
+
+/* approximate - threads logging from one site at once may race on the
+ * counters, which can only let a few more messages through
+ */
+static int xio_log_site_allow(const char *file, unsigned line,
+			      unsigned level, const struct timeval *tv)
+{
+	struct xio_log_site	*site;
+	uintptr_t		hash = (uintptr_t)file ^ (line * 2654435761U);
+
+	site = &xio_log_sites[(hash ^ (hash >> 12)) & (XIO_LOG_SITES - 1)];
+	if (site->file != file || site->line != line ||
+	    site->sec != (uint64_t)tv->tv_sec) {
+		/* the count of the previous second or of an evicted site */
+		xio_log_site_report(site, tv, 0);
+		site->file = file;
+		site->line = line;
+		site->level = level;
+		site->sec = tv->tv_sec;
+		site->count = 0;
+	}
+	if (++site->count > XIO_LOG_SITE_BURST) {
+		site->suppressed++;
+		return 0;
+	}
+
+	return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_ring_release							     */
+/*---------------------------------------------------------------------------*/
+static void xio_log_ring_release(void *data)
+{
+	struct xio_log_ring *ring = (struct xio_log_ring *)data;
+
+	__atomic_store_n(&ring->owned, 0, __ATOMIC_RELEASE);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_key_create							     */
+/*---------------------------------------------------------------------------*/
+static void xio_log_key_create(void)
+{
+	pthread_key_create(&xio_log_ring_key, xio_log_ring_release);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_ring_get							     */
+/*---------------------------------------------------------------------------*/
+static struct xio_log_ring *xio_log_ring_get(void)
+{
+	struct xio_log_ring	*ring;
+
+	if (likely(xio_log_ring))
+		return xio_log_ring;
+
+	pthread_once(&xio_log_once, xio_log_key_create);
+	for (ring = __atomic_load_n(&xio_log_rings, __ATOMIC_ACQUIRE); ring;
+	     ring = ring->next) {
+		if (xio_sync_bool_compare_and_swap(&ring->owned, 0, 1))
+			goto found;
+	}
+	/* outlives the library, keep it off the user's allocator */
+	ring = (struct xio_log_ring *)calloc(1, sizeof(*ring));
+	if (!ring)
+		return NULL;
+	ring->owned = 1;
+	do {
+		ring->next = __atomic_load_n(&xio_log_rings, __ATOMIC_ACQUIRE);
+	} while (!xio_sync_bool_compare_and_swap(&xio_log_rings, ring->next,
+						 ring));
+found:
+	pthread_setspecific(xio_log_ring_key, ring);
+	xio_log_ring = ring;
+
+	return ring;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_push								     */
+/*---------------------------------------------------------------------------*/
+static int xio_log_push(const struct timeval *tv, const char *file,
+			unsigned line, unsigned level, const char *fmt,
+			va_list args)
+{
+	struct xio_log_ring	*ring = xio_log_ring_get();
+	struct xio_log_rec	*rec;
+	uint32_t		tail;
+
+	if (unlikely(!ring))
+		return -1;
+
+	tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	if (unlikely(ring->head - tail == XIO_LOG_RING_SLOTS)) {
+		ring->dropped++;
+		return 0;
+	}
+	rec = &ring->recs[ring->head & (XIO_LOG_RING_SLOTS - 1)];
+	rec->tv		= *tv;
+	rec->file	= file;
+	rec->line	= line;
+	rec->level	= level;
+	vsnprintf(rec->msg, sizeof(rec->msg), fmt, args);
+	__atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_pushf							     */
+/*---------------------------------------------------------------------------*/
+static int xio_log_pushf(const struct timeval *tv, const char *file,
+			 unsigned line, unsigned level, const char *fmt, ...)
+{
+	va_list			args;
+	int			retval;
+
+	va_start(args, fmt);
+	retval = xio_log_push(tv, file, line, level, fmt, args);
+	va_end(args);
+
+	return retval;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_site_report							     */
+/*---------------------------------------------------------------------------*/
+/* direct - write it now, the writer thread or synchronous mode */
+static void xio_log_site_report(struct xio_log_site *site,
+				const struct timeval *tv, int direct)
+{
+	uint32_t	suppressed = site->suppressed;
+	char		msg[64];
+
+	if (!suppressed)
+		return;
+	site->suppressed = 0;
+
+	if (xio_log_async && !direct) {
+		xio_log_pushf(tv, site->file, site->line, site->level,
+			      "%u similar messages suppressed\n",
+			      suppressed);
+		return;
+	}
+	snprintf(msg, sizeof(msg), "%u similar messages suppressed\n",
+		 suppressed);
+	xio_log_write(tv, site->file, site->line, site->level, msg);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_sites_sweep							     */
+/*---------------------------------------------------------------------------*/
+/* reports the suppressed counts of sites quiet since an earlier second,
+ * rather than waiting for the site to log again
+ */
+static int xio_log_sites_sweep(const struct timeval *tv)
+{
+	struct xio_log_site	*site;
+	int			i, n = 0;
+
+	for (i = 0; i < XIO_LOG_SITES; i++) {
+		site = &xio_log_sites[i];
+		if (site->suppressed && site->sec != (uint64_t)tv->tv_sec) {
+			xio_log_site_report(site, tv, 1);
+			n++;
+		}
+	}
+
+	return n;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_drain							     */
+/*---------------------------------------------------------------------------*/
+static int xio_log_drain(void)
+{
+	struct xio_log_ring	*ring;
+	struct xio_log_rec	*rec;
+	struct timeval		tv;
+	uint32_t		head, tail, dropped;
+	char			msg[64];
+	int			n = 0;
+
+	for (ring = __atomic_load_n(&xio_log_rings, __ATOMIC_ACQUIRE); ring;
+	     ring = ring->next) {
+		head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		for (tail = ring->tail; tail != head; tail++, n++) {
+			rec = &ring->recs[tail & (XIO_LOG_RING_SLOTS - 1)];
+			xio_log_write(&rec->tv, rec->file, rec->line,
+				      rec->level, rec->msg);
+		}
+		__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+
+		dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+		if (dropped != ring->reported) {
+			gettimeofday(&tv, NULL);
+			snprintf(msg, sizeof(msg), "%u log messages dropped\n",
+				 dropped - ring->reported);
+			xio_log_write(&tv, __FILE__, __LINE__,
+				      XIO_LOG_LEVEL_WARN, msg);
+			ring->reported = dropped;
+			n++;
+		}
+	}
+	gettimeofday(&tv, NULL);
+	n += xio_log_sites_sweep(&tv);
+	if (n)
+		fflush(stderr);
+
+	return n;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_writer							     */
+/*---------------------------------------------------------------------------*/
+static void *xio_log_writer(void *data)
+{
+	while (!xio_log_stop) {
+		if (!xio_log_drain())
+			usleep(XIO_LOG_IDLE_US);
+	}
+	xio_log_drain();
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_async_stop							     */
+/*---------------------------------------------------------------------------*/
+static void xio_log_async_stop(void)
+{
+	pthread_mutex_lock(&xio_log_mutex);
+	if (xio_log_async) {
+		xio_log_async = 0;
+		xio_log_stop = 1;
+		pthread_join(xio_log_writer_thread, NULL);
+		/* messages pushed while the writer was stopping */
+		xio_log_drain();
+	}
+	pthread_mutex_unlock(&xio_log_mutex);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_set_log_async							     */
+/*---------------------------------------------------------------------------*/
+int xio_set_log_async(int enable)
+{
+	static int	atexit_set;
+	int		retval = 0;
+
+	if (!enable) {
+		xio_log_async_stop();
+		return 0;
+	}
+
+	pthread_mutex_lock(&xio_log_mutex);
+	if (xio_log_async)
+		goto unlock;
+
+	xio_log_stop = 0;
+	retval = pthread_create(&xio_log_writer_thread, NULL,
+				xio_log_writer, NULL);
+	if (retval) {
+		xio_set_error(retval);
+		retval = -1;
+		goto unlock;
+	}
+	/* write what is queued when the process exits */
+	if (!atexit_set && !atexit(xio_log_async_stop))
+		atexit_set = 1;
+	xio_log_async = 1;
+unlock:
+	pthread_mutex_unlock(&xio_log_mutex);
+
+	return retval;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_get_log_async							     */
+/*---------------------------------------------------------------------------*/
+int xio_get_log_async(void)
+{
+	return xio_log_async;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_vlog								     */
+/*---------------------------------------------------------------------------*/
+void xio_vlog(const char *file, unsigned line, const char *function,
+	      unsigned level, const char *fmt, ...)
+{
+	va_list			args;
+	struct timeval		tv;
+	char			buf[2048];
+
+	/* only errors and warnings flood, e.g. from a failing loop */
+	gettimeofday(&tv, NULL);
+	if ((level == XIO_LOG_LEVEL_ERROR || level == XIO_LOG_LEVEL_WARN) &&
+	    !xio_log_site_allow(file, line, level, &tv))
+		return;
+
+	/* the message is formatted here - its arguments may not outlive
+	 * the call - while the time stamp, stdio and the write are left
+	 * to the writer thread, which also reports suppressed counts
+	 */
+	if (xio_log_async && level != XIO_LOG_LEVEL_FATAL) {
+		va_start(args, fmt);
+		xio_log_push(&tv, file, line, level, fmt, args);
+		va_end(args);
+		return;
+	}
+
+	if (xio_log_sweep_sec != (uint64_t)tv.tv_sec) {
+		xio_log_sweep_sec = tv.tv_sec;
+		xio_log_sites_sweep(&tv);
+	}
+
+	va_start(args, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, args);
+	va_end(args);
+
+	xio_log_write(&tv, file, line, level, buf);
 
 	fflush(stderr);
 }
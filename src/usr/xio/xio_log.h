@@ -84,6 +84,11 @@ extern void xio_vlog(const char *file, unsigned line, const char *function,
 
 void xio_read_logging_level(void);
 
+/* write the default log from a background thread - nonzero enables */
+int xio_set_log_async(int enable);
+
+int xio_get_log_async(void);
+
 static inline int xio_set_log_level(enum xio_log_level level)
 {
 	xio_logging_level = level;
@@ -89,8 +89,10 @@ static void xio_stats_handler(int fd, int events, void *data)
 	switch (nlh->nlmsg_type - NLMSG_MIN_TYPE) {
 	case 0: /* Format */
 		/* counting will start now */
-		memset(&ctx->stats.counter, 0,
+		xio_stat_write_begin(&ctx->stats);
+		memset(ctx->stats.counter, 0,
 		       XIO_STAT_LAST * sizeof(uint64_t));
+		xio_stat_write_end(&ctx->stats);
 		/* First the cycles' hertz (assumed to be fixed) */
 		memcpy(ptr, &ctx->stats.hertz, sizeof(ctx->stats.hertz));
 		ptr += sizeof(ctx->stats.hertz);
@@ -218,15 +220,6 @@ int xio_netlink(struct xio_context *ctx)
 	xio_ev_loop_add(ctx->ev_loop, fd, XIO_POLLIN,
 			xio_stats_handler, ctx);
 
-	ctx->stats.hertz = g_mhz * 1000000.0 + 0.5;
-	/* Init default counters' name */
-	ctx->stats.name[XIO_STAT_TX_MSG] = strdup("TX_MSG");
-	ctx->stats.name[XIO_STAT_RX_MSG] = strdup("RX_MSG");
-	ctx->stats.name[XIO_STAT_TX_BYTES] = strdup("TX_BYTES");
-	ctx->stats.name[XIO_STAT_RX_BYTES] = strdup("RX_BYTES");
-	ctx->stats.name[XIO_STAT_DELAY] = strdup("DELAY");
-	ctx->stats.name[XIO_STAT_APPDELAY] = strdup("APPDELAY");
-
 	ctx->netlink_sock = (void *)(unsigned long)fd;
 	return 0;
 
@@ -0,0 +1,304 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <sys/hashtable.h>
+#include <xio_os.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "libxio.h"
+#include "xio_log.h"
+#include "xio_common.h"
+#include "xio_observer.h"
+#include "xio_ev_data.h"
+#include "xio_ev_loop.h"
+#include "xio_objpool.h"
+#include "xio_workqueue.h"
+#include "xio_context.h"
+#include "xio_stats.h"
+#include "xio_perf_counters.h"
+
+enum xio_perf_event {
+	XIO_PERF_EV_CYCLES,
+	XIO_PERF_EV_INSTRUCTIONS,
+	XIO_PERF_EV_CACHE_MISSES,
+	XIO_PERF_EV_CTX_SWITCHES,
+	XIO_PERF_EV_NR
+};
+
+enum xio_perf_state {
+	XIO_PERF_STATE_INIT,
+	XIO_PERF_STATE_OPEN,
+	XIO_PERF_STATE_FAILED
+};
+
+static const struct {
+	const char	*name;
+	uint32_t	type;
+	uint32_t	pad;
+	uint64_t	config;
+} xio_perf_events[XIO_PERF_EV_NR] = {
+	{ "CYCLES", PERF_TYPE_HARDWARE, 0, PERF_COUNT_HW_CPU_CYCLES },
+	{ "INSNS", PERF_TYPE_HARDWARE, 0, PERF_COUNT_HW_INSTRUCTIONS },
+	{ "CACHE_MISSES", PERF_TYPE_HARDWARE, 0, PERF_COUNT_HW_CACHE_MISSES },
+	{ "CTX_SWITCHES", PERF_TYPE_SOFTWARE, 0,
+	  PERF_COUNT_SW_CONTEXT_SWITCHES },
+};
+
+static const char * const xio_perf_phases[XIO_PERF_PHASE_NR] = {
+	"SCHED", "WAIT", "DISPATCH"
+};
+
+struct xio_perf_counters {
+	struct xio_context	*ctx;
+	int			fd[XIO_PERF_EV_NR];
+	/* event of each value in a group read, in open order */
+	int			ev[XIO_PERF_EV_NR];
+	int			nevents;
+	int			state;		/* enum xio_perf_state */
+	uint32_t		phase;		/* enum xio_perf_phase */
+	int			stat_cycles_per_msg;
+	int			stat_insns_per_msg;
+	int			stat[XIO_PERF_PHASE_NR][XIO_PERF_EV_NR];
+	int			pad;
+	uint64_t		last[XIO_PERF_EV_NR];
+	/* messages counted before the counters were opened */
+	uint64_t		msgs_base;
+};
+
+/* read_format PERF_FORMAT_GROUP */
+struct xio_perf_group_read {
+	uint64_t		nr;
+	uint64_t		values[XIO_PERF_EV_NR];
+};
+
+/*---------------------------------------------------------------------------*/
+/* xio_perf_event_open							     */
+/*---------------------------------------------------------------------------*/
+static int xio_perf_event_open(enum xio_perf_event ev, int group_fd,
+			       int exclude_kernel)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size		= sizeof(attr);
+	attr.type		= xio_perf_events[ev].type;
+	attr.config		= xio_perf_events[ev].config;
+	attr.read_format	= PERF_FORMAT_GROUP;
+	attr.exclude_kernel	= exclude_kernel;
+	attr.exclude_hv		= 1;
+
+	/* the calling thread, on any cpu */
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_perf_counters_open						     */
+/*---------------------------------------------------------------------------*/
+static int xio_perf_counters_open(struct xio_perf_counters *perf)
+{
+	int exclude_kernel = 0;
+	int leader = -1;
+	int i, fd;
+
+	for (i = 0; i < XIO_PERF_EV_NR; i++) {
+		fd = xio_perf_event_open((enum xio_perf_event)i, leader,
+					 exclude_kernel);
+		if (fd < 0 && (errno == EACCES || errno == EPERM) &&
+		    !exclude_kernel) {
+			/* perf_event_paranoid allows user space only */
+			exclude_kernel = 1;
+			fd = xio_perf_event_open((enum xio_perf_event)i,
+						 leader, exclude_kernel);
+		}
+		if (fd < 0) {
+			/* e.g. no PMU in a virtual machine - go on without */
+			DEBUG_LOG("perf event %s unavailable. %m\n",
+				  xio_perf_events[i].name);
+			continue;
+		}
+		if (leader == -1)
+			leader = fd;
+		perf->fd[i] = fd;
+		perf->ev[perf->nevents++] = i;
+	}
+	if (leader == -1) {
+		WARN_LOG("performance counters unavailable. %m\n");
+		perf->state = XIO_PERF_STATE_FAILED;
+		return -1;
+	}
+	perf->msgs_base = perf->ctx->stats.counter[XIO_STAT_TX_MSG] +
+			  perf->ctx->stats.counter[XIO_STAT_RX_MSG];
+	perf->state = XIO_PERF_STATE_OPEN;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_perf_counters_phase						     */
+/*---------------------------------------------------------------------------*/
+void xio_perf_counters_phase(struct xio_perf_counters *perf,
+			     enum xio_perf_phase phase)
+{
+	struct xio_perf_group_read	data;
+	struct xio_stat_set		*set = perf->ctx->stat_set;
+	uint64_t			delta;
+	uint32_t			i;
+	int				ev;
+
+	if (unlikely(perf->state != XIO_PERF_STATE_OPEN)) {
+		if (perf->state == XIO_PERF_STATE_FAILED ||
+		    xio_perf_counters_open(perf))
+			return;
+	}
+	if (read(perf->fd[perf->ev[0]], &data, sizeof(data)) <= 0)
+		return;
+
+	for (i = 0; i < data.nr && i < (uint32_t)perf->nevents; i++) {
+		ev = perf->ev[i];
+		delta = data.values[i] - perf->last[ev];
+		perf->last[ev] = data.values[i];
+		if (perf->phase != XIO_PERF_PHASE_NONE)
+			xio_stat_set_add(set, perf->stat[perf->phase][ev],
+					 delta);
+	}
+	perf->phase = phase;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_perf_counters_refresh						     */
+/*---------------------------------------------------------------------------*/
+static void xio_perf_counters_refresh(struct xio_stat_set *set)
+{
+	struct xio_context		*ctx = (struct xio_context *)set->owner;
+	struct xio_perf_counters	*perf = ctx->perf;
+	uint64_t			msgs, cycles, insns;
+
+	if (perf->state != XIO_PERF_STATE_OPEN)
+		return;
+
+	msgs = ctx->stats.counter[XIO_STAT_TX_MSG] +
+	       ctx->stats.counter[XIO_STAT_RX_MSG] - perf->msgs_base;
+	if (!msgs)
+		return;
+
+	/* work per message - time blocked or polling in epoll_wait excluded */
+	cycles = set->slots[perf->stat[XIO_PERF_PHASE_SCHEDULED]
+				       [XIO_PERF_EV_CYCLES]] +
+		 set->slots[perf->stat[XIO_PERF_PHASE_DISPATCH]
+				       [XIO_PERF_EV_CYCLES]];
+	insns = set->slots[perf->stat[XIO_PERF_PHASE_SCHEDULED]
+				      [XIO_PERF_EV_INSTRUCTIONS]] +
+		set->slots[perf->stat[XIO_PERF_PHASE_DISPATCH]
+				      [XIO_PERF_EV_INSTRUCTIONS]];
+
+	xio_stat_set_gauge(set, perf->stat_cycles_per_msg, cycles / msgs);
+	xio_stat_set_gauge(set, perf->stat_insns_per_msg, insns / msgs);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_perf_counters_create						     */
+/*---------------------------------------------------------------------------*/
+int xio_perf_counters_create(struct xio_context *ctx)
+{
+	struct xio_perf_counters	*perf;
+	char				name[XIO_STAT_NAME_LEN];
+	int				i, j;
+
+	if (!g_options.enable_perf_counters)
+		return 0;
+
+	perf = (struct xio_perf_counters *)xio_context_ucalloc(ctx, 1,
+							       sizeof(*perf));
+	if (!perf) {
+		xio_set_error(ENOMEM);
+		return -1;
+	}
+	perf->ctx = ctx;
+	perf->phase = XIO_PERF_PHASE_NONE;
+	for (i = 0; i < XIO_PERF_EV_NR; i++)
+		perf->fd[i] = -1;
+
+	for (i = 0; i < XIO_PERF_PHASE_NR; i++) {
+		for (j = 0; j < XIO_PERF_EV_NR; j++) {
+			snprintf(name, sizeof(name), "PERF_%s_%s",
+				 xio_perf_events[j].name, xio_perf_phases[i]);
+			perf->stat[i][j] = xio_stat_register(
+					ctx, ctx->stat_set, name,
+					XIO_STAT_TYPE_COUNTER);
+			if (perf->stat[i][j] < 0)
+				goto cleanup;
+		}
+	}
+	perf->stat_cycles_per_msg = xio_stat_register(
+			ctx, ctx->stat_set, "PERF_CYCLES_PER_MSG",
+			XIO_STAT_TYPE_GAUGE);
+	perf->stat_insns_per_msg = xio_stat_register(
+			ctx, ctx->stat_set, "PERF_INSNS_PER_MSG",
+			XIO_STAT_TYPE_GAUGE);
+	if (perf->stat_cycles_per_msg < 0 || perf->stat_insns_per_msg < 0)
+		goto cleanup;
+
+	ctx->stat_set->refresh = xio_perf_counters_refresh;
+	ctx->perf = perf;
+
+	return 0;
+
+cleanup:
+	xio_context_ufree(ctx, perf);
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_perf_counters_destroy						     */
+/*---------------------------------------------------------------------------*/
+void xio_perf_counters_destroy(struct xio_context *ctx)
+{
+	struct xio_perf_counters *perf = ctx->perf;
+	int i;
+
+	if (!perf)
+		return;
+
+	for (i = XIO_PERF_EV_NR - 1; i >= 0; i--)
+		if (perf->fd[i] != -1)
+			close(perf->fd[i]);
+
+	if (ctx->stat_set)
+		ctx->stat_set->refresh = NULL;
+	ctx->perf = NULL;
+	xio_context_ufree(ctx, perf);
+}
@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <xio_os.h>
+#include <signal.h>
+#include "libxio.h"
+#include "xio_log.h"
+#include "xio_common.h"
+#include "xio_observer.h"
+#include "xio_ev_data.h"
+#include "xio_ev_loop.h"
+#include "xio_objpool.h"
+#include "xio_workqueue.h"
+#include "xio_context.h"
+#include "xio_stats_shm.h"
+
+/* contexts created by this process - names the segments */
+static uint32_t xio_stats_shm_ctx_id;
+static thread_once_t xio_stats_shm_reap_once = THREAD_ONCE_INIT;
+
+struct xio_stats_shm_hndl {
+	struct xio_stats_shm	*shm;
+	xio_ctx_delayed_work_t	export_work;
+	uint32_t		reg_nr;
+	uint32_t		reg_len;
+	uint32_t		reg_dropped;
+	uint32_t		pad;
+};
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_path							     */
+/*---------------------------------------------------------------------------*/
+static void xio_stats_shm_path(char *path, size_t len, uint32_t ctx_id)
+{
+	snprintf(path, len, XIO_STATS_SHM_DIR "/" XIO_STATS_SHM_PREFIX "%d.%u",
+		 (int)getpid(), ctx_id);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_reap							     */
+/*---------------------------------------------------------------------------*/
+/* removes the segments of processes that died without destroying their
+ * contexts. the directory is sticky, only our own user's are removed
+ */
+static void xio_stats_shm_reap(void)
+{
+	struct dirent	*ent;
+	DIR		*dir;
+	char		path[sizeof(XIO_STATS_SHM_DIR) + sizeof(ent->d_name)];
+	long		pid;
+
+	dir = opendir(XIO_STATS_SHM_DIR);
+	if (!dir)
+		return;
+	while ((ent = readdir(dir))) {
+		if (strncmp(ent->d_name, XIO_STATS_SHM_PREFIX,
+			    strlen(XIO_STATS_SHM_PREFIX)))
+			continue;
+		pid = strtol(ent->d_name + strlen(XIO_STATS_SHM_PREFIX),
+			     NULL, 10);
+		if (pid <= 0 || pid == getpid() ||
+		    !(kill((pid_t)pid, 0) && errno == ESRCH))
+			continue;
+		snprintf(path, sizeof(path), XIO_STATS_SHM_DIR "/%s",
+			 ent->d_name);
+		if (!unlink(path))
+			DEBUG_LOG("removed stale statistics segment %s\n",
+				  path);
+	}
+	closedir(dir);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_export_stat						     */
+/*---------------------------------------------------------------------------*/
+static int xio_stats_shm_export_stat(const struct xio_stat *stat,
+				     void *user_context)
+{
+	struct xio_stats_shm_hndl	*hndl =
+		(struct xio_stats_shm_hndl *)user_context;
+	struct xio_stats_shm_entry	*entry;
+	uint32_t			len = sizeof(*entry);
+
+	if (stat->type == XIO_STAT_TYPE_HISTOGRAM)
+		len += XIO_STAT_HIST_BUCKETS * sizeof(uint64_t);
+	else if (stat->type == XIO_STAT_TYPE_LATENCY)
+		len += sizeof(stat->latency);
+	if (hndl->reg_len + len > XIO_STATS_SHM_REG_SIZE) {
+		hndl->reg_dropped++;
+		return 0;
+	}
+	entry = (struct xio_stats_shm_entry *)
+		((char *)(hndl->shm + 1) + hndl->reg_len);
+	entry->len	= len;
+	entry->scope	= (uint16_t)stat->scope;
+	entry->type	= (uint16_t)stat->type;
+	entry->owner	= (uint64_t)(uintptr_t)stat->owner;
+	entry->value	= stat->value;
+	entry->sum	= stat->sum;
+	memset(entry->name, 0, sizeof(entry->name));
+	strncpy(entry->name, stat->name, sizeof(entry->name) - 1);
+	if (stat->type == XIO_STAT_TYPE_HISTOGRAM)
+		memcpy(entry->buckets, stat->buckets,
+		       XIO_STAT_HIST_BUCKETS * sizeof(uint64_t));
+	else if (stat->type == XIO_STAT_TYPE_LATENCY)
+		memcpy(entry->buckets, &stat->latency, sizeof(stat->latency));
+
+	hndl->reg_len += len;
+	hndl->reg_nr++;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_export_handler						     */
+/*---------------------------------------------------------------------------*/
+static void xio_stats_shm_export_handler(int actual_timeout_ms, void *data)
+{
+	struct xio_context		*ctx = (struct xio_context *)data;
+	struct xio_stats_shm_hndl	*hndl =
+		(struct xio_stats_shm_hndl *)ctx->stats.shm;
+	struct xio_stats_shm		*shm = hndl->shm;
+	struct timespec			ts;
+
+	xio_ctx_del_delayed_work(ctx, &hndl->export_work);
+
+	hndl->reg_nr		= 0;
+	hndl->reg_len		= 0;
+	hndl->reg_dropped	= 0;
+
+	shm->reg_seq++;
+	xio_smp_wmb();
+	xio_query_stats(ctx, xio_stats_shm_export_stat, hndl);
+	xio_clock_gettime(&ts);
+	shm->reg_nr		= hndl->reg_nr;
+	shm->reg_len		= hndl->reg_len;
+	shm->reg_dropped	= hndl->reg_dropped;
+	shm->reg_time_ns	= ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	xio_smp_wmb();
+	shm->reg_seq++;
+
+	xio_ctx_add_delayed_work(ctx, XIO_STATS_SHM_EXPORT_MS, ctx,
+				 xio_stats_shm_export_handler,
+				 &hndl->export_work);
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_create							     */
+/*---------------------------------------------------------------------------*/
+int xio_stats_shm_create(struct xio_context *ctx)
+{
+	struct xio_stats_shm_hndl	*hndl;
+	struct xio_stats_shm		*shm;
+	size_t				len = sizeof(*shm) +
+					      XIO_STATS_SHM_REG_SIZE;
+	char				path[64];
+	uint32_t			ctx_id;
+	int				fd, i;
+
+	if (!g_options.enable_stats_shm)
+		return 0;
+
+	hndl = (struct xio_stats_shm_hndl *)xio_context_ucalloc(
+			ctx, 1, sizeof(*hndl));
+	if (!hndl) {
+		WARN_LOG("xio_context_ucalloc failed. %m\n");
+		return 0;
+	}
+
+	thread_once(&xio_stats_shm_reap_once, xio_stats_shm_reap);
+
+	ctx_id = xio_sync_fetch_and_add32(&xio_stats_shm_ctx_id, 1);
+	xio_stats_shm_path(path, sizeof(path), ctx_id);
+
+	/* a segment left by an earlier process with the same pid */
+	unlink(path);
+	fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		/* statistics are optional - keep the context working */
+		WARN_LOG("statistics segment %s open failed. %m\n", path);
+		goto cleanup;
+	}
+	/* the registry's pages are backed only once written */
+	if (ftruncate(fd, len)) {
+		WARN_LOG("statistics segment %s truncate failed. %m\n", path);
+		goto cleanup1;
+	}
+	shm = (struct xio_stats_shm *)mmap(NULL, len, PROT_READ | PROT_WRITE,
+					   MAP_SHARED, fd, 0);
+	if (shm == MAP_FAILED) {
+		WARN_LOG("statistics segment %s mmap failed. %m\n", path);
+		goto cleanup1;
+	}
+	close(fd);
+
+	shm->version	= XIO_STATS_SHM_VERSION;
+	shm->ncounters	= XIO_STAT_LAST;
+	shm->size	= sizeof(*shm);
+	shm->pid	= (int32_t)getpid();
+	shm->ctx_id	= ctx_id;
+	shm->cpuid	= ctx->cpuid;
+	shm->hertz	= ctx->stats.hertz;
+	shm->reg_size	= XIO_STATS_SHM_REG_SIZE;
+	for (i = 0; i < XIO_STAT_LAST; i++) {
+		shm->counter[i] = ctx->stats.counter[i];
+		if (ctx->stats.name[i])
+			strncpy(shm->name[i], ctx->stats.name[i],
+				XIO_STATS_SHM_NAME_LEN - 1);
+	}
+	hndl->shm		= shm;
+	ctx->stats.counter	= shm->counter;
+	ctx->stats.seq		= &shm->seq;
+	ctx->stats.shm		= hndl;
+
+	xio_smp_wmb();
+	shm->magic = XIO_STATS_SHM_MAGIC;
+
+	xio_ctx_add_delayed_work(ctx, XIO_STATS_SHM_EXPORT_MS, ctx,
+				 xio_stats_shm_export_handler,
+				 &hndl->export_work);
+
+	DEBUG_LOG("statistics published in %s\n", path);
+
+	return 0;
+
+cleanup1:
+	close(fd);
+	unlink(path);
+cleanup:
+	xio_context_ufree(ctx, hndl);
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_destroy						     */
+/*---------------------------------------------------------------------------*/
+void xio_stats_shm_destroy(struct xio_context *ctx)
+{
+	struct xio_stats_shm_hndl *hndl =
+		(struct xio_stats_shm_hndl *)ctx->stats.shm;
+	struct xio_stats_shm *shm;
+	char path[64];
+
+	if (!hndl)
+		return;
+
+	shm = hndl->shm;
+	xio_ctx_del_delayed_work(ctx, &hndl->export_work);
+
+	memcpy(ctx->stats.local_counter, shm->counter,
+	       sizeof(ctx->stats.local_counter));
+	ctx->stats.counter	= ctx->stats.local_counter;
+	ctx->stats.seq		= &ctx->stats.local_seq;
+	ctx->stats.shm		= NULL;
+
+	xio_stats_shm_path(path, sizeof(path), shm->ctx_id);
+	unlink(path);
+	munmap(shm, sizeof(*shm) + XIO_STATS_SHM_REG_SIZE);
+	xio_context_ufree(ctx, hndl);
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef XIO_STATS_SHM_H
+#define XIO_STATS_SHM_H
+
+/*
+ * per context counters published in /dev/shm/xio.<pid>.<ctx> - the owning
+ * thread is the only writer, readers copy the counters while seq is even
+ * and unchanged across the copy.  the statistics registry (xio_query_stats)
+ * is exported periodically after the header as struct xio_stats_shm_entry
+ * records, under reg_seq in the same way
+ */
+#define XIO_STATS_SHM_DIR		"/dev/shm"
+#define XIO_STATS_SHM_PREFIX		"xio."
+#define XIO_STATS_SHM_MAGIC		0x5849534d	/* "XISM" */
+#define XIO_STATS_SHM_VERSION		2
+#define XIO_STATS_SHM_COUNTERS		16
+#define XIO_STATS_SHM_NAME_LEN		32
+#define XIO_STATS_SHM_REG_SIZE		(1 << 20)
+#define XIO_STATS_SHM_EXPORT_MS		100
+
+/*---------------------------------------------------------------------------*/
+/* structs								     */
+/*---------------------------------------------------------------------------*/
+struct xio_stats_shm {
+	uint32_t	magic;		/* set last - segment is ready */
+	uint16_t	version;
+	uint16_t	ncounters;
+	uint32_t	size;		/* of this header		*/
+	int32_t		pid;
+	uint32_t	ctx_id;		/* per process context index	*/
+	int32_t		cpuid;
+	uint64_t	hertz;		/* of the delay counters	*/
+	uint32_t	seq;		/* odd while counters change	*/
+	uint32_t	pad;
+	uint64_t	counter[XIO_STATS_SHM_COUNTERS];
+	/* empty name - counter slot is unused */
+	char		name[XIO_STATS_SHM_COUNTERS][XIO_STATS_SHM_NAME_LEN];
+	uint32_t	reg_seq;	/* odd while the registry changes */
+	uint32_t	reg_nr;		/* entries exported		*/
+	uint32_t	reg_len;	/* bytes of entries exported	*/
+	uint32_t	reg_size;	/* room for entries		*/
+	uint64_t	reg_time_ns;	/* of the last export		*/
+	uint32_t	reg_dropped;	/* entries that did not fit	*/
+	uint32_t	pad2;
+};
+
+struct xio_stats_shm_entry {
+	uint32_t	len;		/* of the entry, buckets included */
+	uint16_t	scope;		/* enum xio_stat_scope		*/
+	uint16_t	type;		/* enum xio_stat_type		*/
+	uint64_t	owner;
+	uint64_t	value;
+	uint64_t	sum;
+	char		name[XIO_STATS_SHM_NAME_LEN];
+	/* XIO_STAT_HIST_BUCKETS entries follow for histograms and a
+	 * struct xio_latency_stats for latencies
+	 */
+	uint64_t	buckets[];
+};
+
+struct xio_context;
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_create							     */
+/*---------------------------------------------------------------------------*/
+int xio_stats_shm_create(struct xio_context *ctx);
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_shm_destroy						     */
+/*---------------------------------------------------------------------------*/
+void xio_stats_shm_destroy(struct xio_context *ctx);
+
+#endif /* XIO_STATS_SHM_H */
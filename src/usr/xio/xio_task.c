@@ -53,6 +53,35 @@
 
 #define XIO_TASK_MAGIC   0x58494f54 /* Hex of 'XIOT' */
 
+/*---------------------------------------------------------------------------*/
+/* xio_tasks_slab_prefault						     */
+/*---------------------------------------------------------------------------*/
+static void xio_tasks_slab_prefault(void *buf, size_t sz)
+{
+	volatile char	*p = (volatile char *)buf;
+	long		page_sz = xio_get_page_size();
+	size_t		i;
+
+	/* write every page now rather than faulting on the data path */
+	for (i = 0; i < sz; i += page_sz)
+		p[i] = p[i];
+	p[sz - 1] = p[sz - 1];
+}
+
+/*---------------------------------------------------------------------------*/
+/* xio_tasks_slab_mem_sub						     */
+/*---------------------------------------------------------------------------*/
+static void xio_tasks_slab_mem_sub(struct xio_tasks_pool *q,
+				   struct xio_tasks_slab *s)
+{
+	xio_ctx_mem_sub(q->params.xio_context, XIO_MEM_CLASS_TASKS_POOL,
+			s->alloc_sz - s->inline_sz, s->nr);
+	if (s->inline_sz)
+		xio_ctx_mem_sub(q->params.xio_context,
+				XIO_MEM_CLASS_INLINE_BUFS,
+				s->inline_sz, s->nr);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_tasks_pool_alloc_slab						     */
 /*---------------------------------------------------------------------------*/
@@ -61,6 +90,7 @@ int xio_tasks_pool_alloc_slab(struct xio_tasks_pool *q, void *context)
 	int			alloc_nr;
 	size_t			slab_alloc_sz;
 	size_t			tasks_alloc_sz;
+	size_t			inline_alloc_sz;
 	void			*buf;
 	void			*data, *ptr;
 	struct xio_tasks_slab	*s;
@@ -68,6 +98,7 @@ int xio_tasks_pool_alloc_slab(struct xio_tasks_pool *q, void *context)
 	int			retval = 0, i;
 	int			tot_sz;
 	int			huge_alloc = 0;
+	size_t			task_sz;
 	LIST_HEAD(tmp_list);
 	INIT_LIST_HEAD(&tmp_list);
 
@@ -90,31 +121,44 @@ int xio_tasks_pool_alloc_slab(struct xio_tasks_pool *q, void *context)
 			q->params.slab_dd_data_sz +
 			alloc_nr * sizeof(struct xio_task *);
 
-	/* slab data */
-	tasks_alloc_sz = alloc_nr * (sizeof(struct xio_task) +
+	/* slab data - every task starts on a cache line boundary so that its
+	 * hot fields span as few lines as possible
+	 */
+	task_sz = ALIGN(sizeof(struct xio_task) +
 			g_options.max_in_iovsz * sizeof(struct xio_iovec_ex) +
 			g_options.max_out_iovsz * sizeof(struct xio_iovec_ex) +
-			q->params.task_dd_data_sz);
+			q->params.task_dd_data_sz, L1_CACHE_BYTES);
+	tasks_alloc_sz = alloc_nr * task_sz;
+
+	/* transport inline buffers - contiguous slabs only. the tasks follow
+	 * them and keep their cache line alignment
+	 */
+	inline_alloc_sz = ALIGN(alloc_nr * q->params.task_inline_buf_sz,
+				L1_CACHE_BYTES);
 
-	tot_sz = slab_alloc_sz + tasks_alloc_sz;
+	tot_sz = inline_alloc_sz + slab_alloc_sz + tasks_alloc_sz;
 
-	if (tot_sz > 1 << 20) {
+	if (inline_alloc_sz || tot_sz > 1 << 20) {
 		buf = xio_context_umalloc_huge_pages(q->params.xio_context, tot_sz);
 		huge_alloc = 1;
 	} else {
-		buf = xio_context_umemalign(q->params.xio_context, 64, tot_sz);
+		buf = xio_context_umemalign(q->params.xio_context,
+					    L1_CACHE_BYTES, tot_sz);
 	}
 	if (!buf) {
 		xio_set_error(ENOMEM);
 		ERROR_LOG("allocation failed\n");
 		return -1;
 	}
-	data = buf;
 	ptr = buf;
 
+	/* layout: [inline buffers][tasks][slab][slab dd_data][task array] */
+	data = (char *)buf + inline_alloc_sz;
+
 	/* slab */
-	s = (struct xio_tasks_slab *)((char *)buf + tasks_alloc_sz);
+	s = (struct xio_tasks_slab *)((char *)data + tasks_alloc_sz);
 	s->dd_data = (void *)((char *)s + sizeof(struct xio_tasks_slab));
+	s->inline_bufs = inline_alloc_sz ? buf : NULL;
 
 	/* array */
 	s->array = (struct xio_task **)
@@ -126,6 +170,18 @@ int xio_tasks_pool_alloc_slab(struct xio_tasks_pool *q, void *context)
 	q->curr_idx = s->end_idx + 1;
 	s->nr = alloc_nr;
 	s->huge_alloc = huge_alloc;
+	s->alloc_sz = tot_sz;
+	s->inline_sz = inline_alloc_sz;
+
+	xio_ctx_mem_add(q->params.xio_context, XIO_MEM_CLASS_TASKS_POOL,
+			tot_sz - inline_alloc_sz, alloc_nr);
+	if (inline_alloc_sz)
+		xio_ctx_mem_add(q->params.xio_context,
+				XIO_MEM_CLASS_INLINE_BUFS,
+				inline_alloc_sz, alloc_nr);
+
+	if (s->inline_bufs)
+		xio_tasks_slab_prefault(buf, tot_sz);
 
 	if (q->params.pool_hooks.slab_pre_create) {
 		retval = q->params.pool_hooks.slab_pre_create(
@@ -149,8 +205,7 @@ int xio_tasks_pool_alloc_slab(struct xio_tasks_pool *q, void *context)
 		task->dd_data	= ((char *)data) +
 						sizeof(struct xio_task);
 
-		data = ((char *)data) + sizeof(struct xio_task) +
-					q->params.task_dd_data_sz;
+		data = ((char *)task->dd_data) + q->params.task_dd_data_sz;
 
 		task->imsg.in.sgl_type		= XIO_SGL_TYPE_IOV_PTR;
 		task->imsg.in.pdata_iov.sglist	= (struct xio_iovec_ex *)data;
@@ -164,8 +219,7 @@ int xio_tasks_pool_alloc_slab(struct xio_tasks_pool *q, void *context)
 		task->imsg.out.pdata_iov.max_nents =
 						g_options.max_out_iovsz;
 
-		data = ((char *)data) +
-			g_options.max_out_iovsz * sizeof(struct xio_iovec_ex);
+		data = ((char *)task) + task_sz;
 
 		if (q->params.pool_hooks.slab_init_task && context) {
 			retval = q->params.pool_hooks.slab_init_task(
@@ -195,6 +249,7 @@ int xio_tasks_pool_alloc_slab(struct xio_tasks_pool *q, void *context)
 	return retval;
 
 cleanup:
+	xio_tasks_slab_mem_sub(q, s);
 	if (huge_alloc)
 		xio_context_ufree_huge_pages(q->params.xio_context, ptr);
 	else
@@ -223,6 +278,8 @@ struct xio_tasks_pool *xio_tasks_pool_create(
 		return NULL;
 	}
 	q		= (struct xio_tasks_pool *)buf;
+	xio_ctx_mem_add(params->xio_context, XIO_MEM_CLASS_TASKS_POOL,
+			sizeof(*q) + params->pool_dd_data_sz, 0);
 	if (params->pool_dd_data_sz)
 		q->dd_data = (void *)(q + 1);
 	else
@@ -238,40 +295,76 @@ struct xio_tasks_pool *xio_tasks_pool_create(
 	if (q->params.pool_hooks.pool_pre_create) {
 		retval = q->params.pool_hooks.pool_pre_create(
 				q->params.pool_hooks.context, q, q->dd_data);
-		if (unlikely(retval)) {
-			xio_context_ufree(q->params.xio_context, q);
-			return NULL;
-		}
+		if (unlikely(retval))
+			goto cleanup;
 	}
 
 	if (q->params.start_nr) {
 		xio_tasks_pool_alloc_slab(q, q->params.pool_hooks.context);
-		if (list_empty(&q->stack)) {
-			xio_context_ufree(q->params.xio_context, q);
-			return NULL;
-		}
+		if (list_empty(&q->stack))
+			goto cleanup;
 	}
 	if (q->params.pool_hooks.pool_post_create) {
 		retval = q->params.pool_hooks.pool_post_create(
 				q->params.pool_hooks.context, q, q->dd_data);
 
-		if (unlikely(retval)) {
-			xio_context_ufree(q->params.xio_context, q);
-			return NULL;
-		}
+		if (unlikely(retval))
+			goto cleanup;
 	}
 	return q;
+
+cleanup:
+	xio_ctx_mem_sub(q->params.xio_context, XIO_MEM_CLASS_TASKS_POOL,
+			sizeof(*q) + q->params.pool_dd_data_sz, 0);
+	xio_context_ufree(q->params.xio_context, q);
+	return NULL;
 }
 EXPORT_SYMBOL(xio_tasks_pool_create);
 
+/*---------------------------------------------------------------------------*/
+/* xio_tasks_pool_free_slab						     */
+/*---------------------------------------------------------------------------*/
+static void xio_tasks_pool_free_slab(struct xio_tasks_pool *q,
+				     struct xio_tasks_slab *pslab)
+{
+	unsigned int		i;
+
+	list_del(&pslab->slabs_list_entry);
+
+	if (q->params.pool_hooks.slab_uninit_task) {
+		for (i = 0; i < pslab->nr; i++)
+			q->params.pool_hooks.slab_uninit_task(
+					pslab->array[i]->context,
+					q->dd_data,
+					pslab->dd_data,
+					pslab->array[i]);
+	}
+
+	if (q->params.pool_hooks.slab_destroy)
+		q->params.pool_hooks.slab_destroy(
+			q->params.pool_hooks.context,
+			q->dd_data,
+			pslab->dd_data);
+
+	/* the tmp tasks are returned back to pool */
+
+	xio_tasks_slab_mem_sub(q, pslab);
+	if (pslab->inline_bufs)
+		xio_context_ufree_huge_pages(q->params.xio_context,
+					     pslab->inline_bufs);
+	else if (pslab->huge_alloc)
+		xio_context_ufree_huge_pages(q->params.xio_context,
+					     pslab->array[0]);
+	else
+		xio_context_ufree(q->params.xio_context, pslab->array[0]);
+}
+
 /*---------------------------------------------------------------------------*/
 /* xio_tasks_pool_destroy						     */
 /*---------------------------------------------------------------------------*/
 void xio_tasks_pool_destroy(struct xio_tasks_pool *q)
 {
 	struct xio_tasks_slab	*pslab, *next_pslab;
-	unsigned int		i;
-
 
 	if (!list_empty(&q->on_hold_list) ||
 	    !list_empty(&q->orphans_list))
@@ -280,32 +373,8 @@ void xio_tasks_pool_destroy(struct xio_tasks_pool *q)
 	xio_tasks_pool_flush_orphan_tasks(q);
 
 	list_for_each_entry_safe(pslab, next_pslab, &q->slabs_list,
-				 slabs_list_entry) {
-		list_del(&pslab->slabs_list_entry);
-
-		if (q->params.pool_hooks.slab_uninit_task) {
-			for (i = 0; i < pslab->nr; i++)
-				q->params.pool_hooks.slab_uninit_task(
-						pslab->array[i]->context,
-						q->dd_data,
-						pslab->dd_data,
-						pslab->array[i]);
-		}
-
-		if (q->params.pool_hooks.slab_destroy)
-			q->params.pool_hooks.slab_destroy(
-				q->params.pool_hooks.context,
-				q->dd_data,
-				pslab->dd_data);
-
-		/* the tmp tasks are returned back to pool */
-
-		if (pslab->huge_alloc)
-			xio_context_ufree_huge_pages(q->params.xio_context,
-						     pslab->array[0]);
-		else
-			xio_context_ufree(q->params.xio_context, pslab->array[0]);
-	}
+				 slabs_list_entry)
+		xio_tasks_pool_free_slab(q, pslab);
 
 	if (q->params.pool_hooks.pool_destroy)
 		q->params.pool_hooks.pool_destroy(
@@ -314,10 +383,54 @@ void xio_tasks_pool_destroy(struct xio_tasks_pool *q)
 
 	kfree(q->params.pool_name);
 
+	xio_ctx_mem_sub(q->params.xio_context, XIO_MEM_CLASS_TASKS_POOL,
+			sizeof(*q) + q->params.pool_dd_data_sz, 0);
 	xio_context_ufree(q->params.xio_context, q);
 }
 EXPORT_SYMBOL(xio_tasks_pool_destroy);
 
+/*---------------------------------------------------------------------------*/
+/* xio_tasks_pool_shrink						     */
+/*---------------------------------------------------------------------------*/
+void xio_tasks_pool_shrink(struct xio_tasks_pool *q)
+{
+	struct xio_tasks_slab	*pslab, *prev_pslab;
+	struct xio_task		*task, *next_task;
+	unsigned int		keep_nr;
+
+	if (!q)
+		return;
+
+	/* keep the start slab and whatever the last window needed */
+	keep_nr = max(q->params.start_nr, q->window_max_used);
+	q->window_max_used = q->curr_used;
+	if (q->curr_alloced <= keep_nr)
+		return;
+
+	list_for_each_entry(pslab, &q->slabs_list, slabs_list_entry)
+		pslab->free_nr = 0;
+	list_for_each_entry(task, &q->stack, tasks_list_entry)
+		((struct xio_tasks_slab *)task->slab)->free_nr++;
+
+	/* newest slabs first - the oldest one holds the start tasks */
+	list_for_each_entry_safe_reverse(pslab, prev_pslab, &q->slabs_list,
+					 slabs_list_entry) {
+		if (q->curr_alloced - pslab->nr < keep_nr)
+			break;
+		if (pslab->free_nr != pslab->nr)
+			continue;
+
+		list_for_each_entry_safe(task, next_task, &q->stack,
+					 tasks_list_entry) {
+			if (task->slab == pslab)
+				list_del_init(&task->tasks_list_entry);
+		}
+		q->curr_alloced -= pslab->nr;
+		xio_tasks_pool_free_slab(q, pslab);
+	}
+}
+EXPORT_SYMBOL(xio_tasks_pool_shrink);
+
 /*---------------------------------------------------------------------------*/
 /* xio_tasks_pool_remap							     */
 /*---------------------------------------------------------------------------*/
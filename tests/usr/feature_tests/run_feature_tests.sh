@@ -0,0 +1,10 @@
+#!/bin/bash
+# Get Running Directory
+DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
+cd $DIR
+
+export LD_LIBRARY_PATH=../../../src/usr/
+
+# client and server run in one process over tcp loopback
+./xio_feature_tests
+exit $?
@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* aggregation of small one way messages */
+#include <unistd.h>
+#include <pthread.h>
+
+#include "xio_feature_tests.h"
+
+#define OW_NR			6000
+
+static struct xio_msg		ow_msgs[OW_NR];
+
+/*---------------------------------------------------------------------------*/
+/* ow_init								     */
+/*---------------------------------------------------------------------------*/
+static struct xio_msg *ow_init(int i, const char *hdr)
+{
+	struct xio_msg *msg = &ow_msgs[i];
+
+	memset(msg, 0, sizeof(*msg));
+	msg->out.header.iov_base	= (void *)hdr;
+	msg->out.header.iov_len		= strlen(hdr);
+	msg->out.sgl_type		= XIO_SGL_TYPE_IOV;
+	msg->out.data_iov.max_nents	= XIO_IOVLEN;
+	msg->in.sgl_type		= XIO_SGL_TYPE_IOV;
+	msg->in.data_iov.max_nents	= XIO_IOVLEN;
+
+	return msg;
+}
+
+/*---------------------------------------------------------------------------*/
+/* agg_enable								     */
+/*---------------------------------------------------------------------------*/
+static int agg_enable(struct xio_connection *conn)
+{
+	struct xio_connection_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.agg_max_bytes	= 4096;
+	attr.agg_max_delay_us	= 500;
+
+	return xio_modify_connection(conn, &attr,
+				     XIO_CONNECTION_ATTR_AGGREGATION);
+}
+
+static int tx_tasks_cb(const struct xio_stat *stat, void *user_context)
+{
+	if (stat->scope == XIO_STAT_SCOPE_NEXUS &&
+	    !strcmp(stat->name, "TX_TASKS"))
+		*(uint64_t *)user_context += stat->value;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* test_agg_pack							     */
+/*---------------------------------------------------------------------------*/
+/* a burst of small one way messages shares a few wire messages and
+ * arrives whole and in order
+ */
+int test_agg_pack(void)
+{
+	struct xio_context	*ctx;
+	struct test_session	ts;
+	uint64_t		before = 0, after = 0;
+	int			rcvd = sd.ow_rcvd;
+	int			errs = sd.ow_order_errors;
+	int			i;
+
+	/* a context of its own, its nexus carries only this burst */
+	ctx = xio_context_create(NULL, 0, -1);
+	CHECK(ctx);
+	CHECK(session_open(&ts, ctx) == 0);
+	CHECK(session_wait(&ts) == 0);
+	CHECK(agg_enable(ts.conn) == 0);
+
+	CHECK(xio_query_stats(ctx, tx_tasks_cb, &before) == 0);
+	for (i = 0; i < 64; i++)
+		CHECK(xio_send_msg(ts.conn, ow_init(i, HDR_OW)) == 0);
+	WAIT_FOR(ctx, sd.ow_rcvd == rcvd + 64);
+	CHECK(xio_query_stats(ctx, tx_tasks_cb, &after) == 0);
+
+	CHECK(after - before < 8);
+	CHECK(sd.ow_order_errors == errs);
+
+	CHECK(session_close(&ts) == 0);
+	xio_context_destroy(ctx);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* starved server							     */
+/*---------------------------------------------------------------------------*/
+/* a server of its own, its context has tasks for two connections only. it
+ * holds the one way messages it gets until the client lets go
+ */
+struct starved_server {
+	struct xio_context	*ctx;
+	struct xio_server	*server;
+	struct xio_msg		*held[OW_NR];
+	uint64_t		last_sn;
+	uint16_t		port;
+	uint16_t		pad;
+	volatile int		ready;
+	volatile int		stop;
+	volatile int		nsessions;
+	volatile int		rcvd;
+	volatile int		nheld;
+	volatile int		release;
+	volatile int		order_errors;
+};
+
+static struct starved_server	ss;
+
+static int ss_on_msg(struct xio_session *session, struct xio_msg *msg,
+		     int last_in_rxq, void *cb_user_context)
+{
+	if (ss.last_sn && msg->sn <= ss.last_sn)
+		ss.order_errors++;
+	ss.last_sn = msg->sn;
+	ss.rcvd++;
+	if (ss.release)
+		xio_release_msg(msg);
+	else
+		ss.held[ss.nheld++] = msg;
+
+	return 0;
+}
+
+static int ss_on_session_event(struct xio_session *session,
+			       struct xio_session_event_data *event_data,
+			       void *cb_user_context)
+{
+	switch (event_data->event) {
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		ss.nheld = 0;
+		xio_connection_destroy(event_data->conn);
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		xio_session_destroy(session);
+		ss.nsessions--;
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+static int ss_on_new_session(struct xio_session *session,
+			     struct xio_new_session_req *req,
+			     void *cb_user_context)
+{
+	ss.nsessions++;
+	xio_accept(session, NULL, 0, NULL, 0);
+
+	return 0;
+}
+
+static struct xio_session_ops ss_ops = {
+	.on_session_event		=  ss_on_session_event,
+	.on_new_session			=  ss_on_new_session,
+	.on_msg				=  ss_on_msg,
+};
+
+static void *ss_thread(void *data)
+{
+	struct xio_context_params	params;
+
+	memset(&params, 0, sizeof(params));
+	params.max_conns_per_ctx = 2;
+	ss.ctx = xio_context_create(&params, 0, -1);
+	if (!ss.ctx) {
+		ss.ready = -1;
+		return NULL;
+	}
+	ss.server = xio_bind(ss.ctx, &ss_ops, SERVER_URI, &ss.port, 0, NULL);
+	if (!ss.server) {
+		ss.ready = -1;
+		xio_context_destroy(ss.ctx);
+		return NULL;
+	}
+	ss.ready = 1;
+
+	while (!ss.stop || ss.nsessions) {
+		xio_context_poll_wait(ss.ctx, 1);
+		while (ss.release && ss.nheld)
+			xio_release_msg(ss.held[--ss.nheld]);
+	}
+	xio_unbind(ss.server);
+	xio_context_destroy(ss.ctx);
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* test_agg_backpressure						     */
+/*---------------------------------------------------------------------------*/
+/* without flow control the server runs out of tasks while it holds the
+ * messages. the packed ones wait for tasks instead of being dropped and
+ * all arrive, in order, once the server lets go
+ */
+static int agg_backpressure(struct test_session *ts, struct xio_context *ctx)
+{
+	int			enable = 0;
+	int			i;
+
+	/* the server's connection is created meanwhile and shares it */
+	xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+		    XIO_OPTNAME_ENABLE_FLOW_CONTROL, &enable, sizeof(enable));
+	CHECK(session_open_port(ts, ctx, ss.port) == 0);
+	i = session_wait(ts);
+	enable = 1;
+	xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+		    XIO_OPTNAME_ENABLE_FLOW_CONTROL, &enable, sizeof(enable));
+	CHECK(i == 0);
+	CHECK(agg_enable(ts->conn) == 0);
+
+	for (i = 0; i < OW_NR; i++)
+		CHECK(xio_send_msg(ts->conn, ow_init(i, HDR_OW)) == 0);
+
+	/* more than the server's tasks pool holds */
+	WAIT_FOR(ctx, ss.nheld > OW_NR / 2);
+	for (i = 0; i < 10 * HOLD_MS; i++)
+		xio_context_poll_wait(ctx, 1);
+	CHECK(ss.rcvd < OW_NR);
+
+	ss.release = 1;
+	WAIT_FOR(ctx, ss.rcvd == OW_NR);
+	for (i = 0; i < HOLD_MS; i++)
+		xio_context_poll_wait(ctx, 1);
+	CHECK(ss.rcvd == OW_NR);
+	CHECK(ss.order_errors == 0);
+
+	return 0;
+}
+
+int test_agg_backpressure(struct xio_context *ctx)
+{
+	struct test_session	ts;
+	pthread_t		stid;
+	int			retval;
+
+	memset(&ss, 0, sizeof(ss));
+	memset(&ts, 0, sizeof(ts));
+	pthread_create(&stid, NULL, ss_thread, NULL);
+	while (!ss.ready)
+		usleep(1000);
+
+	retval = ss.ready > 0 ? agg_backpressure(&ts, ctx) : -1;
+
+	/* whatever failed, nothing is held anymore */
+	ss.release = 1;
+	if (ts.conn && session_close(&ts))
+		retval = -1;
+	ss.stop = 1;
+	pthread_join(stid, NULL);
+
+	return retval;
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* request cancellation and deadlines */
+#include "xio_feature_tests.h"
+
+#define DEADLINE_US		(10 * 1000 * 1000)
+
+/*---------------------------------------------------------------------------*/
+/* test_cancel								     */
+/*---------------------------------------------------------------------------*/
+/* a transmitted request completes as canceled once its response arrives,
+ * the response itself is never delivered
+ */
+int test_cancel(struct test_session *ts)
+{
+	struct xio_msg	*req;
+	int		nhold = sd.nhold;
+	int		nrsp = ts->nrsp;
+
+	ts->nerr = 0;
+	req = req_init(0, HDR_HOLD);
+	CHECK(xio_send_request(ts->conn, req) == 0);
+	WAIT_FOR(ts->ctx, sd.nhold == nhold + 1);
+
+	CHECK(xio_cancel_request(ts->conn, req) == 0);
+	WAIT_FOR(ts->ctx, ts->nerr == 1);
+	CHECK(ts->last_err == XIO_E_MSG_CANCELED);
+	CHECK(ts->nrsp == nrsp);
+
+	/* nothing left to cancel */
+	CHECK(xio_cancel_request(ts->conn, req) == -1);
+
+	/* the connection still works */
+	CHECK(xio_send_request(ts->conn, req_init(1, HDR_ECHO)) == 0);
+	WAIT_FOR(ts->ctx, ts->nrsp == nrsp + 1);
+	CHECK(ts->nerr == 1);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* test_cancel_queued							     */
+/*---------------------------------------------------------------------------*/
+/* a request not transmitted yet is dropped and completed at once */
+int test_cancel_queued(struct xio_context *ctx)
+{
+	struct test_session	ts;
+	int			nhold = sd.nhold;
+
+	CHECK(session_open(&ts, ctx) == 0);
+	CHECK(xio_send_request(ts.conn, req_init(0, HDR_HOLD)) == 0);
+	CHECK(xio_send_request(ts.conn, req_init(1, HDR_ECHO)) == 0);
+	CHECK(xio_cancel_request(ts.conn, &reqs[0].msg) == 0);
+	CHECK(ts.nerr == 1 && ts.last_err == XIO_E_MSG_CANCELED);
+
+	/* the request behind it is still sent */
+	WAIT_FOR(ctx, ts.nrsp == 1);
+	CHECK(reqs[1].seq == 0 && reqs[0].seq == -1);
+	CHECK(sd.nhold == nhold);
+	CHECK(ts.nerr == 1);
+
+	return session_close(&ts);
+}
+
+/*---------------------------------------------------------------------------*/
+/* test_deadline							     */
+/*---------------------------------------------------------------------------*/
+/* a request still queued when its deadline passes fails with a timeout, the
+ * one behind it is sent and the server learns how much of its time is left
+ */
+int test_deadline(struct xio_context *ctx)
+{
+	struct test_session	ts;
+	struct xio_msg		*req;
+
+	CHECK(session_open(&ts, ctx) == 0);
+	/* queued until the connection is up, by then it is too late */
+	req = req_init(0, HDR_ECHO);
+	req->timeout_us = 1;
+	CHECK(xio_send_request(ts.conn, req) == 0);
+	req = req_init(1, HDR_ECHO);
+	req->timeout_us = DEADLINE_US;
+	CHECK(xio_send_request(ts.conn, req) == 0);
+
+	WAIT_FOR(ctx, ts.nrsp == 1 && ts.nerr == 1);
+	CHECK(ts.last_err == XIO_E_TIMEOUT);
+	CHECK(reqs[0].seq == -1 && reqs[1].seq == 0);
+	CHECK(sd.last_timeout_us > 0 && sd.last_timeout_us < DEADLINE_US);
+
+	return session_close(&ts);
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* send completions passed to the application in batches */
+#include "xio_feature_tests.h"
+
+#define COMP_MAX_MSGS		8
+#define COMP_DELAY_MS		20
+#define COMP_LATE_NR		4
+
+static struct xio_msg		comp_ow[MAX_REQS + COMP_LATE_NR];
+static struct xio_session_ops	comp_ops;
+
+static struct {
+	int			ncalls;
+	int			nmsgs;
+	int			max_batch;
+	int			order_errors;
+	uint64_t		last_ms;
+} comp;
+
+/*---------------------------------------------------------------------------*/
+/* comp_on_batch							     */
+/*---------------------------------------------------------------------------*/
+static int comp_on_batch(struct xio_session *session, struct xio_msg **msgs,
+			 int nmsgs, void *conn_user_context)
+{
+	int i;
+
+	comp.ncalls++;
+	if (nmsgs > comp.max_batch)
+		comp.max_batch = nmsgs;
+	for (i = 0; i < nmsgs; i++)
+		if (msgs[i] != &comp_ow[comp.nmsgs++])
+			comp.order_errors++;
+	comp.last_ms = now_ms();
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* comp_send								     */
+/*---------------------------------------------------------------------------*/
+/* the transport signals only the last one, the completions before it come
+ * along
+ */
+static int comp_send(struct test_session *ts, int first, int n)
+{
+	struct xio_msg	*msg;
+	int		i;
+
+	for (i = first; i < first + n; i++) {
+		msg = &comp_ow[i];
+		memset(msg, 0, sizeof(*msg));
+		msg->out.header.iov_base	= (void *)HDR_OW;
+		msg->out.header.iov_len		= strlen(HDR_OW);
+		msg->out.sgl_type		= XIO_SGL_TYPE_IOV;
+		msg->in.sgl_type		= XIO_SGL_TYPE_IOV;
+		if (i == first + n - 1)
+			msg->flags = XIO_MSG_FLAG_IMM_SEND_COMP;
+		CHECK(xio_send_msg(ts->conn, msg) == 0);
+	}
+
+	return 0;
+}
+
+static int comp_coalesce(struct test_session *ts, struct xio_context *ctx)
+{
+	struct xio_connection_attr	attr;
+	uint64_t			start_ms;
+	int				ncalls;
+
+	comp_ops				= client_ops;
+	comp_ops.on_msg_send_complete_batch	= comp_on_batch;
+	CHECK(session_open_ops(ts, ctx, sd.port, &comp_ops) == 0);
+	CHECK(session_wait(ts) == 0);
+	memset(&comp, 0, sizeof(comp));
+
+	/* a burst is passed in calls of at most comp_max_msgs */
+	memset(&attr, 0, sizeof(attr));
+	attr.comp_max_msgs = COMP_MAX_MSGS;
+	CHECK(xio_modify_connection(ts->conn, &attr,
+				    XIO_CONNECTION_ATTR_COMP_COALESCING) == 0);
+	CHECK(comp_send(ts, 0, MAX_REQS) == 0);
+	WAIT_FOR(ctx, comp.nmsgs == MAX_REQS);
+	CHECK(comp.max_batch <= COMP_MAX_MSGS);
+	CHECK(comp.ncalls >= MAX_REQS / COMP_MAX_MSGS);
+	CHECK(comp.ncalls < MAX_REQS);
+
+	/* a few wait the delay out and share one call */
+	memset(&attr, 0, sizeof(attr));
+	attr.comp_max_msgs	= MAX_REQS;
+	attr.comp_max_delay_us	= COMP_DELAY_MS * 1000;
+	CHECK(xio_modify_connection(ts->conn, &attr,
+				    XIO_CONNECTION_ATTR_COMP_COALESCING) == 0);
+	ncalls = comp.ncalls;
+	start_ms = now_ms();
+	CHECK(comp_send(ts, MAX_REQS, COMP_LATE_NR) == 0);
+	WAIT_FOR(ctx, comp.nmsgs == MAX_REQS + COMP_LATE_NR);
+	CHECK(comp.ncalls == ncalls + 1);
+	CHECK(comp.last_ms - start_ms >= COMP_DELAY_MS - 1);
+	CHECK(comp.order_errors == 0);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* test_comp_coalesce							     */
+/*---------------------------------------------------------------------------*/
+int test_comp_coalesce(void)
+{
+	struct xio_context	*ctx;
+	struct test_session	ts;
+	int			retval;
+
+	ctx = xio_context_create(NULL, 0, -1);
+	CHECK(ctx);
+	memset(&ts, 0, sizeof(ts));
+	retval = comp_coalesce(&ts, ctx);
+	if (ts.conn && !ts.teardown && session_close(&ts))
+		retval = -1;
+	xio_context_destroy(ctx);
+
+	return retval;
+}
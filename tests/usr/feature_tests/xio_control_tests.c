@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* runtime tuning through the control socket */
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "xio_feature_tests.h"
+
+/*---------------------------------------------------------------------------*/
+/* test_control								     */
+/*---------------------------------------------------------------------------*/
+static int control_request(struct xio_context *ctx, int fd,
+			   const char *path, const char *req,
+			   char *reply, size_t len)
+{
+	struct sockaddr_un	addr;
+	uint64_t		end = now_ms() + WAIT_MS;
+	ssize_t			n;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	CHECK(sendto(fd, req, strlen(req), 0, (struct sockaddr *)&addr,
+		     sizeof(addr)) == (ssize_t)strlen(req));
+
+	/* the reply is sent from the context loop */
+	while ((n = recv(fd, reply, len - 1, MSG_DONTWAIT)) < 0) {
+		CHECK(errno == EAGAIN && now_ms() < end);
+		xio_context_poll_wait(ctx, 1);
+	}
+	reply[n] = '\0';
+
+	return 0;
+}
+
+int test_control(struct test_session *ts)
+{
+	struct sockaddr_un	addr;
+	struct xio_session_attr	attr;
+	char			path[64];
+	char			req[128];
+	char			handle[32];
+	char			reply[8192];
+	int			fd, retval = -1;
+
+	sprintf(path, "/tmp/xio_feature_tests.%d.ctl", (int)getpid());
+	CHECK(xio_context_open_control(ts->ctx, path) == 0);
+	CHECK(access(path, F_OK) == 0);
+
+	fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+	CHECK(fd >= 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(sa_family_t)))
+		goto cleanup;
+
+	/* both connections are listed by handle */
+	if (control_request(ts->ctx, fd, path, "conns", reply, sizeof(reply)))
+		goto cleanup;
+	sprintf(handle, "%p", (void *)ts[0].conn);
+	if (!strstr(reply, handle))
+		goto cleanup;
+	sprintf(handle, "%p", (void *)ts[1].conn);
+	if (!strstr(reply, handle))
+		goto cleanup;
+
+	/* a parameter set through the socket reaches the session */
+	sprintf(req, "conn %s set tx_weight 3", handle);
+	if (control_request(ts->ctx, fd, path, req, reply, sizeof(reply)) ||
+	    strcmp(reply, "ok\n"))
+		goto cleanup;
+	memset(&attr, 0, sizeof(attr));
+	if (xio_query_session(ts[1].session, &attr,
+			      XIO_SESSION_ATTR_TX_WEIGHT) ||
+	    attr.tx_weight != 3)
+		goto cleanup;
+	sprintf(req, "conn %s get tx_weight", handle);
+	if (control_request(ts->ctx, fd, path, req, reply, sizeof(reply)) ||
+	    strcmp(reply, "tx_weight 3\n"))
+		goto cleanup;
+
+	if (control_request(ts->ctx, fd, path, "no_such_request", reply,
+			    sizeof(reply)) ||
+	    strncmp(reply, "error", 5))
+		goto cleanup;
+	retval = 0;
+
+cleanup:
+	if (retval)
+		fprintf(stderr, "%s: unexpected reply: %s\n", __func__, reply);
+	close(fd);
+	CHECK(xio_context_open_control(ts->ctx, NULL) == 0);
+	CHECK(access(path, F_OK) == -1);
+
+	return retval;
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* completion queue polling */
+#include "xio_feature_tests.h"
+
+/*---------------------------------------------------------------------------*/
+/* test_poll_cq								     */
+/*---------------------------------------------------------------------------*/
+/* with a completion queue the responses are harvested, not called back.
+ * the queue starts smaller than the burst and has to grow
+ */
+int test_poll_cq(struct xio_context *plain_ctx)
+{
+	struct xio_context_params	ctx_params;
+	struct xio_context		*ctx;
+	struct test_session		ts;
+	struct xio_cq_event		events[4];
+	uint64_t			end;
+	int				harvested[16];
+	int				i, n, nevents = 0;
+
+	memset(&ctx_params, 0, sizeof(ctx_params));
+	ctx_params.cq_depth = 4;
+	ctx = xio_context_create(&ctx_params, 0, -1);
+	CHECK(ctx);
+
+	CHECK(session_open(&ts, ctx) == 0);
+	CHECK(session_wait(&ts) == 0);
+	for (i = 0; i < 16; i++) {
+		CHECK(xio_send_request(ts.conn,
+				       req_init(i, HDR_ECHO)) == 0);
+		harvested[i] = 0;
+	}
+
+	end = now_ms() + WAIT_MS;
+	while (nevents < 16) {
+		CHECK(now_ms() < end);
+		xio_context_poll_wait(ctx, 1);
+		n = xio_poll_cq(ctx, events, 4);
+		CHECK(n >= 0 && n <= 4);
+		for (i = 0; i < n; i++) {
+			CHECK(events[i].type == XIO_CQ_EVENT_MSG);
+			CHECK(events[i].conn == ts.conn);
+			CHECK(events[i].session == ts.session);
+			CHECK(events[i].conn_user_context == &ts);
+			CHECK(events[i].msg == &reqs[nevents].msg);
+			CHECK(events[i].msg->type == XIO_MSG_TYPE_RSP);
+			harvested[nevents++]++;
+			xio_release_response(events[i].msg);
+		}
+	}
+	for (i = 0; i < 16; i++)
+		CHECK(harvested[i] == 1);
+	CHECK(xio_poll_cq(ctx, events, 4) == 0);
+	CHECK(ts.nrsp == 0 && ts.nerr == 0);
+
+	CHECK(session_close(&ts) == 0);
+	xio_context_destroy(ctx);
+
+	/* a context without a completion queue has nothing to harvest */
+	CHECK(xio_poll_cq(plain_ctx, events, 4) == -1);
+
+	return 0;
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* flow control credits carried by the messages themselves */
+#include "xio_feature_tests.h"
+
+#define CREDITS_DEPTH		4	/* receive queue, acked at half */
+#define CREDITS_PAIR		(CREDITS_DEPTH / 2)
+
+static struct xio_msg		credits_ow[MAX_REQS];
+static struct xio_session_ops	credits_ops;
+static int			credits_sent;
+
+/*---------------------------------------------------------------------------*/
+/* credits_send_pair							     */
+/*---------------------------------------------------------------------------*/
+static void credits_send_pair(struct test_session *ts)
+{
+	int i;
+
+	for (i = 0; i < CREDITS_PAIR && credits_sent < MAX_REQS; i++) {
+		if (xio_send_request(ts->conn,
+				     req_init(credits_sent++, HDR_ECHO)))
+			ts->nerr++;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* credits_on_response							     */
+/*---------------------------------------------------------------------------*/
+/* requests go in pairs. releasing the second response of a pair reaches
+ * the ack watermark, the next pair goes out right after and carries the
+ * credits
+ */
+static int credits_on_response(struct xio_session *session,
+			       struct xio_msg *rsp,
+			       int last_in_rxq,
+			       void *cb_user_context)
+{
+	struct test_session *ts = (struct test_session *)cb_user_context;
+
+	ts->nrsp++;
+	xio_release_response(rsp);
+	if (ts->nrsp % CREDITS_PAIR == 0)
+		credits_send_pair(ts);
+
+	return 0;
+}
+
+static int tx_tasks_cb(const struct xio_stat *stat, void *user_context)
+{
+	if (stat->scope == XIO_STAT_SCOPE_NEXUS &&
+	    !strcmp(stat->name, "TX_TASKS"))
+		*(uint64_t *)user_context += stat->value;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* test_credits_piggyback						     */
+/*---------------------------------------------------------------------------*/
+/* while requests keep going out, the client's credits never need an ack
+ * of their own. one way messages get no reply, the server still acks them
+ */
+static int credits_piggyback(struct test_session *ts, struct xio_context *ctx)
+{
+	uint64_t		before = 0, after = 0;
+	int			rcvd = sd.ow_rcvd;
+	int			i;
+
+	credits_ops		= client_ops;
+	credits_ops.on_msg	= credits_on_response;
+	CHECK(session_open_ops(ts, ctx, sd.port, &credits_ops) == 0);
+	CHECK(session_wait(ts) == 0);
+
+	CHECK(xio_query_stats(ctx, tx_tasks_cb, &before) == 0);
+	credits_sent = 0;
+	credits_send_pair(ts);
+	WAIT_FOR(ctx, ts->nrsp == MAX_REQS);
+	CHECK(ts->nerr == 0);
+	for (i = 0; i < 10; i++)
+		xio_context_poll_wait(ctx, 1);
+	CHECK(xio_query_stats(ctx, tx_tasks_cb, &after) == 0);
+	/* only the last pair's credits have no request to ride on */
+	CHECK(after - before == MAX_REQS + 1);
+
+	/* far more than the server's receive queue holds */
+	for (i = 0; i < MAX_REQS; i++) {
+		memset(&credits_ow[i], 0, sizeof(credits_ow[i]));
+		credits_ow[i].out.header.iov_base = (void *)HDR_OW;
+		credits_ow[i].out.header.iov_len  = strlen(HDR_OW);
+		credits_ow[i].out.sgl_type	  = XIO_SGL_TYPE_IOV;
+		credits_ow[i].in.sgl_type	  = XIO_SGL_TYPE_IOV;
+		CHECK(xio_send_msg(ts->conn, &credits_ow[i]) == 0);
+	}
+	WAIT_FOR(ctx, sd.ow_rcvd == rcvd + MAX_REQS);
+
+	return 0;
+}
+
+int test_credits_piggyback(void)
+{
+	struct xio_context	*ctx;
+	struct test_session	ts;
+	int			flow_control, depth, len;
+	int			enable = 1, small = CREDITS_DEPTH;
+	int			retval;
+
+	len = sizeof(int);
+	CHECK(xio_get_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+			  XIO_OPTNAME_ENABLE_FLOW_CONTROL,
+			  &flow_control, &len) == 0);
+	CHECK(xio_get_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+			  XIO_OPTNAME_RCV_QUEUE_DEPTH_MSGS, &depth, &len) == 0);
+	xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+		    XIO_OPTNAME_ENABLE_FLOW_CONTROL, &enable, sizeof(int));
+	xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+		    XIO_OPTNAME_RCV_QUEUE_DEPTH_MSGS, &small, sizeof(int));
+
+	/* a context of its own, its nexus carries only this session */
+	ctx = xio_context_create(NULL, 0, -1);
+	CHECK(ctx);
+	memset(&ts, 0, sizeof(ts));
+	retval = credits_piggyback(&ts, ctx);
+	if (ts.conn && !ts.teardown && session_close(&ts))
+		retval = -1;
+	xio_context_destroy(ctx);
+
+	xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+		    XIO_OPTNAME_ENABLE_FLOW_CONTROL, &flow_control,
+		    sizeof(int));
+	xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+		    XIO_OPTNAME_RCV_QUEUE_DEPTH_MSGS, &depth, sizeof(int));
+
+	return retval;
+}
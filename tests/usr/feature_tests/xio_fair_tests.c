@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* sessions sharing a nexus take turns on it */
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "xio_feature_tests.h"
+
+#define FAIR_BURST		24
+#define FAIR_LATE		4
+#define FAIR_NR			(FAIR_BURST + FAIR_LATE)
+#define FAIR_SIZE		4000
+
+static uint8_t			fair_buf[FAIR_SIZE];
+static char			fair_hdr[FAIR_NR][8];
+
+/*---------------------------------------------------------------------------*/
+/* a server of its own that takes the requests one by one, as they come off
+ * the wire. it notes where each one arrived
+ */
+struct fair_server {
+	struct xio_context	*ctx;
+	struct xio_server	*server;
+	int			arrival[FAIR_NR];
+	uint16_t		port;
+	uint16_t		pad[3];
+	volatile int		ready;
+	volatile int		stop;
+	volatile int		nsessions;
+	volatile int		rcvd;
+};
+
+static struct fair_server	fs;
+
+static int fs_on_msg(struct xio_session *session, struct xio_msg *req,
+		     int last_in_rxq, void *cb_user_context)
+{
+	const char	*hdr = (const char *)req->in.header.iov_base;
+	int		i = -1;
+
+	/* the header is the request's index, two digits */
+	if (req->in.header.iov_len == 2)
+		i = (hdr[0] - '0') * 10 + hdr[1] - '0';
+	if (i >= 0 && i < FAIR_NR)
+		fs.arrival[i] = fs.rcvd++;
+	server_respond(req, 0);
+
+	return 0;
+}
+
+static int fs_on_send_complete(struct xio_session *session,
+			       struct xio_msg *rsp, void *cb_user_context)
+{
+	free(rsp);
+
+	return 0;
+}
+
+static int fs_on_session_event(struct xio_session *session,
+			       struct xio_session_event_data *event_data,
+			       void *cb_user_context)
+{
+	switch (event_data->event) {
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		xio_connection_destroy(event_data->conn);
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		xio_session_destroy(session);
+		fs.nsessions--;
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+static int fs_on_new_session(struct xio_session *session,
+			     struct xio_new_session_req *req,
+			     void *cb_user_context)
+{
+	fs.nsessions++;
+	xio_accept(session, NULL, 0, NULL, 0);
+
+	return 0;
+}
+
+static struct xio_session_ops fs_ops = {
+	.on_session_event		=  fs_on_session_event,
+	.on_new_session			=  fs_on_new_session,
+	.on_msg				=  fs_on_msg,
+	.on_msg_send_complete		=  fs_on_send_complete,
+};
+
+static void *fs_thread(void *data)
+{
+	fs.ctx = xio_context_create(NULL, 0, -1);
+	if (!fs.ctx) {
+		fs.ready = -1;
+		return NULL;
+	}
+	fs.server = xio_bind(fs.ctx, &fs_ops, SERVER_URI, &fs.port, 0, NULL);
+	if (!fs.server) {
+		fs.ready = -1;
+		xio_context_destroy(fs.ctx);
+		return NULL;
+	}
+	fs.ready = 1;
+
+	while (!fs.stop || fs.nsessions)
+		xio_context_poll_wait(fs.ctx, 1);
+	xio_unbind(fs.server);
+	xio_context_destroy(fs.ctx);
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* fair_req								     */
+/*---------------------------------------------------------------------------*/
+static struct xio_msg *fair_req(int i)
+{
+	struct xio_msg *req;
+
+	sprintf(fair_hdr[i], "%02d", i);
+	req = req_init(i, fair_hdr[i]);
+	req->out.data_iov.nents			= 1;
+	req->out.data_iov.sglist[0].iov_base	= fair_buf;
+	req->out.data_iov.sglist[0].iov_len	= FAIR_SIZE;
+
+	return req;
+}
+
+/*---------------------------------------------------------------------------*/
+/* test_nexus_fair							     */
+/*---------------------------------------------------------------------------*/
+/* two sessions ride one nexus. one queues a burst, the other a few requests
+ * right after it. the burst may get only a quantum ahead, so the late
+ * requests reach the server before most of the burst
+ */
+static int nexus_fair(struct test_session *ts, struct xio_context *ctx)
+{
+	int	i;
+
+	CHECK(session_open_port(&ts[0], ctx, fs.port) == 0);
+	CHECK(session_wait(&ts[0]) == 0);
+	CHECK(session_open_port(&ts[1], ctx, fs.port) == 0);
+	CHECK(session_wait(&ts[1]) == 0);
+
+	for (i = 0; i < FAIR_BURST; i++)
+		CHECK(xio_send_request(ts[0].conn, fair_req(i)) == 0);
+	for (; i < FAIR_NR; i++)
+		CHECK(xio_send_request(ts[1].conn, fair_req(i)) == 0);
+
+	WAIT_FOR(ctx, ts[0].nrsp == FAIR_BURST && ts[1].nrsp == FAIR_LATE);
+	CHECK(fs.rcvd == FAIR_NR);
+
+	for (i = FAIR_BURST; i < FAIR_NR; i++)
+		CHECK(fs.arrival[i] < FAIR_BURST / 2);
+
+	return 0;
+}
+
+int test_nexus_fair(struct xio_context *ctx)
+{
+	struct test_session	ts[2];
+	pthread_t		stid;
+	int			retval;
+
+	memset(&fs, 0, sizeof(fs));
+	memset(ts, 0, sizeof(ts));
+	pthread_create(&stid, NULL, fs_thread, NULL);
+	while (!fs.ready)
+		usleep(1000);
+
+	retval = fs.ready > 0 ? nexus_fair(ts, ctx) : -1;
+
+	if (ts[1].conn && session_close(&ts[1]))
+		retval = -1;
+	if (ts[0].conn && session_close(&ts[0]))
+		retval = -1;
+	fs.stop = 1;
+	pthread_join(stid, NULL);
+
+	return retval;
+}
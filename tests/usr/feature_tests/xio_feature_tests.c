@@ -0,0 +1,624 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* server and client run in one process over tcp loopback, the server on
+ * its own thread and context. each test checks one feature and the
+ * program exits nonzero if any of them failed
+ */
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "libxio.h"
+#include "xio_feature_tests.h"
+
+struct server_data	sd;
+struct test_req		reqs[MAX_REQS];
+struct xio_reg_mem	big_out;
+struct xio_reg_mem	big_in;
+
+static int		nrsp_all;
+
+/*---------------------------------------------------------------------------*/
+/* now_ms								     */
+/*---------------------------------------------------------------------------*/
+uint64_t now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+/*---------------------------------------------------------------------------*/
+/* pattern								     */
+/*---------------------------------------------------------------------------*/
+static inline uint8_t pattern(size_t off)
+{
+	return (uint8_t)(off % 251);
+}
+
+static void pattern_fill(uint8_t *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = pattern(i);
+}
+
+int pattern_check(struct xio_vmsg *vmsg)
+{
+	struct xio_iovec_ex	*sglist = vmsg_sglist(vmsg);
+	int			nents = vmsg_sglist_nents(vmsg);
+	size_t			off = 0, j;
+	int			i;
+
+	for (i = 0; i < nents; i++) {
+		for (j = 0; j < sglist[i].iov_len; j++, off++)
+			if (((uint8_t *)sglist[i].iov_base)[j] != pattern(off))
+				return -1;
+	}
+
+	return off == BIG_SIZE ? 0 : -1;
+}
+
+int hdr_is(struct xio_msg *msg, const char *hdr)
+{
+	return msg->in.header.iov_len == strlen(hdr) &&
+	       !memcmp(msg->in.header.iov_base, hdr, strlen(hdr));
+}
+
+/*---------------------------------------------------------------------------*/
+/* server_respond							     */
+/*---------------------------------------------------------------------------*/
+void server_respond(struct xio_msg *req, int big)
+{
+	struct xio_msg *rsp;
+
+	rsp = (struct xio_msg *)calloc(1, sizeof(*rsp));
+	if (!rsp) {
+		fprintf(stderr, "server: response allocation failed\n");
+		return;
+	}
+	rsp->request			= req;
+	rsp->out.sgl_type		= XIO_SGL_TYPE_IOV;
+	rsp->out.data_iov.max_nents	= XIO_IOVLEN;
+	if (big) {
+		rsp->out.data_iov.nents			= 1;
+		rsp->out.data_iov.sglist[0].iov_base	= sd.big.addr;
+		rsp->out.data_iov.sglist[0].iov_len	= BIG_SIZE;
+		rsp->out.data_iov.sglist[0].mr		= sd.big.mr;
+	}
+	/* the connection may be gone, e.g. a canceled hedge copy */
+	if (xio_send_response(rsp))
+		free(rsp);
+}
+
+/*---------------------------------------------------------------------------*/
+/* server_release_held							     */
+/*---------------------------------------------------------------------------*/
+static void server_release_held(void)
+{
+	uint64_t	now = now_ms();
+	int		i = 0;
+
+	while (i < sd.nheld) {
+		if (sd.held[i].due_ms > now) {
+			i++;
+			continue;
+		}
+		server_respond(sd.held[i].req, 0);
+		sd.held[i] = sd.held[--sd.nheld];
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/* server_on_one_way							     */
+/*---------------------------------------------------------------------------*/
+/* one way messages are counted and checked for order per connection */
+static void server_on_one_way(struct xio_msg *msg,
+			      struct xio_connection *conn)
+{
+	if (conn != sd.ow_conn) {
+		sd.ow_conn	= conn;
+		sd.ow_last_sn	= 0;
+	}
+	if (sd.ow_last_sn && msg->sn <= sd.ow_last_sn)
+		sd.ow_order_errors++;
+	sd.ow_last_sn = msg->sn;
+	sd.ow_rcvd++;
+
+	xio_release_msg(msg);
+}
+
+/*---------------------------------------------------------------------------*/
+/* server_on_msg_batch							     */
+/*---------------------------------------------------------------------------*/
+static int server_on_msg_batch(struct xio_session *session,
+			       struct xio_msg **msgs, int nmsgs,
+			       void *conn_user_context)
+{
+	struct xio_msg	*req;
+	int		i;
+
+	sd.nbatches++;
+	for (i = 0; i < nmsgs; i++) {
+		req = msgs[i];
+		sd.nbatched++;
+		if (req->type == XIO_MSG_TYPE_ONE_WAY) {
+			server_on_one_way(req, (struct xio_connection *)
+					       conn_user_context);
+			continue;
+		}
+		/* one connection per batch, in arrival order */
+		if (i && req->sn <= msgs[i - 1]->sn)
+			sd.batch_errors++;
+
+		sd.last_timeout_us = req->timeout_us;
+		if (hdr_is(req, HDR_HOLD)) {
+			sd.nhold++;
+			if (sd.nheld == HOLD_MAX) {
+				server_respond(req, 0);
+				continue;
+			}
+			sd.held[sd.nheld].req	 = req;
+			sd.held[sd.nheld].conn	 = (struct xio_connection *)
+						   conn_user_context;
+			sd.held[sd.nheld].due_ms = now_ms() + HOLD_MS;
+			sd.nheld++;
+		} else if (hdr_is(req, HDR_BIG)) {
+			if (pattern_check(&req->in))
+				sd.nbig_bad++;
+			else
+				sd.nbig_ok++;
+			server_respond(req, 1);
+		} else {
+			server_respond(req, 0);
+		}
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* server_on_send_complete						     */
+/*---------------------------------------------------------------------------*/
+static int server_on_send_complete(struct xio_session *session,
+				   struct xio_msg *rsp,
+				   void *cb_user_context)
+{
+	free(rsp);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* server_on_msg_error							     */
+/*---------------------------------------------------------------------------*/
+static int server_on_msg_error(struct xio_session *session,
+			       enum xio_status error,
+			       enum xio_msg_direction direction,
+			       struct xio_msg *msg,
+			       void *cb_user_context)
+{
+	if (direction == XIO_MSG_DIRECTION_OUT)
+		free(msg);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* server_on_session_event						     */
+/*---------------------------------------------------------------------------*/
+static int server_on_session_event(struct xio_session *session,
+				   struct xio_session_event_data *event_data,
+				   void *cb_user_context)
+{
+	struct xio_connection_attr	attr;
+	int				i = 0;
+
+	switch (event_data->event) {
+	case XIO_SESSION_NEW_CONNECTION_EVENT:
+		/* batches name their connection */
+		memset(&attr, 0, sizeof(attr));
+		attr.user_context = event_data->conn;
+		xio_modify_connection(event_data->conn, &attr,
+				      XIO_CONNECTION_ATTR_USER_CTX);
+		break;
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		/* held requests die with their connection */
+		while (i < sd.nheld) {
+			if (sd.held[i].conn == event_data->conn)
+				sd.held[i] = sd.held[--sd.nheld];
+			else
+				i++;
+		}
+		if (sd.ow_conn == event_data->conn)
+			sd.ow_conn = NULL;
+		xio_connection_destroy(event_data->conn);
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		xio_session_destroy(session);
+		sd.nsessions--;
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* server_on_new_session						     */
+/*---------------------------------------------------------------------------*/
+static int server_on_new_session(struct xio_session *session,
+				 struct xio_new_session_req *req,
+				 void *cb_user_context)
+{
+	sd.nsessions++;
+	xio_accept(session, NULL, 0, NULL, 0);
+
+	return 0;
+}
+
+static struct xio_session_ops server_ops = {
+	.on_session_event		=  server_on_session_event,
+	.on_new_session			=  server_on_new_session,
+	.on_msg_send_complete		=  server_on_send_complete,
+	.on_msg_error			=  server_on_msg_error,
+	.on_msg_batch			=  server_on_msg_batch,
+};
+
+/*---------------------------------------------------------------------------*/
+/* server_thread							     */
+/*---------------------------------------------------------------------------*/
+static void *server_thread(void *data)
+{
+	sd.ctx = xio_context_create(NULL, 0, -1);
+	if (!sd.ctx) {
+		fprintf(stderr, "server: context creation failed. %s\n",
+			xio_strerror(xio_errno()));
+		sd.ready = -1;
+		return NULL;
+	}
+	if (xio_mem_alloc(sd.ctx, BIG_SIZE, &sd.big)) {
+		fprintf(stderr, "server: xio_mem_alloc failed\n");
+		goto cleanup;
+	}
+	pattern_fill((uint8_t *)sd.big.addr, BIG_SIZE);
+
+	sd.server = xio_bind(sd.ctx, &server_ops, SERVER_URI, &sd.port, 0,
+			     NULL);
+	if (!sd.server) {
+		fprintf(stderr, "server: bind failed. %s\n",
+			xio_strerror(xio_errno()));
+		goto cleanup;
+	}
+	sd.ready = 1;
+
+	while (!sd.stop || sd.nsessions) {
+		xio_context_poll_wait(sd.ctx, 1);
+		server_release_held();
+	}
+	xio_unbind(sd.server);
+
+cleanup:
+	if (sd.ready != 1)
+		sd.ready = -1;
+	if (sd.big.addr)
+		xio_mem_free(&sd.big);
+	xio_context_destroy(sd.ctx);
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* client_on_session_event						     */
+/*---------------------------------------------------------------------------*/
+static int client_on_session_event(struct xio_session *session,
+				   struct xio_session_event_data *event_data,
+				   void *cb_user_context)
+{
+	struct test_session *ts = (struct test_session *)cb_user_context;
+
+	switch (event_data->event) {
+	case XIO_SESSION_CONNECTION_ESTABLISHED_EVENT:
+		ts->established = 1;
+		break;
+	case XIO_SESSION_CONNECTION_TEARDOWN_EVENT:
+		xio_connection_destroy(event_data->conn);
+		break;
+	case XIO_SESSION_TEARDOWN_EVENT:
+		xio_session_destroy(session);
+		ts->teardown = 1;
+		break;
+	default:
+		break;
+	};
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* client_on_response							     */
+/*---------------------------------------------------------------------------*/
+static int client_on_response(struct xio_session *session,
+			      struct xio_msg *rsp,
+			      int last_in_rxq,
+			      void *cb_user_context)
+{
+	struct test_session	*ts = (struct test_session *)cb_user_context;
+	struct test_req		*treq = (struct test_req *)rsp->user_context;
+
+	treq->seq = ts->nrsp++;
+	treq->order = nrsp_all++;
+	if (vmsg_sglist_nents(&rsp->in) && !pattern_check(&rsp->in))
+		ts->nbig_ok++;
+	xio_release_response(rsp);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* client_on_msg_error							     */
+/*---------------------------------------------------------------------------*/
+static int client_on_msg_error(struct xio_session *session,
+			       enum xio_status error,
+			       enum xio_msg_direction direction,
+			       struct xio_msg *msg,
+			       void *cb_user_context)
+{
+	struct test_session *ts = (struct test_session *)cb_user_context;
+
+	ts->nerr++;
+	ts->last_err = error;
+	if (direction == XIO_MSG_DIRECTION_IN)
+		xio_release_response(msg);
+
+	return 0;
+}
+
+struct xio_session_ops client_ops = {
+	.on_session_event		=  client_on_session_event,
+	.on_msg				=  client_on_response,
+	.on_msg_error			=  client_on_msg_error,
+};
+
+/*---------------------------------------------------------------------------*/
+/* session_open_ops							     */
+/*---------------------------------------------------------------------------*/
+int session_open_ops(struct test_session *ts, struct xio_context *ctx,
+		     uint16_t port, struct xio_session_ops *ops)
+{
+	struct xio_session_params	params;
+	struct xio_connection_params	cparams;
+	char				uri[64];
+
+	memset(ts, 0, sizeof(*ts));
+	sprintf(uri, "tcp://127.0.0.1:%u", port);
+
+	memset(&params, 0, sizeof(params));
+	params.type		= XIO_SESSION_CLIENT;
+	params.ses_ops		= ops;
+	params.user_context	= ts;
+	params.uri		= uri;
+	ts->session = xio_session_create(&params);
+	CHECK(ts->session);
+	ts->ctx = ctx;
+
+	memset(&cparams, 0, sizeof(cparams));
+	cparams.session			= ts->session;
+	cparams.ctx			= ctx;
+	cparams.conn_user_context	= ts;
+	ts->conn = xio_connect(&cparams);
+	CHECK(ts->conn);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* session_open_port							     */
+/*---------------------------------------------------------------------------*/
+int session_open_port(struct test_session *ts, struct xio_context *ctx,
+		      uint16_t port)
+{
+	return session_open_ops(ts, ctx, port, &client_ops);
+}
+
+/*---------------------------------------------------------------------------*/
+/* session_open								     */
+/*---------------------------------------------------------------------------*/
+int session_open(struct test_session *ts, struct xio_context *ctx)
+{
+	return session_open_port(ts, ctx, sd.port);
+}
+
+/*---------------------------------------------------------------------------*/
+/* session_wait								     */
+/*---------------------------------------------------------------------------*/
+int session_wait(struct test_session *ts)
+{
+	WAIT_FOR(ts->ctx, ts->established);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* session_close							     */
+/*---------------------------------------------------------------------------*/
+int session_close(struct test_session *ts)
+{
+	xio_disconnect(ts->conn);
+	WAIT_FOR(ts->ctx, ts->teardown);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* req_init								     */
+/*---------------------------------------------------------------------------*/
+struct xio_msg *req_init(int i, const char *hdr)
+{
+	struct xio_msg *req = &reqs[i].msg;
+
+	memset(&reqs[i], 0, sizeof(reqs[i]));
+	reqs[i].seq			= -1;
+	reqs[i].order			= -1;
+	req->out.header.iov_base	= (void *)hdr;
+	req->out.header.iov_len		= strlen(hdr);
+	req->out.sgl_type		= XIO_SGL_TYPE_IOV;
+	req->out.data_iov.max_nents	= XIO_IOVLEN;
+	req->in.sgl_type		= XIO_SGL_TYPE_IOV;
+	req->in.data_iov.max_nents	= XIO_IOVLEN;
+	req->user_context		= &reqs[i];
+
+	return req;
+}
+
+/*---------------------------------------------------------------------------*/
+/* main									     */
+/*---------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+	struct xio_context	*ctx;
+	struct test_session	ts[NSESSIONS];
+	pthread_t		stid;
+	int			frag = FRAG_SIZE;
+	int			enable = 1;
+	int			i, failed = 0;
+
+	xio_init();
+
+	/* both sides share the options, the 1MB transfers take 64 fragments */
+	xio_set_opt(NULL, XIO_OPTLEVEL_TCP, XIO_OPTNAME_TCP_FRAG_SIZE,
+		    &frag, sizeof(frag));
+	/* send queue depths are enforced with flow control only */
+	xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO, XIO_OPTNAME_ENABLE_FLOW_CONTROL,
+		    &enable, sizeof(enable));
+	/* held requests must not hold back the ones behind them */
+	xio_set_opt(NULL, XIO_OPTLEVEL_TCP, XIO_OPTNAME_TCP_NO_DELAY,
+		    &enable, sizeof(enable));
+
+	pthread_create(&stid, NULL, server_thread, NULL);
+	while (!sd.ready)
+		usleep(1000);
+	if (sd.ready < 0) {
+		pthread_join(stid, NULL);
+		xio_shutdown();
+		return 1;
+	}
+
+	ctx = xio_context_create(NULL, 0, -1);
+	if (!ctx || xio_mem_alloc(ctx, BIG_SIZE, &big_out) ||
+	    xio_mem_alloc(ctx, BIG_SIZE, &big_in)) {
+		fprintf(stderr, "client setup failed. %s\n",
+			xio_strerror(xio_errno()));
+		return 1;
+	}
+	pattern_fill((uint8_t *)big_out.addr, BIG_SIZE);
+
+#define RUN(test)							\
+	do {								\
+		int _failed = (test) != 0;				\
+									\
+		printf("%s %s\n", _failed ? "FAIL" : "PASS", #test);	\
+		failed += _failed;					\
+	} while (0)
+
+	for (i = 0; i < NSESSIONS; i++) {
+		if (session_open(&ts[i], ctx) || session_wait(&ts[i])) {
+			failed++;
+			goto cleanup;
+		}
+	}
+
+	RUN(test_tcp_frag(ts));
+	RUN(test_task_layout(&ts[0]));
+	RUN(test_contig_slabs());
+	RUN(test_lean_conns());
+	RUN(test_objpool_grow(ts));
+	RUN(test_mem_stats());
+	RUN(test_query_stats(ctx));
+	RUN(test_control(ts));
+	RUN(test_cancel(&ts[0]));
+	RUN(test_cancel_queued(ctx));
+	RUN(test_deadline(ctx));
+	RUN(test_hedge_cancel(ts));
+	RUN(test_hedge_overflow(ts));
+	RUN(test_hedge_errors(ctx));
+	RUN(test_poll_cq(ctx));
+	RUN(test_agg_pack());
+	RUN(test_agg_backpressure(ctx));
+	RUN(test_nexus_fair(ctx));
+	RUN(test_msg_batch(&ts[0]));
+	RUN(test_credits_piggyback());
+	RUN(test_prio_strict(ctx));
+	RUN(test_prio_weighted(ctx));
+	RUN(test_comp_coalesce());
+	RUN(test_stats_shm());
+	RUN(test_latency());
+	RUN(test_breakdown());
+	RUN(test_tracepoints());
+	RUN(test_flight());
+	RUN(test_log_rate());
+	RUN(test_perf_counters());
+	RUN(test_observer_hash());
+	RUN(test_ev_handler_frees());
+
+	for (i = 0; i < NSESSIONS; i++)
+		if (session_close(&ts[i]))
+			failed++;
+
+cleanup:
+	sd.stop = 1;
+	pthread_join(stid, NULL);
+
+	xio_mem_free(&big_in);
+	xio_mem_free(&big_out);
+	xio_context_destroy(ctx);
+	xio_shutdown();
+
+	printf("%s\n", failed ? "FAILED" : "PASSED");
+
+	return failed ? 1 : 0;
+}
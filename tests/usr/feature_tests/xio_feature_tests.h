@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef XIO_FEATURE_TESTS_H
+#define XIO_FEATURE_TESTS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "libxio.h"
+
+#define SERVER_URI		"tcp://127.0.0.1:0"
+#define BIG_SIZE		(1024 * 1024)
+#define FRAG_SIZE		(16 * 1024)
+#define HOLD_MS			30
+#define HOLD_MAX		64
+#define WAIT_MS			5000
+#define MAX_REQS		32
+#define NSESSIONS		2
+
+#define HDR_ECHO		"echo"
+#define HDR_HOLD		"hold"
+#define HDR_BIG			"big"
+#define HDR_OW			"ow"
+
+#define CHECK(cond)							\
+	do {								\
+		if (!(cond)) {						\
+			fprintf(stderr, "%s:%d: %s failed\n",		\
+				__func__, __LINE__, #cond);		\
+			return -1;					\
+		}							\
+	} while (0)
+
+/* runs the context loop until cond holds */
+#define WAIT_FOR(ctx, cond)						\
+	do {								\
+		uint64_t _end = now_ms() + WAIT_MS;			\
+									\
+		while (!(cond)) {					\
+			if (now_ms() > _end) {				\
+				fprintf(stderr, "%s:%d: timeout "	\
+					"waiting for %s\n",		\
+					__func__, __LINE__, #cond);	\
+				return -1;				\
+			}						\
+			xio_context_poll_wait((ctx), 1);		\
+		}							\
+	} while (0)
+
+struct held_req {
+	struct xio_msg		*req;
+	struct xio_connection	*conn;
+	uint64_t		due_ms;
+};
+
+struct server_data {
+	struct xio_context	*ctx;
+	struct xio_server	*server;
+	struct xio_reg_mem	big;
+	struct held_req		held[HOLD_MAX];
+	int			nheld;
+	uint16_t		port;
+	uint16_t		pad;
+	volatile int		ready;
+	volatile int		stop;
+	volatile int		nsessions;
+	volatile int		nhold;
+	volatile int		nbig_ok;
+	volatile int		nbig_bad;
+	volatile int		nbatches;
+	volatile int		nbatched;
+	volatile int		batch_errors;
+	volatile uint32_t	last_timeout_us;	/* time left, last req */
+	/* one way messages */
+	volatile int		ow_rcvd;
+	volatile int		ow_order_errors;
+	struct xio_connection	*ow_conn;
+	uint64_t		ow_last_sn;
+};
+
+struct test_session {
+	struct xio_context	*ctx;
+	struct xio_session	*session;
+	struct xio_connection	*conn;
+	int			established;
+	int			teardown;
+	int			nrsp;
+	int			nerr;
+	int			nbig_ok;
+	enum xio_status		last_err;
+};
+
+struct test_req {
+	struct xio_msg		msg;
+	int			seq;	/* response arrival order */
+	int			order;	/* the same, across sessions */
+};
+
+extern struct server_data	sd;
+extern struct test_req		reqs[MAX_REQS];
+extern struct xio_reg_mem	big_out;
+extern struct xio_reg_mem	big_in;
+extern struct xio_session_ops	client_ops;
+
+/*---------------------------------------------------------------------------*/
+/* harness - xio_feature_tests.c					     */
+/*---------------------------------------------------------------------------*/
+uint64_t now_ms(void);
+
+/* checks the pattern across the scatter list of a message side */
+int pattern_check(struct xio_vmsg *vmsg);
+
+int hdr_is(struct xio_msg *msg, const char *hdr);
+
+void server_respond(struct xio_msg *req, int big);
+
+/* connects without waiting, requests sent now stay queued. a session has
+ * one connection per context
+ */
+int session_open(struct test_session *ts, struct xio_context *ctx);
+
+/* the same, to a server of the test's own */
+int session_open_port(struct test_session *ts, struct xio_context *ctx,
+		      uint16_t port);
+
+/* the same, with callbacks of the test's own. ts is their user context */
+int session_open_ops(struct test_session *ts, struct xio_context *ctx,
+		     uint16_t port, struct xio_session_ops *ops);
+
+int session_wait(struct test_session *ts);
+
+int session_close(struct test_session *ts);
+
+struct xio_msg *req_init(int i, const char *hdr);
+
+/*---------------------------------------------------------------------------*/
+/* xio_agg_tests.c							     */
+/*---------------------------------------------------------------------------*/
+int test_agg_pack(void);
+int test_agg_backpressure(struct xio_context *ctx);
+
+/*---------------------------------------------------------------------------*/
+/* xio_batch_tests.c							     */
+/*---------------------------------------------------------------------------*/
+int test_msg_batch(struct test_session *ts);
+
+/*---------------------------------------------------------------------------*/
+/* xio_cancel_tests.c							     */
+/*---------------------------------------------------------------------------*/
+int test_cancel(struct test_session *ts);
+int test_cancel_queued(struct xio_context *ctx);
+int test_deadline(struct xio_context *ctx);
+
+/*---------------------------------------------------------------------------*/
+/* xio_comp_tests.c							     */
+/*---------------------------------------------------------------------------*/
+int test_comp_coalesce(void);
+
+/*---------------------------------------------------------------------------*/
+/* xio_control_tests.c							     */
+/*---------------------------------------------------------------------------*/
+int test_control(struct test_session *ts);
+
+/*---------------------------------------------------------------------------*/
+/* xio_cq_tests.c							     */
+/*---------------------------------------------------------------------------*/
+int test_poll_cq(struct xio_context *plain_ctx);
+
+/*---------------------------------------------------------------------------*/
+/* xio_credits_tests.c							     */
+/*---------------------------------------------------------------------------*/
+int test_credits_piggyback(void);
+
+/*---------------------------------------------------------------------------*/
+/* xio_fair_tests.c							     */
+/*---------------------------------------------------------------------------*/
+int test_nexus_fair(struct xio_context *ctx);
+
+/*---------------------------------------------------------------------------*/
+/* xio_flight_tests.c							     */
+/*---------------------------------------------------------------------------*/
+int test_flight(void);
+
+/*---------------------------------------------------------------------------*/
+/* xio_frag_tests.c							     */
+/*---------------------------------------------------------------------------*/
+int test_tcp_frag(struct test_session *ts);
+
+/*---------------------------------------------------------------------------*/
+/* xio_hedge_tests.c							     */
+/*---------------------------------------------------------------------------*/
+int test_hedge_cancel(struct test_session *ts);
+int test_hedge_overflow(struct test_session *ts);
+int test_hedge_errors(struct xio_context *ctx);
+
+/*---------------------------------------------------------------------------*/
+/* xio_log_tests.c							     */
+/*---------------------------------------------------------------------------*/
+int test_log_rate(void);
+
+/*---------------------------------------------------------------------------*/
+/* xio_mem_tests.c							     */
+/*---------------------------------------------------------------------------*/
+int test_objpool_grow(struct test_session *ts);
+int test_mem_stats(void);
+
+/*---------------------------------------------------------------------------*/
+/* xio_observer_tests.c							     */
+/*---------------------------------------------------------------------------*/
+int test_observer_hash(void);
+int test_ev_handler_frees(void);
+
+/*---------------------------------------------------------------------------*/
+/* xio_prio_tests.c							     */
+/*---------------------------------------------------------------------------*/
+int test_prio_strict(struct xio_context *ctx);
+int test_prio_weighted(struct xio_context *ctx);
+
+/*---------------------------------------------------------------------------*/
+/* xio_shm_tests.c							     */
+/*---------------------------------------------------------------------------*/
+int test_stats_shm(void);
+
+/*---------------------------------------------------------------------------*/
+/* xio_stats_tests.c							     */
+/*---------------------------------------------------------------------------*/
+int test_query_stats(struct xio_context *ctx);
+int test_latency(void);
+int test_breakdown(void);
+int test_perf_counters(void);
+
+/*---------------------------------------------------------------------------*/
+/* xio_task_tests.c							     */
+/*---------------------------------------------------------------------------*/
+int test_task_layout(struct test_session *ts);
+int test_contig_slabs(void);
+int test_lean_conns(void);
+
+/*---------------------------------------------------------------------------*/
+/* xio_trace_tests.c							     */
+/*---------------------------------------------------------------------------*/
+int test_tracepoints(void);
+
+#endif /* XIO_FEATURE_TESTS_H */
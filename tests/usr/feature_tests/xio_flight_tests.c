@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* the context's flight recorder of connection events */
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "xio_feature_tests.h"
+#include "xio_flight.h"
+
+#define FLIGHT_SIGNAL		SIGUSR2
+/* long enough for a queue depth sample */
+#define FLIGHT_SAMPLE_WAIT_MS	(XIO_FLIGHT_SAMPLE_MS + 200)
+
+struct flight_file {
+	struct xio_flight_dump	dump;
+	struct xio_flight_rec	recs[XIO_FLIGHT_RECORDS];
+};
+
+/*---------------------------------------------------------------------------*/
+/* flight_path								     */
+/*---------------------------------------------------------------------------*/
+static void flight_path(char *path, unsigned int ctx_id)
+{
+	sprintf(path, XIO_FLIGHT_DUMP_DIR "/" XIO_FLIGHT_DUMP_PREFIX "%d.%u",
+		(int)getpid(), ctx_id);
+}
+
+/*---------------------------------------------------------------------------*/
+/* flight_read								     */
+/*---------------------------------------------------------------------------*/
+/* reads a dump back and checks its header and the records' order */
+static int flight_read(int fd, struct flight_file *ff)
+{
+	uint64_t	now_ns;
+	struct timespec	ts;
+	ssize_t		len;
+	uint32_t	i;
+
+	CHECK(lseek(fd, 0, SEEK_SET) == 0);
+	memset(ff, 0, sizeof(*ff));
+	len = read(fd, ff, sizeof(*ff));
+	CHECK(len >= (ssize_t)sizeof(ff->dump));
+
+	CHECK(ff->dump.magic == XIO_FLIGHT_MAGIC);
+	CHECK(ff->dump.version == XIO_FLIGHT_VERSION);
+	CHECK(ff->dump.rec_size == sizeof(struct xio_flight_rec));
+	CHECK(ff->dump.pid == (int32_t)getpid());
+	CHECK(ff->dump.hertz);
+	/* the ring has not wrapped, every record ever written is there */
+	CHECK(ff->dump.head < XIO_FLIGHT_RECORDS - 1);
+	CHECK(ff->dump.nrecs == ff->dump.head);
+	CHECK((size_t)len == sizeof(ff->dump) +
+	      ff->dump.nrecs * sizeof(struct xio_flight_rec));
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	now_ns = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	CHECK(ff->dump.time_ns <= now_ns &&
+	      ff->dump.time_ns > now_ns - WAIT_MS * 1000000ULL);
+
+	for (i = 0; i < ff->dump.nrecs; i++) {
+		CHECK(ff->recs[i].event < XIO_FLIGHT_EVENT_LAST);
+		CHECK(ff->recs[i].cycles <= ff->dump.cycles);
+		if (i)
+			CHECK(ff->recs[i].cycles >= ff->recs[i - 1].cycles);
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* flight_count								     */
+/*---------------------------------------------------------------------------*/
+/* the records of an event about obj, any obj when NULL */
+static int flight_count(const struct flight_file *ff,
+			enum xio_flight_event event, const void *obj,
+			int a)
+{
+	uint32_t	i;
+	int		n = 0;
+
+	for (i = 0; i < ff->dump.nrecs; i++) {
+		if (ff->recs[i].event != event)
+			continue;
+		if (obj && ff->recs[i].obj != (uint64_t)(uintptr_t)obj)
+			continue;
+		if (a >= 0 && ff->recs[i].a != (uint32_t)a)
+			continue;
+		n++;
+	}
+
+	return n;
+}
+
+/*---------------------------------------------------------------------------*/
+/* test_flight								     */
+/*---------------------------------------------------------------------------*/
+/* the recorder holds the session and transport events of the connection
+ * and its queue samples. it is dumped on demand and on the signal
+ */
+static int flight(struct test_session *ts, struct xio_context *ctx,
+		  struct flight_file *ff)
+{
+	struct xio_connection	*conn;
+	char			path[64];
+	uint64_t		end;
+	uint32_t		head;
+	FILE			*fp;
+	int			fd;
+
+	CHECK(session_open(ts, ctx) == 0);
+	CHECK(session_wait(ts) == 0);
+	conn = ts->conn;
+	CHECK(xio_send_request(conn, req_init(0, HDR_ECHO)) == 0);
+	WAIT_FOR(ctx, ts->nrsp == 1);
+	end = now_ms() + FLIGHT_SAMPLE_WAIT_MS;
+	WAIT_FOR(ctx, now_ms() >= end);
+
+	fp = tmpfile();
+	CHECK(fp);
+	if (xio_context_dump_flight(ctx, fileno(fp)) ||
+	    flight_read(fileno(fp), ff)) {
+		fclose(fp);
+		return -1;
+	}
+	CHECK(flight_count(ff, XIO_FLIGHT_SESSION_EVENT, conn,
+			   XIO_SESSION_CONNECTION_ESTABLISHED_EVENT) == 1);
+	CHECK(flight_count(ff, XIO_FLIGHT_TRANSPORT_EVENT, NULL, -1) > 0);
+	CHECK(flight_count(ff, XIO_FLIGHT_TRANSPORT_EVENT, conn, -1) == 0);
+	CHECK(flight_count(ff, XIO_FLIGHT_QUEUES, conn, -1) >= 1);
+	/* the request was answered */
+	CHECK(flight_count(ff, XIO_FLIGHT_MSG_ERROR, NULL, -1) == 0);
+	head = (uint32_t)ff->dump.head;
+
+	/* the signal dumps to the file named after the context's slot */
+	flight_path(path, ff->dump.ctx_id);
+	unlink(path);
+	CHECK(raise(FLIGHT_SIGNAL) == 0);
+	fclose(fp);
+	fd = open(path, O_RDONLY);
+	CHECK(fd >= 0);
+	if (flight_read(fd, ff)) {
+		close(fd);
+		return -1;
+	}
+	close(fd);
+	CHECK(ff->dump.head >= head);
+	CHECK(flight_count(ff, XIO_FLIGHT_SESSION_EVENT, conn,
+			   XIO_SESSION_CONNECTION_ESTABLISHED_EVENT) == 1);
+
+	/* the close is recorded */
+	CHECK(session_close(ts) == 0);
+	fp = tmpfile();
+	CHECK(fp);
+	if (xio_context_dump_flight(ctx, fileno(fp)) ||
+	    flight_read(fileno(fp), ff)) {
+		fclose(fp);
+		return -1;
+	}
+	fclose(fp);
+	CHECK(flight_count(ff, XIO_FLIGHT_SESSION_EVENT, conn,
+			   XIO_SESSION_CONNECTION_TEARDOWN_EVENT) == 1);
+
+	return 0;
+}
+
+int test_flight(void)
+{
+	struct xio_context	*ctx;
+	struct test_session	ts;
+	struct flight_file	*ff;
+	char			path[64];
+	int			signum = -1, none = 0;
+	int			i, optlen, retval;
+
+	/* no handler unless asked for */
+	optlen = sizeof(signum);
+	CHECK(xio_get_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+			  XIO_OPTNAME_FLIGHT_DUMP_SIGNAL,
+			  &signum, &optlen) == 0 && signum == 0);
+	signum = FLIGHT_SIGNAL;
+	CHECK(xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+			  XIO_OPTNAME_FLIGHT_DUMP_SIGNAL,
+			  &signum, sizeof(signum)) == 0);
+	ff = (struct flight_file *)malloc(sizeof(*ff));
+	CHECK(ff);
+	ctx = xio_context_create(NULL, 0, -1);
+	if (!ctx) {
+		free(ff);
+		return -1;
+	}
+	memset(&ts, 0, sizeof(ts));
+	retval = flight(&ts, ctx, ff);
+	if (ts.conn && !ts.teardown && session_close(&ts))
+		retval = -1;
+	xio_context_destroy(ctx);
+	free(ff);
+
+	/* the handler stays installed, nothing raises the signal again */
+	xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO, XIO_OPTNAME_FLIGHT_DUMP_SIGNAL,
+		    &none, sizeof(none));
+	/* the server's context was dumped too */
+	for (i = 0; i < 64; i++) {
+		flight_path(path, i);
+		unlink(path);
+	}
+
+	return retval;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* fragmented tcp transfers */
+#include "xio_feature_tests.h"
+
+/*---------------------------------------------------------------------------*/
+/* test_tcp_frag							     */
+/*---------------------------------------------------------------------------*/
+/* a 1MB request and response cross the wire in fragments, small requests
+ * on the same connection keep their order behind them while another
+ * session's requests pass
+ */
+int test_tcp_frag(struct test_session *ts)
+{
+	struct xio_msg	*req;
+	int		i;
+
+	req = req_init(0, HDR_BIG);
+	req->out.data_iov.nents			= 1;
+	req->out.data_iov.sglist[0].iov_base	= big_out.addr;
+	req->out.data_iov.sglist[0].iov_len	= BIG_SIZE;
+	req->out.data_iov.sglist[0].mr		= big_out.mr;
+	req->in.data_iov.nents			= 1;
+	req->in.data_iov.sglist[0].iov_base	= big_in.addr;
+	req->in.data_iov.sglist[0].iov_len	= BIG_SIZE;
+	req->in.data_iov.sglist[0].mr		= big_in.mr;
+	memset(big_in.addr, 0, BIG_SIZE);
+	CHECK(xio_send_request(ts[0].conn, req) == 0);
+
+	for (i = 1; i <= 4; i++)
+		CHECK(xio_send_request(ts[0].conn,
+				       req_init(i, HDR_ECHO)) == 0);
+	for (i = 5; i <= 12; i++)
+		CHECK(xio_send_request(ts[1].conn,
+				       req_init(i, HDR_ECHO)) == 0);
+
+	WAIT_FOR(ts[0].ctx, ts[0].nrsp == 5 && ts[1].nrsp == 8);
+	CHECK(ts[0].nerr == 0 && ts[1].nerr == 0);
+	CHECK(sd.nbig_ok == 1 && sd.nbig_bad == 0);
+	CHECK(ts[0].nbig_ok == 1);
+	for (i = 1; i <= 4; i++)
+		CHECK(reqs[i].seq > reqs[0].seq);
+	/* the other session does not wait for the 1MB transfers */
+	for (i = 5; i <= 12; i++)
+		CHECK(reqs[i].order < reqs[0].order);
+
+	return 0;
+}
@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* hedged requests over the two sessions of the harness */
+#include <errno.h>
+
+#include "xio_feature_tests.h"
+
+static int			hedge_rsps;
+static int			hedge_errs;
+
+/*---------------------------------------------------------------------------*/
+/* hedge callbacks							     */
+/*---------------------------------------------------------------------------*/
+static int hedge_on_response(struct xio_hedge *hedge, struct xio_msg *req,
+			     struct xio_msg *rsp, void *cb_user_context)
+{
+	hedge_rsps++;
+
+	return 0;
+}
+
+static int hedge_on_error(struct xio_hedge *hedge, struct xio_msg *req,
+			  enum xio_status error, void *cb_user_context)
+{
+	hedge_errs++;
+
+	return 0;
+}
+
+static struct xio_hedge_ops hedge_ops = {
+	.on_response	= hedge_on_response,
+	.on_error	= hedge_on_error,
+};
+
+/*---------------------------------------------------------------------------*/
+/* test_hedge_cancel							     */
+/*---------------------------------------------------------------------------*/
+/* held requests are hedged on the other connection, each completes once
+ * and its losing copy is canceled in flight. the group is destroyed while
+ * losing copies are still on the wire
+ */
+int test_hedge_cancel(struct test_session *ts)
+{
+	struct xio_hedge_params	params;
+	struct xio_connection	*conns[NSESSIONS];
+	struct xio_hedge	*hedge;
+	int			nhold = sd.nhold;
+	int			nrsp[NSESSIONS];
+	int			nerr[NSESSIONS];
+	int			i;
+
+	for (i = 0; i < NSESSIONS; i++) {
+		conns[i] = ts[i].conn;
+		nrsp[i]	 = ts[i].nrsp;
+		nerr[i]	 = ts[i].nerr;
+	}
+	memset(&params, 0, sizeof(params));
+	params.ops		= &hedge_ops;
+	params.conns		= conns;
+	params.nconns		= NSESSIONS;
+	params.min_delay_us	= 2000;
+	hedge = xio_hedge_create(ts->ctx, &params);
+	CHECK(hedge);
+
+	hedge_rsps = 0;
+	hedge_errs = 0;
+	for (i = 0; i < 8; i++)
+		CHECK(xio_hedge_send_request(hedge,
+					     req_init(i, HDR_HOLD)) == 0);
+	/* the requests are copied, the application may reuse them */
+	for (i = 0; i < 8; i++)
+		memset(&reqs[i], 0, sizeof(reqs[i]));
+
+	WAIT_FOR(ts->ctx, hedge_rsps == 8);
+	CHECK(hedge_errs == 0);
+	CHECK(sd.nhold == nhold + 16);
+	CHECK(xio_hedge_destroy(hedge) == 0);
+
+	/* the losing copies end without reaching the application */
+	WAIT_FOR(ts->ctx, sd.nheld == 0);
+	for (i = 0; i < HOLD_MS; i++)
+		xio_context_poll_wait(ts->ctx, 1);
+	CHECK(hedge_rsps == 8 && hedge_errs == 0);
+	for (i = 0; i < NSESSIONS; i++)
+		CHECK(ts[i].nrsp == nrsp[i] && ts[i].nerr == nerr[i]);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* test_hedge_errors							     */
+/*---------------------------------------------------------------------------*/
+/* requests no connection accepts fail the send and hold nothing, so the
+ * group can be destroyed once the accepted ones completed
+ */
+int test_hedge_errors(struct xio_context *ctx)
+{
+	struct test_session	ts[NSESSIONS];
+	struct xio_connection	*conns[NSESSIONS];
+	struct xio_hedge_params	params;
+	struct xio_session_attr	attr;
+	struct xio_hedge	*hedge;
+	struct xio_msg		*req;
+	static char		hdr[64 * 1024];
+	int			max_hdr, len = sizeof(max_hdr);
+	int			i, nok = 0, nfail = 0;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.snd_queue_depth_msgs	= 4;
+	attr.snd_queue_depth_bytes	= 1024 * 1024;
+	for (i = 0; i < NSESSIONS; i++) {
+		CHECK(session_open(&ts[i], ctx) == 0);
+		CHECK(xio_modify_session(ts[i].session, &attr,
+					 XIO_SESSION_ATTR_SND_QUEUE_DEPTH) == 0);
+		conns[i] = ts[i].conn;
+	}
+
+	memset(&params, 0, sizeof(params));
+	params.ops		= &hedge_ops;
+	params.conns		= conns;
+	params.nconns		= NSESSIONS;
+	params.min_delay_us	= 1000000;
+	hedge = xio_hedge_create(ctx, &params);
+	CHECK(hedge);
+	hedge_rsps = 0;
+	hedge_errs = 0;
+
+	/* too long to be copied */
+	CHECK(xio_get_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+			  XIO_OPTNAME_MAX_INLINE_XIO_HEADER,
+			  &max_hdr, &len) == 0);
+	CHECK(max_hdr < (int)sizeof(hdr));
+	req = req_init(0, HDR_ECHO);
+	req->out.header.iov_base = hdr;
+	req->out.header.iov_len	 = max_hdr + 1;
+	CHECK(xio_hedge_send_request(hedge, req) == -1);
+	CHECK(xio_errno() == EMSGSIZE);
+
+	/* the connections are not up yet, both send queues overflow */
+	for (i = 0; i < MAX_REQS; i++) {
+		if (xio_hedge_send_request(hedge, req_init(i, HDR_ECHO))) {
+			CHECK(xio_errno() == XIO_E_TX_QUEUE_OVERFLOW);
+			nfail++;
+		} else {
+			nok++;
+		}
+	}
+	CHECK(nok > 0 && nfail > 0);
+	CHECK(xio_hedge_destroy(hedge) == -1 && xio_errno() == EBUSY);
+
+	WAIT_FOR(ctx, hedge_rsps == nok);
+	CHECK(hedge_errs == 0);
+	CHECK(xio_hedge_destroy(hedge) == 0);
+
+	for (i = 0; i < NSESSIONS; i++)
+		CHECK(session_close(&ts[i]) == 0);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* test_hedge_overflow							     */
+/*---------------------------------------------------------------------------*/
+/* the transport can't place the response of either copy, the errors stay
+ * inside the library and the application sees a single hedge error.
+ * tcp reports an oversized response only on the responder, so the buffer
+ * is starved on the requester: with mr checking the unregistered in
+ * buffer must come from the transport pool, which has no slab that large
+ */
+int test_hedge_overflow(struct test_session *ts)
+{
+	struct xio_hedge_params	params;
+	struct xio_connection	*conns[NSESSIONS];
+	struct xio_hedge	*hedge;
+	struct xio_msg		*req;
+	static char		in_buf[2 * 1024 * 1024];
+	int			nrsp[NSESSIONS];
+	int			nerr[NSESSIONS];
+	int			enable = 1;
+	int			i;
+
+	for (i = 0; i < NSESSIONS; i++) {
+		conns[i] = ts[i].conn;
+		nrsp[i]	 = ts[i].nrsp;
+		nerr[i]	 = ts[i].nerr;
+	}
+	memset(&params, 0, sizeof(params));
+	params.ops		= &hedge_ops;
+	params.conns		= conns;
+	params.nconns		= NSESSIONS;
+	params.min_delay_us	= 1000;
+	hedge = xio_hedge_create(ts->ctx, &params);
+	CHECK(hedge);
+	hedge_rsps = 0;
+	hedge_errs = 0;
+
+	xio_set_opt(NULL, XIO_OPTLEVEL_TCP, XIO_OPTNAME_TCP_ENABLE_MR_CHECK,
+		    &enable, sizeof(enable));
+	req = req_init(0, HDR_ECHO);
+	req->in.data_iov.nents			= 1;
+	req->in.data_iov.sglist[0].iov_base	= in_buf;
+	req->in.data_iov.sglist[0].iov_len	= sizeof(in_buf);
+	CHECK(xio_hedge_send_request(hedge, req) == 0);
+	WAIT_FOR(ts->ctx, hedge_errs == 1);
+	enable = 0;
+	xio_set_opt(NULL, XIO_OPTLEVEL_TCP, XIO_OPTNAME_TCP_ENABLE_MR_CHECK,
+		    &enable, sizeof(enable));
+
+	for (i = 0; i < HOLD_MS; i++)
+		xio_context_poll_wait(ts->ctx, 1);
+	CHECK(hedge_rsps == 0 && hedge_errs == 1);
+	for (i = 0; i < NSESSIONS; i++)
+		CHECK(ts[i].nrsp == nrsp[i] && ts[i].nerr == nerr[i]);
+	CHECK(xio_hedge_destroy(hedge) == 0);
+
+	return 0;
+}
+
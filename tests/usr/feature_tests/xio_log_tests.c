@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* the default log backend - rate limiting and the writer thread */
+#include <unistd.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "xio_feature_tests.h"
+
+#define LOG_BURST		10	/* messages per second of a call site */
+#define LOG_CALLS		25
+#define LOG_MSG			"poll cq failed"
+
+struct log_capture {
+	FILE		*fp;
+	int		saved_fd;
+	int		pad;
+	char		site[64];	/* "file:line", "" - any */
+	char		buf[16384];
+};
+
+/*---------------------------------------------------------------------------*/
+/* log_capture_start							     */
+/*---------------------------------------------------------------------------*/
+/* stderr goes to a file until log_capture_stop */
+static int log_capture_start(struct log_capture *lc)
+{
+	lc->fp = tmpfile();
+	CHECK(lc->fp);
+	fflush(stderr);
+	lc->saved_fd = dup(STDERR_FILENO);
+	if (lc->saved_fd < 0 || dup2(fileno(lc->fp), STDERR_FILENO) < 0) {
+		if (lc->saved_fd >= 0)
+			close(lc->saved_fd);
+		fclose(lc->fp);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* log_capture_stop							     */
+/*---------------------------------------------------------------------------*/
+static void log_capture_stop(struct log_capture *lc)
+{
+	fflush(stderr);
+	dup2(lc->saved_fd, STDERR_FILENO);
+	close(lc->saved_fd);
+	fclose(lc->fp);
+}
+
+/*---------------------------------------------------------------------------*/
+/* log_read								     */
+/*---------------------------------------------------------------------------*/
+static int log_read(struct log_capture *lc)
+{
+	ssize_t		len;
+
+	len = pread(fileno(lc->fp), lc->buf, sizeof(lc->buf) - 1, 0);
+	lc->buf[len < 0 ? 0 : len] = 0;
+
+	return len < 0 ? -1 : 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* log_count								     */
+/*---------------------------------------------------------------------------*/
+/* the captured lines of the call site holding str - other sites may report
+ * what they suppressed before the capture
+ */
+static int log_count(struct log_capture *lc, const char *str)
+{
+	char	*line, *save;
+	int	n = 0;
+
+	if (log_read(lc))
+		return -1;
+	for (line = strtok_r(lc->buf, "\n", &save); line;
+	     line = strtok_r(NULL, "\n", &save)) {
+		if (strstr(line, str) && strstr(line, lc->site))
+			n++;
+	}
+
+	return n;
+}
+
+/*---------------------------------------------------------------------------*/
+/* log_site								     */
+/*---------------------------------------------------------------------------*/
+/* the "file:line" of the first LOG_MSG line */
+static int log_site(struct log_capture *lc)
+{
+	char	*p, *end;
+
+	CHECK(!log_read(lc));
+	p = strstr(lc->buf, LOG_MSG);
+	CHECK(p);
+	while (p > lc->buf && p[-1] != '\n')
+		p--;
+	p = strstr(p, "] ");
+	CHECK(p);
+	p += 2;
+	end = strchr(p, ' ');
+	CHECK(end && end - p < (long)sizeof(lc->site));
+	memcpy(lc->site, p, end - p);
+	lc->site[end - p] = 0;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* log_next_sec								     */
+/*---------------------------------------------------------------------------*/
+/* a burst right after it stays within one second */
+static void log_next_sec(void)
+{
+	struct timeval	tv;
+	time_t		sec;
+
+	gettimeofday(&tv, NULL);
+	sec = tv.tv_sec;
+	do {
+		usleep(1000);
+		gettimeofday(&tv, NULL);
+	} while (tv.tv_sec == sec);
+}
+
+/*---------------------------------------------------------------------------*/
+/* log_burst								     */
+/*---------------------------------------------------------------------------*/
+static void log_burst(int n)
+{
+	int	i;
+
+	/* logs an error from one call site */
+	for (i = 0; i < n; i++)
+		xio_poll_cq(NULL, NULL, 0);
+}
+
+/*---------------------------------------------------------------------------*/
+/* test_log_rate							     */
+/*---------------------------------------------------------------------------*/
+/* a call site logs ten errors a second, the rest are counted and the count
+ * is logged a second later. the same holds when the writer thread writes
+ * them, and what it queued is written when it is turned off
+ */
+static int log_rate(struct log_capture *lc)
+{
+	uint64_t	end;
+	int		async = 1, optlen;
+
+	log_next_sec();
+	log_burst(LOG_CALLS);
+	CHECK(!log_site(lc));
+	CHECK(log_count(lc, LOG_MSG) == LOG_BURST);
+	CHECK(log_count(lc, "suppressed") == 0);
+	log_next_sec();
+	log_burst(1);
+	CHECK(log_count(lc, LOG_MSG) == LOG_BURST + 1);
+	CHECK(log_count(lc, "15 similar messages suppressed") == 1);
+
+	CHECK(xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO, XIO_OPTNAME_LOG_ASYNC,
+			  &async, sizeof(async)) == 0);
+	async = 0;
+	optlen = sizeof(async);
+	CHECK(xio_get_opt(NULL, XIO_OPTLEVEL_ACCELIO, XIO_OPTNAME_LOG_ASYNC,
+			  &async, &optlen) == 0 && async == 1);
+
+	/* the writer writes the burst and, the next second, its count */
+	log_next_sec();
+	log_burst(LOG_CALLS);
+	end = now_ms() + WAIT_MS;
+	while (log_count(lc, "similar messages suppressed") < 2 &&
+	       now_ms() < end)
+		usleep(1000);
+	CHECK(log_count(lc, LOG_MSG) == 2 * LOG_BURST + 1);
+	CHECK(log_count(lc, "15 similar messages suppressed") == 2);
+
+	/* queued messages are written when the writer stops */
+	log_burst(LOG_BURST);
+	async = 0;
+	CHECK(xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO, XIO_OPTNAME_LOG_ASYNC,
+			  &async, sizeof(async)) == 0);
+	async = 1;
+	CHECK(xio_get_opt(NULL, XIO_OPTLEVEL_ACCELIO, XIO_OPTNAME_LOG_ASYNC,
+			  &async, &optlen) == 0 && async == 0);
+	CHECK(log_count(lc, LOG_MSG) == 3 * LOG_BURST + 1);
+
+	return 0;
+}
+
+int test_log_rate(void)
+{
+	struct log_capture	*lc;
+	int			off = 0;
+	int			retval;
+
+	lc = (struct log_capture *)calloc(1, sizeof(*lc));
+	CHECK(lc);
+	if (log_capture_start(lc)) {
+		free(lc);
+		return -1;
+	}
+	retval = log_rate(lc);
+	xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO, XIO_OPTNAME_LOG_ASYNC,
+		    &off, sizeof(off));
+	log_read(lc);
+	log_capture_stop(lc);
+	/* the failed check went to the capture too */
+	if (retval)
+		fputs(lc->buf, stderr);
+	free(lc);
+
+	return retval;
+}
@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* memory of the objects pools and the context's accounting */
+#include "xio_feature_tests.h"
+
+#define HEDGE_POOL_NR		16	/* init and grow nr of the hedge pool */
+
+static int			mem_rsps;
+
+/*---------------------------------------------------------------------------*/
+/* mem_class								     */
+/*---------------------------------------------------------------------------*/
+static int mem_class(struct xio_context *ctx, enum xio_mem_class mclass,
+		     struct xio_mem_stats *stats)
+{
+	struct xio_context_attr	attr;
+
+	memset(&attr, 0, sizeof(attr));
+	if (xio_query_context(ctx, &attr, XIO_CONTEXT_ATTR_MEM_STATS))
+		return -1;
+	*stats = attr.mem_stats[mclass];
+
+	return 0;
+}
+
+static uint64_t mem_objs(struct xio_context *ctx, enum xio_mem_class mclass)
+{
+	struct xio_mem_stats	stats;
+
+	return mem_class(ctx, mclass, &stats) ? 0 : stats.objs;
+}
+
+/*---------------------------------------------------------------------------*/
+/* hedge callbacks							     */
+/*---------------------------------------------------------------------------*/
+static int mem_on_response(struct xio_hedge *hedge, struct xio_msg *req,
+			   struct xio_msg *rsp, void *cb_user_context)
+{
+	mem_rsps++;
+
+	return 0;
+}
+
+static int mem_on_error(struct xio_hedge *hedge, struct xio_msg *req,
+			enum xio_status error, void *cb_user_context)
+{
+	return 0;
+}
+
+static struct xio_hedge_ops mem_hedge_ops = {
+	.on_response	= mem_on_response,
+	.on_error	= mem_on_error,
+};
+
+/*---------------------------------------------------------------------------*/
+/* test_objpool_grow							     */
+/*---------------------------------------------------------------------------*/
+/* the hedge requests pool starts with one chunk and grows by another once
+ * more requests are outstanding. every chunk is accounted while the pool
+ * lives and released with it
+ */
+int test_objpool_grow(struct test_session *ts)
+{
+	struct xio_hedge_params	params;
+	struct xio_connection	*conns[NSESSIONS];
+	struct xio_mem_stats	base, one, two, after;
+	struct xio_hedge	*hedge;
+	int			nreqs = HEDGE_POOL_NR + HEDGE_POOL_NR / 2;
+	int			i;
+
+	for (i = 0; i < NSESSIONS; i++)
+		conns[i] = ts[i].conn;
+	memset(&params, 0, sizeof(params));
+	params.ops		= &mem_hedge_ops;
+	params.conns		= conns;
+	params.nconns		= NSESSIONS;
+	params.min_delay_us	= 1000000;
+
+	CHECK(mem_class(ts->ctx, XIO_MEM_CLASS_OBJPOOL, &base) == 0);
+	hedge = xio_hedge_create(ts->ctx, &params);
+	CHECK(hedge);
+	CHECK(mem_class(ts->ctx, XIO_MEM_CLASS_OBJPOOL, &one) == 0);
+	CHECK(one.objs == base.objs + HEDGE_POOL_NR);
+	CHECK(one.bytes > base.bytes);
+
+	/* responses are only handled when polled, all requests are held */
+	mem_rsps = 0;
+	for (i = 0; i < nreqs; i++)
+		CHECK(xio_hedge_send_request(hedge,
+					     req_init(i, HDR_ECHO)) == 0);
+	CHECK(mem_class(ts->ctx, XIO_MEM_CLASS_OBJPOOL, &two) == 0);
+	CHECK(two.objs == base.objs + 2 * HEDGE_POOL_NR);
+	CHECK(two.bytes - base.bytes == 2 * (one.bytes - base.bytes));
+	CHECK(two.peak_bytes >= two.bytes);
+
+	WAIT_FOR(ts->ctx, mem_rsps == nreqs);
+	CHECK(xio_hedge_destroy(hedge) == 0);
+	CHECK(mem_class(ts->ctx, XIO_MEM_CLASS_OBJPOOL, &after) == 0);
+	CHECK(after.objs == base.objs && after.bytes == base.bytes);
+	CHECK(after.peak_bytes >= two.bytes);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* test_mem_stats							     */
+/*---------------------------------------------------------------------------*/
+/* a session brings up a connection, a nexus and its transport, which are
+ * accounted on the context while they live and released once the
+ * session is torn down
+ */
+static int mem_stats(struct test_session *ts, struct xio_context *ctx)
+{
+	struct xio_mem_stats	idle[XIO_MEM_CLASS_LAST];
+	struct xio_mem_stats	up[XIO_MEM_CLASS_LAST];
+	struct xio_mem_stats	down[XIO_MEM_CLASS_LAST];
+	int			i;
+
+	for (i = 0; i < XIO_MEM_CLASS_LAST; i++) {
+		CHECK(strcmp(xio_mem_class_str((enum xio_mem_class)i),
+			     "mem_class_unknown"));
+		CHECK(mem_class(ctx, (enum xio_mem_class)i, &idle[i]) == 0);
+	}
+	CHECK(idle[XIO_MEM_CLASS_OBJPOOL].objs > 0);
+	CHECK(idle[XIO_MEM_CLASS_CONNECTION].objs == 0);
+	CHECK(idle[XIO_MEM_CLASS_NEXUS].objs == 0);
+	CHECK(idle[XIO_MEM_CLASS_TRANSPORT].objs == 0);
+
+	CHECK(session_open(ts, ctx) == 0);
+	CHECK(session_wait(ts) == 0);
+	CHECK(xio_send_request(ts->conn, req_init(0, HDR_ECHO)) == 0);
+	WAIT_FOR(ctx, ts->nrsp == 1);
+	for (i = 0; i < XIO_MEM_CLASS_LAST; i++) {
+		CHECK(mem_class(ctx, (enum xio_mem_class)i, &up[i]) == 0);
+		CHECK(up[i].peak_bytes >= up[i].bytes);
+	}
+	CHECK(up[XIO_MEM_CLASS_CONNECTION].objs == 1);
+	CHECK(up[XIO_MEM_CLASS_NEXUS].objs == 1);
+	CHECK(up[XIO_MEM_CLASS_TRANSPORT].objs == 1);
+	CHECK(up[XIO_MEM_CLASS_TASKS_POOL].bytes >
+	      idle[XIO_MEM_CLASS_TASKS_POOL].bytes);
+
+	CHECK(session_close(ts) == 0);
+	/* the nexus is released once the transport closed */
+	WAIT_FOR(ctx, mem_objs(ctx, XIO_MEM_CLASS_NEXUS) == 0);
+	for (i = 0; i < XIO_MEM_CLASS_LAST; i++)
+		CHECK(mem_class(ctx, (enum xio_mem_class)i, &down[i]) == 0);
+	CHECK(down[XIO_MEM_CLASS_CONNECTION].objs == 0);
+	CHECK(down[XIO_MEM_CLASS_CONNECTION].peak_bytes ==
+	      up[XIO_MEM_CLASS_CONNECTION].peak_bytes);
+	CHECK(down[XIO_MEM_CLASS_TRANSPORT].objs == 0);
+	CHECK(down[XIO_MEM_CLASS_TRANSPORT].bytes == 0);
+
+	return 0;
+}
+
+int test_mem_stats(void)
+{
+	struct xio_context	*ctx;
+	struct test_session	ts;
+	int			close_timeout, nodelay = 0;
+	int			len = sizeof(close_timeout);
+	int			retval;
+
+	/* the client nexus lingers until the close timeout expires */
+	CHECK(xio_get_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+			  XIO_OPTNAME_TRANSPORT_CLOSE_TIMEOUT,
+			  &close_timeout, &len) == 0);
+	CHECK(xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+			  XIO_OPTNAME_TRANSPORT_CLOSE_TIMEOUT,
+			  &nodelay, sizeof(nodelay)) == 0);
+	ctx = xio_context_create(NULL, 0, -1);
+	CHECK(ctx);
+
+	memset(&ts, 0, sizeof(ts));
+	retval = mem_stats(&ts, ctx);
+	if (ts.conn && !ts.teardown)
+		session_close(&ts);
+	xio_context_destroy(ctx);
+	xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+		    XIO_OPTNAME_TRANSPORT_CLOSE_TIMEOUT,
+		    &close_timeout, sizeof(close_timeout));
+
+	return retval;
+}
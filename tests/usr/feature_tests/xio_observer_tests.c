@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* the context's observers and handler frees of a mass teardown */
+#include <libxio.h>
+#include <xio_os.h>
+#include <sys/eventfd.h>
+#include "xio_log.h"
+#include "xio_common.h"
+#include "xio_observer.h"
+#include "xio_ev_data.h"
+#include "xio_objpool.h"
+#include "xio_workqueue.h"
+#include "xio_context.h"
+
+#include "xio_feature_tests.h"
+
+#define OBS_HASH_MIN		16	/* observers before they are hashed */
+/* a nexus each, a context observer - past the first table of 32 */
+#define OBS_SESSIONS_NR		(2 * OBS_HASH_MIN + 8)
+#define EV_HANDLERS_NR		1100	/* more than the old 1024 deferred */
+
+/*---------------------------------------------------------------------------*/
+/* test_observer_hash							     */
+/*---------------------------------------------------------------------------*/
+/* every observer on the list is in the table and nowhere else */
+static int observer_hash_check(struct xio_observable *observable)
+{
+	struct xio_observer_node	*observer_node, *chain;
+	uint32_t			i, nlisted = 0, nhashed = 0;
+	int				found;
+
+	CHECK(observable->hash);
+	CHECK(!((observable->hash_mask + 1) & observable->hash_mask));
+	CHECK(observable->observers_nr <= observable->hash_mask + 1);
+
+	for (i = 0; i <= observable->hash_mask; i++)
+		for (chain = observable->hash[i]; chain;
+		     chain = chain->hash_next)
+			nhashed++;
+
+	list_for_each_entry(observer_node, &observable->observers_list,
+			    observers_list_node) {
+		nlisted++;
+		found = 0;
+		for (i = 0; i <= observable->hash_mask && !found; i++)
+			for (chain = observable->hash[i]; chain;
+			     chain = chain->hash_next)
+				found |= (chain == observer_node);
+		CHECK(found);
+	}
+	CHECK(nlisted == observable->observers_nr);
+	CHECK(nhashed == observable->observers_nr);
+
+	return 0;
+}
+
+/* the context hashes its observers once there are many, and the table
+ * follows them as they come and go
+ */
+static int observer_hash(struct test_session *ts, struct xio_context *ctx)
+{
+	struct xio_observable	*observable = &ctx->observable;
+	int			i;
+
+	CHECK(!observable->hash);
+	for (i = 0; i < OBS_SESSIONS_NR; i++)
+		CHECK(session_open(&ts[i], ctx) == 0);
+	for (i = 0; i < OBS_SESSIONS_NR; i++)
+		CHECK(session_wait(&ts[i]) == 0);
+	CHECK(observable->observers_nr >= OBS_SESSIONS_NR);
+	CHECK(!observer_hash_check(observable));
+	/* it grew from its first size */
+	CHECK(observable->hash_mask + 1 > 2 * OBS_HASH_MIN);
+
+	/* removals keep the table whole */
+	for (i = 0; i < OBS_SESSIONS_NR / 2; i++)
+		CHECK(session_close(&ts[i]) == 0);
+	WAIT_FOR(ctx, observable->observers_nr < OBS_SESSIONS_NR);
+	CHECK(!observer_hash_check(observable));
+
+	/* a nexus still closing stays an observer, the table is dropped only
+	 * when none is left
+	 */
+	for (; i < OBS_SESSIONS_NR; i++)
+		CHECK(session_close(&ts[i]) == 0);
+	WAIT_FOR(ctx, observable->observers_nr < OBS_SESSIONS_NR / 2);
+	if (observable->observers_nr) {
+		CHECK(!observer_hash_check(observable));
+	} else {
+		CHECK(!observable->hash);
+		CHECK(list_empty(&observable->observers_list));
+	}
+
+	return 0;
+}
+
+int test_observer_hash(void)
+{
+	struct xio_context	*ctx;
+	struct test_session	ts[OBS_SESSIONS_NR];
+	int			close_timeout, nodelay = 0;
+	int			len = sizeof(close_timeout);
+	int			i, retval;
+
+	/* the nexuses, and their observers, go with the sessions */
+	CHECK(xio_get_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+			  XIO_OPTNAME_TRANSPORT_CLOSE_TIMEOUT,
+			  &close_timeout, &len) == 0);
+	CHECK(xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+			  XIO_OPTNAME_TRANSPORT_CLOSE_TIMEOUT,
+			  &nodelay, sizeof(nodelay)) == 0);
+	ctx = xio_context_create(NULL, 0, -1);
+	CHECK(ctx);
+
+	memset(ts, 0, sizeof(ts));
+	retval = observer_hash(ts, ctx);
+	for (i = 0; i < OBS_SESSIONS_NR; i++)
+		if (ts[i].conn && !ts[i].teardown && session_close(&ts[i]))
+			retval = -1;
+	xio_context_destroy(ctx);
+	xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+		    XIO_OPTNAME_TRANSPORT_CLOSE_TIMEOUT,
+		    &close_timeout, sizeof(close_timeout));
+
+	return retval;
+}
+
+/*---------------------------------------------------------------------------*/
+/* test_ev_handler_frees						     */
+/*---------------------------------------------------------------------------*/
+/* the context's allocations still held */
+static int ev_allocs;
+
+static void *ev_allocate(struct xio_context *ctx, size_t size,
+			 void *user_context)
+{
+	void *ptr = malloc(size);
+
+	if (ptr)
+		ev_allocs++;
+	return ptr;
+}
+
+static void ev_free(struct xio_context *ctx, void *ptr, void *user_context)
+{
+	if (ptr)
+		ev_allocs--;
+	free(ptr);
+}
+
+static void ev_handler(int fd, int events, void *data)
+{
+}
+
+/* handlers deleted at once are all freed by the next loop run */
+static int ev_handler_frees(struct xio_context *ctx, int *fds)
+{
+	int	base, i;
+
+	/* whatever the first run allocates stays */
+	xio_context_poll_wait(ctx, 1);
+	base = ev_allocs;
+	for (i = 0; i < EV_HANDLERS_NR; i++) {
+		fds[i] = eventfd(0, EFD_NONBLOCK);
+		CHECK(fds[i] >= 0);
+		CHECK(xio_context_add_ev_handler(ctx, fds[i], XIO_POLLIN,
+						 ev_handler, NULL) == 0);
+	}
+	CHECK(ev_allocs == base + EV_HANDLERS_NR);
+
+	for (i = 0; i < EV_HANDLERS_NR; i++)
+		CHECK(xio_context_del_ev_handler(ctx, fds[i]) == 0);
+	xio_context_poll_wait(ctx, 1);
+	CHECK(ev_allocs == base);
+
+	return 0;
+}
+
+int test_ev_handler_frees(void)
+{
+	struct xio_context_params	params;
+	struct xio_context		*ctx;
+	int				*fds;
+	int				i, retval;
+
+	fds = (int *)malloc(EV_HANDLERS_NR * sizeof(*fds));
+	CHECK(fds);
+	for (i = 0; i < EV_HANDLERS_NR; i++)
+		fds[i] = -1;
+
+	memset(&params, 0, sizeof(params));
+	params.allocator_assigned	= 1;
+	params.mem_allocator.allocate	= ev_allocate;
+	params.mem_allocator.free	= ev_free;
+	ctx = xio_context_create(&params, 0, -1);
+	if (!ctx) {
+		free(fds);
+		return -1;
+	}
+	retval = ev_handler_frees(ctx, fds);
+	xio_context_destroy(ctx);
+	for (i = 0; i < EV_HANDLERS_NR; i++)
+		if (fds[i] >= 0)
+			close(fds[i]);
+	free(fds);
+
+	return retval;
+}
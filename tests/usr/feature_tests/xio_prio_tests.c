@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* priority classes of the connection's transmit queues */
+#include "xio_feature_tests.h"
+
+#define PRIO_NR			8	/* requests per class */
+#define PRIO_BULK		3	/* the least urgent class */
+#define PRIO_WEIGHT		3	/* of the urgent class, bulk gets 1 */
+#define PRIO_ROUND		(PRIO_WEIGHT + 1)
+
+/*---------------------------------------------------------------------------*/
+/* prio_queue								     */
+/*---------------------------------------------------------------------------*/
+/* queues a bulk burst, then an urgent one, while the connection is still
+ * coming up. request i < PRIO_NR is bulk
+ */
+static int prio_queue(struct test_session *ts)
+{
+	struct xio_connection_attr	attr;
+	struct xio_msg			*req;
+	int				i;
+
+	for (i = 0; i < 2 * PRIO_NR; i++) {
+		req = req_init(i, HDR_ECHO);
+		if (i < PRIO_NR)
+			req->flags = XIO_MSG_FLAG_PRIO(PRIO_BULK);
+		CHECK(xio_msg_prio(req) == (i < PRIO_NR ? PRIO_BULK : 0));
+		CHECK(xio_send_request(ts->conn, req) == 0);
+	}
+
+	memset(&attr, 0, sizeof(attr));
+	CHECK(xio_query_connection(ts->conn, &attr,
+				   XIO_CONNECTION_ATTR_PRIO_STATS) == 0);
+	CHECK(attr.prio_queued_msgs[0] == PRIO_NR);
+	CHECK(attr.prio_queued_msgs[PRIO_BULK] == PRIO_NR);
+	CHECK(attr.prio_queued_msgs[1] == 0 && attr.prio_queued_msgs[2] == 0);
+
+	return 0;
+}
+
+/* the class of the request whose response came n-th */
+static int prio_of_nth(int n)
+{
+	int i;
+
+	for (i = 0; i < 2 * PRIO_NR; i++)
+		if (reqs[i].seq == n)
+			return i < PRIO_NR ? PRIO_BULK : 0;
+
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/* test_prio_strict							     */
+/*---------------------------------------------------------------------------*/
+/* the urgent class is drained first though it was queued last. within a
+ * class the order is kept
+ */
+int test_prio_strict(struct xio_context *ctx)
+{
+	struct xio_connection_attr	attr;
+	struct test_session		ts;
+	int				i;
+
+	CHECK(session_open(&ts, ctx) == 0);
+	CHECK(prio_queue(&ts) == 0);
+	WAIT_FOR(ctx, ts.nrsp == 2 * PRIO_NR);
+	CHECK(ts.nerr == 0);
+
+	for (i = 0; i < 2 * PRIO_NR; i++)
+		CHECK(prio_of_nth(i) == (i < PRIO_NR ? 0 : PRIO_BULK));
+	for (i = 1; i < PRIO_NR; i++) {
+		CHECK(reqs[i].seq > reqs[i - 1].seq);
+		CHECK(reqs[PRIO_NR + i].seq > reqs[PRIO_NR + i - 1].seq);
+	}
+
+	memset(&attr, 0, sizeof(attr));
+	CHECK(xio_query_connection(ts.conn, &attr,
+				   XIO_CONNECTION_ATTR_PRIO_STATS) == 0);
+	CHECK(attr.prio_queued_msgs[0] == 0);
+	CHECK(attr.prio_queued_msgs[PRIO_BULK] == 0);
+	CHECK(attr.prio_max_queued_msgs[0] == PRIO_NR);
+	CHECK(attr.prio_max_queued_msgs[PRIO_BULK] == PRIO_NR);
+
+	return session_close(&ts);
+}
+
+/*---------------------------------------------------------------------------*/
+/* test_prio_weighted							     */
+/*---------------------------------------------------------------------------*/
+/* weighted round robin: the urgent class sends its weight per round and
+ * the unweighted classes get a weight of one
+ */
+int test_prio_weighted(struct xio_context *ctx)
+{
+	struct xio_connection_attr	attr;
+	struct test_session		ts;
+	int				i, nbulk = 0;
+
+	CHECK(session_open(&ts, ctx) == 0);
+	memset(&attr, 0, sizeof(attr));
+	attr.prio_weights[0] = PRIO_WEIGHT;
+	CHECK(xio_modify_connection(ts.conn, &attr,
+				    XIO_CONNECTION_ATTR_PRIO_WEIGHTS) == 0);
+	memset(&attr, 0, sizeof(attr));
+	CHECK(xio_query_connection(ts.conn, &attr,
+				   XIO_CONNECTION_ATTR_PRIO_WEIGHTS) == 0);
+	CHECK(attr.prio_weights[0] == PRIO_WEIGHT);
+	for (i = 1; i < XIO_MSG_PRIO_NR; i++)
+		CHECK(attr.prio_weights[i] == 1);
+
+	CHECK(prio_queue(&ts) == 0);
+	WAIT_FOR(ctx, ts.nrsp == 2 * PRIO_NR);
+	CHECK(ts.nerr == 0);
+
+	/* bulk is not starved, it has one slot in each full round */
+	for (i = 0; i < 2 * PRIO_NR; i++) {
+		if (prio_of_nth(i) == PRIO_BULK)
+			nbulk++;
+		if (i % PRIO_ROUND == PRIO_ROUND - 1 &&
+		    i < PRIO_NR / PRIO_WEIGHT * PRIO_ROUND)
+			CHECK(nbulk == (i + 1) / PRIO_ROUND);
+	}
+	CHECK(nbulk == PRIO_NR);
+
+	return session_close(&ts);
+}
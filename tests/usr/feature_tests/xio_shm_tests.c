@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* the context's counters published in shared memory */
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+
+#include "xio_feature_tests.h"
+#include "xio_stats_shm.h"
+
+#define SHM_NR			4
+#define SHM_LEN			(sizeof(struct xio_stats_shm) + \
+				 XIO_STATS_SHM_REG_SIZE)
+
+/*---------------------------------------------------------------------------*/
+/* shm_count								     */
+/*---------------------------------------------------------------------------*/
+/* the segments of this process */
+static int shm_count(void)
+{
+	char	path[64];
+	int	i, n = 0;
+
+	for (i = 0; i < 64; i++) {
+		sprintf(path, XIO_STATS_SHM_DIR "/" XIO_STATS_SHM_PREFIX
+			"%d.%d", (int)getpid(), i);
+		if (!access(path, F_OK))
+			n++;
+	}
+
+	return n;
+}
+
+/*---------------------------------------------------------------------------*/
+/* shm_stale								     */
+/*---------------------------------------------------------------------------*/
+/* leaves a segment behind as a process that died would */
+static int shm_stale(char *path)
+{
+	pid_t	pid;
+	int	fd;
+
+	pid = fork();
+	if (pid == 0)
+		_exit(0);
+	CHECK(pid > 0 && waitpid(pid, NULL, 0) == pid);
+	sprintf(path, XIO_STATS_SHM_DIR "/" XIO_STATS_SHM_PREFIX "%d.0",
+		(int)pid);
+	fd = open(path, O_RDWR | O_CREAT, 0644);
+	CHECK(fd >= 0);
+	close(fd);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* shm_find_entry							     */
+/*---------------------------------------------------------------------------*/
+static const struct xio_stats_shm_entry *shm_find_entry(
+		const struct xio_stats_shm *shm, enum xio_stat_scope scope,
+		const char *name)
+{
+	const char	*p = (const char *)(shm + 1);
+	const struct xio_stats_shm_entry *entry;
+	uint32_t	i;
+
+	for (i = 0; i < shm->reg_nr; i++, p += entry->len) {
+		entry = (const struct xio_stats_shm_entry *)p;
+		if (entry->scope == scope && !strcmp(entry->name, name))
+			return entry;
+	}
+
+	return NULL;
+}
+
+static int stats_shm(struct test_session *ts, struct xio_context *ctx,
+		     const char *stale)
+{
+	const struct xio_stats_shm_entry	*entry;
+	struct xio_stats_shm			*shm;
+	char					path[64];
+	uint64_t				tx_msgs = 0;
+	uint32_t				seq;
+	int					fd, i;
+
+	/* the newest segment of this process is the context's */
+	for (i = 63; i >= 0; i--) {
+		sprintf(path, XIO_STATS_SHM_DIR "/" XIO_STATS_SHM_PREFIX
+			"%d.%d", (int)getpid(), i);
+		if (!access(path, F_OK))
+			break;
+	}
+	CHECK(i >= 0);
+	CHECK(access(stale, F_OK) == -1);
+
+	fd = open(path, O_RDONLY);
+	CHECK(fd >= 0);
+	shm = (struct xio_stats_shm *)mmap(NULL, SHM_LEN, PROT_READ,
+					   MAP_SHARED, fd, 0);
+	close(fd);
+	CHECK(shm != MAP_FAILED);
+	CHECK(shm->magic == XIO_STATS_SHM_MAGIC);
+	CHECK(shm->version == XIO_STATS_SHM_VERSION);
+	CHECK(shm->size == sizeof(*shm));
+	CHECK(shm->pid == (int32_t)getpid());
+	CHECK(!strcmp(shm->name[0], "TX_MSG"));
+
+	CHECK(session_open(ts, ctx) == 0);
+	CHECK(session_wait(ts) == 0);
+	for (i = 0; i < SHM_NR; i++)
+		CHECK(xio_send_request(ts->conn,
+				       req_init(i, HDR_ECHO)) == 0);
+	WAIT_FOR(ctx, ts->nrsp == SHM_NR);
+
+	/* a reader's snapshot, taken while no update is under way */
+	do {
+		seq = shm->seq;
+		tx_msgs = shm->counter[0];
+	} while ((seq & 1) || seq != shm->seq);
+	CHECK(tx_msgs == SHM_NR);
+
+	/* the registry is exported periodically */
+	seq = shm->reg_seq;
+	WAIT_FOR(ctx, shm->reg_seq >= seq + 2);
+	CHECK(shm->reg_nr > 0 && shm->reg_dropped == 0);
+	entry = shm_find_entry(shm, XIO_STAT_SCOPE_CONNECTION, "TX_MSGS");
+	CHECK(entry && entry->owner == (uintptr_t)ts->conn);
+	CHECK(entry->value == SHM_NR);
+
+	munmap(shm, SHM_LEN);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* test_stats_shm							     */
+/*---------------------------------------------------------------------------*/
+/* no segment unless asked for. the first one published removes those of
+ * dead processes, and every one goes with its context
+ */
+int test_stats_shm(void)
+{
+	struct xio_context	*ctx;
+	struct test_session	ts;
+	char			stale[64];
+	int			enable, len = sizeof(enable);
+	int			nshm = shm_count();
+	int			retval;
+
+	CHECK(xio_get_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+			  XIO_OPTNAME_ENABLE_STATS_SHM, &enable, &len) == 0);
+	CHECK(enable == 0);
+	ctx = xio_context_create(NULL, 0, -1);
+	CHECK(ctx);
+	CHECK(shm_count() == nshm);
+	xio_context_destroy(ctx);
+
+	CHECK(shm_stale(stale) == 0);
+	enable = 1;
+	CHECK(xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+			  XIO_OPTNAME_ENABLE_STATS_SHM,
+			  &enable, sizeof(enable)) == 0);
+	ctx = xio_context_create(NULL, 0, -1);
+	enable = 0;
+	xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO, XIO_OPTNAME_ENABLE_STATS_SHM,
+		    &enable, sizeof(enable));
+	CHECK(ctx);
+	CHECK(shm_count() == nshm + 1);
+
+	memset(&ts, 0, sizeof(ts));
+	retval = stats_shm(&ts, ctx, stale);
+	if (ts.conn && !ts.teardown && session_close(&ts))
+		retval = -1;
+	xio_context_destroy(ctx);
+	unlink(stale);
+	CHECK(shm_count() == nshm);
+
+	return retval;
+}
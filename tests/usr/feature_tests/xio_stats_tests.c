@@ -0,0 +1,433 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* the statistics registry */
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "xio_feature_tests.h"
+
+#define STATS_NR		3
+#define LAT_NR			4	/* echoed, one held request follows */
+#define MS_NS			1000000ULL
+#define BD_RATE			2	/* one sampled in every BD_RATE */
+#define BD_NR			6	/* requests, BD_HELD is held */
+#define BD_HELD			3
+#define PERF_NR			8	/* echoed requests */
+#define PERF_STATS_NR		14	/* 4 events in 3 phases, 2 gauges */
+
+/*---------------------------------------------------------------------------*/
+/* test_query_stats							     */
+/*---------------------------------------------------------------------------*/
+struct stats_query {
+	struct test_session	*ts;
+	uint64_t		tx_msgs;
+	uint64_t		tx_bytes;
+	uint64_t		nexus_tx_tasks;
+	int			nstats;
+	int			nconn_stats;
+	int			nsession_stats;
+	int			pad;
+};
+
+static int stats_cb(const struct xio_stat *stat, void *user_context)
+{
+	struct stats_query *q = (struct stats_query *)user_context;
+
+	q->nstats++;
+	switch (stat->scope) {
+	case XIO_STAT_SCOPE_CONNECTION:
+		if (stat->owner != q->ts->conn)
+			break;
+		q->nconn_stats++;
+		if (!strcmp(stat->name, "TX_MSGS"))
+			q->tx_msgs = stat->value;
+		else if (!strcmp(stat->name, "TX_BYTES"))
+			q->tx_bytes = stat->value;
+		break;
+	case XIO_STAT_SCOPE_SESSION:
+		if (stat->owner == q->ts->session)
+			q->nsession_stats++;
+		break;
+	case XIO_STAT_SCOPE_NEXUS:
+		if (!strcmp(stat->name, "TX_TASKS"))
+			q->nexus_tx_tasks += stat->value;
+		break;
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+static int stop_cb(const struct xio_stat *stat, void *user_context)
+{
+	(*(int *)user_context)++;
+
+	return 7;
+}
+
+/* a session of its own, its connection counts exactly what it sent. every
+ * scope is listed, more than the 16 counters the fixed table held
+ */
+static int query_stats(struct test_session *ts, struct xio_context *ctx)
+{
+	struct stats_query	q;
+	int			ncalls = 0;
+	int			i;
+
+	CHECK(session_open(ts, ctx) == 0);
+	CHECK(session_wait(ts) == 0);
+	for (i = 0; i < STATS_NR; i++)
+		CHECK(xio_send_request(ts->conn,
+				       req_init(i, HDR_ECHO)) == 0);
+	WAIT_FOR(ctx, ts->nrsp == STATS_NR);
+
+	memset(&q, 0, sizeof(q));
+	q.ts = ts;
+	CHECK(xio_query_stats(ctx, stats_cb, &q) == 0);
+	CHECK(q.nconn_stats > 0);
+	CHECK(q.nsession_stats > 0);
+	CHECK(q.tx_msgs == STATS_NR);
+	CHECK(q.tx_bytes == STATS_NR * strlen(HDR_ECHO));
+	CHECK(q.nexus_tx_tasks >= STATS_NR);
+	CHECK(q.nstats > 16);
+
+	/* a nonzero callback value ends the enumeration */
+	CHECK(xio_query_stats(ctx, stop_cb, &ncalls) == 7);
+	CHECK(ncalls == 1);
+	CHECK(xio_query_stats(ctx, NULL, NULL) == -1);
+
+	return 0;
+}
+
+int test_query_stats(struct xio_context *ctx)
+{
+	struct test_session	ts;
+	int			retval;
+
+	memset(&ts, 0, sizeof(ts));
+	retval = query_stats(&ts, ctx);
+	if (ts.conn && session_close(&ts))
+		retval = -1;
+
+	return retval;
+}
+
+/*---------------------------------------------------------------------------*/
+/* test_latency								     */
+/*---------------------------------------------------------------------------*/
+static int ctx_rtt_cb(const struct xio_stat *stat, void *user_context)
+{
+	if (stat->scope == XIO_STAT_SCOPE_CONTEXT &&
+	    stat->type == XIO_STAT_TYPE_LATENCY && !strcmp(stat->name, "RTT"))
+		*(struct xio_latency_stats *)user_context = stat->latency;
+
+	return 0;
+}
+
+/* a few quick round trips and one held by the server. the tail is the held
+ * one, the median is not. the client holds no request of its own
+ */
+static int latency(struct test_session *ts, struct xio_context *ctx)
+{
+	struct xio_connection_attr	attr;
+	struct xio_latency_stats	ctx_rtt;
+	int				i;
+
+	CHECK(session_open(ts, ctx) == 0);
+	CHECK(session_wait(ts) == 0);
+	for (i = 0; i < LAT_NR; i++)
+		CHECK(xio_send_request(ts->conn,
+				       req_init(i, HDR_ECHO)) == 0);
+	WAIT_FOR(ctx, ts->nrsp == LAT_NR);
+	CHECK(xio_send_request(ts->conn, req_init(LAT_NR, HDR_HOLD)) == 0);
+	WAIT_FOR(ctx, ts->nrsp == LAT_NR + 1);
+
+	memset(&attr, 0, sizeof(attr));
+	CHECK(xio_query_connection(ts->conn, &attr,
+				   XIO_CONNECTION_ATTR_LATENCY) == 0);
+	CHECK(attr.rtt.samples == LAT_NR + 1);
+	CHECK(attr.rtt.max_ns >= (HOLD_MS - 1) * MS_NS);
+	CHECK(attr.rtt.p50_ns < HOLD_MS * MS_NS / 2);
+	/* quantiles are bucket bounds, within an eighth */
+	CHECK(attr.rtt.p999_ns >= attr.rtt.max_ns / 8 * 7);
+	CHECK(attr.rtt.p999_ns <= attr.rtt.max_ns / 8 * 9);
+	CHECK(attr.rtt.mean_ns >= attr.rtt.max_ns / (LAT_NR + 1));
+	CHECK(attr.rtt.mean_ns < attr.rtt.max_ns);
+	CHECK(attr.queueing.samples == LAT_NR + 1);
+	CHECK(attr.app_hold.samples == 0);
+
+	/* the context aggregates its connections */
+	memset(&ctx_rtt, 0, sizeof(ctx_rtt));
+	CHECK(xio_query_stats(ctx, ctx_rtt_cb, &ctx_rtt) == 0);
+	CHECK(ctx_rtt.samples == LAT_NR + 1);
+	CHECK(ctx_rtt.max_ns == attr.rtt.max_ns);
+
+	/* modifying the attribute starts the period over */
+	CHECK(xio_modify_connection(ts->conn, &attr,
+				    XIO_CONNECTION_ATTR_LATENCY) == 0);
+	memset(&attr, 0, sizeof(attr));
+	CHECK(xio_query_connection(ts->conn, &attr,
+				   XIO_CONNECTION_ATTR_LATENCY) == 0);
+	CHECK(attr.rtt.samples == 0 && attr.rtt.max_ns == 0);
+	CHECK(attr.queueing.samples == 0);
+
+	return 0;
+}
+
+int test_latency(void)
+{
+	struct xio_context	*ctx;
+	struct test_session	ts;
+	int			retval;
+
+	/* a context of its own, its distributions hold only this session */
+	ctx = xio_context_create(NULL, 0, -1);
+	CHECK(ctx);
+	memset(&ts, 0, sizeof(ts));
+	retval = latency(&ts, ctx);
+	if (ts.conn && !ts.teardown && session_close(&ts))
+		retval = -1;
+	xio_context_destroy(ctx);
+
+	return retval;
+}
+
+/*---------------------------------------------------------------------------*/
+/* test_breakdown							     */
+/*---------------------------------------------------------------------------*/
+/* every other request is sampled. its stages add up to its round trip and
+ * the time the server held it shows as the server application's
+ */
+static int breakdown(struct test_session *ts, struct xio_context *ctx)
+{
+	struct xio_msg_breakdown	bd[BD_NR];
+	uint64_t			sum;
+	int				i, j, n;
+
+	CHECK(session_open(ts, ctx) == 0);
+	CHECK(session_wait(ts) == 0);
+	for (i = 0; i < BD_NR; i++) {
+		CHECK(xio_send_request(ts->conn,
+				       req_init(i, i == BD_HELD ?
+						HDR_HOLD : HDR_ECHO)) == 0);
+		WAIT_FOR(ctx, ts->nrsp == i + 1);
+	}
+
+	n = xio_connection_get_breakdowns(ts->conn, bd, BD_NR);
+	CHECK(n == BD_NR / BD_RATE);
+	for (i = 0; i < n; i++) {
+		CHECK(bd[i].user_context == &reqs[(i + 1) * BD_RATE - 1]);
+		if (i)
+			CHECK(bd[i].sn > bd[i - 1].sn);
+		for (j = 0, sum = 0; j < XIO_MSG_STAGE_NR; j++)
+			sum += bd[i].stage_ns[j];
+		/* the server's durations are packed, within 1/1024 */
+		CHECK(sum <= bd[i].total_ns + bd[i].total_ns / 512);
+		CHECK(sum >= bd[i].total_ns - bd[i].total_ns / 512);
+		if (bd[i].user_context == &reqs[BD_HELD])
+			CHECK(bd[i].stage_ns[XIO_MSG_STAGE_SERVER_APP] >=
+			      (HOLD_MS - 1) * MS_NS);
+		else
+			CHECK(bd[i].stage_ns[XIO_MSG_STAGE_SERVER_APP] <
+			      HOLD_MS * MS_NS / 2);
+	}
+
+	/* a breakdown is fetched once */
+	CHECK(xio_connection_get_breakdowns(ts->conn, bd, BD_NR) == 0);
+	CHECK(xio_connection_get_breakdowns(NULL, bd, 1) == -1);
+
+	return 0;
+}
+
+int test_breakdown(void)
+{
+	struct xio_context	*ctx;
+	struct test_session	ts;
+	int			rate = BD_RATE, none = 0;
+	int			retval;
+
+	CHECK(xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+			  XIO_OPTNAME_MSG_SAMPLE_RATE,
+			  &rate, sizeof(rate)) == 0);
+	ctx = xio_context_create(NULL, 0, -1);
+	CHECK(ctx);
+	memset(&ts, 0, sizeof(ts));
+	retval = breakdown(&ts, ctx);
+	if (ts.conn && !ts.teardown && session_close(&ts))
+		retval = -1;
+	xio_context_destroy(ctx);
+	xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO, XIO_OPTNAME_MSG_SAMPLE_RATE,
+		    &none, sizeof(none));
+
+	return retval;
+}
+
+/*---------------------------------------------------------------------------*/
+/* test_perf_counters							     */
+/*---------------------------------------------------------------------------*/
+struct perf_query {
+	struct xio_context	*ctx;
+	uint64_t		cycles;		/* scheduled and dispatch */
+	uint64_t		insns;		/* scheduled and dispatch */
+	uint64_t		ctx_switches;	/* any phase */
+	uint64_t		cycles_per_msg;
+	uint64_t		insns_per_msg;
+	int			nstats;
+	int			ngauges;
+};
+
+static int perf_cb(const struct xio_stat *stat, void *user_context)
+{
+	struct perf_query *q = (struct perf_query *)user_context;
+
+	if (stat->scope != XIO_STAT_SCOPE_CONTEXT || stat->owner != q->ctx ||
+	    strncmp(stat->name, "PERF_", 5))
+		return 0;
+
+	q->nstats++;
+	if (stat->type == XIO_STAT_TYPE_GAUGE)
+		q->ngauges++;
+	if (!strcmp(stat->name, "PERF_CYCLES_SCHED") ||
+	    !strcmp(stat->name, "PERF_CYCLES_DISPATCH"))
+		q->cycles += stat->value;
+	else if (!strcmp(stat->name, "PERF_INSNS_SCHED") ||
+		 !strcmp(stat->name, "PERF_INSNS_DISPATCH"))
+		q->insns += stat->value;
+	else if (!strncmp(stat->name, "PERF_CTX_SWITCHES_", 18))
+		q->ctx_switches += stat->value;
+	else if (!strcmp(stat->name, "PERF_CYCLES_PER_MSG"))
+		q->cycles_per_msg = stat->value;
+	else if (!strcmp(stat->name, "PERF_INSNS_PER_MSG"))
+		q->insns_per_msg = stat->value;
+
+	return 0;
+}
+
+/* whether this host lets a thread count the event in user space */
+static int perf_available(uint32_t type, uint64_t config)
+{
+	struct perf_event_attr	attr;
+	int			fd;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size		= sizeof(attr);
+	attr.type		= type;
+	attr.config		= config;
+	attr.exclude_kernel	= 1;
+	attr.exclude_hv		= 1;
+	fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	if (fd < 0)
+		return 0;
+	close(fd);
+
+	return 1;
+}
+
+/* each event is counted per loop phase and the work is divided by the
+ * messages. the values are checked for the events the host can count
+ */
+static int perf_counters(struct test_session *ts, struct xio_context *ctx)
+{
+	struct perf_query	q;
+	int			i;
+
+	CHECK(session_open(ts, ctx) == 0);
+	CHECK(session_wait(ts) == 0);
+	for (i = 0; i < PERF_NR; i++) {
+		CHECK(xio_send_request(ts->conn,
+				       req_init(i, HDR_ECHO)) == 0);
+		WAIT_FOR(ctx, ts->nrsp == i + 1);
+	}
+
+	memset(&q, 0, sizeof(q));
+	q.ctx = ctx;
+	CHECK(xio_query_stats(ctx, perf_cb, &q) == 0);
+	CHECK(q.nstats == PERF_STATS_NR);
+	CHECK(q.ngauges == 2);
+
+	if (perf_available(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES)) {
+		CHECK(q.cycles > 0);
+		CHECK(q.cycles_per_msg > 0);
+	}
+	if (perf_available(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS)) {
+		CHECK(q.insns > 0);
+		CHECK(q.insns_per_msg > 0);
+	}
+	/* the loop blocked in epoll_wait for each response */
+	if (perf_available(PERF_TYPE_SOFTWARE,
+			   PERF_COUNT_SW_CONTEXT_SWITCHES))
+		CHECK(q.ctx_switches > 0);
+
+	return 0;
+}
+
+int test_perf_counters(void)
+{
+	struct xio_context	*ctx;
+	struct test_session	ts;
+	struct perf_query	q;
+	int			enable = 1, none = 0;
+	int			retval;
+
+	/* off by default - a context has no such statistics */
+	ctx = xio_context_create(NULL, 0, -1);
+	CHECK(ctx);
+	memset(&q, 0, sizeof(q));
+	q.ctx = ctx;
+	retval = xio_query_stats(ctx, perf_cb, &q);
+	xio_context_destroy(ctx);
+	CHECK(retval == 0 && q.nstats == 0);
+
+	CHECK(xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+			  XIO_OPTNAME_ENABLE_PERF_COUNTERS,
+			  &enable, sizeof(enable)) == 0);
+	ctx = xio_context_create(NULL, 0, -1);
+	CHECK(ctx);
+	memset(&ts, 0, sizeof(ts));
+	retval = perf_counters(&ts, ctx);
+	if (ts.conn && !ts.teardown && session_close(&ts))
+		retval = -1;
+	xio_context_destroy(ctx);
+	xio_set_opt(NULL, XIO_OPTLEVEL_ACCELIO,
+		    XIO_OPTNAME_ENABLE_PERF_COUNTERS, &none, sizeof(none));
+
+	return retval;
+}
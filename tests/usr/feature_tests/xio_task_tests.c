@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* task layout and task pools, seen from inside the library */
+#include <libxio.h>
+#include <xio_os.h>
+#include "xio_log.h"
+#include "xio_common.h"
+#include "xio_protocol.h"
+#include "xio_mbuf.h"
+#include "xio_task.h"
+#include "xio_observer.h"
+#include "xio_ev_data.h"
+#include "xio_objpool.h"
+#include "xio_workqueue.h"
+#include "xio_context.h"
+
+#include "xio_feature_tests.h"
+
+#define CACHE_LINE(off)		((off) / L1_CACHE_BYTES)
+#define CONTIG_NR		8
+#define CONTIG_SIZE		1024
+#define LEAN_SHRINK_MS		5000	/* the pools shrink period */
+#define LEAN_IDLE_NR		2	/* a posted receive and the last one */
+
+static uint8_t			contig_buf[CONTIG_SIZE];
+
+/*---------------------------------------------------------------------------*/
+/* tasks_aligned							     */
+/*---------------------------------------------------------------------------*/
+/* every task of the pool starts on a cache line. returns the number of
+ * tasks, -1 if one does not
+ */
+static int tasks_aligned(struct xio_tasks_pool *pool)
+{
+	struct xio_tasks_slab	*slab;
+	uint32_t		i;
+	int			ntasks = 0;
+
+	list_for_each_entry(slab, &pool->slabs_list, slabs_list_entry) {
+		for (i = 0; i < slab->nr; i++) {
+			CHECK(((uintptr_t)slab->array[i] &
+			       (L1_CACHE_BYTES - 1)) == 0);
+			ntasks++;
+		}
+	}
+
+	return ntasks;
+}
+
+/*---------------------------------------------------------------------------*/
+/* test_task_layout							     */
+/*---------------------------------------------------------------------------*/
+/* the fields every send and receive touches fill the first two cache lines
+ * of a task, the rest follows them. the harness context has tasks by now
+ */
+int test_task_layout(struct test_session *ts)
+{
+	struct xio_tasks_pool	*pool;
+
+	CHECK(CACHE_LINE(offsetof(struct xio_task, omsg)) == 0);
+	CHECK(CACHE_LINE(offsetof(struct xio_task, connection)) == 0);
+	CHECK(offsetof(struct xio_task, mbuf) <= 2 * L1_CACHE_BYTES);
+	CHECK(offsetof(struct xio_task, in_receipt) >
+	      offsetof(struct xio_task, imsg));
+	CHECK(offsetof(struct xio_task, magic) >
+	      offsetof(struct xio_task, imsg));
+
+	pool = ts->ctx->primary_tasks_pool[XIO_PROTO_TCP];
+	CHECK(pool);
+	CHECK(tasks_aligned(pool) > 0);
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* test_contig_slabs							     */
+/*---------------------------------------------------------------------------*/
+/* with contig_task_slabs the tcp inline buffers are carved from the slab
+ * region, ahead of the tasks, and requests with data still go through
+ */
+static int contig_slabs(struct test_session *ts, struct xio_context *ctx)
+{
+	struct xio_tasks_pool	*pool;
+	struct xio_tasks_slab	*slab;
+	struct xio_msg		*req;
+	int			i;
+
+	CHECK(session_open(ts, ctx) == 0);
+	CHECK(session_wait(ts) == 0);
+	for (i = 0; i < CONTIG_NR; i++) {
+		req = req_init(i, HDR_ECHO);
+		req->out.data_iov.nents			= 1;
+		req->out.data_iov.sglist[0].iov_base	= contig_buf;
+		req->out.data_iov.sglist[0].iov_len	= CONTIG_SIZE;
+		CHECK(xio_send_request(ts->conn, req) == 0);
+	}
+	WAIT_FOR(ctx, ts->nrsp == CONTIG_NR);
+	CHECK(ts->nerr == 0);
+
+	pool = ctx->primary_tasks_pool[XIO_PROTO_TCP];
+	CHECK(pool);
+	list_for_each_entry(slab, &pool->slabs_list, slabs_list_entry) {
+		CHECK(slab->inline_bufs && slab->inline_sz);
+		CHECK((char *)slab->array[0] >=
+		      (char *)slab->inline_bufs + slab->inline_sz);
+	}
+	CHECK(tasks_aligned(pool) > 0);
+
+	return 0;
+}
+
+int test_contig_slabs(void)
+{
+	struct xio_context_params	params;
+	struct xio_context		*ctx;
+	struct test_session		ts;
+	int				retval;
+
+	memset(&params, 0, sizeof(params));
+	params.contig_task_slabs = 1;
+	ctx = xio_context_create(&params, 0, -1);
+	CHECK(ctx);
+
+	memset(&ts, 0, sizeof(ts));
+	retval = contig_slabs(&ts, ctx);
+	if (ts.conn && session_close(&ts))
+		retval = -1;
+	xio_context_destroy(ctx);
+
+	return retval;
+}
+
+/*---------------------------------------------------------------------------*/
+/* test_lean_conns							     */
+/*---------------------------------------------------------------------------*/
+/* an idle lean connection holds no receive window. the primary pool
+ * grows for a burst and gives the slabs back once they stayed unused for
+ * a whole shrink period
+ */
+static int lean_conns(struct test_session *ts, struct xio_context *ctx)
+{
+	struct xio_tasks_pool	*pool;
+	struct xio_msg		*req;
+	uint64_t		end;
+	unsigned int		peak_nr;
+	int			i;
+
+	CHECK(session_open(ts, ctx) == 0);
+	CHECK(session_wait(ts) == 0);
+	pool = ctx->primary_tasks_pool[XIO_PROTO_TCP];
+	CHECK(pool);
+	CHECK(pool->curr_used <= LEAN_IDLE_NR);
+	CHECK(pool->curr_alloced == pool->params.start_nr);
+
+	/* send completions are batched, only the last one is asked for now
+	 * so that the requests' tasks go back to the pool with it
+	 */
+	for (i = 0; i < MAX_REQS; i++) {
+		req = req_init(i, HDR_ECHO);
+		req->out.data_iov.nents			= 1;
+		req->out.data_iov.sglist[0].iov_base	= contig_buf;
+		req->out.data_iov.sglist[0].iov_len	= CONTIG_SIZE;
+		if (i == MAX_REQS - 1)
+			req->flags = XIO_MSG_FLAG_IMM_SEND_COMP;
+		CHECK(xio_send_request(ts->conn, req) == 0);
+	}
+	WAIT_FOR(ctx, ts->nrsp == MAX_REQS);
+	CHECK(ts->nerr == 0);
+	CHECK(pool->curr_alloced > pool->params.start_nr);
+	CHECK(tasks_aligned(pool) == (int)pool->curr_alloced);
+	peak_nr = pool->curr_alloced;
+
+	/* the burst is the peak of the first window, the second frees the
+	 * slabs the posted receive is not on
+	 */
+	end = now_ms() + 3 * LEAN_SHRINK_MS;
+	while (pool->curr_alloced == peak_nr && now_ms() < end)
+		xio_context_poll_wait(ctx, 10);
+	CHECK(pool->curr_alloced < peak_nr);
+	CHECK(pool->curr_alloced >= pool->params.start_nr);
+	CHECK(tasks_aligned(pool) == (int)pool->curr_alloced);
+	CHECK(pool->curr_used <= LEAN_IDLE_NR);
+
+	/* and grows again on demand */
+	for (i = 0; i < MAX_REQS; i++)
+		CHECK(xio_send_request(ts->conn, req_init(i, HDR_ECHO)) == 0);
+	WAIT_FOR(ctx, ts->nrsp == 2 * MAX_REQS);
+	CHECK(ts->nerr == 0);
+
+	return 0;
+}
+
+int test_lean_conns(void)
+{
+	struct xio_context_params	params;
+	struct xio_context		*ctx;
+	struct test_session		ts;
+	int				retval;
+
+	memset(&params, 0, sizeof(params));
+	params.lean_conns = 1;
+	ctx = xio_context_create(&params, 0, -1);
+	CHECK(ctx);
+
+	memset(&ts, 0, sizeof(ts));
+	retval = lean_conns(&ts, ctx);
+	if (ts.conn && session_close(&ts))
+		retval = -1;
+	xio_context_destroy(ctx);
+
+	return retval;
+}
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2013 Mellanox Technologies®. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file COPYING in the main
+ * directory of this source tree, or the Mellanox Technologies® BSD license
+ * below:
+ *
+ *      - Redistribution and use in source and binary forms, with or without
+ *        modification, are permitted provided that the following conditions
+ *        are met:
+ *
+ *      - Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ *      - Neither the name of the Mellanox Technologies® nor the names of its
+ *        contributors may be used to endorse or promote products derived from
+ *        this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* the static tracepoints placed in the library */
+#include <unistd.h>
+#include <fcntl.h>
+#include <elf.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "xio_feature_tests.h"
+
+#define NT_STAPSDT		3
+#define NOTE_ALIGN(n)		(((n) + 3) & ~3U)
+
+struct trace_probe {
+	const char	*name;
+	int		nargs;
+	int		found;
+};
+
+/*---------------------------------------------------------------------------*/
+/* trace_lib_path							     */
+/*---------------------------------------------------------------------------*/
+/* the library mapped into this process */
+static int trace_lib_path(char *path, size_t len)
+{
+	char	line[512];
+	char	*p;
+	FILE	*fp;
+	int	retval = -1;
+
+	fp = fopen("/proc/self/maps", "r");
+	CHECK(fp);
+	while (fgets(line, sizeof(line), fp)) {
+		p = strchr(line, '/');
+		if (!p || !strstr(p, "/libxio.so"))
+			continue;
+		p[strcspn(p, "\n")] = 0;
+		if (strlen(p) < len) {
+			strcpy(path, p);
+			retval = 0;
+		}
+		break;
+	}
+	fclose(fp);
+
+	return retval;
+}
+
+/*---------------------------------------------------------------------------*/
+/* trace_nargs								     */
+/*---------------------------------------------------------------------------*/
+/* the probe's arguments are space separated "size@operand" */
+static int trace_nargs(const char *args)
+{
+	int	n = 0;
+
+	while (*args) {
+		while (*args == ' ')
+			args++;
+		if (!*args)
+			break;
+		n++;
+		while (*args && *args != ' ')
+			args++;
+	}
+
+	return n;
+}
+
+/*---------------------------------------------------------------------------*/
+/* trace_scan_notes							     */
+/*---------------------------------------------------------------------------*/
+static int trace_scan_notes(const char *p, size_t size,
+			    struct trace_probe *probes, int probes_nr)
+{
+	const Elf64_Nhdr	*nhdr;
+	const char		*provider, *name, *args, *end = p + size;
+	int			i;
+
+	while (p + sizeof(*nhdr) <= end) {
+		nhdr = (const Elf64_Nhdr *)p;
+		p += sizeof(*nhdr);
+		CHECK(p + NOTE_ALIGN(nhdr->n_namesz) +
+		      NOTE_ALIGN(nhdr->n_descsz) <= end);
+		if (nhdr->n_type != NT_STAPSDT ||
+		    strcmp(p, "stapsdt") ||
+		    nhdr->n_descsz <= 3 * sizeof(Elf64_Addr)) {
+			p += NOTE_ALIGN(nhdr->n_namesz) +
+			     NOTE_ALIGN(nhdr->n_descsz);
+			continue;
+		}
+		/* pc, base and semaphore precede the strings */
+		provider = p + NOTE_ALIGN(nhdr->n_namesz) +
+			   3 * sizeof(Elf64_Addr);
+		name = provider + strlen(provider) + 1;
+		args = name + strlen(name) + 1;
+		p += NOTE_ALIGN(nhdr->n_namesz) + NOTE_ALIGN(nhdr->n_descsz);
+		if (strcmp(provider, "libxio"))
+			continue;
+		for (i = 0; i < probes_nr; i++) {
+			if (strcmp(name, probes[i].name))
+				continue;
+			CHECK(trace_nargs(args) == probes[i].nargs);
+			probes[i].found++;
+			break;
+		}
+		/* only the documented probes */
+		CHECK(i < probes_nr);
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* trace_scan								     */
+/*---------------------------------------------------------------------------*/
+static int trace_scan(const char *path, struct trace_probe *probes,
+		      int probes_nr)
+{
+	const Elf64_Ehdr	*ehdr;
+	const Elf64_Shdr	*shdr;
+	struct stat		st;
+	void			*map;
+	int			fd, i, retval = 0;
+
+	fd = open(path, O_RDONLY);
+	CHECK(fd >= 0);
+	if (fstat(fd, &st)) {
+		close(fd);
+		return -1;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	CHECK(map != MAP_FAILED);
+
+	ehdr = (const Elf64_Ehdr *)map;
+	if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) ||
+	    ehdr->e_ident[EI_CLASS] != ELFCLASS64 ||
+	    ehdr->e_shoff + (size_t)ehdr->e_shnum * sizeof(*shdr) >
+	    (size_t)st.st_size) {
+		fprintf(stderr, "%s: not a 64 bit elf object\n", path);
+		munmap(map, st.st_size);
+		return -1;
+	}
+	shdr = (const Elf64_Shdr *)((const char *)map + ehdr->e_shoff);
+	for (i = 0; i < ehdr->e_shnum && !retval; i++) {
+		if (shdr[i].sh_type != SHT_NOTE ||
+		    shdr[i].sh_offset + shdr[i].sh_size > (size_t)st.st_size)
+			continue;
+		retval = trace_scan_notes((const char *)map +
+					  shdr[i].sh_offset,
+					  shdr[i].sh_size, probes, probes_nr);
+	}
+	munmap(map, st.st_size);
+
+	return retval;
+}
+
+/*---------------------------------------------------------------------------*/
+/* test_tracepoints							     */
+/*---------------------------------------------------------------------------*/
+/* every probe of xio_trace.h with its arguments, or none when compiled out */
+int test_tracepoints(void)
+{
+	struct trace_probe probes[] = {
+		{"send_request",	4, 0},
+		{"connection_xmit",	4, 0},
+		{"tcp_xmit",		4, 0},
+		{"tcp_rx_data",		4, 0},
+		{"on_req_recv",		5, 0},
+		{"on_rsp_recv",		5, 0},
+		{"task_get",		3, 0},
+		{"task_put",		3, 0},
+		{"mempool_alloc",	4, 0},
+		{"mempool_free",	3, 0},
+		{"ev_dispatch",		3, 0},
+		{"ev_event",		3, 0},
+	};
+	int	probes_nr = sizeof(probes) / sizeof(probes[0]);
+	char	path[256];
+	int	i;
+
+	CHECK(!trace_lib_path(path, sizeof(path)));
+	CHECK(!trace_scan(path, probes, probes_nr));
+
+	for (i = 0; i < probes_nr; i++) {
+#ifdef XIO_CFLAG_TRACEPOINTS
+		if (!probes[i].found) {
+			fprintf(stderr, "probe %s is missing\n",
+				probes[i].name);
+			return -1;
+		}
+#else
+		CHECK(!probes[i].found);
+#endif
+	}
+
+	return 0;
+}